@@ -2,6 +2,7 @@
 #include <array>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <vector>
 #include <vulkan/vulkan_raii.hpp>
 
 namespace data
@@ -40,11 +41,11 @@ namespace data
   constexpr int    gridCount     = gridMax - gridMin + 1;
   constexpr size_t instanceCount = static_cast<size_t>( gridCount ) * gridCount * gridCount;
 
-  // Generate instances at compile time
-  constexpr auto createInstances()
+  // Generate instances at startup, a constexpr table of this size bloats the binary and the compile time
+  inline std::vector<InstanceData> createInstances()
   {
-    std::array<InstanceData, instanceCount> instancesPos{};
-    size_t                                  index = 0;
+    std::vector<InstanceData> instancesPos;
+    instancesPos.reserve( instanceCount );
 
     for ( int x = gridMin; x <= gridMax; ++x )
     {
@@ -52,7 +53,7 @@ namespace data
       {
         for ( int z = gridMin; z <= gridMax; ++z )
         {
-          instancesPos[index++] = InstanceData{ glm::vec3( float( x ) * 3.0f, float( y ) * 3.0f, float( z ) * 3.0f ) };
+          instancesPos.push_back( InstanceData{ glm::vec3( float( x ) * 3.0f, float( y ) * 3.0f, float( z ) * 3.0f ) } );
         }
       }
     }
@@ -60,6 +61,4 @@ namespace data
     return instancesPos;
   }
 
-  constexpr std::array<InstanceData, instanceCount> instancesPos = createInstances();
-
 }  // namespace data
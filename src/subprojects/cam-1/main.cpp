@@ -280,8 +280,9 @@ int main()
     // Copy vertex data to buffer (already mapped)
     memcpy( vertexBufferAllocInfo.pMappedData, data::triangleVertices.data(), static_cast<size_t>( bufferSize ) );
 
-    uint32_t     instanceCount      = static_cast<uint32_t>( data::instancesPos.size() );
-    VkDeviceSize instanceBufferSize = sizeof( data::InstanceData ) * data::instancesPos.size();
+    std::vector<data::InstanceData> instancesPos       = data::createInstances();
+    uint32_t                        instanceCount      = static_cast<uint32_t>( instancesPos.size() );
+    VkDeviceSize                    instanceBufferSize = sizeof( data::InstanceData ) * instancesPos.size();
 
     VkBufferCreateInfo instanceBufferInfo = {};
     instanceBufferInfo.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -296,7 +297,7 @@ int main()
     vmaCreateBuffer( allocator, &instanceBufferInfo, &allocInfo, &instanceBuffer, &instanceBufferAllocation, &instanceBufferAllocInfo );
 
     // Copy instance data to buffer
-    memcpy( instanceBufferAllocInfo.pMappedData, data::instancesPos.data(), static_cast<size_t>( instanceBufferSize ) );
+    memcpy( instanceBufferAllocInfo.pMappedData, instancesPos.data(), static_cast<size_t>( instanceBufferSize ) );
 
     vk::CommandPoolCreateInfo cmdPoolInfo{ vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamilyIndices.graphicsFamily.value() };
     vk::raii::CommandPool     commandPool{ deviceBundle.device, cmdPoolInfo };
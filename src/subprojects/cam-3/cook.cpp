@@ -0,0 +1,77 @@
+// Offline cook target: converts .obj, .gltf and .glb files to the .cmesh format of core/cooked.hpp, which
+// cam-3 loads by mapping the file and copying it to the GPU without parsing.
+//
+//   cam-3-cook [--force] [--no-optimize] [--threads N] <source> [output]
+//
+// The output defaults to the source with a .cmesh extension. Sources whose cook is current are skipped.
+#include "core/meshload.hpp"
+
+#include <charconv>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <print>
+#include <string_view>
+#include <vector>
+
+int main( int argc, char ** argv )
+{
+  bool                               force    = false;
+  bool                               optimize = true;
+  uint32_t                           threads  = 0;
+  std::vector<std::filesystem::path> paths;
+
+  for ( int i = 1; i < argc; ++i )
+  {
+    std::string_view arg = argv[i];
+    if ( arg == "--force" )
+      force = true;
+    else if ( arg == "--no-optimize" )
+      optimize = false;
+    else if ( arg == "--threads" && i + 1 < argc )
+    {
+      std::string_view value = argv[++i];
+      std::from_chars( value.data(), value.data() + value.size(), threads );
+    }
+    else
+      paths.emplace_back( arg );
+  }
+
+  if ( paths.empty() || paths.size() > 2 )
+  {
+    std::println( stderr, "usage: {} [--force] [--no-optimize] [--threads N] <source> [output]", argc > 0 ? argv[0] : "cam-3-cook" );
+    return 2;
+  }
+
+  std::filesystem::path const & source = paths[0];
+  std::filesystem::path         output = paths.size() > 1 ? paths[1] : core::cookedPathFor( source );
+
+  try
+  {
+    if ( !force && core::isCookCurrent( source, output, optimize ) )
+    {
+      std::println( "{} is current", output.string() );
+      return 0;
+    }
+
+    core::MeshLoadStats stats = core::cookMeshFile( source, output, threads, optimize );
+    std::println( "{} -> {}: {} vertices, {} triangles, {} meshlets, {} -> {} B in {:.1f} ms",
+                  source.string(),
+                  output.string(),
+                  stats.vertices,
+                  stats.triangles,
+                  stats.meshlets,
+                  stats.fileBytes,
+                  std::filesystem::file_size( output ),
+                  stats.cpuMs );
+    if ( optimize )
+      std::println(
+        "ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", stats.cacheBefore.acmr, stats.cacheAfter.acmr, stats.cacheBefore.atvr, stats.cacheAfter.atvr );
+  }
+  catch ( std::exception const & e )
+  {
+    std::println( stderr, "{}", e.what() );
+    return 1;
+  }
+  return 0;
+}
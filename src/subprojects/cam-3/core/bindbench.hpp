@@ -0,0 +1,178 @@
+#pragma once
+#include "../helper.hpp"
+#include "../setup.hpp"
+#include "../state.hpp"
+#include "binding.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <print>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Measures the CPU cost of rebinding per-draw descriptor sets every frame with a given BindingBackend.
+  //
+  // Every frame each of `draws` dispatches gets a fresh set of four input buffers and one output buffer,
+  // which is the worst case for classic pools (allocate + update + bind per draw) and the common case for
+  // descriptor buffers (write into mapped memory + set offset). bindbench.comp sums the inputs into
+  // output[draw] so the last frame is read back and checked against the expected bindings.
+  struct BindingBenchmark
+  {
+    static constexpr uint32_t InputCount   = 64;
+    static constexpr uint32_t InputsPerSet = 4;
+    static constexpr uint32_t BindingCount = InputsPerSet + 1;
+    static constexpr uint32_t MaxDraws     = 4096;
+
+    struct Result
+    {
+      BindingBackend backend        = BindingBackend::DescriptorSets;
+      uint32_t       draws          = 0;
+      uint32_t       frames         = 0;
+      float          cpuMsPerFrame  = 0.0f;  // beginFrame + allocate + write + bind + record, averaged
+      float          usPerDraw      = 0.0f;
+      float          wallMsPerFrame = 0.0f;  // submit until the fence signaled
+      uint32_t       mismatches     = 0;
+    };
+
+    uint32_t            draws  = 1024;
+    uint32_t            frames = 64;
+    std::vector<Result> results;
+
+    Result run( vk::raii::Device const &         device,
+                vk::raii::PhysicalDevice const & physicalDevice,
+                VmaAllocator                     allocator,
+                uint32_t                         queueFamily,
+                vk::raii::Queue const &          queue,
+                BindingBackend                   backend )
+    {
+      draws = std::clamp( draws, 1u, MaxDraws );
+
+      DynamicBinder binder;
+      binder.init( device, physicalDevice, allocator, backend, BindingCount, draws );
+
+      vk::PushConstantRange        pushRange{ vk::ShaderStageFlagBits::eCompute, 0, sizeof( uint32_t ) };
+      vk::PipelineLayoutCreateInfo layoutInfo{};
+      layoutInfo.setSetLayouts( *binder.layout ).setPushConstantRanges( pushRange );
+      vk::raii::PipelineLayout pipelineLayout( device, layoutInfo );
+
+      std::vector<uint32_t>   code = core::help::getShaderCode( "bindbench.comp" );
+      vk::ShaderCreateInfoEXT shaderInfo{};
+      shaderInfo.setStage( vk::ShaderStageFlagBits::eCompute )
+        .setCodeType( vk::ShaderCodeTypeEXT::eSpirv )
+        .setPCode( code.data() )
+        .setCodeSize( code.size() * sizeof( uint32_t ) )
+        .setPName( "main" )
+        .setSetLayouts( *binder.layout )
+        .setPushConstantRanges( pushRange );
+      vk::raii::ShaderEXT shader( device, shaderInfo );
+
+      // Small input buffers holding i + 1, so every binding combination produces a distinct sum
+      constexpr vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+      std::array<core::Buffer, InputCount> inputs;
+      std::array<BufferRange, InputCount>  inputRanges;
+      for ( uint32_t i = 0; i < InputCount; ++i )
+      {
+        inputs[i] =
+          core::createBuffer( allocator, sizeof( uint32_t ), usage, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT );
+        *static_cast<uint32_t *>( inputs[i].allocationInfo.pMappedData ) = i + 1;
+        vmaFlushAllocation( allocator, inputs[i].allocation, 0, VK_WHOLE_SIZE );
+        inputRanges[i] = { inputs[i].buffer, device.getBufferAddress( vk::BufferDeviceAddressInfo{ inputs[i].buffer } ), sizeof( uint32_t ) };
+      }
+
+      core::Buffer output =
+        core::createBuffer( allocator, sizeof( uint32_t ) * draws, usage, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT );
+      BufferRange outputRange{ output.buffer, device.getBufferAddress( vk::BufferDeviceAddressInfo{ output.buffer } ), sizeof( uint32_t ) * draws };
+
+      vk::raii::CommandPool   pool( device, vk::CommandPoolCreateInfo{ vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamily } );
+      vk::raii::CommandBuffer cmd = std::move( vk::raii::CommandBuffers( device, vk::CommandBufferAllocateInfo{ pool, vk::CommandBufferLevel::ePrimary, 1 } ).front() );
+      vk::raii::Fence         fence( device, vk::FenceCreateInfo{} );
+
+      auto inputFor = [&]( uint32_t frame, uint32_t draw, uint32_t k ) { return ( draw * InputsPerSet + k + frame ) % InputCount; };
+
+      double cpuMs  = 0.0;
+      double wallMs = 0.0;
+      for ( uint32_t frame = 0; frame < frames; ++frame )
+      {
+        auto cpuBegin = std::chrono::steady_clock::now();
+
+        binder.beginFrame( frame % global::state::MAX_FRAMES_IN_FLIGHT );
+
+        cmd.reset();
+        cmd.begin( vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+        cmd.bindShadersEXT( vk::ShaderStageFlagBits::eCompute, *shader );
+        binder.bindBuffers( cmd );
+
+        std::array<BufferRange, BindingCount> ranges;
+        ranges[InputsPerSet] = outputRange;
+        for ( uint32_t draw = 0; draw < draws; ++draw )
+        {
+          for ( uint32_t k = 0; k < InputsPerSet; ++k )
+            ranges[k] = inputRanges[inputFor( frame, draw, k )];
+
+          DynamicBinder::Set set = binder.allocate();
+          binder.write( set, ranges );
+          binder.bind( cmd, *pipelineLayout, vk::PipelineBindPoint::eCompute, set );
+          cmd.pushConstants<uint32_t>( *pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, draw );
+          cmd.dispatch( 1, 1, 1 );
+        }
+
+        vk::MemoryBarrier2 toHost{};
+        toHost.setSrcStageMask( vk::PipelineStageFlagBits2::eComputeShader )
+          .setSrcAccessMask( vk::AccessFlagBits2::eShaderStorageWrite )
+          .setDstStageMask( vk::PipelineStageFlagBits2::eHost )
+          .setDstAccessMask( vk::AccessFlagBits2::eHostRead );
+        cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( toHost ) );
+        cmd.end();
+
+        auto cpuEnd = std::chrono::steady_clock::now();
+        cpuMs += std::chrono::duration<double, std::milli>( cpuEnd - cpuBegin ).count();
+
+        vk::CommandBufferSubmitInfo cmdInfo{ *cmd };
+        queue.submit2( vk::SubmitInfo2{}.setCommandBufferInfos( cmdInfo ), *fence );
+        (void)device.waitForFences( *fence, VK_TRUE, UINT64_MAX );
+        device.resetFences( *fence );
+        wallMs += std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - cpuEnd ).count();
+      }
+
+      Result result{};
+      result.backend        = backend;
+      result.draws          = draws;
+      result.frames         = frames;
+      result.cpuMsPerFrame  = static_cast<float>( cpuMs / frames );
+      result.usPerDraw      = result.cpuMsPerFrame * 1000.0f / draws;
+      result.wallMsPerFrame = static_cast<float>( wallMs / frames );
+
+      // Verify the last frame
+      vmaInvalidateAllocation( allocator, output.allocation, 0, VK_WHOLE_SIZE );
+      auto const * values = static_cast<uint32_t const *>( output.allocationInfo.pMappedData );
+      for ( uint32_t draw = 0; draw < draws; ++draw )
+      {
+        uint32_t expected = 0;
+        for ( uint32_t k = 0; k < InputsPerSet; ++k )
+          expected += inputFor( frames - 1, draw, k ) + 1;
+        if ( values[draw] != expected )
+          result.mismatches++;
+      }
+
+      isDebug( std::println( "[bindbench] {}: {} draws, {:.3f} ms/frame CPU, {:.3f} us/draw, {} mismatches",
+                             toString( backend ),
+                             draws,
+                             result.cpuMsPerFrame,
+                             result.usPerDraw,
+                             result.mismatches ) );
+
+      for ( auto & input : inputs )
+        core::destroyBuffer( allocator, input );
+      core::destroyBuffer( allocator, output );
+      binder.destroy();
+
+      results.push_back( result );
+      return result;
+    }
+  };
+}  // namespace core
@@ -0,0 +1,228 @@
+#pragma once
+#include "../features.hpp"
+#include "../setup.hpp"
+#include "../state.hpp"
+#include "../structs.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // How per-draw descriptor sets that change every frame are provided to shaders.
+  // Only BindingBenchmark binds through a DynamicBinder: the render and compute passes read everything through the
+  // bindless heap, so neither backend is used to draw the scene.
+  enum class BindingBackend : uint8_t
+  {
+    DescriptorSets,    // classic pools, vkAllocateDescriptorSets + vkUpdateDescriptorSets + vkCmdBindDescriptorSets
+    DescriptorBuffer,  // VK_EXT_descriptor_buffer, descriptors written into mapped memory, bound by offset
+  };
+
+  [[nodiscard]] inline const char * toString( BindingBackend backend )
+  {
+    return backend == BindingBackend::DescriptorBuffer ? "Descriptor buffer" : "Descriptor sets";
+  }
+
+  // Best backend the device supports, descriptor buffers when VK_EXT_descriptor_buffer was enabled. Reported in the
+  // Binding Backends window, the benchmark itself runs every supported backend.
+  [[nodiscard]] inline BindingBackend preferredBindingBackend()
+  {
+    return cfg::supported.descriptorBuffer ? BindingBackend::DescriptorBuffer : BindingBackend::DescriptorSets;
+  }
+
+  struct BufferRange
+  {
+    vk::Buffer        buffer;
+    vk::DeviceAddress address = 0;  // needed by the descriptor buffer backend
+    vk::DeviceSize    range   = 0;  // explicit size, descriptor buffers do not accept VK_WHOLE_SIZE
+  };
+
+  // Per-frame descriptor sets of storage buffers (one descriptor per binding, binding i = buffers[i]).
+  // Every frame slot owns room for `setsPerFrame` sets, beginFrame() recycles the slot wholesale:
+  //   DescriptorSets   - one pool per slot, reset at the start of the frame
+  //   DescriptorBuffer - one region of a mapped descriptor buffer per slot, sets are aligned offsets into it
+  struct DynamicBinder
+  {
+    // Handle of one set for the current frame
+    struct Set
+    {
+      vk::DescriptorSet set    = nullptr;
+      vk::DeviceSize    offset = 0;
+    };
+
+    BindingBackend                backend      = BindingBackend::DescriptorSets;
+    vk::raii::DescriptorSetLayout layout       = nullptr;
+    uint32_t                      bindingCount = 0;
+    uint32_t                      setsPerFrame = 0;
+
+    void init( vk::raii::Device const &         device_,
+               vk::raii::PhysicalDevice const & physicalDevice,
+               VmaAllocator                     allocator_,
+               BindingBackend                   backend_,
+               uint32_t                         bindingCount_,
+               uint32_t                         setsPerFrame_ )
+    {
+      if ( backend_ == BindingBackend::DescriptorBuffer && !cfg::supported.descriptorBuffer )
+        throw std::runtime_error( "VK_EXT_descriptor_buffer is not enabled on this device" );
+      if ( bindingCount_ > MaxBindings )
+        throw std::runtime_error( "DynamicBinder supports at most 16 bindings per set" );
+
+      device       = &device_;
+      allocator    = allocator_;
+      backend      = backend_;
+      bindingCount = bindingCount_;
+      setsPerFrame = setsPerFrame_;
+
+      std::vector<vk::DescriptorSetLayoutBinding> bindings( bindingCount );
+      for ( uint32_t i = 0; i < bindingCount; ++i )
+        bindings[i].setBinding( i ).setDescriptorType( vk::DescriptorType::eStorageBuffer ).setDescriptorCount( 1 ).setStageFlags( vk::ShaderStageFlagBits::eAll );
+
+      vk::DescriptorSetLayoutCreateInfo layoutInfo{};
+      layoutInfo.setBindings( bindings );
+      if ( backend == BindingBackend::DescriptorBuffer )
+        layoutInfo.setFlags( vk::DescriptorSetLayoutCreateFlagBits::eDescriptorBufferEXT );
+      layout = vk::raii::DescriptorSetLayout( *device, layoutInfo );
+
+      if ( backend == BindingBackend::DescriptorSets )
+      {
+        vk::DescriptorPoolSize       poolSize{ vk::DescriptorType::eStorageBuffer, setsPerFrame * bindingCount };
+        vk::DescriptorPoolCreateInfo poolInfo{};
+        poolInfo.setMaxSets( setsPerFrame ).setPoolSizes( poolSize );
+        pools.clear();
+        for ( size_t i = 0; i < global::state::MAX_FRAMES_IN_FLIGHT; ++i )
+          pools.emplace_back( *device, poolInfo );
+        return;
+      }
+
+      auto props = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorBufferPropertiesEXT>()
+                     .get<vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+
+      // robustBufferAccess is enabled, storage buffer descriptors use the robust size
+      descriptorSize = props.robustStorageBufferDescriptorSize;
+      setStride      = alignUp( layout.getSizeEXT(), props.descriptorBufferOffsetAlignment );
+
+      bindingOffsets.resize( bindingCount );
+      for ( uint32_t i = 0; i < bindingCount; ++i )
+        bindingOffsets[i] = layout.getBindingOffsetEXT( i );
+
+      descriptorBuffer  = core::createBuffer( allocator,
+                                             setStride * setsPerFrame * global::state::MAX_FRAMES_IN_FLIGHT,
+                                             vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                                             VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT );
+      descriptorAddress = device->getBufferAddress( vk::BufferDeviceAddressInfo{ descriptorBuffer.buffer } );
+    }
+
+    void destroy()
+    {
+      core::destroyBuffer( allocator, descriptorBuffer );
+      pools.clear();
+      layout = nullptr;
+    }
+
+    // Recycle everything allocated the last time this frame slot was used, its fence must have signaled
+    void beginFrame( uint32_t frameSlot )
+    {
+      slot   = frameSlot;
+      cursor = 0;
+      if ( backend == BindingBackend::DescriptorSets )
+        pools[slot].reset();
+    }
+
+    [[nodiscard]] Set allocate()
+    {
+      if ( cursor >= setsPerFrame )
+        throw std::runtime_error( "DynamicBinder: more sets than setsPerFrame requested in one frame" );
+
+      Set result{};
+      if ( backend == BindingBackend::DescriptorSets )
+      {
+        vk::DescriptorSetAllocateInfo allocInfo{};
+        allocInfo.setDescriptorPool( *pools[slot] ).setSetLayouts( *layout );
+        result.set = ( **device ).allocateDescriptorSets( allocInfo ).front();
+      }
+      else
+      {
+        result.offset = setStride * ( static_cast<vk::DeviceSize>( slot ) * setsPerFrame + cursor );
+      }
+      cursor++;
+      return result;
+    }
+
+    void write( Set const & set, std::span<const BufferRange> buffers )
+    {
+      if ( backend == BindingBackend::DescriptorSets )
+      {
+        std::array<vk::DescriptorBufferInfo, MaxBindings> infos{};
+        std::array<vk::WriteDescriptorSet, MaxBindings>   writes{};
+        for ( uint32_t i = 0; i < buffers.size(); ++i )
+        {
+          infos[i] = vk::DescriptorBufferInfo{ buffers[i].buffer, 0, buffers[i].range };
+          writes[i].setDstSet( set.set ).setDstBinding( i ).setDescriptorType( vk::DescriptorType::eStorageBuffer ).setBufferInfo( infos[i] );
+        }
+        ( **device ).updateDescriptorSets( vk::ArrayProxy<const vk::WriteDescriptorSet>( static_cast<uint32_t>( buffers.size() ), writes.data() ), {} );
+        return;
+      }
+
+      auto * base = static_cast<std::byte *>( descriptorBuffer.allocationInfo.pMappedData ) + set.offset;
+      for ( uint32_t i = 0; i < buffers.size(); ++i )
+      {
+        vk::DescriptorAddressInfoEXT addressInfo{ buffers[i].address, buffers[i].range };
+        vk::DescriptorGetInfoEXT     getInfo{ vk::DescriptorType::eStorageBuffer, vk::DescriptorDataEXT{}.setPStorageBuffer( &addressInfo ) };
+        device->getDescriptorEXT( getInfo, descriptorSize, base + bindingOffsets[i] );
+      }
+      // HOST_ACCESS_SEQUENTIAL_WRITE may land in non-coherent memory, a no-op where it is coherent
+      if ( vmaFlushAllocation( allocator, descriptorBuffer.allocation, set.offset, setStride ) != VK_SUCCESS )
+        throw std::runtime_error( "vmaFlushAllocation failed for the descriptor buffer" );
+    }
+
+    // Once per command buffer, before the first bind()
+    void bindBuffers( vk::raii::CommandBuffer const & cmd ) const
+    {
+      if ( backend == BindingBackend::DescriptorBuffer )
+        cmd.bindDescriptorBuffersEXT(
+          vk::DescriptorBufferBindingInfoEXT{ descriptorAddress, vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT } );
+    }
+
+    void bind( vk::raii::CommandBuffer const & cmd, vk::PipelineLayout pipelineLayout, vk::PipelineBindPoint bindPoint, Set const & set ) const
+    {
+      if ( backend == BindingBackend::DescriptorSets )
+      {
+        cmd.bindDescriptorSets( bindPoint, pipelineLayout, 0, set.set, {} );
+        return;
+      }
+
+      uint32_t bufferIndex = 0;
+      cmd.setDescriptorBufferOffsetsEXT( bindPoint, pipelineLayout, 0, bufferIndex, set.offset );
+    }
+
+  private:
+    static constexpr uint32_t MaxBindings = 16;
+
+    vk::raii::Device const * device    = nullptr;
+    VmaAllocator             allocator = nullptr;
+
+    uint32_t slot   = 0;
+    uint32_t cursor = 0;
+
+    // DescriptorSets, one pool per frame slot
+    std::vector<vk::raii::DescriptorPool> pools;
+
+    // DescriptorBuffer
+    core::Buffer                descriptorBuffer;
+    vk::DeviceAddress           descriptorAddress = 0;
+    vk::DeviceSize              setStride         = 0;
+    size_t                      descriptorSize    = 0;
+    std::vector<vk::DeviceSize> bindingOffsets;
+
+    static vk::DeviceSize alignUp( vk::DeviceSize value, vk::DeviceSize alignment )
+    {
+      return ( value + alignment - 1 ) & ~( alignment - 1 );
+    }
+  };
+}  // namespace core
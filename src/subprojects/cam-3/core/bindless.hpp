@@ -0,0 +1,317 @@
+#pragma once
+#include "../state.hpp"
+#include "resources.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Slots of one resource inside the bindless heap, InvalidBindlessIndex where the resource is not visible
+  inline constexpr uint32_t InvalidBindlessIndex = UINT32_MAX;
+
+  struct BindlessSlots
+  {
+    uint32_t sampledImage  = InvalidBindlessIndex;
+    uint32_t storageImage  = InvalidBindlessIndex;
+    uint32_t sampler       = InvalidBindlessIndex;
+    uint32_t storageBuffer = InvalidBindlessIndex;
+  };
+
+  // One global descriptor set with update-after-bind, partially bound arrays for every resource type.
+  //
+  //   set = 0, binding = 0   texture2D     sampledImages[]
+  //   set = 0, binding = 1   image2D       storageImages[]
+  //   set = 0, binding = 2   sampler       samplers[]
+  //   set = 0, binding = 3   buffer        storageBuffers[]
+  //
+  // The set is bound once per command buffer, draws select resources by writing indices into push constants.
+  // Freed slots are recycled only after MAX_FRAMES_IN_FLIGHT frames so a pending command buffer never sees
+  // a descriptor change under it (UPDATE_UNUSED_WHILE_PENDING only covers slots nobody reads).
+  struct BindlessHeap
+  {
+    enum Binding : uint32_t
+    {
+      SampledImages  = 0,
+      StorageImages  = 1,
+      Samplers       = 2,
+      StorageBuffers = 3,
+      BindingCount
+    };
+
+    // Upper bounds, clamped to the update-after-bind limits of the device in init()
+    static constexpr std::array<uint32_t, BindingCount> DesiredCapacity = { 16384, 4096, 256, 16384 };
+
+    vk::raii::DescriptorSetLayout layout = nullptr;
+    vk::raii::DescriptorPool      pool   = nullptr;
+    vk::DescriptorSet             set    = nullptr;  // owned by the pool
+
+    std::array<uint32_t, BindingCount> capacity{};
+
+    void init( vk::raii::Device const & device_, vk::raii::PhysicalDevice const & physicalDevice )
+    {
+      device = *device_;
+
+      auto props  = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+      auto limits = props.get<vk::PhysicalDeviceVulkan12Properties>();
+
+      capacity[SampledImages]  = std::min( DesiredCapacity[SampledImages], limits.maxDescriptorSetUpdateAfterBindSampledImages );
+      capacity[StorageImages]  = std::min( DesiredCapacity[StorageImages], limits.maxDescriptorSetUpdateAfterBindStorageImages );
+      capacity[Samplers]       = std::min( DesiredCapacity[Samplers], limits.maxDescriptorSetUpdateAfterBindSamplers );
+      capacity[StorageBuffers] = std::min( DesiredCapacity[StorageBuffers], limits.maxDescriptorSetUpdateAfterBindStorageBuffers );
+
+      constexpr std::array<vk::DescriptorType, BindingCount> types = {
+        vk::DescriptorType::eSampledImage, vk::DescriptorType::eStorageImage, vk::DescriptorType::eSampler, vk::DescriptorType::eStorageBuffer };
+
+      std::array<vk::DescriptorSetLayoutBinding, BindingCount> bindings{};
+      std::array<vk::DescriptorBindingFlags, BindingCount>     bindingFlags{};
+      std::array<vk::DescriptorPoolSize, BindingCount>         poolSizes{};
+      for ( uint32_t i = 0; i < BindingCount; ++i )
+      {
+        bindings[i].setBinding( i ).setDescriptorType( types[i] ).setDescriptorCount( capacity[i] ).setStageFlags( vk::ShaderStageFlagBits::eAll );
+        bindingFlags[i] = vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::ePartiallyBound |
+                          vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+        poolSizes[i] = vk::DescriptorPoolSize{ types[i], capacity[i] };
+      }
+
+      vk::DescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+      flagsInfo.setBindingFlags( bindingFlags );
+
+      vk::DescriptorSetLayoutCreateInfo layoutInfo{};
+      layoutInfo.setFlags( vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool ).setBindings( bindings ).setPNext( &flagsInfo );
+      layout = vk::raii::DescriptorSetLayout( device_, layoutInfo );
+
+      vk::DescriptorPoolCreateInfo poolInfo{};
+      poolInfo.setFlags( vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind ).setMaxSets( 1 ).setPoolSizes( poolSizes );
+      pool = vk::raii::DescriptorPool( device_, poolInfo );
+
+      vk::DescriptorSetAllocateInfo allocInfo{};
+      allocInfo.setDescriptorPool( *pool ).setSetLayouts( *layout );
+      set = device.allocateDescriptorSets( allocInfo ).front();
+
+      for ( uint32_t i = 0; i < BindingCount; ++i )
+      {
+        slots[i].next = 0;
+        slots[i].free.clear();
+      }
+    }
+
+    [[nodiscard]] uint32_t addSampledImage( vk::ImageView view, vk::ImageLayout imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal )
+    {
+      uint32_t index = acquire( SampledImages );
+      writeImage( SampledImages, index, view, imageLayout );
+      return index;
+    }
+
+    [[nodiscard]] uint32_t addStorageImage( vk::ImageView view )
+    {
+      uint32_t index = acquire( StorageImages );
+      writeImage( StorageImages, index, view, vk::ImageLayout::eGeneral );
+      return index;
+    }
+
+    [[nodiscard]] uint32_t addSampler( vk::Sampler sampler )
+    {
+      uint32_t index = acquire( Samplers );
+      writeSampler( index, sampler );
+      return index;
+    }
+
+    [[nodiscard]] uint32_t addStorageBuffer( vk::Buffer buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE )
+    {
+      uint32_t index = acquire( StorageBuffers );
+      writeBuffer( index, buffer, offset, range );
+      return index;
+    }
+
+    // The slot becomes reusable once every frame that could have referenced it has retired
+    void remove( Binding binding, uint32_t index, uint64_t frame )
+    {
+      if ( index != InvalidBindlessIndex )
+        retired.push_back( { binding, index, frame } );
+    }
+
+    void collect( uint64_t frame )
+    {
+      std::erase_if(
+        retired,
+        [&]( Retired const & r )
+        {
+          if ( frame - r.frame < global::state::MAX_FRAMES_IN_FLIGHT )
+            return false;
+          slots[r.binding].free.push_back( r.index );
+          return true;
+        } );
+    }
+
+    // Make a ResourceTable entry visible to shaders, storage buffers for buffers and sampled/storage images
+    // (plus the texture's sampler) for textures depending on the usage it was created with
+    BindlessSlots const & registerResource( ResourceTable & table, ResourceHandle handle )
+    {
+      ResourceEntry & entry = table[handle];
+      BindlessSlots   s{};
+
+      if ( entry.kind == ResourceKind::Buffer )
+      {
+        if ( entry.bufferUsage & vk::BufferUsageFlagBits::eStorageBuffer )
+          s.storageBuffer = addStorageBuffer( entry.buffer.buffer );
+      }
+      else
+      {
+        if ( entry.imageUsage & vk::ImageUsageFlagBits::eSampled )
+          s.sampledImage = addSampledImage( entry.texture.imageView, sampledLayout( entry ) );
+        if ( entry.imageUsage & vk::ImageUsageFlagBits::eStorage )
+          s.storageImage = addStorageImage( entry.texture.imageView );
+        if ( entry.texture.sampler )
+          s.sampler = addSampler( entry.texture.sampler );
+      }
+
+      return resourceSlots[handle] = s;
+    }
+
+    void unregisterResource( ResourceHandle handle, uint64_t frame )
+    {
+      auto it = resourceSlots.find( handle );
+      if ( it == resourceSlots.end() )
+        return;
+
+      removeSlots( it->second, frame );
+      resourceSlots.erase( it );
+    }
+
+    // Point moved resources at their new Vulkan objects.
+    // Command buffers still pending may read the current slots, so a moved resource gets fresh image and buffer
+    // slots and the old ones keep describing the old objects (alive until the defragmenter retires them) until
+    // they are recycled with the usual frame delay. Consumers look the index up through slotsOf() when recording.
+    // The sampler is not part of the move and keeps its slot.
+    void patch( ResourceTable & table, std::vector<ResourceHandle> const & handles, uint64_t frame )
+    {
+      for ( ResourceHandle handle : handles )
+      {
+        auto it = resourceSlots.find( handle );
+        if ( it == resourceSlots.end() )
+          continue;
+
+        ResourceEntry const & entry = table[handle];
+        BindlessSlots &       s     = it->second;
+
+        if ( s.storageBuffer != InvalidBindlessIndex )
+        {
+          remove( StorageBuffers, s.storageBuffer, frame );
+          s.storageBuffer = addStorageBuffer( entry.buffer.buffer );
+        }
+        if ( s.sampledImage != InvalidBindlessIndex )
+        {
+          remove( SampledImages, s.sampledImage, frame );
+          s.sampledImage = addSampledImage( entry.texture.imageView, sampledLayout( entry ) );
+        }
+        if ( s.storageImage != InvalidBindlessIndex )
+        {
+          remove( StorageImages, s.storageImage, frame );
+          s.storageImage = addStorageImage( entry.texture.imageView );
+        }
+      }
+    }
+
+    [[nodiscard]] BindlessSlots slotsOf( ResourceHandle handle ) const
+    {
+      auto it = resourceSlots.find( handle );
+      return it != resourceSlots.end() ? it->second : BindlessSlots{};
+    }
+
+    [[nodiscard]] uint32_t usedCount( Binding binding ) const
+    {
+      return slots[binding].next - static_cast<uint32_t>( slots[binding].free.size() );
+    }
+
+    void bind( vk::raii::CommandBuffer const & cmd, vk::PipelineLayout pipelineLayout, vk::PipelineBindPoint bindPoint ) const
+    {
+      cmd.bindDescriptorSets( bindPoint, pipelineLayout, 0, set, {} );
+    }
+
+  private:
+    struct Slots
+    {
+      uint32_t              next = 0;
+      std::vector<uint32_t> free;
+    };
+
+    struct Retired
+    {
+      Binding  binding;
+      uint32_t index;
+      uint64_t frame;
+    };
+
+    vk::Device                                        device = nullptr;
+    std::array<Slots, BindingCount>                   slots;
+    std::vector<Retired>                              retired;
+    std::unordered_map<ResourceHandle, BindlessSlots> resourceSlots;
+
+    uint32_t acquire( Binding binding )
+    {
+      Slots & s = slots[binding];
+      if ( !s.free.empty() )
+      {
+        uint32_t index = s.free.back();
+        s.free.pop_back();
+        return index;
+      }
+      if ( s.next >= capacity[binding] )
+        throw std::runtime_error( "Bindless heap binding " + std::to_string( binding ) + " is full" );
+      return s.next++;
+    }
+
+    // The layout the table tracks for the texture, read-only until it has been written at all
+    [[nodiscard]] static vk::ImageLayout sampledLayout( ResourceEntry const & entry )
+    {
+      return entry.layout != vk::ImageLayout::eUndefined ? entry.layout : vk::ImageLayout::eShaderReadOnlyOptimal;
+    }
+
+    void removeSlots( BindlessSlots const & s, uint64_t frame )
+    {
+      remove( SampledImages, s.sampledImage, frame );
+      remove( StorageImages, s.storageImage, frame );
+      remove( Samplers, s.sampler, frame );
+      remove( StorageBuffers, s.storageBuffer, frame );
+    }
+
+    void writeImage( Binding binding, uint32_t index, vk::ImageView view, vk::ImageLayout imageLayout )
+    {
+      vk::DescriptorImageInfo imageInfo{ nullptr, view, imageLayout };
+      vk::WriteDescriptorSet  write{};
+      write.setDstSet( set )
+        .setDstBinding( binding )
+        .setDstArrayElement( index )
+        .setDescriptorType( binding == SampledImages ? vk::DescriptorType::eSampledImage : vk::DescriptorType::eStorageImage )
+        .setImageInfo( imageInfo );
+      device.updateDescriptorSets( write, {} );
+    }
+
+    void writeSampler( uint32_t index, vk::Sampler sampler )
+    {
+      vk::DescriptorImageInfo imageInfo{ sampler, nullptr, vk::ImageLayout::eUndefined };
+      vk::WriteDescriptorSet  write{};
+      write.setDstSet( set ).setDstBinding( Samplers ).setDstArrayElement( index ).setDescriptorType( vk::DescriptorType::eSampler ).setImageInfo( imageInfo );
+      device.updateDescriptorSets( write, {} );
+    }
+
+    void writeBuffer( uint32_t index, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range )
+    {
+      vk::DescriptorBufferInfo bufferInfo{ buffer, offset, range };
+      vk::WriteDescriptorSet   write{};
+      write.setDstSet( set )
+        .setDstBinding( StorageBuffers )
+        .setDstArrayElement( index )
+        .setDescriptorType( vk::DescriptorType::eStorageBuffer )
+        .setBufferInfo( bufferInfo );
+      device.updateDescriptorSets( write, {} );
+    }
+  };
+}  // namespace core
@@ -0,0 +1,521 @@
+#pragma once
+#include "../data.hpp"
+#include "../helper.hpp"
+#include "../setup.hpp"
+#include "../state.hpp"
+#include "bindless.hpp"
+#include "marchingcubes.hpp"
+#include "sdf.hpp"
+#include "surface.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  struct SdfClipmapLayout
+  {
+    static constexpr uint32_t MaxLevels = 8;
+
+    uint32_t levels          = 4;
+    uint32_t ring            = 6;     // chunks per axis and level, even
+    uint32_t cells           = 16;    // per chunk edge
+    float    voxelSize       = 0.5f;  // of level 0, doubling per level
+    uint32_t verticesPerSlot = 3072;
+    uint32_t indicesPerSlot  = 12288;
+    uint32_t budgetMB        = 96;    // vertices, indices and draws of the slot cache
+
+    [[nodiscard]] float voxel( uint32_t level ) const
+    {
+      return voxelSize * float( 1u << level );
+    }
+
+    [[nodiscard]] float chunkSize( uint32_t level ) const
+    {
+      return float( cells ) * voxel( level );
+    }
+
+    [[nodiscard]] vk::DeviceSize bytesPerSlot() const
+    {
+      return sizeof( data::Vertex ) * vk::DeviceSize( verticesPerSlot ) + sizeof( uint32_t ) * vk::DeviceSize( indicesPerSlot ) +
+             sizeof( vk::DrawIndexedIndirectCommand );
+    }
+
+    [[nodiscard]] uint32_t slotCount() const
+    {
+      return static_cast<uint32_t>( std::min<vk::DeviceSize>( vk::DeviceSize( budgetMB ) * 1024 * 1024 / bytesPerSlot(), UINT32_MAX ) );
+    }
+
+    // First chunk of the level's ring around `camera` in chunk coordinates of that level. The ring is centered on
+    // the chunk corner with even coordinates nearest to the camera, so it is made of whole chunks of the next level
+    // and stays inside the next ring from 4 chunks on.
+    [[nodiscard]] glm::ivec3 ringStart( uint32_t level, glm::vec3 camera ) const
+    {
+      glm::ivec3 center = glm::ivec3( glm::round( camera / ( 2.0f * chunkSize( level ) ) ) ) * 2;
+      return center - glm::ivec3( int32_t( ring / 2 ) );
+    }
+  };
+
+  // Terrain streamed around the camera as a clipmap: every level is a ring^3 block of chunks around the camera with
+  // twice the voxel size of the level below, so the finer levels nest inside the coarser ones and every chunk of
+  // a level is covered by exactly eight chunks of the level below while those are inside their ring.
+  //
+  // Chunks are meshed with MarchingCubes into the slots of `surface`, at most `budget` per frame in the command
+  // buffer of the frame, coarse levels and chunks near the camera first. A chunk only counts as generated once the
+  // frame's fence passed and its index count was read back in collect(), until then nothing waits for it: the
+  // scene draws a chunk's eight children only when all of them are generated and the chunk itself otherwise, which
+  // falls back to the coarser level wherever the finer one is missing. The draws of a frame are written by the host
+  // into the selection buffer of its frame slot.
+  //
+  // The slots are a cache bounded by SdfClipmapLayout::budgetMB. Chunks without triangles give their slot back
+  // right away, chunks whose center is too far from the surface for it to reach them are never meshed. When no
+  // slot is free the chunk left the rings longest ago is evicted, chunks inside the rings are never evicted.
+  // A chunk entering the rings counts as a hit when it is still cached. Levels are not stitched, the borders between
+  // them may show cracks the size of a voxel of the coarser level. The shape is `scene` without edits.
+  struct SdfClipmap
+  {
+    struct Stats
+    {
+      uint64_t generated = 0;  // chunks meshed
+      uint64_t hits      = 0;  // chunks entering the rings that were cached
+      uint64_t misses    = 0;  // chunks entering the rings that had to be generated
+      uint64_t evictions = 0;
+      uint64_t overflows = 0;  // chunks that did not fit their slot, drawn from the coarser level
+      uint64_t starved   = 0;  // frames that wanted a slot while every slot held a chunk inside the rings
+      uint32_t resident  = 0;  // slots holding triangles
+      uint32_t pending   = 0;  // chunks meshed by frames in flight
+      uint32_t missing   = 0;  // chunks inside the rings waiting for their turn
+      uint32_t cached    = 0;  // chunks known to the cache, with and without a slot
+      uint32_t drawn     = 0;
+      float    perSecond = 0.0f;  // chunks generated
+      float    gpuMs     = 0.0f;  // meshing of the last collected frame
+
+      std::array<uint32_t, SdfClipmapLayout::MaxLevels> drawnPerLevel{};
+    };
+
+    data::SdfScene   scene;
+    SdfClipmapLayout layout;           // applied by rebuild()
+    uint32_t         budget  = 8;      // chunks per frame, up to MarchingCubes::MaxJobs
+    bool             enabled = false;  // streamed and drawn
+    MarchingCubes    mesher;
+    SurfaceChunks    surface;
+    Stats            stats;
+    std::string      error;  // of the last rebuild started from the UI
+
+    void init( vk::raii::Device const &         device_,
+               vk::raii::PhysicalDevice const & physicalDevice_,
+               VmaAllocator                     allocator_,
+               uint32_t                         queueFamily )
+    {
+      device         = &device_;
+      physicalDevice = &physicalDevice_;
+      allocator      = allocator_;
+      period         = physicalDevice_.getProperties().limits.timestampPeriod;
+
+      commandPool = vk::raii::CommandPool( device_, vk::CommandPoolCreateInfo{ vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamily } );
+      frameCmds   = vk::raii::CommandBuffers(
+        device_, vk::CommandBufferAllocateInfo{ commandPool, vk::CommandBufferLevel::ePrimary, uint32_t( global::state::MAX_FRAMES_IN_FLIGHT ) } );
+
+      vk::QueryPoolCreateInfo queryInfo{};
+      queryInfo.setQueryType( vk::QueryType::eTimestamp ).setQueryCount( 2 * uint32_t( global::state::MAX_FRAMES_IN_FLIGHT ) );
+      queries = vk::raii::QueryPool( device_, queryInfo );
+    }
+
+    // Reallocates the slots for the current layout and forgets every chunk. Nothing may still use the previous buffers.
+    void rebuild( BindlessHeap & heap, uint64_t frame )
+    {
+      if ( layout.levels == 0 || layout.levels > SdfClipmapLayout::MaxLevels )
+        throw std::runtime_error( "The clipmap needs 1 to " + std::to_string( SdfClipmapLayout::MaxLevels ) + " levels" );
+      if ( layout.ring < 4 || layout.ring % 2 != 0 || layout.voxelSize <= 0.0f )
+        throw std::runtime_error( "The clipmap needs an even ring of at least 4 chunks and a positive voxel size" );
+      uint32_t slots = layout.slotCount();
+      if ( slots < 8 )
+        throw std::runtime_error( "A budget of " + std::to_string( layout.budgetMB ) + " MB holds only " + std::to_string( slots ) + " chunks" );
+
+      destroy( heap, frame );
+      mesher.init( *device, *physicalDevice, allocator, heap, layout.cells, frame );
+      surface.create( allocator, heap, slots, layout.verticesPerSlot, layout.indicesPerSlot, frame );
+      built = layout;
+
+      constexpr VmaAllocationCreateFlags upload   = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      constexpr VmaAllocationCreateFlags readback = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      for ( uint32_t slot = 0; slot < global::state::MAX_FRAMES_IN_FLIGHT; ++slot )
+      {
+        vk::DeviceSize drawBytes = SurfaceChunks::DrawsOffset + sizeof( vk::DrawIndexedIndirectCommand ) * vk::DeviceSize( slots );
+        selections[slot]         = core::createBuffer( allocator, drawBytes, vk::BufferUsageFlagBits::eIndirectBuffer, upload );
+        readbacks[slot] = core::createBuffer( allocator, sizeof( uint32_t ) * 4 * MarchingCubes::MaxJobs, vk::BufferUsageFlagBits::eTransferDst, readback );
+      }
+
+      slotOwner.assign( slots, NoChunk );
+      freeSlots.resize( slots );
+      for ( uint32_t slot = 0; slot < slots; ++slot )
+        freeSlots[slot] = slots - 1 - slot;
+      stats       = Stats{};
+      tick        = 1;  // chunks start out with lastDesired 0, which must not look like the previous tick
+      windowStart = std::chrono::steady_clock::now();
+    }
+
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      mesher.destroy( heap, frame );
+      surface.destroy( heap, frame );
+      surface.selection = nullptr;
+      for ( uint32_t slot = 0; slot < global::state::MAX_FRAMES_IN_FLIGHT; ++slot )
+      {
+        core::destroyBuffer( allocator, selections[slot] );
+        core::destroyBuffer( allocator, readbacks[slot] );
+        inFlight[slot].clear();
+        recorded[slot] = false;
+      }
+      chunks.clear();
+      slotOwner.clear();
+      freeSlots.clear();
+      built = SdfClipmapLayout{ 0 };
+    }
+
+    [[nodiscard]] float hitRate() const
+    {
+      uint64_t lookups = stats.hits + stats.misses;
+      return lookups ? float( stats.hits ) / float( lookups ) : 0.0f;
+    }
+
+    [[nodiscard]] vk::DeviceSize residentBytes() const
+    {
+      return vk::DeviceSize( stats.resident ) * built.bytesPerSlot();
+    }
+
+    // Moves the rings to `camera`, selects the chunks the scene draws this frame and meshes the next `budget`
+    // missing chunks in the command buffer of `slot`, submit it before the scene. Empty when disabled or nothing
+    // is missing, the selection still changes.
+    [[nodiscard]] vk::CommandBuffer recordFrame( BindlessHeap const & heap, uint32_t slot, glm::vec3 camera )
+    {
+      recorded[slot] = false;
+      if ( !enabled || surface.empty() )
+        return nullptr;
+      ++tick;
+
+      std::vector<data::MarchingCubesJob> batch = request( camera, slot );
+      select( slot );
+      updateRate();
+      if ( batch.empty() )
+        return nullptr;
+
+      auto & frameCmd = frameCmds[slot];
+      frameCmd.reset();
+      frameCmd.begin( vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+      frameCmd.resetQueryPool( *queries, slot * 2, 2 );
+      frameCmd.writeTimestamp2( vk::PipelineStageFlagBits2::eAllCommands, *queries, slot * 2 );
+      data::SdfScene unedited = scene;
+      unedited.editCount      = 0;
+      mesher.record( frameCmd, heap, surface, unedited, batch );
+
+      // The vertex and index count of every chunk, for collect()
+      frameCmd.copyBuffer( mesher.state.buffer,
+                           readbacks[slot].buffer,
+                           vk::BufferCopy{ sizeof( uint32_t ) * MarchingCubes::StateChunks, 0, sizeof( uint32_t ) * 4 * batch.size() } );
+      vk::MemoryBarrier2 toHost{
+        vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead
+      };
+      frameCmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( toHost ) );
+      frameCmd.writeTimestamp2( vk::PipelineStageFlagBits2::eAllCommands, *queries, slot * 2 + 1 );
+      frameCmd.end();
+
+      recorded[slot] = true;
+      return *frameCmd;
+    }
+
+    // Call after the slot's fence has been waited, the chunks its frame meshed become drawable
+    void collect( uint32_t slot )
+    {
+      if ( !recorded[slot] )
+        return;
+      recorded[slot] = false;
+
+      auto [result, ticks] = queries.getResults<uint64_t>( slot * 2, 2, 2 * sizeof( uint64_t ), sizeof( uint64_t ), vk::QueryResultFlagBits::e64 );
+      if ( result == vk::Result::eSuccess )
+        stats.gpuMs = static_cast<float>( ticks[1] - ticks[0] ) * period * 1e-6f;
+
+      vmaInvalidateAllocation( allocator, readbacks[slot].allocation, 0, VK_WHOLE_SIZE );
+      auto const * words = static_cast<uint32_t const *>( readbacks[slot].allocationInfo.pMappedData );
+      for ( size_t j = 0; j < inFlight[slot].size(); ++j )
+      {
+        Chunk &  chunk       = chunks.at( inFlight[slot][j] );
+        uint32_t vertexCount = words[4 * j + 2];
+        uint32_t indexCount  = words[4 * j + 3];
+        bool     fits        = vertexCount <= built.verticesPerSlot && indexCount <= built.indicesPerSlot;
+
+        chunk.state      = fits ? ChunkState::Ready : ChunkState::Failed;
+        chunk.indexCount = fits ? indexCount : 0;
+        if ( chunk.indexCount == 0 )
+          release( chunk );
+        stats.overflows += fits ? 0 : 1;
+        ++stats.generated;
+        ++windowGenerated;
+      }
+      inFlight[slot].clear();
+    }
+
+  private:
+    enum class ChunkState : uint8_t
+    {
+      Missing,  // inside the rings, not meshed yet
+      Pending,  // meshed by a frame in flight
+      Ready,
+      Failed,  // did not fit a slot
+      Culled,  // too far from the surface to hold triangles
+    };
+
+    struct Chunk
+    {
+      glm::ivec3 coord;
+      uint32_t   level;
+      uint32_t   slot        = NoSlot;
+      uint32_t   indexCount  = 0;
+      uint64_t   lastDesired = 0;  // tick the chunk was last inside the rings
+      ChunkState state       = ChunkState::Missing;
+    };
+
+    static constexpr uint32_t NoSlot    = UINT32_MAX;
+    static constexpr uint64_t NoChunk   = UINT64_MAX;
+    static constexpr uint64_t PruneAge  = 600;  // ticks outside the rings before chunks without a slot are forgotten
+    static constexpr int32_t  CoordBias = 1 << 19;
+
+    [[nodiscard]] static uint64_t key( uint32_t level, glm::ivec3 coord )
+    {
+      auto bits = []( int32_t c ) { return uint64_t( uint32_t( c + CoordBias ) & 0xFFFFFu ); };
+      return uint64_t( level ) << 60 | bits( coord.x ) << 40 | bits( coord.y ) << 20 | bits( coord.z );
+    }
+
+    [[nodiscard]] bool inRing( uint32_t level, glm::ivec3 coord ) const
+    {
+      glm::ivec3 start = rings[level];
+      for ( uint32_t axis = 0; axis < 3; ++axis )
+        if ( coord[axis] < start[axis] || coord[axis] >= start[axis] + int32_t( built.ring ) )
+          return false;
+      return true;
+    }
+
+    // The field moves by at most 1 per unit away from the sphere and the box, the hills by up to 1.5 amplitudes
+    // either way, so a chunk whose center is further from the surface than that holds no crossing
+    [[nodiscard]] bool mayHoldSurface( uint32_t level, glm::ivec3 coord ) const
+    {
+      float     size   = built.chunkSize( level );
+      glm::vec3 center = ( glm::vec3( coord ) + 0.5f ) * size;
+      float     reach  = 0.5f * std::sqrt( 3.0f ) * size + 3.0f * std::abs( scene.amplitude ) + 2.0f * built.voxel( level );
+      return std::abs( sdfScene( center, scene, {} ) ) <= reach;
+    }
+
+    void release( Chunk & chunk )
+    {
+      if ( chunk.slot == NoSlot )
+        return;
+      slotOwner[chunk.slot] = NoChunk;
+      freeSlots.push_back( chunk.slot );
+      chunk.slot = NoSlot;
+    }
+
+    // A free slot, or the one of the chunk that left the rings longest ago. NoSlot when every slot holds a chunk
+    // inside the rings or one in flight.
+    [[nodiscard]] uint32_t acquire()
+    {
+      if ( freeSlots.empty() )
+      {
+        uint32_t oldest = NoSlot;
+        uint64_t age    = tick;
+        for ( uint32_t slot = 0; slot < slotOwner.size(); ++slot )
+        {
+          Chunk const & owner = chunks.at( slotOwner[slot] );
+          if ( owner.state != ChunkState::Pending && owner.lastDesired < age )
+          {
+            oldest = slot;
+            age    = owner.lastDesired;
+          }
+        }
+        if ( oldest == NoSlot )
+          return NoSlot;
+
+        auto owner = chunks.find( slotOwner[oldest] );
+        release( owner->second );
+        chunks.erase( owner );
+        ++stats.evictions;
+      }
+
+      uint32_t slot = freeSlots.back();
+      freeSlots.pop_back();
+      return slot;
+    }
+
+    // Marks the chunks inside the rings and hands out slots to the most wanted missing ones
+    [[nodiscard]] std::vector<data::MarchingCubesJob> request( glm::vec3 camera, uint32_t frameSlot )
+    {
+      struct Wanted
+      {
+        uint64_t key;
+        uint32_t level;
+        float    distance;
+      };
+      std::vector<Wanted> wanted;
+
+      for ( uint32_t level = 0; level < built.levels; ++level )
+      {
+        rings[level] = built.ringStart( level, camera );
+        float size   = built.chunkSize( level );
+        for ( uint32_t k = 0; k < built.ring * built.ring * built.ring; ++k )
+        {
+          glm::ivec3 coord   = rings[level] + glm::ivec3( k % built.ring, k / built.ring % built.ring, k / ( built.ring * built.ring ) );
+          uint64_t   id      = key( level, coord );
+          auto [it, created] = chunks.try_emplace( id, Chunk{ coord, level } );
+          Chunk & chunk      = it->second;
+          if ( created && !mayHoldSurface( level, coord ) )
+            chunk.state = ChunkState::Culled;
+
+          // Entering the rings this tick
+          if ( chunk.lastDesired + 1 != tick && chunk.state != ChunkState::Culled )
+          {
+            bool cached = chunk.state == ChunkState::Ready || chunk.state == ChunkState::Pending;
+            stats.hits += cached ? 1 : 0;
+            stats.misses += cached ? 0 : 1;
+          }
+          chunk.lastDesired = tick;
+
+          if ( chunk.state == ChunkState::Missing )
+            wanted.push_back( { id, level, glm::length( ( glm::vec3( coord ) + 0.5f ) * size - camera ) } );
+        }
+      }
+
+      // Coarse levels first, they are the fallback of everything finer
+      std::ranges::sort( wanted, []( Wanted const & a, Wanted const & b ) { return a.level != b.level ? a.level > b.level : a.distance < b.distance; } );
+
+      std::vector<data::MarchingCubesJob> batch;
+      uint32_t                            count = std::min( budget, MarchingCubes::MaxJobs );
+      for ( Wanted const & want : wanted )
+      {
+        if ( batch.size() >= count )
+          break;
+        uint32_t slot = acquire();
+        if ( slot == NoSlot )
+        {
+          ++stats.starved;
+          break;
+        }
+
+        Chunk & chunk   = chunks.at( want.key );
+        chunk.slot      = slot;
+        chunk.state     = ChunkState::Pending;
+        slotOwner[slot] = want.key;
+        inFlight[frameSlot].push_back( want.key );
+        batch.push_back( data::MarchingCubesJob{ glm::vec3( chunk.coord ) * built.chunkSize( chunk.level ), built.voxel( chunk.level ), slot } );
+      }
+
+      if ( tick % 256 == 0 )
+        std::erase_if( chunks,
+                       [&]( auto const & entry )
+                       { return entry.second.slot == NoSlot && entry.second.state != ChunkState::Pending && entry.second.lastDesired + PruneAge < tick; } );
+
+      stats.missing = 0;
+      stats.pending = 0;
+      for ( Wanted const & want : wanted )
+        stats.missing += chunks.at( want.key ).state == ChunkState::Missing ? 1 : 0;
+      for ( auto const & keys : inFlight )
+        stats.pending += static_cast<uint32_t>( keys.size() );
+      stats.resident = static_cast<uint32_t>( slotOwner.size() - freeSlots.size() );
+      stats.cached   = static_cast<uint32_t>( chunks.size() );
+      return batch;
+    }
+
+    // Walks down from the coarsest ring: a chunk whose eight children are all generated hands over to them,
+    // otherwise it draws itself if it has triangles
+    void select( uint32_t frameSlot )
+    {
+      auto ready = [&]( uint32_t level, glm::ivec3 coord )
+      {
+        auto it = chunks.find( key( level, coord ) );
+        return it != chunks.end() && ( it->second.state == ChunkState::Ready || it->second.state == ChunkState::Culled );
+      };
+
+      auto *   bytes = static_cast<std::byte *>( selections[frameSlot].allocationInfo.pMappedData );
+      uint32_t drawn = 0;
+      stats.drawnPerLevel.fill( 0 );
+
+      uint32_t                                     top = built.levels - 1;
+      std::vector<std::pair<uint32_t, glm::ivec3>> stack;
+      for ( uint32_t k = 0; k < built.ring * built.ring * built.ring; ++k )
+        stack.emplace_back( top, rings[top] + glm::ivec3( k % built.ring, k / built.ring % built.ring, k / ( built.ring * built.ring ) ) );
+
+      while ( !stack.empty() )
+      {
+        auto [level, coord] = stack.back();
+        stack.pop_back();
+
+        bool refine = level > 0 && inRing( level - 1, coord * 2 );
+        for ( uint32_t child = 0; child < 8 && refine; ++child )
+          refine = ready( level - 1, coord * 2 + glm::ivec3( child & 1, child >> 1 & 1, child >> 2 ) );
+        if ( refine )
+        {
+          for ( uint32_t child = 0; child < 8; ++child )
+            stack.emplace_back( level - 1, coord * 2 + glm::ivec3( child & 1, child >> 1 & 1, child >> 2 ) );
+          continue;
+        }
+
+        auto it = chunks.find( key( level, coord ) );
+        if ( it == chunks.end() || it->second.state != ChunkState::Ready || it->second.indexCount == 0 )
+          continue;
+        uint32_t                       slot = it->second.slot;
+        vk::DrawIndexedIndirectCommand command{ it->second.indexCount, 1, slot * built.indicesPerSlot, int32_t( slot * built.verticesPerSlot ), 0 };
+        std::memcpy( bytes + SurfaceChunks::DrawsOffset + sizeof( command ) * drawn, &command, sizeof( command ) );
+        ++drawn;
+        ++stats.drawnPerLevel[level];
+      }
+
+      std::memcpy( bytes, &drawn, sizeof( drawn ) );
+      vmaFlushAllocation( allocator, selections[frameSlot].allocation, 0, VK_WHOLE_SIZE );
+      surface.selection = selections[frameSlot].buffer;
+      stats.drawn       = drawn;
+    }
+
+    void updateRate()
+    {
+      auto  now     = std::chrono::steady_clock::now();
+      float elapsed = std::chrono::duration<float>( now - windowStart ).count();
+      if ( elapsed < 1.0f )
+        return;
+      stats.perSecond = float( windowGenerated ) / elapsed;
+      windowGenerated = 0;
+      windowStart     = now;
+    }
+
+    vk::raii::Device const *              device          = nullptr;
+    vk::raii::PhysicalDevice const *      physicalDevice  = nullptr;
+    VmaAllocator                          allocator       = nullptr;
+    float                                 period          = 1.0f;
+    SdfClipmapLayout                      built           = { 0 };  // of the current slots
+    uint64_t                              tick            = 0;
+    uint64_t                              windowGenerated = 0;
+    std::chrono::steady_clock::time_point windowStart;
+    std::unordered_map<uint64_t, Chunk>   chunks;
+    std::vector<uint64_t>                 slotOwner;  // chunk key per slot, NoChunk when free
+    std::vector<uint32_t>                 freeSlots;
+    vk::raii::CommandPool                 commandPool = nullptr;
+    vk::raii::CommandBuffers              frameCmds   = nullptr;
+    vk::raii::QueryPool                   queries     = nullptr;
+
+    std::array<glm::ivec3, SdfClipmapLayout::MaxLevels>                    rings{};       // ringStart() per level
+    std::array<core::Buffer, global::state::MAX_FRAMES_IN_FLIGHT>          selections{};  // draws of the frame, see SurfaceChunks::selection
+    std::array<core::Buffer, global::state::MAX_FRAMES_IN_FLIGHT>          readbacks{};   // MarchingCubes::StateChunks of the frame's batch
+    std::array<std::vector<uint64_t>, global::state::MAX_FRAMES_IN_FLIGHT> inFlight{};    // chunk keys in batch order
+    std::array<bool, global::state::MAX_FRAMES_IN_FLIGHT>                  recorded{};
+  };
+}  // namespace core
@@ -0,0 +1,77 @@
+#pragma once
+#include "../helper.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Subgroup arithmetic in compute shaders, which the *_subgroup.comp variants of the compute modules need
+  [[nodiscard]] inline bool subgroupArithmeticSupported( vk::raii::PhysicalDevice const & physicalDevice )
+  {
+    constexpr vk::SubgroupFeatureFlags needed = vk::SubgroupFeatureFlagBits::eBasic | vk::SubgroupFeatureFlagBits::eArithmetic;
+
+    auto props    = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>();
+    auto subgroup = props.get<vk::PhysicalDeviceSubgroupProperties>();
+    return ( subgroup.supportedStages & vk::ShaderStageFlagBits::eCompute ) && ( subgroup.supportedOperations & needed ) == needed;
+  }
+
+  // A compute shader object together with the pipeline layout it is bound and pushed with. `constants` are the
+  // values of the shader's specialization constants, constant_id i takes constants[i].
+  struct ComputeShader
+  {
+    vk::raii::PipelineLayout layout = nullptr;
+    vk::raii::ShaderEXT      shader = nullptr;
+
+    ComputeShader() = default;
+
+    ComputeShader( vk::raii::Device const &                     device,
+                   std::string const &                          name,
+                   uint32_t                                     pushConstantSize,
+                   std::vector<vk::DescriptorSetLayout> const & setLayouts = {},
+                   std::vector<uint32_t> const &                constants  = {} )
+    {
+      vk::PushConstantRange pushRange{ vk::ShaderStageFlagBits::eCompute, 0, pushConstantSize };
+
+      vk::PipelineLayoutCreateInfo layoutInfo{};
+      layoutInfo.setSetLayouts( setLayouts );
+      if ( pushConstantSize > 0 )
+        layoutInfo.setPushConstantRanges( pushRange );
+      layout = vk::raii::PipelineLayout( device, layoutInfo );
+
+      std::vector<uint32_t> code = core::help::getShaderCode( name );
+
+      std::vector<vk::SpecializationMapEntry> entries;
+      for ( uint32_t id = 0; id < constants.size(); ++id )
+        entries.emplace_back( id, id * uint32_t( sizeof( uint32_t ) ), sizeof( uint32_t ) );
+      vk::SpecializationInfo specialization{};
+      specialization.setMapEntries( entries ).setDataSize( constants.size() * sizeof( uint32_t ) ).setPData( constants.data() );
+
+      vk::ShaderCreateInfoEXT shaderInfo{};
+      shaderInfo.setStage( vk::ShaderStageFlagBits::eCompute )
+        .setCodeType( vk::ShaderCodeTypeEXT::eSpirv )
+        .setPCode( code.data() )
+        .setCodeSize( code.size() * sizeof( uint32_t ) )
+        .setPName( "main" )
+        .setSetLayouts( setLayouts );
+      if ( pushConstantSize > 0 )
+        shaderInfo.setPushConstantRanges( pushRange );
+      if ( !constants.empty() )
+        shaderInfo.setPSpecializationInfo( &specialization );
+      shader = vk::raii::ShaderEXT( device, shaderInfo );
+    }
+
+    void bind( vk::raii::CommandBuffer const & cmd ) const
+    {
+      cmd.bindShadersEXT( vk::ShaderStageFlagBits::eCompute, *shader );
+    }
+
+    template <typename T>
+    void push( vk::raii::CommandBuffer const & cmd, T const & constants ) const
+    {
+      cmd.pushConstants<T>( *layout, vk::ShaderStageFlagBits::eCompute, 0, constants );
+    }
+  };
+}  // namespace core
@@ -0,0 +1,205 @@
+#pragma once
+#include "../data.hpp"
+#include "mappedfile.hpp"
+#include "material.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace core
+{
+  // Cooked model file (.cmesh), written offline by cam-3-cook and drawn without any parsing: the header is
+  // followed by the vertex, index and meshlet blobs exactly as core::Model's buffers hold them, so loading is a
+  // mapping, a validation pass and one copy into a staging buffer.
+  //
+  //   CookedHeader
+  //   data::QuantizedVertex[vertexCount]    at vertexOffset
+  //   uint32_t[indexCount]                  at indexOffset
+  //   packMeshlets() words[meshletWords]    at meshletOffset, the file ends with them
+  //
+  // Every blob starts at a multiple of CookedAlignment, the gaps are zero.
+  inline constexpr std::array<char, 8> CookedMagic     = { 'C', 'A', 'M', 'M', 'E', 'S', 'H', '\0' };
+  inline constexpr uint32_t            CookedVersion   = 1;
+  inline constexpr uint64_t            CookedAlignment = 64;
+  inline constexpr uint32_t            CookedOptimized = 1u << 0;  // CookedHeader::flags, indices went through core/meshopt.hpp
+
+  struct CookedLod
+  {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    float    minScreenSize;
+  };
+
+  struct CookedHeader
+  {
+    std::array<char, 8>                   magic         = CookedMagic;
+    uint32_t                              version       = CookedVersion;
+    uint32_t                              headerBytes   = sizeof( CookedHeader );
+    uint64_t                              sourceHash    = 0;     // cookedSourceHash() of what was cooked, tells whether a cook is stale
+    uint64_t                              contentHash   = 0;     // cookedHash() of every byte after the header
+    uint64_t                              fileBytes     = 0;
+    uint64_t                              vertexOffset  = 0;
+    uint64_t                              indexOffset   = 0;
+    uint64_t                              meshletOffset = 0;
+    uint32_t                              vertexCount   = 0;
+    uint32_t                              indexCount    = 0;
+    uint32_t                              meshletCount  = 0;     // data::Meshlet records at the start of the meshlet blob
+    uint32_t                              meshletWords  = 0;
+    uint32_t                              lodCount      = 0;
+    uint32_t                              flags         = 0;
+    float                                 radius        = 0.0f;  // bounding sphere around the origin, the unit of quantized positions
+    glm::vec3                             boundsMin{ 0.0f };
+    glm::vec3                             boundsMax{ 0.0f };
+    std::array<CookedLod, Model::MaxLods> lods{};
+    uint32_t                              pad = 0;
+  };
+  static_assert( sizeof( CookedHeader ) == 200, "written as is, no implicit padding" );
+
+  // 64-bit FNV-1a over whole words, the tail byte by byte. Fast enough to check every load.
+  [[nodiscard]] inline uint64_t cookedHash( std::string_view bytes, uint64_t hash = 14695981039346656037ull )
+  {
+    size_t words = bytes.size() / sizeof( uint64_t );
+    for ( size_t i = 0; i < words; ++i )
+    {
+      uint64_t word;
+      std::memcpy( &word, bytes.data() + i * sizeof( uint64_t ), sizeof( word ) );
+      hash = ( hash ^ word ) * 1099511628211ull;
+    }
+    for ( size_t i = words * sizeof( uint64_t ); i < bytes.size(); ++i )
+      hash = ( hash ^ static_cast<uint8_t>( bytes[i] ) ) * 1099511628211ull;
+    return hash;
+  }
+
+  // Source file bytes and every setting that changes the cooked output
+  [[nodiscard]] inline uint64_t cookedSourceHash( std::string_view source, bool optimize, float radius )
+  {
+    std::array<uint32_t, 5> settings = { CookedVersion,
+                                         optimize ? 1u : 0u,
+                                         std::bit_cast<uint32_t>( radius ),
+                                         static_cast<uint32_t>( sizeof( data::Meshlet ) ),
+                                         static_cast<uint32_t>( sizeof( data::QuantizedVertex ) ) };
+    return cookedHash( source, cookedHash( std::string_view( reinterpret_cast<char const *>( settings.data() ), sizeof( settings ) ) ) );
+  }
+
+  [[nodiscard]] inline data::QuantizedVertex quantizeVertex( glm::vec3 position, glm::vec3 color, float radius )
+  {
+    glm::vec3 p = glm::round( glm::clamp( position / radius, -1.0f, 1.0f ) * 32767.0f );
+    glm::vec3 c = glm::round( glm::clamp( color, 0.0f, 1.0f ) * 255.0f );
+
+    data::QuantizedVertex vertex{};
+    for ( int i = 0; i < 3; ++i )
+    {
+      vertex.position[i] = static_cast<int16_t>( p[i] );
+      vertex.color[i]    = static_cast<uint8_t>( c[i] );
+    }
+    vertex.color[3] = 255;
+    return vertex;
+  }
+
+  // Lays out the blobs behind `header`, whose counts, offsets and hashes are filled in here. The lods, bounds,
+  // flags and source hash are taken as given.
+  inline void writeCookedFile( std::filesystem::path const &          path,
+                               CookedHeader                           header,
+                               std::span<const data::QuantizedVertex> vertices,
+                               std::span<const uint32_t>              indices,
+                               std::span<const uint32_t>              meshletWords )
+  {
+    auto align = []( uint64_t offset ) { return ( offset + CookedAlignment - 1 ) / CookedAlignment * CookedAlignment; };
+
+    header.vertexCount   = static_cast<uint32_t>( vertices.size() );
+    header.indexCount    = static_cast<uint32_t>( indices.size() );
+    header.meshletWords  = static_cast<uint32_t>( meshletWords.size() );
+    header.vertexOffset  = align( sizeof( CookedHeader ) );
+    header.indexOffset   = align( header.vertexOffset + vertices.size_bytes() );
+    header.meshletOffset = align( header.indexOffset + indices.size_bytes() );
+    header.fileBytes     = header.meshletOffset + meshletWords.size_bytes();
+
+    std::vector<char> file( header.fileBytes, 0 );
+    std::memcpy( file.data() + header.vertexOffset, vertices.data(), vertices.size_bytes() );
+    std::memcpy( file.data() + header.indexOffset, indices.data(), indices.size_bytes() );
+    std::memcpy( file.data() + header.meshletOffset, meshletWords.data(), meshletWords.size_bytes() );
+    header.contentHash = cookedHash( std::string_view( file.data() + sizeof( CookedHeader ), file.size() - sizeof( CookedHeader ) ) );
+    std::memcpy( file.data(), &header, sizeof( header ) );
+
+    if ( path.has_parent_path() )
+      std::filesystem::create_directories( path.parent_path() );
+    std::ofstream out( path, std::ios::binary | std::ios::trunc );
+    if ( !out || !out.write( file.data(), static_cast<std::streamsize>( file.size() ) ) )
+      throw std::runtime_error( "Failed to write cooked model: " + path.string() );
+  }
+
+  // Mapped cooked file. Throws unless the magic, version, layout and content hash all check out, after that the
+  // blobs can be copied as they are.
+  struct CookedFile
+  {
+    CookedHeader header;
+
+    explicit CookedFile( std::filesystem::path const & path ) : file( path )
+    {
+      std::string_view bytes = file.bytes();
+      auto             fail  = [&]( std::string const & what ) { throw std::runtime_error( "Cooked model " + path.string() + ": " + what ); };
+
+      if ( bytes.size() < sizeof( CookedHeader ) )
+        fail( "truncated header" );
+      std::memcpy( &header, bytes.data(), sizeof( header ) );
+      if ( header.magic != CookedMagic )
+        fail( "not a cooked model" );
+      if ( header.version != CookedVersion || header.headerBytes != sizeof( CookedHeader ) )
+        fail( "version " + std::to_string( header.version ) + ", expected " + std::to_string( CookedVersion ) + ", cook it again" );
+
+      bool layout = header.fileBytes == bytes.size() && header.vertexOffset >= sizeof( CookedHeader ) &&
+                    header.vertexOffset + uint64_t( header.vertexCount ) * sizeof( data::QuantizedVertex ) <= header.indexOffset &&
+                    header.indexOffset + uint64_t( header.indexCount ) * sizeof( uint32_t ) <= header.meshletOffset &&
+                    header.meshletOffset + uint64_t( header.meshletWords ) * sizeof( uint32_t ) == header.fileBytes &&
+                    uint64_t( header.meshletCount ) * sizeof( data::Meshlet ) <= uint64_t( header.meshletWords ) * sizeof( uint32_t ) &&
+                    header.vertexOffset % CookedAlignment == 0 && header.indexOffset % CookedAlignment == 0 &&
+                    header.meshletOffset % CookedAlignment == 0 && header.lodCount >= 1 && header.lodCount <= Model::MaxLods &&
+                    header.indexCount % 3 == 0 && header.radius > 0.0f;
+      if ( !layout )
+        fail( "inconsistent layout" );
+      for ( uint32_t lod = 0; lod < header.lodCount; ++lod )
+        if ( uint64_t( header.lods[lod].firstIndex ) + header.lods[lod].indexCount > header.indexCount ||
+             uint64_t( header.lods[lod].firstMeshlet ) + header.lods[lod].meshletCount > header.meshletCount )
+          fail( "level of detail " + std::to_string( lod ) + " out of range" );
+
+      if ( cookedHash( bytes.substr( sizeof( CookedHeader ) ) ) != header.contentHash )
+        fail( "content hash mismatch" );
+    }
+
+    // Vertices, indices and meshlet words with their gaps, in one piece for a single staging copy
+    [[nodiscard]] std::string_view blobs() const
+    {
+      return file.bytes().substr( header.vertexOffset );
+    }
+
+  private:
+    MappedFile file;
+  };
+
+  // Header of a cooked file without validating the rest, empty when there is none or it is of another version
+  [[nodiscard]] inline std::optional<CookedHeader> peekCookedHeader( std::filesystem::path const & path )
+  {
+    std::ifstream file( path, std::ios::binary );
+    CookedHeader  header;
+    if ( !file || !file.read( reinterpret_cast<char *>( &header ), sizeof( header ) ) )
+      return std::nullopt;
+    if ( header.magic != CookedMagic || header.version != CookedVersion || header.headerBytes != sizeof( CookedHeader ) )
+      return std::nullopt;
+    return header;
+  }
+}  // namespace core
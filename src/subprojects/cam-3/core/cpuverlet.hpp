@@ -0,0 +1,1187 @@
+#pragma once
+#include "../data.hpp"
+#include "../helper.hpp"
+#include "../setup.hpp"
+#include "../state.hpp"
+#include "bindless.hpp"
+#include "instanceformat.hpp"
+#include "verlet.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#elif defined( __ARM_NEON ) && defined( __aarch64__ )
+#include <arm_neon.h>
+#endif
+
+namespace core
+{
+  namespace detail
+  {
+    // Eight float lanes for the kernels of CpuVerletSim. Every backend runs the same IEEE operations lane by lane
+    // and reduces the lanes in the same order, ((0 + 4) + (2 + 6)) + ((1 + 5) + (3 + 7)), so as long as the compiler
+    // does not contract multiplies and adds all of them produce the same bits. Clang contracts by default and arm64
+    // always has FMA, so CMakeLists.txt builds cam-3 with -ffp-contract=off (/fp:precise on MSVC).
+    struct ScalarLanes
+    {
+      static constexpr char const * Name = "scalar";
+
+      struct V
+      {
+        std::array<float, 8> f;
+      };
+
+      struct M
+      {
+        std::array<bool, 8> b;
+      };
+
+      template <typename Op>
+      static V map( V const & a, V const & b, Op op )
+      {
+        V r;
+        for ( uint32_t i = 0; i < 8; ++i )
+          r.f[i] = op( a.f[i], b.f[i] );
+        return r;
+      }
+
+      static V splat( float x )
+      {
+        V r;
+        r.f.fill( x );
+        return r;
+      }
+
+      static V load( float const * p )
+      {
+        V r;
+        std::memcpy( r.f.data(), p, sizeof( r.f ) );
+        return r;
+      }
+
+      static void store( float * p, V const & a )
+      {
+        std::memcpy( p, a.f.data(), sizeof( a.f ) );
+      }
+
+      static V add( V const & a, V const & b )
+      {
+        return map( a, b, []( float x, float y ) { return x + y; } );
+      }
+
+      static V sub( V const & a, V const & b )
+      {
+        return map( a, b, []( float x, float y ) { return x - y; } );
+      }
+
+      static V mul( V const & a, V const & b )
+      {
+        return map( a, b, []( float x, float y ) { return x * y; } );
+      }
+
+      static V div( V const & a, V const & b )
+      {
+        return map( a, b, []( float x, float y ) { return x / y; } );
+      }
+
+      static V min( V const & a, V const & b )
+      {
+        return map( a, b, []( float x, float y ) { return x < y ? x : y; } );
+      }
+
+      static V max( V const & a, V const & b )
+      {
+        return map( a, b, []( float x, float y ) { return x > y ? x : y; } );
+      }
+
+      static V sqrt( V const & a )
+      {
+        V r;
+        for ( uint32_t i = 0; i < 8; ++i )
+          r.f[i] = std::sqrt( a.f[i] );
+        return r;
+      }
+
+      static M greater( V const & a, V const & b )
+      {
+        M r;
+        for ( uint32_t i = 0; i < 8; ++i )
+          r.b[i] = a.f[i] > b.f[i];
+        return r;
+      }
+
+      static M both( M const & a, M const & b )
+      {
+        M r;
+        for ( uint32_t i = 0; i < 8; ++i )
+          r.b[i] = a.b[i] && b.b[i];
+        return r;
+      }
+
+      static M lanesBelow( uint32_t n )
+      {
+        M r;
+        for ( uint32_t i = 0; i < 8; ++i )
+          r.b[i] = i < n;
+        return r;
+      }
+
+      static V select( M const & m, V const & a, V const & b )
+      {
+        V r;
+        for ( uint32_t i = 0; i < 8; ++i )
+          r.f[i] = m.b[i] ? a.f[i] : b.f[i];
+        return r;
+      }
+
+      static uint32_t count( M const & m )
+      {
+        return static_cast<uint32_t>( std::count( m.b.begin(), m.b.end(), true ) );
+      }
+
+      static float sum( V const & a )
+      {
+        std::array<float, 4> s = { a.f[0] + a.f[4], a.f[1] + a.f[5], a.f[2] + a.f[6], a.f[3] + a.f[7] };
+        return ( s[0] + s[2] ) + ( s[1] + s[3] );
+      }
+    };
+
+#if defined( __AVX2__ )
+    struct Avx2Lanes
+    {
+      static constexpr char const * Name = "AVX2";
+
+      using V = __m256;
+      using M = __m256;
+
+      static V splat( float x )
+      {
+        return _mm256_set1_ps( x );
+      }
+
+      static V load( float const * p )
+      {
+        return _mm256_loadu_ps( p );
+      }
+
+      static void store( float * p, V a )
+      {
+        _mm256_storeu_ps( p, a );
+      }
+
+      static V add( V a, V b )
+      {
+        return _mm256_add_ps( a, b );
+      }
+
+      static V sub( V a, V b )
+      {
+        return _mm256_sub_ps( a, b );
+      }
+
+      static V mul( V a, V b )
+      {
+        return _mm256_mul_ps( a, b );
+      }
+
+      static V div( V a, V b )
+      {
+        return _mm256_div_ps( a, b );
+      }
+
+      static V min( V a, V b )
+      {
+        return _mm256_min_ps( a, b );
+      }
+
+      static V max( V a, V b )
+      {
+        return _mm256_max_ps( a, b );
+      }
+
+      static V sqrt( V a )
+      {
+        return _mm256_sqrt_ps( a );
+      }
+
+      static M greater( V a, V b )
+      {
+        return _mm256_cmp_ps( a, b, _CMP_GT_OQ );
+      }
+
+      static M both( M a, M b )
+      {
+        return _mm256_and_ps( a, b );
+      }
+
+      static V select( M m, V a, V b )
+      {
+        return _mm256_blendv_ps( b, a, m );
+      }
+
+      static M lanesBelow( uint32_t n )
+      {
+        __m256i limit = _mm256_set1_epi32( static_cast<int>( std::min( n, 8u ) ) );
+        return _mm256_castsi256_ps( _mm256_cmpgt_epi32( limit, _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) ) );
+      }
+
+      static uint32_t count( M m )
+      {
+        return static_cast<uint32_t>( std::popcount( static_cast<uint32_t>( _mm256_movemask_ps( m ) ) ) );
+      }
+
+      static float sum( V a )
+      {
+        __m128 s = _mm_add_ps( _mm256_castps256_ps128( a ), _mm256_extractf128_ps( a, 1 ) );
+        s        = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+        s        = _mm_add_ss( s, _mm_shuffle_ps( s, s, 1 ) );
+        return _mm_cvtss_f32( s );
+      }
+    };
+
+    using NativeLanes = Avx2Lanes;
+#elif defined( __ARM_NEON ) && defined( __aarch64__ )
+    struct NeonLanes
+    {
+      static constexpr char const * Name = "NEON";
+
+      struct V
+      {
+        float32x4_t lo, hi;
+      };
+
+      struct M
+      {
+        uint32x4_t lo, hi;
+      };
+
+      static V splat( float x )
+      {
+        return { vdupq_n_f32( x ), vdupq_n_f32( x ) };
+      }
+
+      static V load( float const * p )
+      {
+        return { vld1q_f32( p ), vld1q_f32( p + 4 ) };
+      }
+
+      static void store( float * p, V a )
+      {
+        vst1q_f32( p, a.lo );
+        vst1q_f32( p + 4, a.hi );
+      }
+
+      static V add( V a, V b )
+      {
+        return { vaddq_f32( a.lo, b.lo ), vaddq_f32( a.hi, b.hi ) };
+      }
+
+      static V sub( V a, V b )
+      {
+        return { vsubq_f32( a.lo, b.lo ), vsubq_f32( a.hi, b.hi ) };
+      }
+
+      static V mul( V a, V b )
+      {
+        return { vmulq_f32( a.lo, b.lo ), vmulq_f32( a.hi, b.hi ) };
+      }
+
+      static V div( V a, V b )
+      {
+        return { vdivq_f32( a.lo, b.lo ), vdivq_f32( a.hi, b.hi ) };
+      }
+
+      static V min( V a, V b )
+      {
+        return { vminq_f32( a.lo, b.lo ), vminq_f32( a.hi, b.hi ) };
+      }
+
+      static V max( V a, V b )
+      {
+        return { vmaxq_f32( a.lo, b.lo ), vmaxq_f32( a.hi, b.hi ) };
+      }
+
+      static V sqrt( V a )
+      {
+        return { vsqrtq_f32( a.lo ), vsqrtq_f32( a.hi ) };
+      }
+
+      static M greater( V a, V b )
+      {
+        return { vcgtq_f32( a.lo, b.lo ), vcgtq_f32( a.hi, b.hi ) };
+      }
+
+      static M both( M a, M b )
+      {
+        return { vandq_u32( a.lo, b.lo ), vandq_u32( a.hi, b.hi ) };
+      }
+
+      static V select( M m, V a, V b )
+      {
+        return { vbslq_f32( m.lo, a.lo, b.lo ), vbslq_f32( m.hi, a.hi, b.hi ) };
+      }
+
+      static M lanesBelow( uint32_t n )
+      {
+        static constexpr uint32_t lanes[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+        uint32x4_t                limit    = vdupq_n_u32( n );
+        return { vcltq_u32( vld1q_u32( lanes ), limit ), vcltq_u32( vld1q_u32( lanes + 4 ), limit ) };
+      }
+
+      static uint32_t count( M m )
+      {
+        return vaddvq_u32( vshrq_n_u32( m.lo, 31 ) ) + vaddvq_u32( vshrq_n_u32( m.hi, 31 ) );
+      }
+
+      static float sum( V a )
+      {
+        float32x4_t s = vaddq_f32( a.lo, a.hi );
+        float32x2_t h = vadd_f32( vget_low_f32( s ), vget_high_f32( s ) );
+        return vget_lane_f32( h, 0 ) + vget_lane_f32( h, 1 );
+      }
+    };
+
+    using NativeLanes = NeonLanes;
+#else
+    using NativeLanes = ScalarLanes;
+#endif
+
+    // PCG hash of verlet.comp, so the CPU seeds the same spheres as the GPU
+    [[nodiscard]] inline uint32_t pcgHash( uint32_t v )
+    {
+      uint32_t state = v * 747796405u + 2891336453u;
+      uint32_t word  = ( ( state >> ( ( state >> 28u ) + 4u ) ) ^ state ) * 277803737u;
+      return ( word >> 22u ) ^ word;
+    }
+
+    [[nodiscard]] inline float nextRandom( uint32_t & state )
+    {
+      state = pcgHash( state );
+      return float( state >> 8 ) * ( 1.0f / 16777216.0f );
+    }
+  }  // namespace detail
+
+  // Persistent workers for loops of independent tasks, the calling thread is worker 0. Every worker starts on an
+  // equal share of the task indices and takes them front to back, a worker that runs out steals the back half of
+  // another worker's share. Shares are a [first, end) pair in one atomic word, owner and thieves both advance it
+  // with a compare-exchange, so nothing locks while tasks run. Which worker runs a task is not deterministic, the
+  // tasks have to write disjoint outputs and must not throw.
+  struct WorkStealingPool
+  {
+    ~WorkStealingPool()
+    {
+      stop();
+    }
+
+    // `threads` workers including the caller, 0 for every hardware thread
+    void start( uint32_t threads )
+    {
+      stop();
+      workers  = threads ? threads : std::max( 1u, std::thread::hardware_concurrency() );
+      shares   = std::make_unique<Share[]>( workers );
+      stopping = false;
+      for ( uint32_t w = 1; w < workers; ++w )
+        helpers.emplace_back( [this, w, seen = generation] { loop( w, seen ); } );
+    }
+
+    void stop()
+    {
+      {
+        std::lock_guard lock( mutex );
+        stopping = true;
+      }
+      wake.notify_all();
+      helpers.clear();
+      workers = 0;
+    }
+
+    [[nodiscard]] uint32_t size() const
+    {
+      return workers;
+    }
+
+    // body( task, worker ) for every task below `tasks`, returns when all of them ran
+    template <typename Body>
+    void run( uint32_t tasks, Body const & body )
+    {
+      if ( tasks == 0 )
+        return;
+      if ( workers <= 1 )
+      {
+        for ( uint32_t task = 0; task < tasks; ++task )
+          body( task, 0u );
+        return;
+      }
+
+      for ( uint32_t w = 0; w < workers; ++w )
+        shares[w].range.store( pack( uint64_t( tasks ) * w / workers, uint64_t( tasks ) * ( w + 1 ) / workers ), std::memory_order_relaxed );
+      job    = &body;
+      invoke = []( void const * job_, uint32_t task, uint32_t worker ) { ( *static_cast<Body const *>( job_ ) )( task, worker ); };
+      {
+        std::lock_guard lock( mutex );
+        running = workers - 1;
+        ++generation;
+      }
+      wake.notify_all();
+
+      work( 0 );
+      std::unique_lock lock( mutex );
+      done.wait( lock, [this] { return running == 0; } );
+    }
+
+    std::atomic<uint64_t> steals = 0;
+
+  private:
+    struct alignas( 64 ) Share
+    {
+      std::atomic<uint64_t> range = 0;  // first task in the low word, end in the high word
+    };
+
+    uint32_t                  workers = 0;
+    std::unique_ptr<Share[]>  shares;
+    std::vector<std::jthread> helpers;  // workers 1 and up
+    std::mutex                mutex;
+    std::condition_variable   wake;
+    std::condition_variable   done;
+    uint64_t                  generation = 0;
+    uint32_t                  running    = 0;
+    bool                      stopping   = false;
+    void const *              job        = nullptr;
+    void ( *invoke )( void const *, uint32_t, uint32_t ) = nullptr;
+
+    static uint64_t pack( uint64_t first, uint64_t end )
+    {
+      return first | end << 32;
+    }
+
+    void loop( uint32_t worker, uint64_t seen )
+    {
+      for ( ;; )
+      {
+        {
+          std::unique_lock lock( mutex );
+          wake.wait( lock, [&] { return stopping || generation != seen; } );
+          if ( stopping )
+            return;
+          seen = generation;
+        }
+        work( worker );
+        std::lock_guard lock( mutex );
+        if ( --running == 0 )
+          done.notify_one();
+      }
+    }
+
+    void work( uint32_t worker )
+    {
+      for ( ;; )
+      {
+        uint32_t task = 0;
+        if ( pop( worker, task ) )
+          invoke( job, task, worker );
+        else if ( !steal( worker ) )
+          return;
+      }
+    }
+
+    bool pop( uint32_t worker, uint32_t & task )
+    {
+      std::atomic<uint64_t> & range = shares[worker].range;
+      uint64_t                value = range.load( std::memory_order_acquire );
+      for ( ;; )
+      {
+        uint64_t first = value & 0xFFFFFFFFu;
+        uint64_t end   = value >> 32;
+        if ( first >= end )
+          return false;
+        if ( range.compare_exchange_weak( value, pack( first + 1, end ), std::memory_order_acq_rel ) )
+        {
+          task = static_cast<uint32_t>( first );
+          return true;
+        }
+      }
+    }
+
+    // Moves the back half of another worker's share into this worker's empty one
+    bool steal( uint32_t worker )
+    {
+      for ( uint32_t k = 1; k < workers; ++k )
+      {
+        std::atomic<uint64_t> & range = shares[( worker + k ) % workers].range;
+        uint64_t                value = range.load( std::memory_order_acquire );
+        for ( ;; )
+        {
+          uint64_t first = value & 0xFFFFFFFFu;
+          uint64_t end   = value >> 32;
+          if ( first >= end )
+            break;
+          uint64_t middle = first + ( end - first ) / 2;
+          if ( range.compare_exchange_weak( value, pack( first, middle ), std::memory_order_acq_rel ) )
+          {
+            shares[worker].range.store( pack( middle, end ), std::memory_order_release );
+            steals.fetch_add( 1, std::memory_order_relaxed );
+            return true;
+          }
+        }
+      }
+      return false;
+    }
+  };
+
+  // The sphere simulation of VerletSim on the CPU, for machines without a capable GPU and for reproducible runs.
+  // It seeds the same spheres and runs the same substeps: integrate, bin into a grid, resolve contacts with the
+  // Jacobi step of verlet.comp. Soft bodies are not supported.
+  //
+  // Positions live in padded SoA float arrays that the kernels stream eight lanes at a time through
+  // detail::NativeLanes (AVX2 in CAM3_AVX2 builds, NEON on arm64, scalar otherwise). The broadphase is a uniform
+  // grid over the container, cells of at least one diameter numbered x fastest, so the cells of one x row are
+  // consecutive:
+  //
+  //   integrate  per block of BlockSize spheres, also the cell of every sphere
+  //   sort       LSD radix sort of the cells, RadixBits per pass, each pass a count and a scatter per block
+  //   gather     per block of sorted entries, the positions in sorted order and the first entry of every row
+  //   collide    per tile of TileCells cells in whole rows. A cell's three x-neighbors in one row are a single
+  //              range of the sorted positions, found by binary search inside the row, so a sphere tests 9
+  //              contiguous ranges of candidates and writes its correction to its own slot
+  //
+  // Only occupied cells cost anything, most of a container is empty while the spheres pile up at the bottom.
+  // Tasks split the spheres and the grid the same way for any thread count and the sort is stable, so a sphere
+  // sees its neighbors in the same order and sums them with the same lanes on every run: the state is bitwise
+  // identical for a given seed, build and kernel, whatever the thread count and however the pool spreads the work.
+  struct CpuVerletSim
+  {
+    static constexpr uint32_t BlockSize  = 8192;      // spheres per integration, sorting and gathering task, a multiple of 8
+    static constexpr uint32_t TileCells  = 4096;      // cells per collision task, rounded to whole x rows
+    static constexpr uint32_t RadixBits  = 11;        // per sorting pass, two passes cover MaxCells
+    static constexpr uint32_t MaxCells   = 1u << 22;  // larger containers get larger cells
+    static constexpr uint32_t MaxSpheres = VerletSim::MaxSpheres;
+    static constexpr float    Padding    = 1e18f;  // position of the lanes past the last sorted sphere, far from all
+
+    struct Timings
+    {
+      float integrateMs = 0.0f;  // with the cells
+      float sortMs      = 0.0f;  // radix sort and gather
+      float collideMs   = 0.0f;
+      float encodeMs    = 0.0f;
+    };
+
+    VerletParams params;
+    uint32_t     count    = 0;
+    uint64_t     substeps = 0;      // since the last reset
+    uint64_t     contacts = 0;      // of the last substep
+    uint32_t     threads  = 0;      // 0 for every hardware thread, applied by reset()
+    bool         scalar   = false;  // the scalar kernels in place of detail::NativeLanes
+    bool         paused   = false;
+    float        frameMs  = 0.0f;  // stepping and encoding of the last frame
+    Timings      timings;
+    std::string  error;
+
+    std::array<core::Buffer, global::state::MAX_FRAMES_IN_FLIGHT> instances;  // per frame slot, data::instanceFormat
+    std::array<uint32_t, global::state::MAX_FRAMES_IN_FLIGHT>      instanceIndices;
+
+    CpuVerletSim()
+    {
+      instanceIndices.fill( InvalidBindlessIndex );
+    }
+
+    void init( VmaAllocator allocator_ )
+    {
+      allocator = allocator_;
+    }
+
+    [[nodiscard]] static char const * nativeKernel()
+    {
+      return detail::NativeLanes::Name;
+    }
+
+    [[nodiscard]] char const * kernel() const
+    {
+      return scalar ? detail::ScalarLanes::Name : detail::NativeLanes::Name;
+    }
+
+    [[nodiscard]] uint32_t threadCount() const
+    {
+      return pool.size();
+    }
+
+    [[nodiscard]] uint64_t steals() const
+    {
+      return pool.steals.load();
+    }
+
+    // Allocates the state for `params_.count` spheres and seeds them like VerletPass::Seed. Instance buffers of
+    // another count stop being drawn until attach().
+    void reset( VerletParams const & params_ )
+    {
+      if ( params_.count == 0 || params_.count > MaxSpheres )
+        throw std::runtime_error( "Sphere count has to be between 1 and " + std::to_string( MaxSpheres ) );
+      if ( params_.radius <= 0.0f || params_.radius > data::instanceMaxScale * data::modelRadius )
+        throw std::runtime_error( "Sphere radius has to be between 0 and " + std::to_string( data::instanceMaxScale * data::modelRadius ) );
+      glm::vec3 extent = params_.boundsMax - params_.boundsMin;
+      if ( params_.radius * 2.0f > std::min( { extent.x, extent.y, extent.z } ) )
+        throw std::runtime_error( "Spheres do not fit into the container" );
+      if ( params_.softBodies > 0 )
+        throw std::runtime_error( "The CPU spheres have no springs, set the soft bodies to 0" );
+
+      params   = params_;
+      count    = params.count;
+      substeps = 0;
+      contacts = 0;
+      if ( pool.size() != ( threads ? threads : std::max( 1u, std::thread::hardware_concurrency() ) ) )
+        pool.start( threads );
+
+      uint32_t padded = ( count + 7 ) & ~7u;
+      for ( std::vector<float> * array : { &x, &y, &z, &oldX, &oldY, &oldZ } )
+        array->assign( padded, 0.0f );
+      for ( std::vector<float> * array : { &sortedX, &sortedY, &sortedZ } )
+        array->assign( count + 8, Padding );
+      for ( std::vector<uint32_t> * array : { &keys, &order, &scratchKeys, &scratchOrder } )
+        array->assign( count, 0 );
+      resizeGrid();
+
+      glm::vec3 low  = params.boundsMin + params.radius;
+      glm::vec3 high = params.boundsMax - params.radius;
+      float     dt   = substepTime();
+      pool.run( blockCount(),
+                [&]( uint32_t block, uint32_t )
+                {
+                  for ( uint32_t i = block * BlockSize; i < std::min( count, ( block + 1 ) * BlockSize ); ++i )
+                  {
+                    uint32_t  state    = i + detail::pcgHash( params.seed );
+                    float     rx       = detail::nextRandom( state );
+                    float     ry       = detail::nextRandom( state );
+                    float     rz       = detail::nextRandom( state );
+                    glm::vec3 position = glm::mix( low, high, glm::vec3( rx, ry, rz ) );
+                    float     cz       = detail::nextRandom( state ) * 2.0f - 1.0f;
+                    float     phi      = detail::nextRandom( state ) * 6.28318530718f;
+                    float     plane    = std::sqrt( std::max( 1.0f - cz * cz, 0.0f ) );
+                    glm::vec3 velocity = glm::vec3( plane * std::cos( phi ), plane * std::sin( phi ), cz ) * params.launchSpeed * dt;
+                    x[i]               = position.x;
+                    y[i]               = position.y;
+                    z[i]               = position.z;
+                    oldX[i]            = position.x - velocity.x;
+                    oldY[i]            = position.y - velocity.y;
+                    oldZ[i]            = position.z - velocity.z;
+                  }
+                } );
+    }
+
+    // Instance buffers for drawing, one per frame slot. Nothing may still use the previous ones.
+    void attach( BindlessHeap & heap, uint64_t frame )
+    {
+      detach( heap, frame );
+      constexpr VmaAllocationCreateFlags upload = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      for ( uint32_t slot = 0; slot < instances.size(); ++slot )
+      {
+        instances[slot] = core::createBuffer(
+          allocator, instanceStride( data::instanceFormat ) * vk::DeviceSize( std::max( count, 1u ) ), vk::BufferUsageFlagBits::eStorageBuffer, upload );
+        instanceIndices[slot] = heap.addStorageBuffer( instances[slot].buffer );
+      }
+      attachedCount = count;
+      for ( uint32_t slot = 0; slot < instances.size(); ++slot )
+        encode( slot );
+    }
+
+    void detach( BindlessHeap & heap, uint64_t frame )
+    {
+      for ( uint32_t slot = 0; slot < instances.size(); ++slot )
+      {
+        heap.remove( BindlessHeap::StorageBuffers, instanceIndices[slot], frame );
+        instanceIndices[slot] = InvalidBindlessIndex;
+        core::destroyBuffer( allocator, instances[slot] );
+      }
+      attachedCount = 0;
+    }
+
+    // Nothing may still use the instance buffers
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      detach( heap, frame );
+      pool.stop();
+      count = 0;
+    }
+
+    [[nodiscard]] bool drawable() const
+    {
+      return count > 0 && attachedCount == count;
+    }
+
+    // Steps one frame unless paused and encodes the spheres into the instances of `slot`, after its fence wait
+    void frame( uint32_t slot )
+    {
+      if ( count == 0 )
+        return;
+      auto begin = std::chrono::steady_clock::now();
+      timings    = Timings{};
+      if ( !paused )
+        step();
+      if ( drawable() )
+        encode( slot );
+      frameMs = std::chrono::duration<float, std::milli>( std::chrono::steady_clock::now() - begin ).count();
+    }
+
+    // All substeps of one frame
+    void step()
+    {
+      uint32_t steps = std::max( params.substeps, 1u );
+      for ( uint32_t i = 0; i < steps; ++i )
+      {
+        if ( scalar )
+          substep<detail::ScalarLanes>();
+        else
+          substep<detail::NativeLanes>();
+      }
+    }
+
+    // FNV-1a over the current and previous positions, equal for equal states
+    [[nodiscard]] uint64_t stateHash() const
+    {
+      uint64_t hash = 14695981039346656037ull;
+      for ( std::vector<float> const * array : { &x, &y, &z, &oldX, &oldY, &oldZ } )
+      {
+        auto const * bytes = reinterpret_cast<uint8_t const *>( array->data() );
+        for ( size_t i = 0; i < size_t( count ) * sizeof( float ); ++i )
+          hash = ( hash ^ bytes[i] ) * 1099511628211ull;
+      }
+      return hash;
+    }
+
+  private:
+    static constexpr uint32_t Digits = 1u << RadixBits;
+
+    VmaAllocator     allocator = nullptr;
+    WorkStealingPool pool;
+
+    std::vector<float>    x, y, z;                    // current positions, padded to a multiple of 8
+    std::vector<float>    oldX, oldY, oldZ;           // previous positions
+    std::vector<float>    sortedX, sortedY, sortedZ;  // current positions in `order`, Padding past the end
+    std::vector<uint32_t> keys;                       // cell per sphere, sorted by the radix sort
+    std::vector<uint32_t> order;                      // sphere indices, sorted along with the keys
+    std::vector<uint32_t> scratchKeys;                // the other side of every radix pass
+    std::vector<uint32_t> scratchOrder;
+    std::vector<uint32_t> digitCounts;                // [blocks * Digits], per block count of every digit, then its cursors
+    std::vector<uint32_t> rowStart;                   // [rows + 1], first sorted entry of every x row
+    std::vector<uint64_t> tileContacts;
+
+    glm::uvec3 cells         = glm::uvec3( 1 );
+    float      cellSize      = 1.0f;
+    uint32_t   rowsPerTile   = 1;
+    uint32_t   tiles         = 1;
+    uint32_t   passes        = 1;
+    uint32_t   attachedCount = 0;  // spheres the instance buffers hold
+
+    [[nodiscard]] float substepTime() const
+    {
+      return params.frameTime / float( std::max( params.substeps, 1u ) );
+    }
+
+    [[nodiscard]] uint32_t blockCount() const
+    {
+      return ( count + BlockSize - 1 ) / BlockSize;
+    }
+
+    [[nodiscard]] uint32_t rowCount() const
+    {
+      return cells.y * cells.z;
+    }
+
+    // A diameter per cell keeps every contact within the 27 neighbors, larger containers grow the cells
+    void resizeGrid()
+    {
+      glm::vec3 extent = params.boundsMax - params.boundsMin;
+      cellSize         = std::max( 2.0f * params.radius, std::cbrt( extent.x * extent.y * extent.z / float( MaxCells ) ) );
+      cells            = glm::max( glm::uvec3( glm::ceil( extent / cellSize ) ), glm::uvec3( 1 ) );
+      rowsPerTile      = std::max( TileCells / cells.x, 1u );
+      tiles            = ( rowCount() + rowsPerTile - 1 ) / rowsPerTile;
+      passes           = std::max( ( uint32_t( std::bit_width( cells.x * rowCount() - 1 ) ) + RadixBits - 1 ) / RadixBits, 1u );
+
+      digitCounts.assign( size_t( blockCount() ) * Digits, 0 );
+      rowStart.assign( rowCount() + 1, 0 );
+      tileContacts.assign( tiles, 0 );
+    }
+
+    [[nodiscard]] uint32_t cellKey( uint32_t i ) const
+    {
+      float    inverse = 1.0f / cellSize;
+      uint32_t cx      = std::min( uint32_t( std::max( ( x[i] - params.boundsMin.x ) * inverse, 0.0f ) ), cells.x - 1 );
+      uint32_t cy      = std::min( uint32_t( std::max( ( y[i] - params.boundsMin.y ) * inverse, 0.0f ) ), cells.y - 1 );
+      uint32_t cz      = std::min( uint32_t( std::max( ( z[i] - params.boundsMin.z ) * inverse, 0.0f ) ), cells.z - 1 );
+      return ( cz * cells.y + cy ) * cells.x + cx;
+    }
+
+    template <typename L>
+    void substep()
+    {
+      using Clock = std::chrono::steady_clock;
+
+      float          dt         = substepTime();
+      glm::vec3      low        = params.boundsMin + params.radius;
+      glm::vec3      high       = params.boundsMax - params.radius;
+      glm::vec3      fall       = params.gravity * ( dt * dt );
+      bool           collisions = params.collisions;
+      uint32_t const blocks     = blockCount();
+
+      auto begin = Clock::now();
+      pool.run( blocks,
+                [&]( uint32_t block, uint32_t )
+                {
+                  uint32_t first = block * BlockSize;
+                  uint32_t end   = std::min( first + BlockSize, ( count + 7 ) & ~7u );
+                  integrate<L>( first, end, low, high, fall );
+                  if ( !collisions )
+                    return;
+                  for ( uint32_t i = first; i < std::min( end, count ); ++i )
+                  {
+                    keys[i]  = cellKey( i );
+                    order[i] = i;
+                  }
+                } );
+      auto integrated = Clock::now();
+      timings.integrateMs += std::chrono::duration<float, std::milli>( integrated - begin ).count();
+      ++substeps;
+      if ( !collisions )
+      {
+        contacts = 0;
+        return;
+      }
+
+      for ( uint32_t pass = 0; pass < passes; ++pass )
+        radixPass( pass * RadixBits );
+      pool.run( blocks, [&]( uint32_t block, uint32_t ) { gather( block ); } );
+      auto sorted = Clock::now();
+      timings.sortMs += std::chrono::duration<float, std::milli>( sorted - integrated ).count();
+
+      pool.run( tiles, [&]( uint32_t tile, uint32_t ) { tileContacts[tile] = collideTile<L>( tile, low, high ); } );
+      contacts = 0;
+      for ( uint64_t found : tileContacts )
+        contacts += found;
+      timings.collideMs += std::chrono::duration<float, std::milli>( Clock::now() - sorted ).count();
+    }
+
+    // Position Verlet of verlet.comp on [first, end), a multiple of 8
+    template <typename L>
+    void integrate( uint32_t first, uint32_t end, glm::vec3 low, glm::vec3 high, glm::vec3 fall )
+    {
+      using V = typename L::V;
+
+      V const                      keep     = L::splat( 1.0f - params.damping );
+      std::array<float *, 3> const current  = { x.data(), y.data(), z.data() };
+      std::array<float *, 3> const previous = { oldX.data(), oldY.data(), oldZ.data() };
+      V const                      lows[3]  = { L::splat( low.x ), L::splat( low.y ), L::splat( low.z ) };
+      V const                      highs[3] = { L::splat( high.x ), L::splat( high.y ), L::splat( high.z ) };
+      V const                      falls[3] = { L::splat( fall.x ), L::splat( fall.y ), L::splat( fall.z ) };
+      for ( uint32_t axis = 0; axis < 3; ++axis )
+        for ( uint32_t i = first; i < end; i += 8 )
+        {
+          V position = L::load( current[axis] + i );
+          V velocity = L::mul( L::sub( position, L::load( previous[axis] + i ) ), keep );
+          V next     = L::add( L::add( position, velocity ), falls[axis] );
+          L::store( previous[axis] + i, position );
+          L::store( current[axis] + i, L::min( L::max( next, lows[axis] ), highs[axis] ) );
+        }
+    }
+
+    // One stable counting pass over the digit at `shift`: every block counts its digits, the offsets follow the
+    // digits and inside a digit the blocks in order, then every block scatters its entries in order
+    void radixPass( uint32_t shift )
+    {
+      uint32_t const blocks = blockCount();
+      pool.run( blocks,
+                [&]( uint32_t block, uint32_t )
+                {
+                  uint32_t * counts = digitCounts.data() + size_t( block ) * Digits;
+                  std::fill( counts, counts + Digits, 0u );
+                  for ( uint32_t i = block * BlockSize; i < std::min( count, ( block + 1 ) * BlockSize ); ++i )
+                    ++counts[keys[i] >> shift & ( Digits - 1 )];
+                } );
+
+      uint32_t running = 0;
+      for ( uint32_t digit = 0; digit < Digits; ++digit )
+        for ( uint32_t block = 0; block < blocks; ++block )
+        {
+          uint32_t & slot = digitCounts[size_t( block ) * Digits + digit];
+          uint32_t   n    = slot;
+          slot            = running;
+          running += n;
+        }
+
+      pool.run( blocks,
+                [&]( uint32_t block, uint32_t )
+                {
+                  uint32_t * cursor = digitCounts.data() + size_t( block ) * Digits;
+                  for ( uint32_t i = block * BlockSize; i < std::min( count, ( block + 1 ) * BlockSize ); ++i )
+                  {
+                    uint32_t slot      = cursor[keys[i] >> shift & ( Digits - 1 )]++;
+                    scratchKeys[slot]  = keys[i];
+                    scratchOrder[slot] = order[i];
+                  }
+                } );
+      keys.swap( scratchKeys );
+      order.swap( scratchOrder );
+    }
+
+    // Positions in sorted order and the row starts of the sorted entries of a block, the rows between the
+    // previous entry's and this entry's start here
+    void gather( uint32_t block )
+    {
+      uint32_t first = block * BlockSize;
+      uint32_t end   = std::min( count, first + BlockSize );
+      uint32_t row   = first == 0 ? 0 : keys[first - 1] / cells.x + 1;
+      for ( uint32_t slot = first; slot < end; ++slot )
+      {
+        uint32_t sphere = order[slot];
+        sortedX[slot]   = x[sphere];
+        sortedY[slot]   = y[sphere];
+        sortedZ[slot]   = z[sphere];
+        for ( uint32_t last = keys[slot] / cells.x; row <= last; ++row )
+          rowStart[row] = slot;
+      }
+      if ( end == count )
+        for ( ; row <= rowCount(); ++row )
+          rowStart[row] = count;
+    }
+
+    // Jacobi contact step of verlet.comp for the spheres of a tile, returns their contacts. The spheres of a cell
+    // share its 9 candidate ranges, each the three x-neighbors of one row of cells. Cells come in increasing x
+    // within a row, so the ranges only move forward and are found by walking from the previous ones.
+    template <typename L>
+    uint64_t collideTile( uint32_t tile, glm::vec3 low, glm::vec3 high )
+    {
+      using V = typename L::V;
+
+      V const  diameter = L::splat( 2.0f * params.radius );
+      V const  half     = L::splat( 0.5f );
+      V const  epsilon  = L::splat( 1e-6f );
+      V const  zero     = L::splat( 0.0f );
+      uint64_t found    = 0;
+
+      std::array<uint32_t, 9>                      neighborRows;
+      std::array<std::pair<uint32_t, uint32_t>, 9> ranges;
+      uint32_t                                     rangeCount = 0;
+      uint32_t                                     currentRow = ~0u;
+
+      uint32_t const end = rowStart[std::min( ( tile + 1 ) * rowsPerTile, rowCount() )];
+      for ( uint32_t first = rowStart[tile * rowsPerTile], next = first; first < end; first = next )
+      {
+        uint32_t key = keys[first];
+        while ( next < end && keys[next] == key )
+          ++next;
+
+        uint32_t cx  = key % cells.x;
+        uint32_t row = key / cells.x;
+        if ( row != currentRow )
+        {
+          currentRow  = row;
+          rangeCount  = 0;
+          uint32_t cy = row % cells.y;
+          uint32_t cz = row / cells.y;
+          for ( uint32_t nz = cz > 0 ? cz - 1 : 0; nz <= std::min( cz + 1, cells.z - 1 ); ++nz )
+            for ( uint32_t ny = cy > 0 ? cy - 1 : 0; ny <= std::min( cy + 1, cells.y - 1 ); ++ny )
+            {
+              uint32_t neighbor = nz * cells.y + ny;
+              if ( rowStart[neighbor] == rowStart[neighbor + 1] )
+                continue;
+              neighborRows[rangeCount] = neighbor;
+              ranges[rangeCount++]     = { rowStart[neighbor], rowStart[neighbor] };
+            }
+        }
+
+        uint32_t firstKey = currentRow * cells.x + ( cx > 0 ? cx - 1 : 0 );
+        uint32_t endKey   = currentRow * cells.x + std::min( cx + 1, cells.x - 1 ) + 1;
+        for ( uint32_t r = 0; r < rangeCount; ++r )
+        {
+          uint32_t shift = ( neighborRows[r] - currentRow ) * cells.x;  // wraps for rows below, as the keys do
+          uint32_t limit = rowStart[neighborRows[r] + 1];
+          auto &   range = ranges[r];
+          while ( range.first < limit && keys[range.first] < firstKey + shift )
+            ++range.first;
+          range.second = std::max( range.second, range.first );
+          while ( range.second < limit && keys[range.second] < endKey + shift )
+            ++range.second;
+        }
+
+        for ( uint32_t slot = first; slot < next; ++slot )
+        {
+          V        selfX = L::splat( sortedX[slot] );
+          V        selfY = L::splat( sortedY[slot] );
+          V        selfZ = L::splat( sortedZ[slot] );
+          V        sumX  = zero;
+          V        sumY  = zero;
+          V        sumZ  = zero;
+          uint32_t hits  = 0;
+          for ( uint32_t r = 0; r < rangeCount; ++r )
+            for ( uint32_t k = ranges[r].first; k < ranges[r].second; k += 8 )
+            {
+              V    dx       = L::sub( selfX, L::load( sortedX.data() + k ) );
+              V    dy       = L::sub( selfY, L::load( sortedY.data() + k ) );
+              V    dz       = L::sub( selfZ, L::load( sortedZ.data() + k ) );
+              V    distance = L::sqrt( L::add( L::add( L::mul( dx, dx ), L::mul( dy, dy ) ), L::mul( dz, dz ) ) );
+              V    overlap  = L::sub( diameter, distance );
+              auto touching = L::both( L::both( L::greater( overlap, zero ), L::greater( distance, epsilon ) ), L::lanesBelow( ranges[r].second - k ) );
+              V    push     = L::select( touching, L::div( L::mul( overlap, half ), distance ), zero );
+              sumX          = L::add( sumX, L::mul( dx, push ) );
+              sumY          = L::add( sumY, L::mul( dy, push ) );
+              sumZ          = L::add( sumZ, L::mul( dz, push ) );
+              hits += L::count( touching );
+            }
+
+          uint32_t sphere = order[slot];
+          x[sphere]       = std::min( std::max( sortedX[slot] + L::sum( sumX ) * params.relaxation, low.x ), high.x );
+          y[sphere]       = std::min( std::max( sortedY[slot] + L::sum( sumY ) * params.relaxation, low.y ), high.y );
+          z[sphere]       = std::min( std::max( sortedZ[slot] + L::sum( sumZ ) * params.relaxation, low.z ), high.z );
+          found += hits;
+        }
+      }
+      return found;
+    }
+
+    // The instance writeInstance() of verlet.comp would store, into the mapped buffer of `slot`
+    void encode( uint32_t slot )
+    {
+      auto   begin  = std::chrono::steady_clock::now();
+      void * mapped = instances[slot].allocationInfo.pMappedData;
+      float  scale  = params.radius / data::modelRadius;
+      float  speed  = substepTime() * params.colorSpeed;
+      pool.run( blockCount(),
+                [&]( uint32_t block, uint32_t )
+                {
+                  for ( uint32_t i = block * BlockSize; i < std::min( count, ( block + 1 ) * BlockSize ); ++i )
+                  {
+                    glm::vec3          position = glm::vec3( x[i], y[i], z[i] );
+                    float              heat     = std::clamp( glm::length( position - glm::vec3( oldX[i], oldY[i], oldZ[i] ) ) / speed, 0.0f, 1.0f );
+                    data::InstanceData instance{ position, scale };
+                    instance.color = glm::vec4( glm::mix( glm::vec3( 0.2f, 0.45f, 1.0f ), glm::vec3( 1.0f, 0.45f, 0.1f ), heat ), 1.0f );
+                    storeInstance( data::instanceFormat, mapped, i, count, instance );
+                  }
+                } );
+      vmaFlushAllocation( allocator, instances[slot].allocation, 0, VK_WHOLE_SIZE );
+      timings.encodeMs += std::chrono::duration<float, std::milli>( std::chrono::steady_clock::now() - begin ).count();
+    }
+  };
+
+  // Steps per second of CpuVerletSim from 10k to 1M spheres with the parameters of the Spheres window, each
+  // count in a fresh simulation. Counts up to DeterminismLimit are also run on a single thread, the final states
+  // have to hash the same.
+  struct CpuVerletBenchmark
+  {
+    static constexpr std::array<uint32_t, 6> Counts           = { 10000, 50000, 100000, 250000, 500000, 1000000 };
+    static constexpr uint32_t                DeterminismLimit = 100000;
+
+    struct Result
+    {
+      uint32_t count            = 0;
+      uint32_t threads          = 0;
+      uint32_t substeps         = 0;
+      float    msPerFrame       = 0.0f;
+      float    stepsPerSecond   = 0.0f;  // substeps
+      float    spheresPerSecond = 0.0f;  // millions of sphere substeps
+      uint64_t contacts         = 0;     // in the last substep
+      uint64_t hash             = 0;
+      bool     checked          = false;  // compared against a single thread
+      bool     deterministic    = false;
+
+      CpuVerletSim::Timings timings;  // per frame
+    };
+
+    uint32_t            warmupFrames = 2;
+    uint32_t            frames       = 8;
+    uint32_t            threads      = 0;
+    bool                scalar       = false;
+    std::vector<Result> results;
+    std::string         error;
+
+    void run( VerletParams const & params )
+    {
+      using Clock = std::chrono::steady_clock;
+
+      results.clear();
+      error.clear();
+      try
+      {
+        CpuVerletSim sim;
+        sim.threads = threads;
+        sim.scalar  = scalar;
+        for ( uint32_t count : Counts )
+        {
+          VerletParams scratch = params;
+          scratch.count        = std::min( count, CpuVerletSim::MaxSpheres );
+          scratch.softBodies   = 0;
+          sim.reset( scratch );
+          for ( uint32_t i = 0; i < warmupFrames; ++i )
+            sim.step();
+
+          Result                result{};
+          CpuVerletSim::Timings total;
+          uint32_t              timed = std::max( frames, 1u );
+          auto                  begin = Clock::now();
+          for ( uint32_t i = 0; i < timed; ++i )
+          {
+            sim.timings = CpuVerletSim::Timings{};
+            sim.step();
+            total.integrateMs += sim.timings.integrateMs / float( timed );
+            total.sortMs += sim.timings.sortMs / float( timed );
+            total.collideMs += sim.timings.collideMs / float( timed );
+          }
+          result.count      = sim.count;
+          result.threads    = sim.threadCount();
+          result.substeps   = std::max( scratch.substeps, 1u );
+          result.msPerFrame = std::chrono::duration<float, std::milli>( Clock::now() - begin ).count() / float( timed );
+          result.contacts   = sim.contacts;
+          result.hash       = sim.stateHash();
+          result.timings    = total;
+          if ( result.msPerFrame > 0.0f )
+          {
+            result.stepsPerSecond   = float( result.substeps ) * 1000.0f / result.msPerFrame;
+            result.spheresPerSecond = float( result.count ) * result.stepsPerSecond * 1e-6f;
+          }
+
+          if ( result.count <= DeterminismLimit && result.threads > 1 )
+          {
+            CpuVerletSim single;
+            single.threads = 1;
+            single.scalar  = scalar;
+            single.reset( scratch );
+            for ( uint32_t i = 0; i < warmupFrames + timed; ++i )
+              single.step();
+            result.checked       = true;
+            result.deterministic = single.stateHash() == result.hash;
+          }
+          results.push_back( result );
+
+          isDebug( std::println( "[cpu verlet] {} spheres, {} threads, {}: {:.2f} ms/frame, {:.0f} substeps/s, {:.1f} M sphere substeps/s, hash {:016x}{}",
+                                 result.count,
+                                 result.threads,
+                                 sim.kernel(),
+                                 result.msPerFrame,
+                                 result.stepsPerSecond,
+                                 result.spheresPerSecond,
+                                 result.hash,
+                                 result.checked ? ( result.deterministic ? ", matches one thread" : ", DIFFERS from one thread" ) : "" ) );
+        }
+      }
+      catch ( std::exception const & e )
+      {
+        error = e.what();
+      }
+    }
+  };
+}  // namespace core
@@ -0,0 +1,425 @@
+#pragma once
+#include "../data.hpp"
+#include "../setup.hpp"
+#include "../state.hpp"
+#include "bindless.hpp"
+#include "compute.hpp"
+#include "hiz.hpp"
+#include "material.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <optional>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Planes point inwards, a sphere is outside when dot(plane.xyz, center) + plane.w < -radius for any plane
+  [[nodiscard]] inline std::array<glm::vec4, 6> extractFrustumPlanes( glm::mat4 const & viewProj )
+  {
+    auto row = [&]( int i ) { return glm::vec4( viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i] ); };
+
+    std::array<glm::vec4, 6> planes = {
+      row( 3 ) + row( 0 ),  // left
+      row( 3 ) - row( 0 ),  // right
+      row( 3 ) + row( 1 ),  // bottom
+      row( 3 ) - row( 1 ),  // top
+      row( 3 ) + row( 2 ),  // near
+      row( 3 ) - row( 2 ),  // far
+    };
+
+    for ( auto & plane : planes )
+      plane /= glm::length( glm::vec3( plane ) );
+
+    return planes;
+  }
+
+  // Draw buffer layout shared by the culling shaders and vkCmdDrawIndexedIndirectCount:
+  //   uint                         drawCount       offset 0, LOD count of the frame
+  //   uint                         frustumVisible  counted by the late phase
+  //   uint                         occluded        counted by the late phase
+  //   uint                         pad
+  //   VkDrawIndexedIndirectCommand commands[]      offset DrawCommandsOffset, Model::MaxLods per phase:
+  //                                                early/frustum draws first, late draws after them
+  inline constexpr vk::DeviceSize DrawCommandsOffset = 16;
+  inline constexpr vk::DeviceSize DrawCommandStride  = sizeof( vk::DrawIndexedIndirectCommand );
+  inline constexpr vk::DeviceSize DrawBufferSize     = DrawCommandsOffset + 2 * Model::MaxLods * DrawCommandStride;
+
+  enum class CullMode : uint8_t
+  {
+    Off,        // every instance is drawn at LOD 0
+    Frustum,    // one cull pass, one draw per LOD
+    Occlusion,  // two phases against a depth pyramid of the first one
+  };
+
+  [[nodiscard]] inline const char * toString( CullMode mode )
+  {
+    switch ( mode )
+    {
+      case CullMode::Off: return "Off";
+      case CullMode::Frustum: return "Frustum";
+      case CullMode::Occlusion: return "Frustum + occlusion";
+    }
+    return "";
+  }
+
+  // Value of data::CullPushConstants::phase, mirrors cull.comp
+  enum class CullPhase : uint32_t
+  {
+    Frustum = 0,
+    Early   = 1,  // instances visible last frame, drawn to build the depth pyramid
+    Late    = 2,  // every instance against the pyramid, draws those not drawn in the early phase
+  };
+
+  // GPU culling and LOD selection of the instance buffer.
+  // cull.comp compacts the surviving instances into the visible list of their LOD and counts them into that
+  // LOD's indexed indirect draw, the scene pass then draws every LOD with one vkCmdDrawIndexedIndirectCount and
+  // reads its instance through visible[gl_InstanceIndex] (firstInstance selects the LOD's list region).
+  //
+  // In CullMode::Occlusion a frame is: early cull -> early draw -> depth pyramid -> late cull -> late draw.
+  // The history buffer carries per-instance visibility of the late phase and the current LOD into the next frame.
+  struct InstanceCuller
+  {
+    // Read back from the GPU, MAX_FRAMES_IN_FLIGHT frames old
+    struct Stats
+    {
+      CullMode                             mode           = CullMode::Off;
+      uint32_t                             drawn          = 0;
+      uint32_t                             early          = 0;  // drawn by the frustum or early phase
+      uint32_t                             late           = 0;  // newly visible, drawn by the late phase
+      uint32_t                             frustumVisible = 0;
+      uint32_t                             occluded       = 0;  // inside the frustum but behind the depth pyramid
+      std::array<uint32_t, Model::MaxLods> lodInstances{};
+      uint64_t                             triangles     = 0;  // submitted by the draws
+      uint64_t                             trianglesLod0 = 0;  // the same instances drawn without LOD
+    };
+
+    CullMode mode          = CullMode::Occlusion;
+    bool     lodEnabled    = true;
+    float    lodHysteresis = 0.15f;
+    uint32_t instanceCount = 0;
+    Stats    stats;
+
+    DepthPyramid pyramid;
+
+    core::Buffer visible;
+    core::Buffer visibleLate;
+    core::Buffer history;
+    core::Buffer draws;
+    uint32_t     visibleIndex     = InvalidBindlessIndex;
+    uint32_t     visibleLateIndex = InvalidBindlessIndex;
+    uint32_t     historyIndex     = InvalidBindlessIndex;
+    uint32_t     drawsIndex       = InvalidBindlessIndex;
+
+    // `model` is drawn by every instance and has to outlive the culler
+    void init( vk::raii::Device const & device, VmaAllocator allocator_, BindlessHeap & heap, uint32_t instanceCount_, Model const & model_ )
+    {
+      allocator     = allocator_;
+      instanceCount = instanceCount_;
+      model         = &model_;
+
+      shader = ComputeShader( device, "cull.comp", sizeof( data::CullPushConstants ), { *heap.layout } );
+      pyramid.init( device, allocator, heap );
+
+      createLists( heap );
+      draws = core::createBuffer( allocator,
+                                  DrawBufferSize,
+                                  vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer |
+                                    vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc );
+      drawsIndex = heap.addStorageBuffer( draws.buffer );
+
+      for ( auto & buffer : readback )
+        buffer = core::createBuffer(
+          allocator, DrawBufferSize, vk::BufferUsageFlagBits::eTransferDst, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT );
+    }
+
+    // New instance buffer size, the visible lists and the history are reallocated and the history starts empty.
+    // Nothing may still use the previous buffers (wait for the device first).
+    void resize( BindlessHeap & heap, uint32_t instanceCount_, uint64_t frame )
+    {
+      heap.remove( BindlessHeap::StorageBuffers, visibleIndex, frame );
+      heap.remove( BindlessHeap::StorageBuffers, visibleLateIndex, frame );
+      heap.remove( BindlessHeap::StorageBuffers, historyIndex, frame );
+      destroyLists();
+
+      instanceCount  = instanceCount_;
+      historyCleared = false;
+      createLists( heap );
+    }
+
+    void destroy()
+    {
+      pyramid.destroy();
+      destroyLists();
+      core::destroyBuffer( allocator, draws );
+      for ( auto & buffer : readback )
+        core::destroyBuffer( allocator, buffer );
+    }
+
+    // Levels drawn this frame, only LOD 0 while LOD selection is disabled
+    [[nodiscard]] uint32_t lodCount() const
+    {
+      return lodEnabled ? static_cast<uint32_t>( model->lods.size() ) : 1;
+    }
+
+    // Reset the draw commands (and the history on first use), before the first cull of the frame
+    void begin( vk::raii::CommandBuffer const & cmd )
+    {
+      // The previous frame may still read the draw/visible buffers
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eComputeShader |
+                 vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eTransferRead,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite );
+
+      // Every phase draws each LOD's index range, instanceCount is counted by the shader
+      std::array<uint32_t, DrawBufferSize / sizeof( uint32_t )> reset{};
+      reset[0]       = lodCount();
+      auto * command = reinterpret_cast<vk::DrawIndexedIndirectCommand *>( reset.data() + DrawCommandsOffset / sizeof( uint32_t ) );
+      for ( uint32_t phase = 0; phase < 2; ++phase )
+        for ( uint32_t lod = 0; lod < lodCount(); ++lod )
+          command[phase * Model::MaxLods + lod] =
+            vk::DrawIndexedIndirectCommand{ model->lods[lod].indexCount, 0, model->lods[lod].firstIndex, 0, lod * instanceCount };
+      cmd.updateBuffer<uint32_t>( draws.buffer, 0, reset );
+
+      // Nothing was visible before the first frame, the late phase of the first frame draws everything it finds
+      if ( !historyCleared )
+      {
+        cmd.fillBuffer( history.buffer, 0, VK_WHOLE_SIZE, 0 );
+        historyCleared = true;
+      }
+
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+
+      pendingLods = lodCount();
+    }
+
+    // One cull phase, results are visible to the indirect draw and the vertex shader afterwards.
+    // CullPhase::Late samples the pyramid, build it in between the early draw and this call.
+    void cull( vk::raii::CommandBuffer const & cmd,
+               BindlessHeap const &            heap,
+               glm::mat4 const &               view,
+               glm::mat4 const &               proj,
+               float                           znear,
+               float                           screenHeight,
+               uint32_t                        instanceBufferIndex,
+               CullPhase                       phase )
+    {
+      data::CullPushConstants pc{};
+      auto                    planes = extractFrustumPlanes( proj * view );
+      std::copy( planes.begin(), planes.end(), pc.planes );
+      pc.view          = view;
+      pc.projection    = glm::vec4( proj[0][0], -proj[1][1], proj[2][2], proj[3][2] );  // undo the Vulkan y flip
+      pc.znear         = znear;
+      pc.radius        = model->radius;
+      pc.screenHeight  = screenHeight;
+      pc.lodHysteresis = lodHysteresis;
+      for ( uint32_t lod = 0; lod < model->lods.size(); ++lod )
+        pc.lodScreenSizes[lod] = model->lods[lod].minScreenSize;
+      pc.instanceBuffer = instanceBufferIndex;
+      pc.visibleBuffer  = listIndex( phase );
+      pc.drawBuffer     = drawsIndex;
+      pc.instanceCount  = instanceCount;
+      pc.historyBuffer  = historyIndex;
+      pc.pyramidTexture = pyramid.textureIndex;
+      pc.pyramidSampler = pyramid.samplerIndex;
+      pc.phase          = static_cast<uint32_t>( phase );
+      pc.lodCount       = pendingLods;
+
+      shader.bind( cmd );
+      heap.bind( cmd, *shader.layout, vk::PipelineBindPoint::eCompute );
+      shader.push( cmd, pc );
+      cmd.dispatch( ( instanceCount + 63 ) / 64, 1, 1 );
+
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageWrite,
+               vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eComputeShader |
+                 vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite |
+                 vk::AccessFlagBits2::eTransferRead );
+    }
+
+    // Visible list the vertex shader reads for the draw of `phase`
+    [[nodiscard]] uint32_t listIndex( CullPhase phase ) const
+    {
+      return phase == CullPhase::Late ? visibleLateIndex : visibleIndex;
+    }
+
+    // All LODs of a phase, the model's buffers have to be bound
+    void draw( vk::raii::CommandBuffer const & cmd, CullPhase phase ) const
+    {
+      vk::DeviceSize first = phase == CullPhase::Late ? Model::MaxLods : 0;
+      cmd.drawIndexedIndirectCount( draws.buffer, DrawCommandsOffset + first * DrawCommandStride, draws.buffer, 0, Model::MaxLods, DrawCommandStride );
+    }
+
+    // Counters for the UI, read in collect() once this slot's fence signaled
+    void end( vk::raii::CommandBuffer const & cmd, uint32_t slot )
+    {
+      pendingMode[slot] = mode;
+      if ( mode == CullMode::Off )
+        return;
+
+      cmd.copyBuffer( draws.buffer, readback[slot].buffer, vk::BufferCopy{ 0, 0, DrawBufferSize } );
+      barrier( cmd, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead );
+    }
+
+    void collect( uint32_t slot )
+    {
+      if ( !pendingMode[slot] )
+        return;
+
+      stats      = Stats{};
+      stats.mode = *pendingMode[slot];
+      pendingMode[slot].reset();
+
+      uint64_t lod0Triangles = model->lods[0].triangleCount();
+      if ( stats.mode == CullMode::Off )
+      {
+        stats.drawn = stats.early = stats.frustumVisible = stats.lodInstances[0] = instanceCount;
+        stats.triangles = stats.trianglesLod0 = lod0Triangles * instanceCount;
+        return;
+      }
+
+      vmaInvalidateAllocation( allocator, readback[slot].allocation, 0, VK_WHOLE_SIZE );
+      auto const * header   = static_cast<uint32_t const *>( readback[slot].allocationInfo.pMappedData );
+      auto const * commands = reinterpret_cast<vk::DrawIndexedIndirectCommand const *>( reinterpret_cast<std::byte const *>( header ) + DrawCommandsOffset );
+
+      for ( uint32_t lod = 0; lod < header[0]; ++lod )
+      {
+        uint32_t early = commands[lod].instanceCount;
+        uint32_t late  = stats.mode == CullMode::Occlusion ? commands[Model::MaxLods + lod].instanceCount : 0;
+
+        stats.early += early;
+        stats.late += late;
+        stats.lodInstances[lod] = early + late;
+        stats.triangles += uint64_t( commands[lod].indexCount / 3 ) * ( early + late );
+      }
+
+      stats.drawn          = stats.early + stats.late;
+      stats.frustumVisible = stats.mode == CullMode::Occlusion ? header[1] : stats.early;
+      stats.occluded       = stats.mode == CullMode::Occlusion ? header[2] : 0;
+      stats.trianglesLod0  = lod0Triangles * stats.drawn;
+    }
+
+  private:
+    VmaAllocator  allocator = nullptr;
+    Model const * model     = nullptr;
+    ComputeShader shader;
+    bool          historyCleared = false;
+    uint32_t      pendingLods    = 1;  // lodCount() when the frame's commands were reset
+
+    std::array<core::Buffer, global::state::MAX_FRAMES_IN_FLIGHT>            readback;
+    std::array<std::optional<CullMode>, global::state::MAX_FRAMES_IN_FLIGHT> pendingMode;
+
+    void createLists( BindlessHeap & heap )
+    {
+      vk::DeviceSize listSize = sizeof( uint32_t ) * instanceCount * Model::MaxLods;
+      visible                 = core::createBuffer( allocator, listSize, vk::BufferUsageFlagBits::eStorageBuffer );
+      visibleLate             = core::createBuffer( allocator, listSize, vk::BufferUsageFlagBits::eStorageBuffer );
+      history                 = core::createBuffer(
+        allocator, sizeof( uint32_t ) * instanceCount, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst );
+
+      visibleIndex     = heap.addStorageBuffer( visible.buffer );
+      visibleLateIndex = heap.addStorageBuffer( visibleLate.buffer );
+      historyIndex     = heap.addStorageBuffer( history.buffer );
+    }
+
+    void destroyLists()
+    {
+      core::destroyBuffer( allocator, visible );
+      core::destroyBuffer( allocator, visibleLate );
+      core::destroyBuffer( allocator, history );
+    }
+
+    static void barrier( vk::raii::CommandBuffer const & cmd,
+                         vk::PipelineStageFlags2         srcStage,
+                         vk::AccessFlags2                srcAccess,
+                         vk::PipelineStageFlags2         dstStage,
+                         vk::AccessFlags2                dstAccess )
+    {
+      vk::MemoryBarrier2 memoryBarrier{ srcStage, srcAccess, dstStage, dstAccess };
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( memoryBarrier ) );
+    }
+  };
+
+  // Benchmark: steps the camera through a grid of yaw/pitch orientations, one per frame, and records the
+  // visible instance count and pass timings of every orientation once its frame slot is read back
+  struct OrientationSweep
+  {
+    static constexpr uint32_t YawSteps   = 36;
+    static constexpr uint32_t PitchSteps = 5;
+    static constexpr uint32_t StepCount  = YawSteps * PitchSteps;
+
+    struct Sample
+    {
+      glm::vec2 rotation;
+      uint32_t  visible   = 0;     // drawn instances
+      uint64_t  triangles = 0;     // submitted by the draws
+      float     cullMs    = 0.0f;  // cull phases and depth pyramid
+      float     sceneMs   = 0.0f;  // draws
+    };
+
+    bool                active = false;
+    std::vector<Sample> samples;
+
+    void start( glm::vec2 currentRotation )
+    {
+      active        = true;
+      next          = 0;
+      savedRotation = currentRotation;
+      samples.clear();
+      slotStep.fill( -1 );
+    }
+
+    // Before recording a frame, points the camera at the next orientation
+    void apply( uint32_t slot, glm::vec2 & rotation )
+    {
+      if ( !active )
+        return;
+
+      if ( next < StepCount )
+      {
+        slotStep[slot] = static_cast<int32_t>( next );
+        rotation       = orientation( next++ );
+        return;
+      }
+
+      rotation = savedRotation;
+      active   = std::any_of( slotStep.begin(), slotStep.end(), []( int32_t s ) { return s >= 0; } );
+    }
+
+    // After the slot's fence signaled, attributes the read back results to the orientation it rendered
+    void record( uint32_t slot, uint32_t visible, uint64_t triangles, float cullMs, float sceneMs )
+    {
+      if ( slotStep[slot] < 0 )
+        return;
+
+      samples.push_back( { orientation( static_cast<uint32_t>( slotStep[slot] ) ), visible, triangles, cullMs, sceneMs } );
+      slotStep[slot] = -1;
+    }
+
+  private:
+    uint32_t                                                 next = 0;
+    glm::vec2                                                savedRotation{ 0.0f };
+    std::array<int32_t, global::state::MAX_FRAMES_IN_FLIGHT> slotStep{};
+
+    static glm::vec2 orientation( uint32_t step )
+    {
+      float yaw   = glm::two_pi<float>() * float( step % YawSteps ) / float( YawSteps );
+      float pitch = glm::radians( -60.0f + 120.0f * float( step / YawSteps ) / float( PitchSteps - 1 ) );
+      return { yaw, pitch };
+    }
+  };
+}  // namespace core
@@ -0,0 +1,470 @@
+#pragma once
+#include "../state.hpp"
+#include "resources.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Summary of the allocator state, taken before and after a defragmentation run
+  struct MemorySnapshot
+  {
+    uint32_t     blockCount       = 0;  // VkDeviceMemory blocks owned by VMA
+    uint32_t     allocationCount  = 0;
+    uint32_t     freeRangeCount   = 0;  // free regions between allocations inside the blocks
+    VkDeviceSize blockBytes       = 0;
+    VkDeviceSize allocationBytes  = 0;
+    VkDeviceSize largestFreeRange = 0;
+    VkDeviceSize deviceLocalUsage = 0;  // bytes in DEVICE_LOCAL heaps
+    VkDeviceSize spilledUsage     = 0;  // bytes in the remaining heaps (spill to system memory)
+  };
+
+  [[nodiscard]] inline MemorySnapshot takeMemorySnapshot( VmaAllocator allocator )
+  {
+    VmaTotalStatistics total{};
+    vmaCalculateStatistics( allocator, &total );
+
+    MemorySnapshot snapshot{};
+    snapshot.blockCount       = total.total.statistics.blockCount;
+    snapshot.allocationCount  = total.total.statistics.allocationCount;
+    snapshot.blockBytes       = total.total.statistics.blockBytes;
+    snapshot.allocationBytes  = total.total.statistics.allocationBytes;
+    snapshot.freeRangeCount   = total.total.unusedRangeCount;
+    snapshot.largestFreeRange = total.total.unusedRangeCount > 0 ? total.total.unusedRangeSizeMax : 0;
+
+    const VkPhysicalDeviceMemoryProperties * memProps = nullptr;
+    vmaGetMemoryProperties( allocator, &memProps );
+
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+    vmaGetHeapBudgets( allocator, budgets.data() );
+
+    for ( uint32_t heap = 0; heap < memProps->memoryHeapCount; ++heap )
+    {
+      if ( memProps->memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT )
+        snapshot.deviceLocalUsage += budgets[heap].statistics.allocationBytes;
+      else
+        snapshot.spilledUsage += budgets[heap].statistics.allocationBytes;
+    }
+
+    return snapshot;
+  }
+
+  // Incremental VMA defragmentation for allocations owned by a ResourceTable.
+  //
+  // One pass is in flight at a time and every phase is driven from step(), once per frame:
+  //   Ready    -> vmaBeginDefragmentationPass, create replacement objects, record GPU copies, submit with a fence
+  //   Copying  -> fence signaled: patch the ResourceTable so the next recorded frame uses the new objects
+  //   Retiring -> wait MAX_FRAMES_IN_FLIGHT frames so nothing in flight touches the old objects, then
+  //               vmaEndDefragmentationPass and destroy them
+  // The size of a pass is bounded by maxBytesPerPass / maxAllocationsPerPass, and moves that do not fit in the
+  // CPU time budget of the frame are ignored and picked up again by a later pass.
+  struct Defragmenter
+  {
+    enum class Phase
+    {
+      Idle,
+      Ready,
+      Copying,
+      Retiring
+    };
+
+    struct Stats
+    {
+      VkDeviceSize bytesMoved       = 0;
+      VkDeviceSize bytesFreed       = 0;
+      uint32_t     allocationsMoved = 0;
+      uint32_t     blocksFreed      = 0;
+      uint32_t     passes           = 0;
+      float        lastStepMs       = 0.0f;  // CPU time spent in the last step()
+    };
+
+    // Tunables, exposed in the UI
+    VkDeviceSize maxBytesPerPass       = 16ull * 1024 * 1024;
+    uint32_t     maxAllocationsPerPass = 32;
+    float        timeBudgetMs          = 0.5f;
+    bool         autoDefragment        = false;
+    float        autoFreeRatio         = 0.25f;  // start automatically when this fraction of block bytes is unused
+
+    Phase          phase = Phase::Idle;
+    Stats          stats;
+    MemorySnapshot before;
+    MemorySnapshot after;
+
+    void init( vk::raii::Device const & device_, VmaAllocator allocator_, ResourceTable & table_, uint32_t queueFamily, vk::raii::Queue const & queue_ )
+    {
+      device    = *device_;
+      allocator = allocator_;
+      table     = &table_;
+      queue     = *queue_;
+
+      commandPool = vk::raii::CommandPool( device_, vk::CommandPoolCreateInfo{ vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamily } );
+      cmd         = std::move( vk::raii::CommandBuffers( device_, vk::CommandBufferAllocateInfo{ commandPool, vk::CommandBufferLevel::ePrimary, 1 } ).front() );
+      fence       = vk::raii::Fence( device_, vk::FenceCreateInfo{} );
+    }
+
+    [[nodiscard]] bool running() const
+    {
+      return phase != Phase::Idle;
+    }
+
+    void start()
+    {
+      if ( running() )
+        return;
+
+      VmaDefragmentationInfo info{};
+      info.flags                 = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+      info.maxBytesPerPass       = maxBytesPerPass;
+      info.maxAllocationsPerPass = maxAllocationsPerPass;
+
+      if ( vmaBeginDefragmentation( allocator, &info, &context ) != VK_SUCCESS )
+        throw std::runtime_error( "vmaBeginDefragmentation failed" );
+
+      before        = takeMemorySnapshot( allocator );
+      stats         = Stats{};
+      table->locked = true;
+      phase         = Phase::Ready;
+    }
+
+    // Drive the state machine, call once per frame before recording
+    void step( uint64_t frame )
+    {
+      auto begin = std::chrono::steady_clock::now();
+
+      switch ( phase )
+      {
+        case Phase::Idle:
+          if ( autoDefragment && frame % 240 == 0 )
+          {
+            MemorySnapshot snapshot = takeMemorySnapshot( allocator );
+            if ( snapshot.blockBytes > 0 && float( snapshot.blockBytes - snapshot.allocationBytes ) / float( snapshot.blockBytes ) > autoFreeRatio )
+              start();
+          }
+          break;
+        case Phase::Ready: beginPass( begin ); break;
+        case Phase::Copying:
+          if ( device.getFenceStatus( *fence ) == vk::Result::eSuccess )
+          {
+            patchTable();
+            retireFrame = frame;
+            phase       = Phase::Retiring;
+          }
+          break;
+        case Phase::Retiring:
+          if ( frame - retireFrame >= global::state::MAX_FRAMES_IN_FLIGHT )
+            endPass();
+          break;
+      }
+
+      stats.lastStepMs = std::chrono::duration<float, std::milli>( std::chrono::steady_clock::now() - begin ).count();
+    }
+
+    // Blocks until the current run is finished, used before shutdown
+    void finish()
+    {
+      while ( running() )
+      {
+        if ( phase == Phase::Copying )
+        {
+          (void)device.waitForFences( { *fence }, VK_TRUE, UINT64_MAX );
+          patchTable();
+          phase = Phase::Retiring;
+        }
+        else if ( phase == Phase::Retiring )
+        {
+          device.waitIdle();
+          endPass();
+        }
+        else
+        {
+          beginPass( std::chrono::steady_clock::now() );
+        }
+      }
+    }
+
+  private:
+    struct Replacement
+    {
+      ResourceHandle handle;
+      vk::Buffer     oldBuffer;
+      vk::Buffer     newBuffer;
+      vk::Image      oldImage;
+      vk::Image      newImage;
+      vk::ImageView  oldView;
+      vk::ImageView  newView;
+    };
+
+    vk::Device      device    = nullptr;
+    VmaAllocator    allocator = nullptr;
+    ResourceTable * table     = nullptr;
+    vk::Queue       queue     = nullptr;
+
+    vk::raii::CommandPool   commandPool = nullptr;
+    vk::raii::CommandBuffer cmd         = nullptr;
+    vk::raii::Fence         fence       = nullptr;
+
+    VmaDefragmentationContext      context = nullptr;
+    VmaDefragmentationPassMoveInfo pass{};
+    std::vector<Replacement>       replacements;
+    uint64_t                       retireFrame = 0;
+
+    void beginPass( std::chrono::steady_clock::time_point frameBegin )
+    {
+      VkResult res = vmaBeginDefragmentationPass( allocator, context, &pass );
+      if ( res == VK_SUCCESS )
+      {
+        // nothing left to move
+        finishRun();
+        return;
+      }
+      if ( res != VK_INCOMPLETE )
+        throw std::runtime_error( "vmaBeginDefragmentationPass failed" );
+
+      replacements.clear();
+
+      cmd.reset();
+      cmd.begin( vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+
+      // Everything submitted before this pass has to be done writing before we read the sources
+      vk::MemoryBarrier2 entryBarrier{};
+      entryBarrier.setSrcStageMask( vk::PipelineStageFlagBits2::eAllCommands )
+        .setSrcAccessMask( vk::AccessFlagBits2::eMemoryWrite )
+        .setDstStageMask( vk::PipelineStageFlagBits2::eTransfer )
+        .setDstAccessMask( vk::AccessFlagBits2::eTransferRead );
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( entryBarrier ) );
+
+      for ( uint32_t i = 0; i < pass.moveCount; ++i )
+      {
+        VmaDefragmentationMove & move = pass.pMoves[i];
+
+        VmaAllocationInfo allocInfo{};
+        vmaGetAllocationInfo( allocator, move.srcAllocation, &allocInfo );
+        ResourceHandle handle = ResourceTable::fromUserData( allocInfo.pUserData );
+
+        float elapsedMs = std::chrono::duration<float, std::milli>( std::chrono::steady_clock::now() - frameBegin ).count();
+        bool  owned     = handle != InvalidResource && handle < table->entries.size() && ( *table )[handle].alive;
+
+        if ( !owned || ( *table )[handle].pinned || elapsedMs > timeBudgetMs )
+        {
+          move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+          continue;
+        }
+
+        ResourceEntry & entry = ( *table )[handle];
+        if ( entry.kind == ResourceKind::Buffer )
+          recordBufferMove( move, handle, entry, allocInfo.size );
+        else
+          recordTextureMove( move, handle, entry );
+      }
+
+      vk::MemoryBarrier2 exitBarrier{};
+      exitBarrier.setSrcStageMask( vk::PipelineStageFlagBits2::eTransfer )
+        .setSrcAccessMask( vk::AccessFlagBits2::eTransferWrite )
+        .setDstStageMask( vk::PipelineStageFlagBits2::eAllCommands )
+        .setDstAccessMask( vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite );
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( exitBarrier ) );
+
+      cmd.end();
+
+      vk::CommandBufferSubmitInfo cmdInfo{};
+      cmdInfo.setCommandBuffer( *cmd );
+      vk::SubmitInfo2 submitInfo{};
+      submitInfo.setCommandBufferInfos( cmdInfo );
+
+      device.resetFences( { *fence } );
+      queue.submit2( submitInfo, *fence );
+
+      phase = Phase::Copying;
+    }
+
+    void recordBufferMove( VmaDefragmentationMove & move, ResourceHandle handle, ResourceEntry & entry, VkDeviceSize size )
+    {
+      vk::BufferCreateInfo bufferInfo{};
+      bufferInfo.setSize( entry.buffer.size ).setUsage( entry.bufferUsage ).setSharingMode( vk::SharingMode::eExclusive );
+
+      vk::Buffer newBuffer = device.createBuffer( bufferInfo );
+      if ( vmaBindBufferMemory( allocator, move.dstTmpAllocation, newBuffer ) != VK_SUCCESS )
+      {
+        // leave the resource where it is, a later pass may try again
+        device.destroyBuffer( newBuffer );
+        move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+        return;
+      }
+
+      cmd.copyBuffer( entry.buffer.buffer, newBuffer, vk::BufferCopy{ 0, 0, entry.buffer.size } );
+
+      replacements.push_back( { .handle = handle, .oldBuffer = entry.buffer.buffer, .newBuffer = newBuffer } );
+      stats.bytesMoved += size;
+    }
+
+    void recordTextureMove( VmaDefragmentationMove & move, ResourceHandle handle, ResourceEntry & entry )
+    {
+      core::Texture const & tex = entry.texture;
+
+      vk::ImageCreateInfo imageInfo{};
+      imageInfo.setImageType( vk::ImageType::e2D )
+        .setFormat( tex.format )
+        .setExtent( vk::Extent3D{ tex.extent.width, tex.extent.height, 1 } )
+        .setMipLevels( 1 )
+        .setArrayLayers( 1 )
+        .setSamples( vk::SampleCountFlagBits::e1 )
+        .setTiling( vk::ImageTiling::eOptimal )
+        .setUsage( entry.imageUsage )
+        .setSharingMode( vk::SharingMode::eExclusive )
+        .setInitialLayout( vk::ImageLayout::eUndefined );
+
+      vk::Image newImage = device.createImage( imageInfo );
+      if ( vmaBindImageMemory( allocator, move.dstTmpAllocation, newImage ) != VK_SUCCESS )
+      {
+        device.destroyImage( newImage );
+        move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+        return;
+      }
+
+      vk::ImageViewCreateInfo viewInfo{};
+      viewInfo.setImage( newImage )
+        .setViewType( vk::ImageViewType::e2D )
+        .setFormat( tex.format )
+        .setSubresourceRange( { entry.aspect, 0, 1, 0, 1 } );
+      vk::ImageView newView = device.createImageView( viewInfo );
+
+      // Undefined contents do not need a copy, the new image simply starts out undefined as well
+      if ( entry.layout != vk::ImageLayout::eUndefined )
+      {
+        vk::ImageSubresourceRange range{ entry.aspect, 0, 1, 0, 1 };
+
+        std::array<vk::ImageMemoryBarrier2, 2> toTransfer{};
+        toTransfer[0]
+          .setSrcStageMask( vk::PipelineStageFlagBits2::eAllCommands )
+          .setDstStageMask( vk::PipelineStageFlagBits2::eTransfer )
+          .setDstAccessMask( vk::AccessFlagBits2::eTransferRead )
+          .setOldLayout( entry.layout )
+          .setNewLayout( vk::ImageLayout::eTransferSrcOptimal )
+          .setImage( tex.image )
+          .setSubresourceRange( range );
+        toTransfer[1]
+          .setSrcStageMask( vk::PipelineStageFlagBits2::eTopOfPipe )
+          .setDstStageMask( vk::PipelineStageFlagBits2::eTransfer )
+          .setDstAccessMask( vk::AccessFlagBits2::eTransferWrite )
+          .setOldLayout( vk::ImageLayout::eUndefined )
+          .setNewLayout( vk::ImageLayout::eTransferDstOptimal )
+          .setImage( newImage )
+          .setSubresourceRange( range );
+        cmd.pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( toTransfer ) );
+
+        vk::ImageCopy2 region{};
+        region.setSrcSubresource( { entry.aspect, 0, 0, 1 } )
+          .setDstSubresource( { entry.aspect, 0, 0, 1 } )
+          .setExtent( vk::Extent3D{ tex.extent.width, tex.extent.height, 1 } );
+
+        vk::CopyImageInfo2 copyInfo{};
+        copyInfo.setSrcImage( tex.image )
+          .setSrcImageLayout( vk::ImageLayout::eTransferSrcOptimal )
+          .setDstImage( newImage )
+          .setDstImageLayout( vk::ImageLayout::eTransferDstOptimal )
+          .setRegions( region );
+        cmd.copyImage2( copyInfo );
+
+        // Leave both images in the layout the rest of the frame expects, frames recorded while the pass is
+        // Copying still sample the old image through its bindless slot in entry.layout
+        std::array<vk::ImageMemoryBarrier2, 2> toUsage{};
+        toUsage[0]
+          .setSrcStageMask( vk::PipelineStageFlagBits2::eTransfer )
+          .setSrcAccessMask( vk::AccessFlagBits2::eTransferRead )
+          .setDstStageMask( vk::PipelineStageFlagBits2::eAllCommands )
+          .setDstAccessMask( vk::AccessFlagBits2::eMemoryRead )
+          .setOldLayout( vk::ImageLayout::eTransferSrcOptimal )
+          .setNewLayout( entry.layout )
+          .setImage( tex.image )
+          .setSubresourceRange( range );
+        toUsage[1]
+          .setSrcStageMask( vk::PipelineStageFlagBits2::eTransfer )
+          .setSrcAccessMask( vk::AccessFlagBits2::eTransferWrite )
+          .setDstStageMask( vk::PipelineStageFlagBits2::eAllCommands )
+          .setDstAccessMask( vk::AccessFlagBits2::eMemoryRead )
+          .setOldLayout( vk::ImageLayout::eTransferDstOptimal )
+          .setNewLayout( entry.layout )
+          .setImage( newImage )
+          .setSubresourceRange( range );
+        cmd.pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( toUsage ) );
+      }
+
+      VmaAllocationInfo dstInfo{};
+      vmaGetAllocationInfo( allocator, move.dstTmpAllocation, &dstInfo );
+
+      replacements.push_back( { .handle = handle, .oldImage = tex.image, .newImage = newImage, .oldView = tex.imageView, .newView = newView } );
+      stats.bytesMoved += dstInfo.size;
+    }
+
+    void patchTable()
+    {
+      for ( Replacement const & r : replacements )
+      {
+        if ( r.newBuffer )
+          table->patchBuffer( r.handle, r.newBuffer );
+        else
+          table->patchTexture( r.handle, r.newImage, r.newView );
+      }
+    }
+
+    void endPass()
+    {
+      // Old objects are no longer referenced by any frame in flight
+      for ( Replacement const & r : replacements )
+      {
+        if ( r.oldBuffer )
+          device.destroyBuffer( r.oldBuffer );
+        if ( r.oldView )
+          device.destroyImageView( r.oldView );
+        if ( r.oldImage )
+          device.destroyImage( r.oldImage );
+      }
+
+      stats.allocationsMoved += static_cast<uint32_t>( replacements.size() );
+      stats.passes++;
+
+      VkResult res = vmaEndDefragmentationPass( allocator, context, &pass );
+
+      // srcAllocation now refers to the new memory, refresh the cached offsets
+      for ( Replacement const & r : replacements )
+        table->refreshAllocationInfo( r.handle );
+      replacements.clear();
+
+      if ( res == VK_SUCCESS )
+        finishRun();
+      else if ( res == VK_INCOMPLETE )
+        phase = Phase::Ready;
+      else
+        throw std::runtime_error( "vmaEndDefragmentationPass failed" );
+    }
+
+    void finishRun()
+    {
+      VmaDefragmentationStats vmaStats{};
+      vmaEndDefragmentation( allocator, context, &vmaStats );
+      context = nullptr;
+
+      stats.bytesFreed  = vmaStats.bytesFreed;
+      stats.blocksFreed = vmaStats.deviceMemoryBlocksFreed;
+
+      after         = takeMemorySnapshot( allocator );
+      table->locked = false;
+      phase         = Phase::Idle;
+
+      isDebug(
+        std::println(
+          "[Defrag] moved {} allocations ({} bytes) in {} passes, freed {} blocks, free ranges {} -> {}",
+          stats.allocationsMoved,
+          stats.bytesMoved,
+          stats.passes,
+          stats.blocksFreed,
+          before.freeRangeCount,
+          after.freeRangeCount ) );
+    }
+  };
+}  // namespace core
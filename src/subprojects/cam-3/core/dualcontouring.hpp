@@ -0,0 +1,722 @@
+#pragma once
+#include "../data.hpp"
+#include "../helper.hpp"
+#include "../setup.hpp"
+#include "bindless.hpp"
+#include "compute.hpp"
+#include "marchingcubes.hpp"
+#include "meshload.hpp"
+#include "oneshot.hpp"
+#include "parallel.hpp"
+#include "scan.hpp"
+#include "sdf.hpp"
+#include "surface.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <print>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  using Matrix3 = std::array<std::array<float, 3>, 3>;
+
+  // Cyclic Jacobi rotations of a symmetric matrix, a[row][col]. Leaves the eigenvalues on the diagonal of `a` and the
+  // eigenvectors in the columns of `v`. Mirrors qefEigen in dualcontouring.comp.
+  inline void qefEigen( Matrix3 & a, Matrix3 & v )
+  {
+    for ( uint32_t r = 0; r < 3; ++r )
+      for ( uint32_t c = 0; c < 3; ++c )
+        v[r][c] = r == c ? 1.0f : 0.0f;
+
+    for ( uint32_t sweep = 0; sweep < 6; ++sweep )
+      for ( uint32_t k = 0; k < 3; ++k )
+      {
+        uint32_t p   = k == 2 ? 1 : 0;
+        uint32_t q   = k == 0 ? 1 : 2;
+        float    apq = a[p][q];
+        if ( std::abs( apq ) < 1e-12f )
+          continue;
+
+        float theta = ( a[q][q] - a[p][p] ) / ( 2.0f * apq );
+        float t     = ( theta >= 0.0f ? 1.0f : -1.0f ) / ( std::abs( theta ) + std::sqrt( theta * theta + 1.0f ) );
+        float c     = 1.0f / std::sqrt( t * t + 1.0f );
+        float s     = t * c;
+
+        a[p][p] -= t * apq;
+        a[q][q] += t * apq;
+        a[p][q]      = 0.0f;
+        a[q][p]      = 0.0f;
+        uint32_t r   = 3 - p - q;
+        float    arp = a[r][p];
+        float    arq = a[r][q];
+        a[r][p]      = c * arp - s * arq;
+        a[p][r]      = a[r][p];
+        a[r][q]      = s * arp + c * arq;
+        a[q][r]      = a[r][q];
+        for ( uint32_t row = 0; row < 3; ++row )
+        {
+          float vrp = v[row][p];
+          float vrq = v[row][q];
+          v[row][p] = c * vrp - s * vrq;
+          v[row][q] = s * vrp + c * vrq;
+        }
+      }
+  }
+
+  // Quadratic error function of the tangent planes n . x = n . p of edge intersections, in the sums of
+  // data::DualContouringCell so the QEFs of neighbor cells merge by adding them up
+  struct Qef
+  {
+    // Eigenvalues below this fraction of the largest are dropped, like QefTruncation in dualcontouring.comp
+    static constexpr float Truncation = 0.1f;
+
+    std::array<float, 6> ata{};  // xx, xy, xz, yy, yz, zz
+    glm::vec3            atb     = glm::vec3( 0.0f );
+    float                btb     = 0.0f;
+    glm::vec3            massSum = glm::vec3( 0.0f );
+    float                count   = 0.0f;
+
+    [[nodiscard]] static Qef fromCell( data::DualContouringCell const & cell )
+    {
+      Qef qef;
+      std::copy( std::begin( cell.ata ), std::end( cell.ata ), qef.ata.begin() );
+      qef.atb     = cell.atb;
+      qef.btb     = cell.btb;
+      qef.massSum = cell.massSum;
+      qef.count   = cell.count;
+      return qef;
+    }
+
+    void merge( Qef const & other )
+    {
+      for ( size_t k = 0; k < ata.size(); ++k )
+        ata[k] += other.ata[k];
+      atb += other.atb;
+      btb += other.btb;
+      massSum += other.massSum;
+      count += other.count;
+    }
+
+    [[nodiscard]] glm::vec3 multiply( glm::vec3 x ) const
+    {
+      return glm::vec3( ata[0] * x.x + ata[1] * x.y + ata[2] * x.z, ata[1] * x.x + ata[3] * x.y + ata[4] * x.z, ata[2] * x.x + ata[4] * x.y + ata[5] * x.z );
+    }
+
+    // Minimizer closest to the mass point, clamped to [low, high]. Mirrors qefSolve in dualcontouring.comp.
+    [[nodiscard]] glm::vec3 solve( glm::vec3 low, glm::vec3 high ) const
+    {
+      Matrix3 a = { { { ata[0], ata[1], ata[2] }, { ata[1], ata[3], ata[4] }, { ata[2], ata[4], ata[5] } } };
+      Matrix3 v{};
+      qefEigen( a, v );
+
+      glm::vec3 massPoint = massSum / std::max( count, 1.0f );
+      glm::vec3 rhs       = atb - multiply( massPoint );
+      float     largest   = std::max( { std::abs( a[0][0] ), std::abs( a[1][1] ), std::abs( a[2][2] ) } );
+      glm::vec3 x         = massPoint;
+      for ( uint32_t k = 0; k < 3; ++k )
+      {
+        if ( std::abs( a[k][k] ) <= Truncation * largest || a[k][k] == 0.0f )
+          continue;
+        glm::vec3 e( v[0][k], v[1][k], v[2][k] );
+        x += e * ( glm::dot( e, rhs ) / a[k][k] );
+      }
+      return glm::clamp( x, low, high );
+    }
+
+    [[nodiscard]] float error( glm::vec3 x ) const
+    {
+      return std::max( glm::dot( x, multiply( x ) ) - 2.0f * glm::dot( x, atb ) + btb, 0.0f );
+    }
+  };
+
+  // Value of data::DualContouringPushConstants::pass, mirrors dualcontouring.comp
+  enum class DualContouringPass : uint32_t
+  {
+    Field    = 0,
+    Classify = 1,
+    Args     = 2,
+    Cells    = 3,
+  };
+
+  // The GPU half of dual contouring for batches of up to MaxJobs chunks: samples the field, compacts the cells the
+  // surface crosses with core::Scan and solves the QEF of every such cell, see dualcontouring.comp. The cells
+  // buffer then holds StateActive data::DualContouringCell in batch cell order, for contourChunk() on the host.
+  struct DualContouring
+  {
+    static constexpr uint32_t GroupSize = 64;
+    static constexpr uint32_t MaxJobs   = 8;
+
+    static constexpr uint32_t StateActive = 0;
+    static constexpr uint32_t StateArgs   = 1;
+    static constexpr uint32_t StateWords  = 4;
+
+    core::Buffer jobs;
+    core::Buffer field;
+    core::Buffer flags;
+    core::Buffer active;
+    core::Buffer state;
+    core::Buffer cellData;  // data::DualContouringCell per active cell
+    uint32_t     jobIndex    = InvalidBindlessIndex;
+    uint32_t     fieldIndex  = InvalidBindlessIndex;
+    uint32_t     flagIndex   = InvalidBindlessIndex;
+    uint32_t     activeIndex = InvalidBindlessIndex;
+    uint32_t     stateIndex  = InvalidBindlessIndex;
+    uint32_t     cellIndex   = InvalidBindlessIndex;
+    uint32_t     cells       = 0;  // owned per chunk edge
+    Scan         scan;
+
+    // Allocates the buffers of a full batch, nothing may still use the previous ones
+    void init( vk::raii::Device const &         device,
+               vk::raii::PhysicalDevice const & physicalDevice,
+               VmaAllocator                     allocator_,
+               BindlessHeap &                   heap,
+               uint32_t                         cells_,
+               uint64_t                         frame )
+    {
+      if ( cells_ < 2 )
+        throw std::runtime_error( "Dual contouring chunks need at least 2 cells per edge" );
+      uint32_t groupLimit = physicalDevice.getProperties().limits.maxComputeWorkGroupCount[0];
+      if ( uint64_t( MaxJobs ) * ( uint64_t( cells_ ) + 2 ) * ( cells_ + 2 ) * ( cells_ + 2 ) > uint64_t( groupLimit ) * GroupSize )
+        throw std::runtime_error( "Dual contouring chunks of " + std::to_string( cells_ ) + " cells per edge exceed the dispatch limit" );
+
+      destroy( heap, frame );
+      allocator = allocator_;
+      cells     = cells_;
+      if ( !*shader.shader )
+        shader = ComputeShader( device, "dualcontouring.comp", sizeof( data::DualContouringPushConstants ), { *heap.layout } );
+      scan.init( device, physicalDevice, allocator, heap );
+      scan.resize( heap, MaxJobs * cellsPerChunk(), frame );
+
+      constexpr vk::BufferUsageFlags usage =
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc;
+      jobs     = core::createBuffer( allocator, sizeof( data::MarchingCubesJob ) * MaxJobs, usage );
+      field    = core::createBuffer( allocator, sizeof( float ) * vk::DeviceSize( MaxJobs ) * samplesPerChunk(), usage );
+      flags    = core::createBuffer( allocator, sizeof( uint32_t ) * vk::DeviceSize( MaxJobs ) * cellsPerChunk(), usage );
+      active   = core::createBuffer( allocator, sizeof( uint32_t ) * vk::DeviceSize( MaxJobs ) * cellsPerChunk(), usage );
+      state    = core::createBuffer( allocator, sizeof( uint32_t ) * StateWords, usage | vk::BufferUsageFlagBits::eIndirectBuffer );
+      cellData = core::createBuffer( allocator, sizeof( data::DualContouringCell ) * vk::DeviceSize( MaxJobs ) * cellsPerChunk(), usage );
+
+      jobIndex    = heap.addStorageBuffer( jobs.buffer );
+      fieldIndex  = heap.addStorageBuffer( field.buffer );
+      flagIndex   = heap.addStorageBuffer( flags.buffer );
+      activeIndex = heap.addStorageBuffer( active.buffer );
+      stateIndex  = heap.addStorageBuffer( state.buffer );
+      cellIndex   = heap.addStorageBuffer( cellData.buffer );
+    }
+
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      for ( uint32_t * index : { &jobIndex, &fieldIndex, &flagIndex, &activeIndex, &stateIndex, &cellIndex } )
+      {
+        heap.remove( BindlessHeap::StorageBuffers, *index, frame );
+        *index = InvalidBindlessIndex;
+      }
+      for ( core::Buffer * buffer : { &jobs, &field, &flags, &active, &state, &cellData } )
+        core::destroyBuffer( allocator, *buffer );
+      scan.destroy( heap, frame );
+      cells = 0;
+    }
+
+    [[nodiscard]] uint32_t samplesPerChunk() const
+    {
+      return ( cells + 2 ) * ( cells + 2 ) * ( cells + 2 );
+    }
+
+    [[nodiscard]] uint32_t cellsPerChunk() const
+    {
+      return ( cells + 1 ) * ( cells + 1 ) * ( cells + 1 );
+    }
+
+    // Field and cells of every job, visible to transfers afterwards
+    void record( vk::raii::CommandBuffer const &         cmd,
+                 BindlessHeap const &                    heap,
+                 data::SdfScene const &                  scene,
+                 std::span<const data::MarchingCubesJob> batch ) const
+    {
+      if ( batch.empty() )
+        return;
+      if ( batch.size() > MaxJobs )
+        throw std::runtime_error( "Dual contouring batches hold up to " + std::to_string( MaxJobs ) + " chunks" );
+
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferRead,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite );
+      cmd.updateBuffer<data::MarchingCubesJob>( jobs.buffer, 0, { uint32_t( batch.size() ), batch.data() } );
+      cmd.fillBuffer( state.buffer, 0, VK_WHOLE_SIZE, 0 );
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+
+      uint32_t jobCount = static_cast<uint32_t>( batch.size() );
+
+      data::DualContouringPushConstants pc{};
+      pc.scene        = scene;
+      pc.jobBuffer    = jobIndex;
+      pc.fieldBuffer  = fieldIndex;
+      pc.flagBuffer   = flagIndex;
+      pc.activeBuffer = activeIndex;
+      pc.stateBuffer  = stateIndex;
+      pc.cellBuffer   = cellIndex;
+      pc.cells        = cells;
+      pc.jobCount     = jobCount;
+
+      dispatch( cmd, heap, pc, DualContouringPass::Field, jobCount * samplesPerChunk() );
+      dispatch( cmd, heap, pc, DualContouringPass::Classify, jobCount * cellsPerChunk() );
+      scan.recordCompact( cmd, heap, InvalidBindlessIndex, flagIndex, activeIndex, stateIndex, jobCount * cellsPerChunk() );
+      dispatch( cmd, heap, pc, DualContouringPass::Args, 1 );
+
+      pc.pass = static_cast<uint32_t>( DualContouringPass::Cells );
+      shader.bind( cmd );
+      heap.bind( cmd, *shader.layout, vk::PipelineBindPoint::eCompute );
+      shader.push( cmd, pc );
+      cmd.dispatchIndirect( state.buffer, sizeof( uint32_t ) * StateArgs );
+
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageWrite,
+               vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eTransferRead );
+    }
+
+  private:
+    VmaAllocator  allocator = nullptr;
+    ComputeShader shader;
+
+    void dispatch( vk::raii::CommandBuffer const &     cmd,
+                   BindlessHeap const &                heap,
+                   data::DualContouringPushConstants & pc,
+                   DualContouringPass                  pass,
+                   uint32_t                            count ) const
+    {
+      pc.pass = static_cast<uint32_t>( pass );
+      shader.bind( cmd );
+      heap.bind( cmd, *shader.layout, vk::PipelineBindPoint::eCompute );
+      shader.push( cmd, pc );
+      cmd.dispatch( ( count + GroupSize - 1 ) / GroupSize, 1, 1 );
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageWrite,
+               vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eDrawIndirect,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eIndirectCommandRead );
+    }
+
+    static void barrier( vk::raii::CommandBuffer const & cmd,
+                         vk::PipelineStageFlags2         srcStage,
+                         vk::AccessFlags2                srcAccess,
+                         vk::PipelineStageFlags2         dstStage,
+                         vk::AccessFlags2                dstAccess )
+    {
+      vk::MemoryBarrier2 memoryBarrier{ srcStage, srcAccess, dstStage, dstAccess };
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( memoryBarrier ) );
+    }
+  };
+
+  struct DualContouringMesh
+  {
+    std::vector<data::Vertex> vertices;
+    std::vector<uint32_t>     indices;
+    uint32_t                  leaves    = 0;  // cells the surface crosses
+    uint32_t                  collapsed = 0;  // octree nodes that replaced their children with one vertex
+  };
+
+  // The host half of dual contouring for one chunk: `field` holds its (cells + 2)^3 samples and `active` its cells
+  // from DualContouring, in cell order.
+  //
+  // An octree over the chunk's cells^3 cells is simplified bottom-up. A node collapses into one vertex when all its
+  // children are leaves or empty, their merged QEF stays below `threshold` (in squared voxels, negative disables
+  // the simplification) and the signs on its edge, face and center midpoints each agree with one of the corners
+  // they lie between, which keeps the surface a manifold (Ju et al., section 4.2). Nodes touching the lower faces
+  // of the chunk stay fine, those cells are the shared layer of the neighbor below.
+  //
+  // Every edge the chunk owns (along axis a starting in [0, cells), across the other axes in [1, cells]) that
+  // crosses the surface becomes a quad between the vertices of the four cells around it, looked up through their
+  // collapsed ancestors, without the triangles that collapsed into a point or a line.
+  [[nodiscard]] inline DualContouringMesh contourChunk( std::span<const float>                    field,
+                                                        std::span<const data::DualContouringCell> active,
+                                                        data::MarchingCubesJob const &            job,
+                                                        uint32_t                                  cells,
+                                                        float                                     threshold,
+                                                        data::SdfScene const &                    scene,
+                                                        std::span<const glm::vec4>                edits )
+  {
+    enum NodeState : uint8_t
+    {
+      Empty,
+      Leaf,
+      Split,
+    };
+    struct Node
+    {
+      Qef       qef;
+      glm::vec3 vertex = glm::vec3( 0.0f );
+      NodeState state  = Empty;
+      uint32_t  output = ~0u;  // vertex in the mesh
+    };
+
+    uint32_t sampleEdge = cells + 2;
+    uint32_t cellEdge   = cells + 1;
+    auto     inside     = [&]( glm::uvec3 p ) { return field[p.x + p.y * sampleEdge + p.z * sampleEdge * sampleEdge] < 0.0f; };
+
+    DualContouringMesh mesh;
+    mesh.leaves = static_cast<uint32_t>( active.size() );
+
+    // Level 0 covers the shared layer as well, levels above only the cells the chunk owns
+    std::vector<std::vector<Node>> levels( 1, std::vector<Node>( size_t( cellEdge ) * cellEdge * cellEdge ) );
+    std::vector<uint32_t>          edges( 1, cellEdge );
+    for ( data::DualContouringCell const & cell : active )
+    {
+      Node & node = levels[0][cell.cell % levels[0].size()];
+      node.qef    = Qef::fromCell( cell );
+      node.vertex = cell.vertex;
+      node.state  = Leaf;
+    }
+
+    for ( uint32_t size = 2; size <= cells; size *= 2 )
+    {
+      uint32_t                  edge      = cells / size;
+      std::vector<Node> const & children  = levels.back();
+      uint32_t                  childEdge = edges.back();
+      std::vector<Node>         nodes( size_t( edge ) * edge * edge );
+
+      for ( uint32_t z = 0, n = 0; z < edge; ++z )
+        for ( uint32_t y = 0; y < edge; ++y )
+          for ( uint32_t x = 0; x < edge; ++x, ++n )
+          {
+            Node & node  = nodes[n];
+            bool   split = false, empty = true;
+            for ( uint32_t child = 0; child < 8; ++child )
+            {
+              glm::uvec3   c   = glm::uvec3( x, y, z ) * 2u + glm::uvec3( child & 1, child >> 1 & 1, child >> 2 );
+              Node const & sub = children[c.x + c.y * childEdge + c.z * childEdge * childEdge];
+              split |= sub.state == Split;
+              empty &= sub.state == Empty;
+              if ( sub.state == Leaf )
+                node.qef.merge( sub.qef );
+            }
+            if ( empty )
+              continue;
+
+            glm::uvec3 low = glm::uvec3( x, y, z ) * size;
+            node.state     = Split;
+            if ( split || threshold < 0.0f || low.x == 0 || low.y == 0 || low.z == 0 )
+              continue;
+
+            // Every point of the 3x3x3 lattice over the node agrees with one of the corners around it
+            bool     manifold = true;
+            uint32_t half     = size / 2;
+            for ( uint32_t k = 0; k < 27 && manifold; ++k )
+            {
+              glm::uvec3 lattice( k % 3, k / 3 % 3, k / 9 );
+              uint32_t   mids = ( lattice.x == 1 ) + ( lattice.y == 1 ) + ( lattice.z == 1 );
+              if ( mids == 0 )
+                continue;
+              bool sign  = inside( low + lattice * half );
+              bool agree = false;
+              for ( uint32_t corner = 0; corner < 8 && !agree; ++corner )
+              {
+                glm::uvec3 around = lattice;
+                for ( uint32_t axis = 0; axis < 3; ++axis )
+                  if ( lattice[axis] == 1 )
+                    around[axis] = ( corner >> axis & 1 ) * 2;
+                agree = inside( low + around * half ) == sign;
+              }
+              manifold = agree;
+            }
+            if ( !manifold )
+              continue;
+
+            glm::vec3 vertex = node.qef.solve( glm::vec3( low ), glm::vec3( low + size ) );
+            if ( node.qef.error( vertex ) > threshold )
+              continue;
+            node.vertex = vertex;
+            node.state  = Leaf;
+            ++mesh.collapsed;
+          }
+      levels.push_back( std::move( nodes ) );
+      edges.push_back( edge );
+    }
+
+    data::SdfScene edited = scene;
+    edited.editCount      = static_cast<uint32_t>( edits.size() );
+    auto vertexOf         = [&]( glm::uvec3 cell )
+    {
+      // The highest collapsed ancestor, or the cell itself
+      Node * chosen = &levels[0][cell.x + cell.y * cellEdge + cell.z * cellEdge * cellEdge];
+      for ( size_t level = 1; level < levels.size(); ++level )
+      {
+        glm::uvec3 n = cell >> glm::uvec3( static_cast<uint32_t>( level ) );
+        if ( n.x >= edges[level] || n.y >= edges[level] || n.z >= edges[level] )
+          break;
+        Node & node = levels[level][n.x + n.y * edges[level] + n.z * edges[level] * edges[level]];
+        if ( node.state != Leaf )
+          break;
+        chosen = &node;
+      }
+
+      if ( chosen->output == ~0u )
+      {
+        glm::vec3 p      = job.origin + chosen->vertex * job.voxelSize;
+        glm::vec3 normal = sdfNormal( p, edited, edits, 0.5f * job.voxelSize );
+        chosen->output   = static_cast<uint32_t>( mesh.vertices.size() );
+        mesh.vertices.push_back( data::Vertex{ p, sdfColor( p, normal, edited ) } );
+      }
+      return chosen->output;
+    };
+
+    for ( uint32_t axis = 0; axis < 3; ++axis )
+    {
+      uint32_t u = ( axis + 1 ) % 3, v = ( axis + 2 ) % 3;
+      for ( uint32_t z = 0; z <= cells; ++z )
+        for ( uint32_t y = 0; y <= cells; ++y )
+          for ( uint32_t x = 0; x <= cells; ++x )
+          {
+            glm::uvec3 q( x, y, z );
+            if ( q[axis] >= cells || q[u] == 0 || q[v] == 0 )
+              continue;
+            glm::uvec3 next = q;
+            ++next[axis];
+            bool lowInside = inside( q );
+            if ( lowInside == inside( next ) )
+              continue;
+
+            // Counter-clockwise around +axis, the quad faces away from the inside end of the edge
+            std::array<uint32_t, 4> quad{};
+            constexpr std::array<std::array<uint32_t, 2>, 4> Around = { { { 1, 1 }, { 0, 1 }, { 0, 0 }, { 1, 0 } } };
+            for ( uint32_t k = 0; k < 4; ++k )
+            {
+              glm::uvec3 cell = q;
+              cell[u] -= Around[k][0];
+              cell[v] -= Around[k][1];
+              quad[k] = vertexOf( cell );
+            }
+            if ( !lowInside )
+              std::swap( quad[1], quad[3] );
+
+            using Triangle = std::array<uint32_t, 3>;
+            for ( Triangle triangle : { Triangle{ quad[0], quad[1], quad[2] }, Triangle{ quad[0], quad[2], quad[3] } } )
+              if ( triangle[0] != triangle[1] && triangle[1] != triangle[2] && triangle[2] != triangle[0] )
+                mesh.indices.insert( mesh.indices.end(), triangle.begin(), triangle.end() );
+          }
+    }
+    return mesh;
+  }
+
+  // Meshes the chunks of an SdfVolumeLayout with MarchingCubes and with DualContouring, the latter without and with
+  // the octree simplification, and keeps the simplified mesh in `surface` for drawing:
+  //
+  //   gpuMs    timestamps around the meshing commands
+  //   cpuMs    dual contouring on the host, `threads` workers over the chunks
+  //   totalMs  from the first submit to the last mesh, including the readback of the cells and for the
+  //            simplified mesh the upload into its slots
+  struct DualContouringComparison
+  {
+    struct Result
+    {
+      std::string mesher;
+      uint32_t    chunks    = 0;
+      uint32_t    vertices  = 0;
+      uint32_t    triangles = 0;
+      uint32_t    collapsed = 0;  // octree nodes
+      uint32_t    overflows = 0;  // chunks that did not fit their slot
+      float       gpuMs     = 0.0f;
+      float       cpuMs     = 0.0f;
+      float       totalMs   = 0.0f;
+    };
+
+    float               threshold = 0.02f;  // of the simplification, squared voxels
+    uint32_t            threads   = 0;      // of the host contouring, 0 for all
+    bool                show      = false;  // draw `surface` in place of the marching cubes terrain
+    SurfaceChunks       surface;
+    std::vector<Result> results;
+    std::string         error;  // of the last run started from the UI
+
+    void run( vk::raii::Device const &         device,
+              vk::raii::PhysicalDevice const & physicalDevice,
+              VmaAllocator                     allocator,
+              BindlessHeap &                   heap,
+              uint32_t                         queueFamily,
+              vk::raii::Queue const &          queue,
+              uint64_t                         frame,
+              SdfVolumeLayout const &          layout,
+              data::SdfScene                   scene,
+              std::span<const glm::vec4>       edits )
+    {
+      using Clock = std::chrono::steady_clock;
+      auto msSince = []( Clock::time_point start ) { return std::chrono::duration<float, std::milli>( Clock::now() - start ).count(); };
+
+      OneShotQueue oneShot;
+      oneShot.init( device, physicalDevice, allocator, queueFamily, queue );
+
+      core::Buffer editBuffer = core::createBuffer(
+        allocator, sizeof( glm::vec4 ) * std::max<size_t>( edits.size(), 1 ), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst );
+      oneShot.upload( editBuffer.buffer, edits );
+      scene.editBuffer = heap.addStorageBuffer( editBuffer.buffer );
+      scene.editCount  = static_cast<uint32_t>( edits.size() );
+
+      std::vector<data::MarchingCubesJob> jobs;
+      for ( uint32_t chunk = 0; chunk < layout.chunkCount(); ++chunk )
+        jobs.push_back( layout.job( scene.center, chunk ) );
+      results.clear();
+
+      // Marching cubes straight into its own slots
+      {
+        Result result{ "marching cubes" };
+        result.chunks = layout.chunkCount();
+
+        MarchingCubes mesher;
+        SurfaceChunks meshed;
+        mesher.init( device, physicalDevice, allocator, heap, layout.cells, frame );
+        meshed.create( allocator, heap, layout.chunkCount(), layout.verticesPerSlot, layout.indicesPerSlot, frame );
+        for ( size_t first = 0; first < jobs.size(); first += MarchingCubes::MaxJobs )
+        {
+          std::span<const data::MarchingCubesJob> batch( jobs.data() + first, std::min<size_t>( MarchingCubes::MaxJobs, jobs.size() - first ) );
+
+          auto start = Clock::now();
+          oneShot.submit(
+            [&]( vk::raii::CommandBuffer const & cmd )
+            {
+              oneShot.timestamp( cmd, 0 );
+              mesher.record( cmd, heap, meshed, scene, batch );
+              oneShot.timestamp( cmd, 1 );
+            } );
+          result.totalMs += msSince( start );
+          result.gpuMs += oneShot.milliseconds( 0, 1 );
+
+          std::vector<uint32_t> state = oneShot.download<uint32_t>( mesher.state.buffer, MarchingCubes::StateChunks );
+          result.vertices += state[MarchingCubes::StateVertices];
+          result.triangles += state[MarchingCubes::StateIndices] / 3;
+          result.overflows += state[MarchingCubes::StateOverflows];
+        }
+        mesher.destroy( heap, frame );
+        meshed.destroy( heap, frame );
+        results.push_back( result );
+      }
+
+      // Dual contouring, the field and cells of every batch are read back once and contoured both ways
+      Result plain{ "dual contouring" }, simplified{ "dual contouring, simplified" };
+      plain.chunks = simplified.chunks = layout.chunkCount();
+
+      DualContouring mesher;
+      mesher.init( device, physicalDevice, allocator, heap, layout.cells, frame );
+      uint32_t                                           samplesPerChunk = mesher.samplesPerChunk();
+      uint32_t                                           cellsPerChunk   = mesher.cellsPerChunk();
+      std::vector<float>                                 field( jobs.size() * samplesPerChunk );
+      std::vector<std::vector<data::DualContouringCell>> chunkCells( jobs.size() );
+      float                                              readbackMs = 0.0f;
+      for ( size_t first = 0; first < jobs.size(); first += DualContouring::MaxJobs )
+      {
+        std::span<const data::MarchingCubesJob> batch( jobs.data() + first, std::min<size_t>( DualContouring::MaxJobs, jobs.size() - first ) );
+
+        auto start = Clock::now();
+        oneShot.submit(
+          [&]( vk::raii::CommandBuffer const & cmd )
+          {
+            oneShot.timestamp( cmd, 0 );
+            mesher.record( cmd, heap, scene, batch );
+            oneShot.timestamp( cmd, 1 );
+          } );
+        plain.gpuMs += oneShot.milliseconds( 0, 1 );
+
+        std::vector<uint32_t>                 state      = oneShot.download<uint32_t>( mesher.state.buffer, DualContouring::StateWords );
+        std::vector<float>                    batchField = oneShot.download<float>( mesher.field.buffer, batch.size() * samplesPerChunk );
+        std::vector<data::DualContouringCell> cells = oneShot.download<data::DualContouringCell>( mesher.cellData.buffer, state[DualContouring::StateActive] );
+        std::copy( batchField.begin(), batchField.end(), field.begin() + std::ptrdiff_t( first ) * samplesPerChunk );
+
+        // Compaction keeps the cells in order, so every chunk's cells are one range
+        for ( data::DualContouringCell const & cell : cells )
+          chunkCells[first + cell.cell / cellsPerChunk].push_back( cell );
+        readbackMs += msSince( start );
+      }
+      mesher.destroy( heap, frame );
+      simplified.gpuMs = plain.gpuMs;
+
+      surface.create( allocator, heap, layout.chunkCount(), layout.verticesPerSlot, layout.indicesPerSlot, frame );
+      std::vector<data::Vertex> vertices( size_t( surface.slots ) * surface.verticesPerSlot );
+      std::vector<uint32_t>     indices( size_t( surface.slots ) * surface.indicesPerSlot );
+      std::vector<uint32_t>     indexCounts( surface.slots, 0 );
+
+      for ( Result * result : { &plain, &simplified } )
+      {
+        bool simplify = result == &simplified;
+
+        std::vector<DualContouringMesh> meshes( jobs.size() );
+        auto                            start = Clock::now();
+        parallelFor( jobs.size(),
+                     threads,
+                     [&]( size_t j )
+                     {
+                       meshes[j] = contourChunk( std::span<const float>( field ).subspan( j * samplesPerChunk, samplesPerChunk ),
+                                                 chunkCells[j],
+                                                 jobs[j],
+                                                 layout.cells,
+                                                 simplify ? threshold : -1.0f,
+                                                 scene,
+                                                 edits );
+                     } );
+        result->cpuMs   = msSince( start );
+        result->totalMs = readbackMs + result->cpuMs;
+
+        for ( size_t j = 0; j < jobs.size(); ++j )
+        {
+          DualContouringMesh const & mesh = meshes[j];
+          if ( mesh.vertices.size() > surface.verticesPerSlot || mesh.indices.size() > surface.indicesPerSlot )
+          {
+            ++result->overflows;
+            continue;
+          }
+          result->vertices += static_cast<uint32_t>( mesh.vertices.size() );
+          result->triangles += static_cast<uint32_t>( mesh.indices.size() / 3 );
+          result->collapsed += mesh.collapsed;
+          if ( simplify )
+          {
+            uint32_t slot = jobs[j].slot;
+            std::copy( mesh.vertices.begin(), mesh.vertices.end(), vertices.begin() + std::ptrdiff_t( slot ) * surface.verticesPerSlot );
+            std::copy( mesh.indices.begin(), mesh.indices.end(), indices.begin() + std::ptrdiff_t( slot ) * surface.indicesPerSlot );
+            indexCounts[slot] = static_cast<uint32_t>( mesh.indices.size() );
+          }
+        }
+      }
+
+      auto uploadStart = Clock::now();
+      oneShot.upload( surface.vertices.buffer, std::span<const data::Vertex>( vertices ) );
+      oneShot.upload( surface.indices.buffer, std::span<const uint32_t>( indices ) );
+      surface.setIndexCounts( indexCounts );
+      simplified.totalMs += msSince( uploadStart );
+
+      heap.remove( BindlessHeap::StorageBuffers, scene.editBuffer, frame );
+      core::destroyBuffer( allocator, editBuffer );
+
+      results.push_back( plain );
+      results.push_back( simplified );
+      for ( Result const & result : results )
+        isDebug( std::println( "[dual contouring] {}: {} chunks, {} vertices, {} triangles, GPU {:.3f} ms, CPU {:.1f} ms, total {:.1f} ms",
+                               result.mesher,
+                               result.chunks,
+                               result.vertices,
+                               result.triangles,
+                               result.gpuMs,
+                               result.cpuMs,
+                               result.totalMs ) );
+    }
+
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      surface.destroy( heap, frame );
+      show = false;
+    }
+  };
+}  // namespace core
@@ -0,0 +1,250 @@
+#pragma once
+#include "../data.hpp"
+#include "../setup.hpp"
+#include "../structs.hpp"
+#include "bindless.hpp"
+#include "compute.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Hierarchical depth (HiZ) of the scene depth target, level n holds the farthest depth of the texels it covers.
+  //
+  // Level 0 is the depth target rounded down to a power of two, each of its texels reduces the exact (non
+  // power of two) footprint it covers in the depth target. Every level is built in one dispatch of
+  // depth_pyramid.comp: each workgroup reduces a 32x32 tile of level 0 down to level 5 in shared memory,
+  // the last workgroup to finish (atomic counter) reduces level 5 down to 1x1.
+  // Sampled through a min/max sampler in MAX mode, one textureLod covers the 2x2 texel footprint conservatively.
+  struct DepthPyramid
+  {
+    static constexpr uint32_t MaxLevels = 13;  // 4096x4096 level 0
+    static constexpr uint32_t TileSize  = 32;
+
+    vk::Image     image      = nullptr;
+    vk::ImageView view       = nullptr;  // all levels, sampled by the culling shader
+    vk::Sampler   sampler    = nullptr;  // linear + MAX reduction, clamp to edge
+    vk::Extent2D  extent     = {};       // level 0
+    uint32_t      levelCount = 0;
+
+    uint32_t textureIndex = InvalidBindlessIndex;
+    uint32_t samplerIndex = InvalidBindlessIndex;
+    uint32_t depthIndex   = InvalidBindlessIndex;  // the depth target the pyramid was built for
+
+    void init( vk::raii::Device const & device_, VmaAllocator allocator_, BindlessHeap & heap )
+    {
+      device    = *device_;
+      allocator = allocator_;
+      shader    = ComputeShader( device_, "depth_pyramid.comp", sizeof( data::DepthPyramidPushConstants ), { *heap.layout } );
+
+      vk::SamplerReductionModeCreateInfo reduction{ vk::SamplerReductionMode::eMax };
+      vk::SamplerCreateInfo              samplerInfo{};
+      samplerInfo.setMagFilter( vk::Filter::eLinear )
+        .setMinFilter( vk::Filter::eLinear )
+        .setMipmapMode( vk::SamplerMipmapMode::eNearest )
+        .setAddressModeU( vk::SamplerAddressMode::eClampToEdge )
+        .setAddressModeV( vk::SamplerAddressMode::eClampToEdge )
+        .setAddressModeW( vk::SamplerAddressMode::eClampToEdge )
+        .setMinLod( 0.0f )
+        .setMaxLod( static_cast<float>( MaxLevels ) )
+        .setPNext( &reduction );
+      sampler      = device.createSampler( samplerInfo );
+      samplerIndex = heap.addSampler( sampler );
+
+      counter      = core::createBuffer( allocator, sizeof( uint32_t ), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst );
+      counterIndex = heap.addStorageBuffer( counter.buffer );
+    }
+
+    void destroy()
+    {
+      destroyImage();
+      core::destroyBuffer( allocator, counter );
+      if ( sampler )
+        device.destroySampler( sampler );
+      sampler = nullptr;
+    }
+
+    // The depth target was recreated, the next build() recreates the pyramid for it. Handles of destroyed
+    // objects may be reused, so the image handle alone does not tell.
+    void invalidate()
+    {
+      source = nullptr;
+    }
+
+    // Reduce `depth` (in DepthAttachmentOptimal, written by the early pass) into the pyramid.
+    // The depth target is handed back in DepthAttachmentOptimal for the late pass, the pyramid stays in
+    // GENERAL and is ready for sampled reads in the compute stage.
+    void build( vk::raii::CommandBuffer const & cmd, BindlessHeap & heap, core::Texture const & depth, uint64_t frame )
+    {
+      if ( depth.image != source )
+        recreate( heap, depth, frame );
+
+      vk::ImageMemoryBarrier2 depthToRead{};
+      depthToRead.setSrcStageMask( vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests )
+        .setSrcAccessMask( vk::AccessFlagBits2::eDepthStencilAttachmentWrite )
+        .setDstStageMask( vk::PipelineStageFlagBits2::eComputeShader )
+        .setDstAccessMask( vk::AccessFlagBits2::eShaderSampledRead )
+        .setOldLayout( vk::ImageLayout::eDepthAttachmentOptimal )
+        .setNewLayout( vk::ImageLayout::eDepthReadOnlyOptimal )
+        .setImage( depth.image )
+        .setSubresourceRange( { vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1 } );
+
+      // Last frame's contents are not needed, the late cull of the previous frame is the only reader
+      vk::ImageMemoryBarrier2 pyramidToWrite{};
+      pyramidToWrite.setSrcStageMask( vk::PipelineStageFlagBits2::eComputeShader )
+        .setSrcAccessMask( vk::AccessFlagBits2::eNone )
+        .setDstStageMask( vk::PipelineStageFlagBits2::eComputeShader )
+        .setDstAccessMask( vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite )
+        .setOldLayout( vk::ImageLayout::eUndefined )
+        .setNewLayout( vk::ImageLayout::eGeneral )
+        .setImage( image )
+        .setSubresourceRange( { vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1 } );
+
+      std::array<vk::ImageMemoryBarrier2, 2> before = { depthToRead, pyramidToWrite };
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( before ) );
+
+      // The last workgroup resets the counter for the next build, it only has to start at zero once
+      if ( !counterCleared )
+      {
+        cmd.fillBuffer( counter.buffer, 0, VK_WHOLE_SIZE, 0 );
+        vk::MemoryBarrier2 cleared{ vk::PipelineStageFlagBits2::eTransfer,
+                                    vk::AccessFlagBits2::eTransferWrite,
+                                    vk::PipelineStageFlagBits2::eComputeShader,
+                                    vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite };
+        cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( cleared ) );
+        counterCleared = true;
+      }
+
+      vk::Extent2D groups{ ( extent.width + TileSize - 1 ) / TileSize, ( extent.height + TileSize - 1 ) / TileSize };
+
+      data::DepthPyramidPushConstants pc{};
+      pc.depthTexture  = depthIndex;
+      pc.depthSampler  = samplerIndex;
+      pc.counterBuffer = counterIndex;
+      pc.levelCount    = levelCount;
+      pc.size          = { extent.width, extent.height };
+      pc.depthSize     = { depth.extent.width, depth.extent.height };
+      pc.groupCount    = groups.width * groups.height;
+      std::copy( levelIndices.begin(), levelIndices.end(), pc.levels );
+
+      shader.bind( cmd );
+      heap.bind( cmd, *shader.layout, vk::PipelineBindPoint::eCompute );
+      shader.push( cmd, pc );
+      cmd.dispatch( groups.width, groups.height, 1 );
+
+      vk::ImageMemoryBarrier2 depthToAttachment{};
+      depthToAttachment.setSrcStageMask( vk::PipelineStageFlagBits2::eComputeShader )
+        .setSrcAccessMask( vk::AccessFlagBits2::eNone )
+        .setDstStageMask( vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests )
+        .setDstAccessMask( vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite )
+        .setOldLayout( vk::ImageLayout::eDepthReadOnlyOptimal )
+        .setNewLayout( vk::ImageLayout::eDepthAttachmentOptimal )
+        .setImage( depth.image )
+        .setSubresourceRange( { vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1 } );
+
+      vk::ImageMemoryBarrier2 pyramidToSample{};
+      pyramidToSample.setSrcStageMask( vk::PipelineStageFlagBits2::eComputeShader )
+        .setSrcAccessMask( vk::AccessFlagBits2::eShaderStorageWrite )
+        .setDstStageMask( vk::PipelineStageFlagBits2::eComputeShader )
+        .setDstAccessMask( vk::AccessFlagBits2::eShaderSampledRead )
+        .setOldLayout( vk::ImageLayout::eGeneral )
+        .setNewLayout( vk::ImageLayout::eGeneral )
+        .setImage( image )
+        .setSubresourceRange( { vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1 } );
+
+      std::array<vk::ImageMemoryBarrier2, 2> after = { depthToAttachment, pyramidToSample };
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( after ) );
+    }
+
+  private:
+    vk::Device    device    = nullptr;
+    VmaAllocator  allocator = nullptr;
+    ComputeShader shader;
+
+    VmaAllocation              allocation = nullptr;
+    std::vector<vk::ImageView> levelViews;
+    vk::Image                  source = nullptr;
+
+    std::array<uint32_t, MaxLevels> levelIndices{};
+
+    core::Buffer counter;
+    uint32_t     counterIndex   = InvalidBindlessIndex;
+    bool         counterCleared = false;
+
+    // The depth target is only recreated after the swapchain recreation waited for the device, so the old
+    // pyramid is no longer in use. Its heap slots retire with the usual frame delay.
+    void recreate( BindlessHeap & heap, core::Texture const & depth, uint64_t frame )
+    {
+      heap.remove( BindlessHeap::SampledImages, depthIndex, frame );
+      heap.remove( BindlessHeap::SampledImages, textureIndex, frame );
+      for ( uint32_t level = 0; level < levelCount; ++level )
+        heap.remove( BindlessHeap::StorageImages, levelIndices[level], frame );
+      destroyImage();
+
+      source     = depth.image;
+      extent     = vk::Extent2D{ std::min( std::bit_floor( depth.extent.width ), 1u << ( MaxLevels - 1 ) ),
+                             std::min( std::bit_floor( depth.extent.height ), 1u << ( MaxLevels - 1 ) ) };
+      levelCount = std::bit_width( std::max( extent.width, extent.height ) );
+
+      VkImageCreateInfo imageInfo = {};
+      imageInfo.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      imageInfo.imageType         = VK_IMAGE_TYPE_2D;
+      imageInfo.extent            = { extent.width, extent.height, 1 };
+      imageInfo.mipLevels         = levelCount;
+      imageInfo.arrayLayers       = 1;
+      imageInfo.format            = VK_FORMAT_R32_SFLOAT;
+      imageInfo.tiling            = VK_IMAGE_TILING_OPTIMAL;
+      imageInfo.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+      imageInfo.usage             = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+      imageInfo.samples           = VK_SAMPLE_COUNT_1_BIT;
+      imageInfo.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+
+      VmaAllocationCreateInfo allocInfo = {};
+      allocInfo.usage                   = VMA_MEMORY_USAGE_AUTO;
+      allocInfo.requiredFlags           = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+      VkImage vkImage = VK_NULL_HANDLE;
+      vmaCreateImage( allocator, &imageInfo, &allocInfo, &vkImage, &allocation, nullptr );
+      image = vkImage;
+
+      vk::ImageViewCreateInfo viewInfo{};
+      viewInfo.setImage( image ).setViewType( vk::ImageViewType::e2D ).setFormat( vk::Format::eR32Sfloat );
+
+      viewInfo.setSubresourceRange( { vk::ImageAspectFlagBits::eColor, 0, levelCount, 0, 1 } );
+      view         = device.createImageView( viewInfo );
+      textureIndex = heap.addSampledImage( view, vk::ImageLayout::eGeneral );
+
+      for ( uint32_t level = 0; level < levelCount; ++level )
+      {
+        viewInfo.setSubresourceRange( { vk::ImageAspectFlagBits::eColor, level, 1, 0, 1 } );
+        levelViews.push_back( device.createImageView( viewInfo ) );
+        levelIndices[level] = heap.addStorageImage( levelViews.back() );
+      }
+
+      depthIndex = heap.addSampledImage( depth.imageView, vk::ImageLayout::eDepthReadOnlyOptimal );
+    }
+
+    void destroyImage()
+    {
+      for ( auto levelView : levelViews )
+        device.destroyImageView( levelView );
+      levelViews.clear();
+
+      if ( view )
+        device.destroyImageView( view );
+      view = nullptr;
+
+      if ( image && allocation )
+        vmaDestroyImage( allocator, image, allocation );
+      image      = nullptr;
+      allocation = nullptr;
+      levelCount = 0;
+    }
+  };
+}  // namespace core
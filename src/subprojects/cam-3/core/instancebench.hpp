@@ -0,0 +1,148 @@
+#pragma once
+#include "../data.hpp"
+#include "../helper.hpp"
+#include "../setup.hpp"
+#include "bindless.hpp"
+#include "instanceformat.hpp"
+#include "instances.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <print>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Measures vertex fetch bound throughput of every data::InstanceFormat, independent of the format the
+  // subproject is compiled with.
+  //
+  // For each format the same scattered, rotated, scaled and colored instances are encoded into a scratch
+  // buffer by InstanceGenerator::fill(), then drawn `repeats` times as one point per instance with
+  // rasterization discarded, so the timestamps around the draws cover the instance fetch and decode only.
+  struct InstanceFormatBenchmark
+  {
+    static constexpr std::array<data::InstanceFormat, 3> Formats = {
+      data::InstanceFormat::Float, data::InstanceFormat::Packed, data::InstanceFormat::PackedSoA };
+
+    struct Result
+    {
+      data::InstanceFormat format             = data::InstanceFormat::Float;
+      uint32_t             instanceCount      = 0;
+      float                msPerDraw          = 0.0f;
+      float                instancesPerSecond = 0.0f;  // millions
+      float                gigabytesPerSecond = 0.0f;  // instance data read, every stream
+    };
+
+    uint32_t            instanceCount = 1u << 20;
+    uint32_t            repeats       = 16;
+    std::vector<Result> results;  // one per format of the last run
+
+    void run( vk::raii::Device const &         device,
+              vk::raii::PhysicalDevice const & physicalDevice,
+              VmaAllocator                     allocator,
+              BindlessHeap &                   heap,
+              InstanceGenerator &              generator,
+              uint32_t                         queueFamily,
+              vk::raii::Queue const &          queue,
+              uint64_t                         frame )
+    {
+      instanceCount = std::clamp( instanceCount, 1u, InstanceGenerator::MaxInstances );
+      repeats       = std::max( repeats, 1u );
+
+      float period = physicalDevice.getProperties().limits.timestampPeriod;
+
+      vk::PushConstantRange    pushRange{ vk::ShaderStageFlagBits::eVertex, 0, sizeof( data::InstanceBenchPushConstants ) };
+      core::raii::ShaderBundle shaders( device, { "instancebench.vert" }, {}, pushRange, { *heap.layout } );
+
+      vk::raii::QueryPool queries( device, vk::QueryPoolCreateInfo{}.setQueryType( vk::QueryType::eTimestamp ).setQueryCount( 2 ) );
+
+      vk::raii::CommandPool    pool( device, vk::CommandPoolCreateInfo{ vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamily } );
+      vk::raii::CommandBuffers cmds( device, vk::CommandBufferAllocateInfo{ pool, vk::CommandBufferLevel::ePrimary, 1 } );
+      vk::raii::CommandBuffer  cmd = std::move( cmds.front() );
+      vk::raii::Fence          fence( device, vk::FenceCreateInfo{} );
+
+      core::Buffer resultBuffer = core::createBuffer( allocator, sizeof( glm::vec4 ), vk::BufferUsageFlagBits::eStorageBuffer );
+      uint32_t     resultIndex  = heap.addStorageBuffer( resultBuffer.buffer );
+
+      InstanceParams params;
+      params.layout         = InstanceLayout::Ball;
+      params.ballCount      = instanceCount;
+      params.scaleJitter    = 0.5f;
+      params.randomRotation = true;
+      params.randomColor    = true;
+
+      results.clear();
+      for ( data::InstanceFormat format : Formats )
+      {
+        vk::DeviceSize bytes  = instanceStride( format ) * vk::DeviceSize( instanceCount );
+        core::Buffer   buffer = core::createBuffer( allocator, bytes, vk::BufferUsageFlagBits::eStorageBuffer );
+        uint32_t       index  = heap.addStorageBuffer( buffer.buffer );
+        generator.fill( heap, params, format, index, instanceCount );
+
+        data::InstanceBenchPushConstants pc{ glm::mat4( 1.0f ), index, instanceCount, static_cast<uint32_t>( format ), resultIndex };
+
+        cmd.reset();
+        cmd.begin( vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+        cmd.resetQueryPool( *queries, 0, 2 );
+
+        vk::RenderingInfo renderingInfo{};
+        renderingInfo.setRenderArea( vk::Rect2D{ { 0, 0 }, { 1, 1 } } ).setLayerCount( 1 );
+        cmd.beginRendering( renderingInfo );
+
+        shaders.bindVertexStages( cmd );
+        heap.bind( cmd, *shaders.pipelineLayout, vk::PipelineBindPoint::eGraphics );
+        cmd.pushConstants<data::InstanceBenchPushConstants>( *shaders.pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, { pc } );
+
+        cmd.setVertexInputEXT( {}, {} );
+        cmd.setViewportWithCount( vk::Viewport{ 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f } );
+        cmd.setScissorWithCount( vk::Rect2D{ { 0, 0 }, { 1, 1 } } );
+        cmd.setPrimitiveTopology( vk::PrimitiveTopology::ePointList );
+        cmd.setPrimitiveRestartEnable( VK_FALSE );
+        cmd.setRasterizerDiscardEnable( VK_TRUE );
+
+        cmd.writeTimestamp2( vk::PipelineStageFlagBits2::eAllCommands, *queries, 0 );
+        for ( uint32_t i = 0; i < repeats; ++i )
+          cmd.draw( 1, instanceCount, 0, 0 );
+        cmd.writeTimestamp2( vk::PipelineStageFlagBits2::eAllCommands, *queries, 1 );
+
+        cmd.endRendering();
+        cmd.end();
+
+        vk::CommandBufferSubmitInfo cmdInfo{ *cmd };
+        queue.submit2( vk::SubmitInfo2{}.setCommandBufferInfos( cmdInfo ), *fence );
+        (void)device.waitForFences( { *fence }, VK_TRUE, UINT64_MAX );
+        device.resetFences( { *fence } );
+
+        auto [status, ticks] = queries.getResults<uint64_t>( 0, 2, 2 * sizeof( uint64_t ), sizeof( uint64_t ), vk::QueryResultFlagBits::e64 );
+
+        Result result{};
+        result.format        = format;
+        result.instanceCount = instanceCount;
+        if ( status == vk::Result::eSuccess )
+          result.msPerDraw = static_cast<float>( ticks[1] - ticks[0] ) * period * 1e-6f / float( repeats );
+        if ( result.msPerDraw > 0.0f )
+        {
+          result.instancesPerSecond = float( instanceCount ) / result.msPerDraw * 1e-3f;
+          result.gigabytesPerSecond = float( bytes ) / result.msPerDraw * 1e-6f;
+        }
+        results.push_back( result );
+
+        isDebug( std::println( "[instancebench] {}: {} instances, {:.3f} ms/draw, {:.1f} M instances/s, {:.1f} GB/s",
+                               toString( format ),
+                               instanceCount,
+                               result.msPerDraw,
+                               result.instancesPerSecond,
+                               result.gigabytesPerSecond ) );
+
+        heap.remove( BindlessHeap::StorageBuffers, index, frame );
+        core::destroyBuffer( allocator, buffer );
+      }
+
+      heap.remove( BindlessHeap::StorageBuffers, resultIndex, frame );
+      core::destroyBuffer( allocator, resultBuffer );
+    }
+  };
+}  // namespace core
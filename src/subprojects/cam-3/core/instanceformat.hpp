@@ -0,0 +1,118 @@
+#pragma once
+#include "../data.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/packing.hpp>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+// CPU side of the instance formats, mirrors shaders/instance.glsl
+namespace core
+{
+  static_assert( sizeof( data::InstanceData ) == 48, "InstanceData has to match the scalar layout of Instance in instance.glsl" );
+  static_assert( sizeof( data::InstancePacked ) == 16 );
+
+  [[nodiscard]] inline const char * toString( data::InstanceFormat format )
+  {
+    switch ( format )
+    {
+      case data::InstanceFormat::Float: return "Float (48 B)";
+      case data::InstanceFormat::Packed: return "Packed (16 B)";
+      case data::InstanceFormat::PackedSoA: return "Packed SoA (16 B)";
+    }
+    return "";
+  }
+
+  // Bytes per instance, every stream included
+  [[nodiscard]] constexpr size_t instanceStride( data::InstanceFormat format )
+  {
+    return format == data::InstanceFormat::Float ? sizeof( data::InstanceData ) : sizeof( data::InstancePacked );
+  }
+
+  [[nodiscard]] inline glm::vec2 octahedralEncode( glm::vec3 n )
+  {
+    n /= std::abs( n.x ) + std::abs( n.y ) + std::abs( n.z );
+    glm::vec2 p( n.x, n.y );
+    if ( n.z < 0.0f )
+      p = ( 1.0f - glm::abs( glm::vec2( p.y, p.x ) ) ) * glm::vec2( p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f );
+    return p;
+  }
+
+  [[nodiscard]] inline glm::uvec2 packInstancePosition( glm::vec3 position )
+  {
+    glm::vec3  scaled = position / data::instanceChunkSize;
+    glm::ivec3 coord  = glm::clamp( glm::ivec3( glm::floor( scaled ) ), glm::ivec3( -16 ), glm::ivec3( 15 ) );
+    glm::vec3  local  = glm::clamp( scaled - glm::vec3( coord ), 0.0f, 1.0f );
+    uint32_t   chunk  = uint32_t( coord.x & 31 ) | ( uint32_t( coord.y & 31 ) << 5 ) | ( uint32_t( coord.z & 31 ) << 10 );
+    return { glm::packUnorm2x16( glm::vec2( local.x, local.y ) ), glm::packUnorm2x16( glm::vec2( local.z, 0.0f ) ) | ( chunk << 16 ) };
+  }
+
+  // Octahedral axis and angle in [0, pi]
+  [[nodiscard]] inline uint32_t packInstanceRotation( glm::vec4 q )
+  {
+    if ( q.w < 0.0f )
+      q = -q;
+    float      s     = glm::length( glm::vec3( q ) );
+    glm::vec3  axis  = s > 1e-6f ? glm::vec3( q ) / s : glm::vec3( 0.0f, 0.0f, 1.0f );
+    float      angle = 2.0f * std::atan2( s, q.w );
+    glm::ivec2 oct   = glm::ivec2( glm::round( glm::clamp( octahedralEncode( axis ), -1.0f, 1.0f ) * 511.0f ) );
+    uint32_t   a     = std::min( uint32_t( std::round( angle / glm::pi<float>() * 4095.0f ) ), 4095u );
+    return uint32_t( oct.x & 1023 ) | ( uint32_t( oct.y & 1023 ) << 10 ) | ( a << 20 );
+  }
+
+  [[nodiscard]] inline data::InstancePacked packInstance( data::InstanceData const & instance )
+  {
+    glm::uvec2 position = packInstancePosition( instance.position );
+    return { position.x,
+             position.y,
+             packInstanceRotation( instance.rotation ),
+             glm::packUnorm4x8( glm::vec4( glm::vec3( instance.color ), instance.scale / data::instanceMaxScale ) ) };
+  }
+
+  // Writes instance `index` of a buffer holding `count` instances in `format`
+  inline void storeInstance( data::InstanceFormat format, void * buffer, uint32_t index, uint32_t count, data::InstanceData const & instance )
+  {
+    if ( format == data::InstanceFormat::Float )
+    {
+      static_cast<data::InstanceData *>( buffer )[index] = instance;
+      return;
+    }
+
+    data::InstancePacked packed = packInstance( instance );
+    if ( format == data::InstanceFormat::Packed )
+    {
+      static_cast<data::InstancePacked *>( buffer )[index] = packed;
+      return;
+    }
+
+    auto * words                       = static_cast<uint32_t *>( buffer );
+    words[2 * size_t( index )]         = packed.positionXY;
+    words[2 * size_t( index ) + 1]     = packed.positionZ;
+    words[2 * size_t( count ) + index] = packed.rotation;
+    words[3 * size_t( count ) + index] = packed.colorScale;
+  }
+
+  // Copies of the instances [first, first + runCount) of a buffer holding `count` instances in `format`, from a
+  // source at `srcOffset` that holds just those instances as a buffer of runCount instances, as storeInstance()
+  // writes them. PackedSoA takes one region per stream.
+  inline void appendInstanceCopies(
+    data::InstanceFormat format, vk::DeviceSize srcOffset, uint32_t first, uint32_t runCount, uint32_t count, std::vector<vk::BufferCopy> & regions )
+  {
+    vk::DeviceSize n = runCount;
+    if ( format != data::InstanceFormat::PackedSoA )
+    {
+      regions.push_back( vk::BufferCopy{ srcOffset, instanceStride( format ) * vk::DeviceSize( first ), instanceStride( format ) * n } );
+      return;
+    }
+
+    vk::DeviceSize total = count;
+    regions.push_back( vk::BufferCopy{ srcOffset, 8 * vk::DeviceSize( first ), 8 * n } );
+    regions.push_back( vk::BufferCopy{ srcOffset + 8 * n, 8 * total + 4 * vk::DeviceSize( first ), 4 * n } );
+    regions.push_back( vk::BufferCopy{ srcOffset + 12 * n, 12 * total + 4 * vk::DeviceSize( first ), 4 * n } );
+  }
+}  // namespace core
@@ -0,0 +1,341 @@
+#pragma once
+#include "../data.hpp"
+#include "../setup.hpp"
+#include "bindless.hpp"
+#include "compute.hpp"
+#include "instanceformat.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Value of data::InstanceGenPushConstants::layout, mirrors instances.comp
+  enum class InstanceLayout : uint32_t
+  {
+    Grid = 0,  // gridCount cells `spacing` apart around the origin, optionally jittered
+    Ball = 1,  // ballCount positions uniformly distributed in a ball of ballRadius
+  };
+
+  enum class InstanceSource : uint8_t
+  {
+    Gpu,  // instances.comp writes a device local buffer
+    Cpu,  // worker threads write a host visible buffer
+  };
+
+  // What the scene pass draws, the instance buffer or one of the sources drawn in its place
+  enum class SceneSource : uint8_t
+  {
+    Instances,   // the buffer of InstanceGenerator
+    GpuSpheres,  // VerletSim
+    CpuSpheres,  // CpuVerletSim
+    Entities,    // Scene
+  };
+
+  [[nodiscard]] inline const char * toString( InstanceLayout layout )
+  {
+    switch ( layout )
+    {
+      case InstanceLayout::Grid: return "Grid";
+      case InstanceLayout::Ball: return "Ball";
+    }
+    return "";
+  }
+
+  [[nodiscard]] inline const char * toString( InstanceSource source )
+  {
+    switch ( source )
+    {
+      case InstanceSource::Gpu: return "GPU compute";
+      case InstanceSource::Cpu: return "CPU threads";
+    }
+    return "";
+  }
+
+  [[nodiscard]] inline const char * toString( SceneSource source )
+  {
+    switch ( source )
+    {
+      case SceneSource::Instances: return "Instances";
+      case SceneSource::GpuSpheres: return "GPU spheres";
+      case SceneSource::CpuSpheres: return "CPU spheres";
+      case SceneSource::Entities: return "Entities";
+    }
+    return "";
+  }
+
+  struct InstanceParams
+  {
+    InstanceLayout layout         = InstanceLayout::Grid;
+    InstanceSource source         = InstanceSource::Gpu;
+    glm::uvec3     gridCount      = glm::uvec3( data::gridCount );
+    float          spacing        = data::gridSpacing;
+    float          jitter         = 0.0f;  // fraction of spacing
+    uint32_t       ballCount      = 1000000;
+    float          ballRadius     = 300.0f;
+    float          scaleJitter    = 0.0f;  // scale in [1 - scaleJitter, 1 + scaleJitter]
+    bool           randomRotation = false;
+    bool           randomColor    = false;
+    uint32_t       seed           = 1;
+    uint32_t       threads        = 0;  // CPU workers, 0 uses every hardware thread
+
+    [[nodiscard]] uint64_t count() const
+    {
+      return layout == InstanceLayout::Ball ? uint64_t( ballCount ) : uint64_t( gridCount.x ) * gridCount.y * gridCount.z;
+    }
+  };
+
+  // PCG hash, the same function as in instances.comp
+  [[nodiscard]] inline uint32_t pcgHash( uint32_t v )
+  {
+    uint32_t state = v * 747796405u + 2891336453u;
+    uint32_t word  = ( ( state >> ( ( state >> 28u ) + 4u ) ) ^ state ) * 277803737u;
+    return ( word >> 22u ) ^ word;
+  }
+
+  // Uniform in [0, 1) from the top 24 bits
+  [[nodiscard]] inline float nextRandom( uint32_t & state )
+  {
+    state = pcgHash( state );
+    return float( state >> 8 ) * ( 1.0f / 16777216.0f );
+  }
+
+  // x major like the former compile time table, so the default grid is laid out as before
+  [[nodiscard]] inline glm::vec3 gridPosition( InstanceParams const & params, uint32_t index, uint32_t & state )
+  {
+    glm::uvec3 const & n = params.gridCount;
+    glm::uvec3         cell( index / ( n.y * n.z ), ( index / n.z ) % n.y, index % n.z );
+    glm::vec3          center = ( glm::vec3( cell ) - glm::vec3( n - 1u ) * 0.5f ) * params.spacing;
+    if ( params.jitter <= 0.0f )
+      return center;
+
+    float x = nextRandom( state ), y = nextRandom( state ), z = nextRandom( state );
+    return center + ( glm::vec3( x, y, z ) * 2.0f - 1.0f ) * params.jitter * params.spacing;
+  }
+
+  [[nodiscard]] inline glm::vec3 ballPosition( InstanceParams const & params, uint32_t & state )
+  {
+    float z     = nextRandom( state ) * 2.0f - 1.0f;
+    float phi   = nextRandom( state ) * glm::two_pi<float>();
+    float r     = params.ballRadius * std::cbrt( nextRandom( state ) );
+    float plane = std::sqrt( std::max( 1.0f - z * z, 0.0f ) );
+    return r * glm::vec3( plane * std::cos( phi ), plane * std::sin( phi ), z );
+  }
+
+  // Everything but the position, drawn from the same state after it
+  [[nodiscard]] inline data::InstanceData instanceAttributes( InstanceParams const & params, glm::vec3 position, uint32_t & state )
+  {
+    data::InstanceData instance{ position };
+    if ( params.randomRotation )
+    {
+      float z     = nextRandom( state ) * 2.0f - 1.0f;
+      float phi   = nextRandom( state ) * glm::two_pi<float>();
+      float angle = nextRandom( state ) * glm::pi<float>();
+      float plane = std::sqrt( std::max( 1.0f - z * z, 0.0f ) );
+      instance.rotation =
+        glm::vec4( glm::vec3( plane * std::cos( phi ), plane * std::sin( phi ), z ) * std::sin( angle * 0.5f ), std::cos( angle * 0.5f ) );
+    }
+    if ( params.scaleJitter > 0.0f )
+      instance.scale = 1.0f + ( nextRandom( state ) * 2.0f - 1.0f ) * params.scaleJitter;
+    if ( params.randomColor )
+    {
+      float r = nextRandom( state ), g = nextRandom( state ), b = nextRandom( state );
+      instance.color = glm::vec4( glm::vec3( r, g, b ) * 0.6f + 0.4f, 1.0f );
+    }
+    return instance;
+  }
+
+  // Owns the instance buffer and (re)fills it from InstanceParams at runtime, either with a compute dispatch
+  // into device local memory or with CPU worker threads streaming straight into a mapped buffer, encoded in
+  // data::instanceFormat. Every instance only depends on its index and the seed, so both sources produce the
+  // same instances. The buffer belongs to a ResourceTable, so the defragmenter can move the device local one.
+  struct InstanceGenerator
+  {
+    static constexpr uint32_t GroupSize    = 64;
+    static constexpr uint32_t MaxInstances = 65535 * GroupSize;  // one dimensional dispatch, the same limit applies to cull.comp
+
+    struct Result
+    {
+      InstanceParams params;
+      uint32_t       count   = 0;
+      uint32_t       threads = 0;  // CPU workers used, 0 for the GPU
+      vk::DeviceSize bytes   = 0;
+      double         ms      = 0.0;  // allocation and fill, until the data is ready for the next frame
+    };
+
+    ResourceHandle      resource = InvalidResource;
+    uint32_t            count    = 0;
+    std::vector<Result> results;  // every generation since startup, for comparing sources and sizes
+
+    void init( vk::raii::Device const & device_,
+               VmaAllocator             allocator_,
+               ResourceTable &          table_,
+               BindlessHeap const &     heap,
+               uint32_t                 queueFamily,
+               vk::raii::Queue const &  queue_ )
+    {
+      device    = &device_;
+      allocator = allocator_;
+      table     = &table_;
+      queue     = &queue_;
+
+      shader      = ComputeShader( device_, "instances.comp", sizeof( data::InstanceGenPushConstants ), { *heap.layout } );
+      commandPool = vk::raii::CommandPool( device_, vk::CommandPoolCreateInfo{ vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamily } );
+      cmd         = std::move( vk::raii::CommandBuffers( device_, vk::CommandBufferAllocateInfo{ commandPool, vk::CommandBufferLevel::ePrimary, 1 } ).front() );
+      fence       = vk::raii::Fence( device_, vk::FenceCreateInfo{} );
+    }
+
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      release( heap, frame );
+      count = 0;
+    }
+
+    // Heap slot of the instance buffer, changes when the defragmenter moves it
+    [[nodiscard]] uint32_t bufferIndex( BindlessHeap const & heap ) const
+    {
+      return heap.slotsOf( resource ).storageBuffer;
+    }
+
+    // Replaces the instance buffer, nothing may still write the previous one (wait for the device first)
+    Result generate( BindlessHeap & heap, InstanceParams const & params, uint64_t frame )
+    {
+      if ( params.count() == 0 || params.count() > MaxInstances )
+        throw std::runtime_error( "Instance count has to be between 1 and " + std::to_string( MaxInstances ) );
+
+      auto begin = std::chrono::steady_clock::now();
+
+      release( heap, frame );
+
+      count = static_cast<uint32_t>( params.count() );
+
+      Result result{};
+      result.params = params;
+      result.count  = count;
+      result.bytes  = instanceStride( data::instanceFormat ) * vk::DeviceSize( count );
+
+      // Written once here and only read by the frames afterwards, so the device local buffer is free to move
+      if ( params.source == InstanceSource::Gpu )
+      {
+        resource = table->createBuffer( result.bytes, vk::BufferUsageFlagBits::eStorageBuffer );
+        heap.registerResource( *table, resource );
+        fill( heap, params, data::instanceFormat, bufferIndex( heap ), count );
+      }
+      else
+      {
+        constexpr VmaAllocationCreateFlags upload = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+        resource = table->createBuffer( result.bytes, vk::BufferUsageFlagBits::eStorageBuffer, upload );
+        heap.registerResource( *table, resource );
+        result.threads = fillOnCpu( params );
+      }
+
+      result.ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - begin ).count();
+      results.push_back( result );
+      return result;
+    }
+
+    // Encodes the instances of `params` into the storage buffer at heap slot `target`, sized for `instanceCount`
+    // instances of `format`, and waits for the dispatch
+    void fill( BindlessHeap const & heap, InstanceParams const & params, data::InstanceFormat format, uint32_t target, uint32_t instanceCount )
+    {
+      data::InstanceGenPushConstants pc{};
+      pc.gridCount      = params.gridCount;
+      pc.spacing        = params.spacing;
+      pc.jitter         = params.jitter;
+      pc.ballRadius     = params.ballRadius;
+      pc.seed           = params.seed;
+      pc.layout         = static_cast<uint32_t>( params.layout );
+      pc.instanceBuffer = target;
+      pc.instanceCount  = instanceCount;
+      pc.format         = static_cast<uint32_t>( format );
+      pc.scaleJitter    = params.scaleJitter;
+      pc.randomRotation = params.randomRotation ? 1 : 0;
+      pc.randomColor    = params.randomColor ? 1 : 0;
+
+      cmd.reset();
+      cmd.begin( vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+      shader.bind( cmd );
+      heap.bind( cmd, *shader.layout, vk::PipelineBindPoint::eCompute );
+      shader.push( cmd, pc );
+      cmd.dispatch( ( instanceCount + GroupSize - 1 ) / GroupSize, 1, 1 );
+
+      // Frames are submitted to the same queue afterwards, the fence wait makes the writes available to them
+      vk::MemoryBarrier2 toReaders{ vk::PipelineStageFlagBits2::eComputeShader,
+                                    vk::AccessFlagBits2::eShaderStorageWrite,
+                                    vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eVertexShader,
+                                    vk::AccessFlagBits2::eShaderStorageRead };
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( toReaders ) );
+      cmd.end();
+
+      vk::CommandBufferSubmitInfo cmdInfo{ *cmd };
+      queue->submit2( vk::SubmitInfo2{}.setCommandBufferInfos( cmdInfo ), *fence );
+      (void)device->waitForFences( { *fence }, VK_TRUE, UINT64_MAX );
+      device->resetFences( { *fence } );
+    }
+
+  private:
+    vk::raii::Device const * device    = nullptr;
+    vk::raii::Queue const *  queue     = nullptr;
+    VmaAllocator             allocator = nullptr;
+    ResourceTable *          table     = nullptr;
+    ComputeShader            shader;
+    vk::raii::CommandPool    commandPool = nullptr;
+    vk::raii::CommandBuffer  cmd         = nullptr;
+    vk::raii::Fence          fence       = nullptr;
+
+    // The table destroys the buffer once no frame in flight can read it anymore
+    void release( BindlessHeap & heap, uint64_t frame )
+    {
+      if ( resource == InvalidResource )
+        return;
+      heap.unregisterResource( resource, frame );
+      table->release( resource, frame );
+      resource = InvalidResource;
+    }
+
+    // Every worker writes one contiguous range of the mapped buffer, returns the worker count
+    uint32_t fillOnCpu( InstanceParams const & params )
+    {
+      uint32_t threads = params.threads ? params.threads : std::max( 1u, std::thread::hardware_concurrency() );
+      threads          = std::clamp( threads, 1u, count );
+
+      core::Buffer const & buffer = table->buffer( resource );
+      void *               out    = buffer.allocationInfo.pMappedData;
+      uint32_t             chunk  = ( count + threads - 1 ) / threads;
+      {
+        std::vector<std::jthread> workers;
+        workers.reserve( threads );
+        for ( uint32_t t = 0; t < threads; ++t )
+        {
+          uint32_t first = t * chunk;
+          uint32_t end   = std::min( first + chunk, count );
+          workers.emplace_back(
+            [&params, out, first, end, total = count]
+            {
+              uint32_t seed = pcgHash( params.seed );
+              for ( uint32_t i = first; i < end; ++i )
+              {
+                uint32_t  state    = i + seed;
+                glm::vec3 position = params.layout == InstanceLayout::Ball ? ballPosition( params, state ) : gridPosition( params, i, state );
+                storeInstance( data::instanceFormat, out, i, total, instanceAttributes( params, position, state ) );
+              }
+            } );
+        }
+      }
+
+      vmaFlushAllocation( allocator, buffer.allocation, 0, VK_WHOLE_SIZE );
+      return threads;
+    }
+  };
+}  // namespace core
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
+
+#if defined( _WIN32 )
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace core
+{
+  // Read-only mapping of a whole file, the pages are read by whichever worker touches them first
+  struct MappedFile
+  {
+    explicit MappedFile( std::filesystem::path const & path )
+    {
+#if defined( _WIN32 )
+      file = CreateFileW( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+      if ( file == INVALID_HANDLE_VALUE )
+        throw std::runtime_error( "Failed to open " + path.string() );
+      LARGE_INTEGER fileSize{};
+      GetFileSizeEx( file, &fileSize );
+      size = static_cast<size_t>( fileSize.QuadPart );
+      if ( size == 0 )
+        return;
+      mapping = CreateFileMappingW( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+      if ( mapping )
+        data = static_cast<char const *>( MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) );
+#else
+      int descriptor = open( path.c_str(), O_RDONLY );
+      if ( descriptor < 0 )
+        throw std::runtime_error( "Failed to open " + path.string() );
+      struct stat info{};
+      fstat( descriptor, &info );
+      size = static_cast<size_t>( info.st_size );
+      if ( size > 0 )
+      {
+        void * view = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0 );
+        data        = view == MAP_FAILED ? nullptr : static_cast<char const *>( view );
+      }
+      close( descriptor );
+#endif
+      if ( size > 0 && !data )
+        throw std::runtime_error( "Failed to map " + path.string() );
+    }
+
+    ~MappedFile()
+    {
+#if defined( _WIN32 )
+      if ( data )
+        UnmapViewOfFile( data );
+      if ( mapping )
+        CloseHandle( mapping );
+      if ( file != INVALID_HANDLE_VALUE )
+        CloseHandle( file );
+#else
+      if ( data )
+        munmap( const_cast<char *>( data ), size );
+#endif
+    }
+
+    MappedFile( MappedFile const & )             = delete;
+    MappedFile & operator=( MappedFile const & ) = delete;
+
+    [[nodiscard]] std::string_view bytes() const
+    {
+      return { data, size };
+    }
+
+  private:
+    char const * data = nullptr;
+    size_t       size = 0;
+#if defined( _WIN32 )
+    HANDLE file    = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+  };
+}  // namespace core
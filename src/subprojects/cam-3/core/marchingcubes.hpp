@@ -0,0 +1,949 @@
+#pragma once
+#include "../data.hpp"
+#include "../helper.hpp"
+#include "../setup.hpp"
+#include "../state.hpp"
+#include "bindless.hpp"
+#include "compute.hpp"
+#include "oneshot.hpp"
+#include "scan.hpp"
+#include "sdf.hpp"
+#include "surface.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <optional>
+#include <print>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Triangles of every cube configuration, bit c of the cube index is set when corner c is inside (negative).
+  // Corner c sits at (c & 1, c >> 1 & 1, c >> 2), edges 0-3 run along x, 4-7 along y and 8-11 along z from
+  // EdgeCorner[edge]. Triangles are wound counter-clockwise seen from outside, like the icosphere.
+  //
+  // The table is derived instead of transcribed. On every face of the cube each run of inside corners is cut off by
+  // one segment between the two crossed edges around it, so the two inside corners of an ambiguous face stay
+  // separated. That only depends on the face, neighbor cells agree on it and the surface has no holes. Segments
+  // are oriented with the inside on their right seen from outside the cube, chain into loops and every loop is
+  // fanned into triangles, at most 5 per cube.
+  struct MarchingCubesTable
+  {
+    static constexpr uint32_t                 MaxIndices = 15;
+    static constexpr std::array<uint32_t, 12> EdgeCorner = { 0, 2, 4, 6, 0, 1, 4, 5, 0, 1, 2, 3 };
+
+    std::array<uint8_t, 256>                         indexCount{};
+    std::array<std::array<uint8_t, MaxIndices>, 256> edges{};
+
+    // Layout of the table buffer of marchingcubes.comp: the index count of every cube, then MaxIndices edges per cube
+    [[nodiscard]] std::vector<uint32_t> words() const
+    {
+      std::vector<uint32_t> result( 256 + 256 * MaxIndices, 0 );
+      for ( uint32_t cube = 0; cube < 256; ++cube )
+      {
+        result[cube] = indexCount[cube];
+        for ( uint32_t k = 0; k < indexCount[cube]; ++k )
+          result[256 + cube * MaxIndices + k] = edges[cube][k];
+      }
+      return result;
+    }
+  };
+
+  [[nodiscard]] inline MarchingCubesTable buildMarchingCubesTable()
+  {
+    constexpr std::array<std::array<uint32_t, 2>, 4> Square = { { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } } };
+
+    auto corner   = []( uint32_t c ) { return glm::vec3( float( c & 1 ), float( c >> 1 & 1 ), float( c >> 2 ) ); };
+    auto midpoint = [&]( uint32_t edge )
+    {
+      glm::vec3 p = corner( MarchingCubesTable::EdgeCorner[edge] );
+      p[edge / 4] += 0.5f;
+      return p;
+    };
+    auto edgeBetween = []( uint32_t a, uint32_t b )
+    {
+      uint32_t axis = uint32_t( std::countr_zero( a ^ b ) );
+      uint32_t base = std::min( a, b );
+      for ( uint32_t edge = axis * 4; edge < axis * 4 + 4; ++edge )
+        if ( MarchingCubesTable::EdgeCorner[edge] == base )
+          return edge;
+      throw std::runtime_error( "Corners do not share a cube edge" );
+    };
+
+    MarchingCubesTable table;
+    for ( uint32_t cube = 0; cube < 256; ++cube )
+    {
+      auto inside = [&]( uint32_t c ) { return ( cube >> c & 1 ) != 0; };
+
+      std::vector<std::array<uint32_t, 2>> segments;
+      for ( uint32_t axis = 0; axis < 3; ++axis )
+        for ( uint32_t side = 0; side < 2; ++side )
+        {
+          uint32_t                u = ( axis + 1 ) % 3, v = ( axis + 2 ) % 3;
+          std::array<uint32_t, 4> ring{};
+          for ( uint32_t k = 0; k < 4; ++k )
+            ring[k] = side << axis | Square[k][0] << u | Square[k][1] << v;
+          glm::vec3 outward( 0.0f );
+          outward[axis] = side ? 1.0f : -1.0f;
+
+          for ( uint32_t k = 0; k < 4; ++k )
+          {
+            if ( !inside( ring[k] ) || inside( ring[( k + 3 ) % 4] ) )
+              continue;
+            uint32_t last = k;
+            while ( inside( ring[( last + 1 ) % 4] ) )
+              last = ( last + 1 ) % 4;
+
+            uint32_t  from = edgeBetween( ring[( k + 3 ) % 4], ring[k] );
+            uint32_t  to   = edgeBetween( ring[last], ring[( last + 1 ) % 4] );
+            glm::vec3 mid  = 0.5f * ( midpoint( from ) + midpoint( to ) );
+            if ( glm::dot( glm::cross( outward, midpoint( to ) - midpoint( from ) ), corner( ring[k] ) - mid ) > 0.0f )
+              std::swap( from, to );
+            segments.push_back( { from, to } );
+          }
+        }
+
+      uint32_t          count = 0;
+      std::vector<bool> used( segments.size(), false );
+      for ( size_t first = 0; first < segments.size(); ++first )
+      {
+        if ( used[first] )
+          continue;
+        used[first] = true;
+
+        std::vector<uint32_t> loop = { segments[first][0] };
+        for ( uint32_t next = segments[first][1]; next != loop.front(); )
+        {
+          loop.push_back( next );
+          auto found = std::find_if( segments.begin(), segments.end(), [&]( auto const & segment ) { return segment[0] == next; } );
+          if ( found == segments.end() )
+            throw std::runtime_error( "Marching cubes loop of cube " + std::to_string( cube ) + " does not close" );
+          used[size_t( found - segments.begin() )] = true;
+          next                                      = ( *found )[1];
+        }
+
+        for ( size_t k = 1; k + 1 < loop.size(); ++k )
+        {
+          if ( count + 3 > MarchingCubesTable::MaxIndices )
+            throw std::runtime_error( "Marching cubes case " + std::to_string( cube ) + " needs more than 5 triangles" );
+          for ( uint32_t edge : { loop[0], loop[k], loop[k + 1] } )
+            table.edges[cube][count++] = uint8_t( edge );
+        }
+      }
+      table.indexCount[cube] = uint8_t( count );
+    }
+    return table;
+  }
+
+  [[nodiscard]] inline MarchingCubesTable const & marchingCubesTable()
+  {
+    static MarchingCubesTable const table = buildMarchingCubesTable();
+    return table;
+  }
+
+  // Value of data::MarchingCubesPushConstants::pass, mirrors marchingcubes.comp
+  enum class MarchingCubesPass : uint32_t
+  {
+    Field     = 0,
+    Classify  = 1,
+    Chunks    = 2,
+    Vertices  = 3,
+    Triangles = 4,
+  };
+
+  // Marching cubes on the GPU for batches of up to MaxJobs chunks of `cells`^3 cells, written into the slots of a
+  // SurfaceChunks, see marchingcubes.comp. The field is sampled once per batch, the active cells are compacted
+  // and the vertex and index counts turned into offsets with core::Scan, the triangles are dispatched indirectly
+  // over the active cells only. Vertices on an edge are shared by all cells around it inside a chunk, chunks do not
+  // share vertices with their neighbors.
+  //
+  // The state buffer ends up with what the batch produced:
+  //
+  //   StateActive     cells with triangles
+  //   StateArgs       3 words, the indirect dispatch of the triangle pass
+  //   StateVertices   vertices and indices written, chunks that did not fit their slot count in StateOverflows
+  //   StateChunks     4 words per chunk: first vertex and index in the batch, vertex and index count
+  struct MarchingCubes
+  {
+    static constexpr uint32_t GroupSize = 64;
+    static constexpr uint32_t MaxJobs   = 16;
+
+    static constexpr uint32_t StateActive    = 0;
+    static constexpr uint32_t StateArgs      = 1;
+    static constexpr uint32_t StateVertices  = 4;
+    static constexpr uint32_t StateIndices   = 5;
+    static constexpr uint32_t StateOverflows = 6;
+    static constexpr uint32_t StateChunks    = 8;
+
+    core::Buffer table;
+    core::Buffer jobs;
+    core::Buffer field;
+    core::Buffer cases;
+    core::Buffer vertexOffsets;
+    core::Buffer indexOffsets;
+    core::Buffer active;
+    core::Buffer state;
+    uint32_t     tableIndex        = InvalidBindlessIndex;
+    uint32_t     jobIndex          = InvalidBindlessIndex;
+    uint32_t     fieldIndex        = InvalidBindlessIndex;
+    uint32_t     caseIndex         = InvalidBindlessIndex;
+    uint32_t     vertexOffsetIndex = InvalidBindlessIndex;
+    uint32_t     indexOffsetIndex  = InvalidBindlessIndex;
+    uint32_t     activeIndex       = InvalidBindlessIndex;
+    uint32_t     stateIndex        = InvalidBindlessIndex;
+    uint32_t     cells             = 0;
+    Scan         scan;
+
+    // Allocates the scratch buffers of a full batch, nothing may still use the previous ones
+    void init( vk::raii::Device const &         device,
+               vk::raii::PhysicalDevice const & physicalDevice,
+               VmaAllocator                     allocator_,
+               BindlessHeap &                   heap,
+               uint32_t                         cells_,
+               uint64_t                         frame )
+    {
+      if ( cells_ < 2 )
+        throw std::runtime_error( "Marching cubes chunks need at least 2 cells per edge" );
+      uint32_t groupLimit = physicalDevice.getProperties().limits.maxComputeWorkGroupCount[0];
+      if ( uint64_t( MaxJobs ) * ( uint64_t( cells_ ) + 1 ) * ( cells_ + 1 ) * ( cells_ + 1 ) > uint64_t( groupLimit ) * GroupSize )
+        throw std::runtime_error( "Marching cubes chunks of " + std::to_string( cells_ ) + " cells per edge exceed the dispatch limit" );
+
+      destroy( heap, frame );
+      allocator = allocator_;
+      cells     = cells_;
+      if ( !*shader.shader )
+        shader = ComputeShader( device, "marchingcubes.comp", sizeof( data::MarchingCubesPushConstants ), { *heap.layout } );
+      scan.init( device, physicalDevice, allocator, heap );
+      scan.resize( heap, MaxJobs * samplesPerChunk(), frame );
+
+      constexpr VmaAllocationCreateFlags upload = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      constexpr vk::BufferUsageFlags     usage =
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc;
+
+      std::vector<uint32_t> words = marchingCubesTable().words();
+      table                       = core::createBuffer( allocator, sizeof( uint32_t ) * words.size(), vk::BufferUsageFlagBits::eStorageBuffer, upload );
+      std::memcpy( table.allocationInfo.pMappedData, words.data(), sizeof( uint32_t ) * words.size() );
+      vmaFlushAllocation( allocator, table.allocation, 0, VK_WHOLE_SIZE );
+
+      vk::DeviceSize samples = sizeof( uint32_t ) * vk::DeviceSize( MaxJobs ) * samplesPerChunk();
+      vk::DeviceSize cellSet = sizeof( uint32_t ) * vk::DeviceSize( MaxJobs ) * cellsPerChunk();
+      jobs                   = core::createBuffer( allocator, sizeof( data::MarchingCubesJob ) * MaxJobs, usage );
+      field                  = core::createBuffer( allocator, samples, usage );
+      cases                  = core::createBuffer( allocator, samples, usage );
+      vertexOffsets          = core::createBuffer( allocator, samples, usage );
+      indexOffsets           = core::createBuffer( allocator, cellSet, usage );
+      active                 = core::createBuffer( allocator, cellSet, usage );
+      state = core::createBuffer( allocator, sizeof( uint32_t ) * ( StateChunks + 4 * MaxJobs ), usage | vk::BufferUsageFlagBits::eIndirectBuffer );
+
+      tableIndex        = heap.addStorageBuffer( table.buffer );
+      jobIndex          = heap.addStorageBuffer( jobs.buffer );
+      fieldIndex        = heap.addStorageBuffer( field.buffer );
+      caseIndex         = heap.addStorageBuffer( cases.buffer );
+      vertexOffsetIndex = heap.addStorageBuffer( vertexOffsets.buffer );
+      indexOffsetIndex  = heap.addStorageBuffer( indexOffsets.buffer );
+      activeIndex       = heap.addStorageBuffer( active.buffer );
+      stateIndex        = heap.addStorageBuffer( state.buffer );
+    }
+
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      for ( uint32_t * index : { &tableIndex, &jobIndex, &fieldIndex, &caseIndex, &vertexOffsetIndex, &indexOffsetIndex, &activeIndex, &stateIndex } )
+      {
+        heap.remove( BindlessHeap::StorageBuffers, *index, frame );
+        *index = InvalidBindlessIndex;
+      }
+      for ( core::Buffer * buffer : { &table, &jobs, &field, &cases, &vertexOffsets, &indexOffsets, &active, &state } )
+        core::destroyBuffer( allocator, *buffer );
+      scan.destroy( heap, frame );
+      cells = 0;
+    }
+
+    [[nodiscard]] uint32_t samplesPerChunk() const
+    {
+      return ( cells + 1 ) * ( cells + 1 ) * ( cells + 1 );
+    }
+
+    [[nodiscard]] uint32_t cellsPerChunk() const
+    {
+      return cells * cells * cells;
+    }
+
+    // Meshes every job into its slot of `surface`. Waits for earlier draws of the surface and earlier batches,
+    // the surface is ready for drawing and the state buffer for transfers afterwards.
+    void record( vk::raii::CommandBuffer const &         cmd,
+                 BindlessHeap const &                    heap,
+                 SurfaceChunks const &                   surface,
+                 data::SdfScene const &                  scene,
+                 std::span<const data::MarchingCubesJob> batch ) const
+    {
+      if ( batch.empty() )
+        return;
+      if ( batch.size() > MaxJobs )
+        throw std::runtime_error( "Marching cubes batches hold up to " + std::to_string( MaxJobs ) + " chunks" );
+      for ( data::MarchingCubesJob const & job : batch )
+        if ( job.slot >= surface.slots )
+          throw std::runtime_error( "Marching cubes slot " + std::to_string( job.slot ) + " is outside the surface" );
+
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eVertexAttributeInput |
+                 vk::PipelineStageFlagBits2::eIndexInput | vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferWrite,
+               vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferWrite );
+      cmd.updateBuffer<data::MarchingCubesJob>( jobs.buffer, 0, { uint32_t( batch.size() ), batch.data() } );
+      cmd.fillBuffer( state.buffer, 0, sizeof( uint32_t ) * StateChunks, 0 );
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+
+      uint32_t jobCount = static_cast<uint32_t>( batch.size() );
+      uint32_t samples  = jobCount * samplesPerChunk();
+
+      data::MarchingCubesPushConstants pc{};
+      pc.scene              = scene;
+      pc.jobBuffer          = jobIndex;
+      pc.fieldBuffer        = fieldIndex;
+      pc.caseBuffer         = caseIndex;
+      pc.vertexOffsetBuffer = vertexOffsetIndex;
+      pc.indexOffsetBuffer  = indexOffsetIndex;
+      pc.activeBuffer       = activeIndex;
+      pc.stateBuffer        = stateIndex;
+      pc.tableBuffer        = tableIndex;
+      pc.vertexBuffer       = surface.vertexIndex;
+      pc.indexBuffer        = surface.indexIndex;
+      pc.drawBuffer         = surface.drawIndex;
+      pc.cells              = cells;
+      pc.jobCount           = jobCount;
+      pc.verticesPerSlot    = surface.verticesPerSlot;
+      pc.indicesPerSlot     = surface.indicesPerSlot;
+
+      dispatch( cmd, heap, pc, MarchingCubesPass::Field, samples );
+      dispatch( cmd, heap, pc, MarchingCubesPass::Classify, samples );
+
+      scan.recordCompact( cmd, heap, InvalidBindlessIndex, indexOffsetIndex, activeIndex, stateIndex, jobCount * cellsPerChunk() );
+      scan.recordScan( cmd, heap, vertexOffsetIndex, vertexOffsetIndex, samples, ScanOp::Add, true );
+      scan.recordScan( cmd, heap, indexOffsetIndex, indexOffsetIndex, jobCount * cellsPerChunk(), ScanOp::Add, true );
+
+      dispatch( cmd, heap, pc, MarchingCubesPass::Chunks, jobCount );
+      dispatch( cmd, heap, pc, MarchingCubesPass::Vertices, samples );
+
+      pc.pass = static_cast<uint32_t>( MarchingCubesPass::Triangles );
+      shader.bind( cmd );
+      heap.bind( cmd, *shader.layout, vk::PipelineBindPoint::eCompute );
+      shader.push( cmd, pc );
+      cmd.dispatchIndirect( state.buffer, sizeof( uint32_t ) * StateArgs );
+
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageWrite,
+               vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eVertexAttributeInput | vk::PipelineStageFlagBits2::eIndexInput |
+                 vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eVertexAttributeRead | vk::AccessFlagBits2::eIndexRead |
+                 vk::AccessFlagBits2::eTransferRead );
+    }
+
+  private:
+    VmaAllocator  allocator = nullptr;
+    ComputeShader shader;
+
+    // Dispatch over `count` invocations followed by a barrier, the pass after it and the indirect dispatch see
+    // what it wrote
+    void dispatch( vk::raii::CommandBuffer const &    cmd,
+                   BindlessHeap const &               heap,
+                   data::MarchingCubesPushConstants & pc,
+                   MarchingCubesPass                  pass,
+                   uint32_t                           count ) const
+    {
+      pc.pass = static_cast<uint32_t>( pass );
+      shader.bind( cmd );
+      heap.bind( cmd, *shader.layout, vk::PipelineBindPoint::eCompute );
+      shader.push( cmd, pc );
+      cmd.dispatch( ( count + GroupSize - 1 ) / GroupSize, 1, 1 );
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageWrite,
+               vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eDrawIndirect,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eIndirectCommandRead );
+    }
+
+    static void barrier( vk::raii::CommandBuffer const & cmd,
+                         vk::PipelineStageFlags2         srcStage,
+                         vk::AccessFlags2                srcAccess,
+                         vk::PipelineStageFlags2         dstStage,
+                         vk::AccessFlags2                dstAccess )
+    {
+      vk::MemoryBarrier2 memoryBarrier{ srcStage, srcAccess, dstStage, dstAccess };
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( memoryBarrier ) );
+    }
+  };
+
+  // A chunk meshed on the CPU in the order of marchingcubes.comp: vertices by owning sample and axis, indices by
+  // cell and table entry, so the GPU result has to match it index for index
+  struct MarchingCubesMesh
+  {
+    std::vector<data::Vertex> vertices;
+    std::vector<uint32_t>     indices;
+    std::vector<uint32_t>     owners;  // per vertex, owning sample * 3 + axis
+  };
+
+  // The (cells + 1)^3 samples of a chunk in the order of marchingcubes.comp
+  [[nodiscard]] inline std::vector<float>
+    sampleChunk( data::SdfScene const & scene, std::span<const glm::vec4> edits, data::MarchingCubesJob const & job, uint32_t cells )
+  {
+    uint32_t           edge = cells + 1;
+    std::vector<float> field( size_t( edge ) * edge * edge );
+    for ( uint32_t z = 0, s = 0; z < edge; ++z )
+      for ( uint32_t y = 0; y < edge; ++y )
+        for ( uint32_t x = 0; x < edge; ++x, ++s )
+          field[s] = sdfScene( job.origin + glm::vec3( float( x ), float( y ), float( z ) ) * job.voxelSize, scene, edits );
+    return field;
+  }
+
+  [[nodiscard]] inline MarchingCubesMesh meshChunk( std::span<const float>        field,
+                                                    data::SdfScene const &        scene,
+                                                    std::span<const glm::vec4>    edits,
+                                                    data::MarchingCubesJob const & job,
+                                                    uint32_t                      cells )
+  {
+    MarchingCubesTable const & table  = marchingCubesTable();
+    uint32_t                   edge   = cells + 1;
+    std::array<uint32_t, 3>    stride = { 1, edge, edge * edge };
+
+    MarchingCubesMesh     mesh;
+    std::vector<uint32_t> vertexOf( field.size() * 3, ~0u );
+    for ( uint32_t z = 0, s = 0; z < edge; ++z )
+      for ( uint32_t y = 0; y < edge; ++y )
+        for ( uint32_t x = 0; x < edge; ++x, ++s )
+        {
+          glm::uvec3 coord( x, y, z );
+          for ( uint32_t axis = 0; axis < 3; ++axis )
+          {
+            if ( coord[axis] >= cells || ( field[s] < 0.0f ) == ( field[s + stride[axis]] < 0.0f ) )
+              continue;
+            glm::vec3 local = glm::vec3( coord );
+            local[axis] += field[s] / ( field[s] - field[s + stride[axis]] );
+
+            glm::vec3 p      = job.origin + local * job.voxelSize;
+            glm::vec3 normal = sdfNormal( p, scene, edits, 0.5f * job.voxelSize );
+            vertexOf[s * 3 + axis] = uint32_t( mesh.vertices.size() );
+            mesh.vertices.push_back( data::Vertex{ p, sdfColor( p, normal, scene ) } );
+            mesh.owners.push_back( s * 3 + axis );
+          }
+        }
+
+    for ( uint32_t z = 0; z < cells; ++z )
+      for ( uint32_t y = 0; y < cells; ++y )
+        for ( uint32_t x = 0; x < cells; ++x )
+        {
+          uint32_t s    = x + y * stride[1] + z * stride[2];
+          uint32_t cube = 0;
+          for ( uint32_t corner = 0; corner < 8; ++corner )
+            if ( field[s + ( corner & 1 ) + ( corner >> 1 & 1 ) * stride[1] + ( corner >> 2 ) * stride[2]] < 0.0f )
+              cube |= 1u << corner;
+          for ( uint32_t k = 0; k < table.indexCount[cube]; ++k )
+          {
+            uint32_t edgeIndex = table.edges[cube][k];
+            uint32_t corner    = MarchingCubesTable::EdgeCorner[edgeIndex];
+            uint32_t owner     = s + ( corner & 1 ) + ( corner >> 1 & 1 ) * stride[1] + ( corner >> 2 ) * stride[2];
+            mesh.indices.push_back( vertexOf[owner * 3 + edgeIndex / 4] );
+          }
+        }
+    return mesh;
+  }
+
+  // Triangle edges without a twin running the other way that do not lie on the chunk boundary, 0 when the surface
+  // is closed and consistently wound
+  [[nodiscard]] inline uint32_t openEdges( MarchingCubesMesh const & mesh, uint32_t cells )
+  {
+    uint32_t edge = cells + 1;
+    auto     planes = [&]( uint32_t vertex )
+    {
+      uint32_t   owner = mesh.owners[vertex];
+      uint32_t   s     = owner / 3;
+      glm::uvec3 coord( s % edge, s / edge % edge, s / ( edge * edge ) );
+      uint32_t   bits = 0;
+      for ( uint32_t axis = 0; axis < 3; ++axis )
+        if ( axis != owner % 3 )
+          bits |= ( coord[axis] == 0 ? 1u : 0u ) << ( 2 * axis ) | ( coord[axis] == cells ? 2u : 0u ) << ( 2 * axis );
+      return bits;
+    };
+
+    std::unordered_map<uint64_t, uint32_t> halfEdges;
+    halfEdges.reserve( mesh.indices.size() );
+    for ( size_t i = 0; i + 2 < mesh.indices.size(); i += 3 )
+      for ( uint32_t k = 0; k < 3; ++k )
+        ++halfEdges[uint64_t( mesh.indices[i + k] ) << 32 | mesh.indices[i + ( k + 1 ) % 3]];
+
+    uint32_t open = 0;
+    for ( auto const & [key, uses] : halfEdges )
+    {
+      uint32_t a = uint32_t( key >> 32 ), b = uint32_t( key );
+      if ( !halfEdges.contains( uint64_t( b ) << 32 | a ) && ( planes( a ) & planes( b ) ) == 0 )
+        ++open;
+    }
+    return open;
+  }
+
+  // Chunk grid and slot sizes of an SdfVolume
+  struct SdfVolumeLayout
+  {
+    glm::uvec3 chunks          = glm::uvec3( 4 );
+    uint32_t   cells           = 32;  // per chunk edge
+    float      voxelSize       = 1.5f;
+    uint32_t   verticesPerSlot = 8192;
+    uint32_t   indicesPerSlot  = 32768;
+
+    [[nodiscard]] uint32_t chunkCount() const
+    {
+      return chunks.x * chunks.y * chunks.z;
+    }
+
+    [[nodiscard]] float chunkSize() const
+    {
+      return float( cells ) * voxelSize;
+    }
+
+    // Chunk i of the grid centered on `center`, meshed into slot i
+    [[nodiscard]] data::MarchingCubesJob job( glm::vec3 center, uint32_t chunk ) const
+    {
+      glm::uvec3 coord( chunk % chunks.x, chunk / chunks.x % chunks.y, chunk / ( chunks.x * chunks.y ) );
+      glm::vec3  low = center - 0.5f * glm::vec3( chunks ) * chunkSize();
+      return data::MarchingCubesJob{ low + glm::vec3( coord ) * chunkSize(), voxelSize, chunk };
+    }
+  };
+
+  // Editable terrain on a fixed grid of chunks around SdfScene::center, chunk i is meshed into slot i of `surface`.
+  // Chunks are re-meshed when dirty: all of them after the scene changed, the ones an edit reaches otherwise. Up to
+  // `budget` chunks are meshed per frame in one MarchingCubes batch, the others keep drawing their previous mesh
+  // until their turn.
+  struct SdfVolume
+  {
+    static constexpr uint32_t MaxEdits = 256;
+
+    data::SdfScene         scene;
+    SdfVolumeLayout        layout;      // applied by rebuild()
+    uint32_t               budget = 8;  // chunks per frame, up to MarchingCubes::MaxJobs
+    std::vector<glm::vec4> edits;
+    std::vector<uint8_t>   dirty;  // per chunk
+    MarchingCubes          mesher;
+    SurfaceChunks          surface;
+    core::Buffer           editBuffer;  // MaxEdits glm::vec4
+    uint32_t               editIndex = InvalidBindlessIndex;
+    bool                   enabled   = false;  // meshed and drawn
+    uint64_t               meshed    = 0;      // chunks since the last rebuild
+    float                  gpuMs     = 0.0f;   // meshing of the last collected frame
+    std::string            error;              // of the last rebuild or run started from the UI
+
+    void init( vk::raii::Device const &         device_,
+               vk::raii::PhysicalDevice const & physicalDevice_,
+               VmaAllocator                     allocator_,
+               uint32_t                         queueFamily )
+    {
+      device         = &device_;
+      physicalDevice = &physicalDevice_;
+      allocator      = allocator_;
+      period         = physicalDevice_.getProperties().limits.timestampPeriod;
+
+      commandPool = vk::raii::CommandPool( device_, vk::CommandPoolCreateInfo{ vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamily } );
+      frameCmds   = vk::raii::CommandBuffers(
+        device_, vk::CommandBufferAllocateInfo{ commandPool, vk::CommandBufferLevel::ePrimary, uint32_t( global::state::MAX_FRAMES_IN_FLIGHT ) } );
+
+      vk::QueryPoolCreateInfo queryInfo{};
+      queryInfo.setQueryType( vk::QueryType::eTimestamp ).setQueryCount( 2 * uint32_t( global::state::MAX_FRAMES_IN_FLIGHT ) );
+      queries = vk::raii::QueryPool( device_, queryInfo );
+    }
+
+    // Reallocates the surface and the mesher for the current layout and marks every chunk dirty. Nothing may
+    // still use the previous buffers.
+    void rebuild( BindlessHeap & heap, uint64_t frame )
+    {
+      if ( layout.chunks.x == 0 || layout.chunks.y == 0 || layout.chunks.z == 0 || layout.voxelSize <= 0.0f )
+        throw std::runtime_error( "The volume needs chunks and a positive voxel size" );
+
+      built = SdfVolumeLayout{ glm::uvec3( 0 ) };
+      mesher.init( *device, *physicalDevice, allocator, heap, layout.cells, frame );
+      surface.create( allocator, heap, layout.chunkCount(), layout.verticesPerSlot, layout.indicesPerSlot, frame );
+      built = layout;
+      if ( !editBuffer.buffer )
+      {
+        editBuffer = core::createBuffer(
+          allocator, sizeof( glm::vec4 ) * MaxEdits, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst );
+        editIndex = heap.addStorageBuffer( editBuffer.buffer );
+      }
+      editsChanged = true;
+      meshed       = 0;
+      markAllDirty();
+    }
+
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      mesher.destroy( heap, frame );
+      surface.destroy( heap, frame );
+      heap.remove( BindlessHeap::StorageBuffers, editIndex, frame );
+      editIndex = InvalidBindlessIndex;
+      core::destroyBuffer( allocator, editBuffer );
+      built = SdfVolumeLayout{ glm::uvec3( 0 ) };
+      dirty.clear();
+    }
+
+    [[nodiscard]] uint32_t chunkCount() const
+    {
+      return built.chunkCount();
+    }
+
+    [[nodiscard]] float chunkSize() const
+    {
+      return built.chunkSize();
+    }
+
+    [[nodiscard]] data::MarchingCubesJob job( uint32_t chunk ) const
+    {
+      return built.job( scene.center, chunk );
+    }
+
+    [[nodiscard]] uint32_t dirtyCount() const
+    {
+      return uint32_t( std::count( dirty.begin(), dirty.end(), uint8_t( 1 ) ) );
+    }
+
+    void markAllDirty()
+    {
+      dirty.assign( chunkCount(), 1 );
+    }
+
+    // Adds a sphere to the field (or carves one with a negative radius) and marks the chunks whose surface it can
+    // move: the blend reaches `smoothness` beyond the sphere, the crossed edges sample a voxel or two around the
+    // surface and the normals half a voxel further. False when the edit list is full.
+    bool addEdit( glm::vec4 edit )
+    {
+      if ( edits.size() >= MaxEdits )
+        return false;
+      edits.push_back( edit );
+      editsChanged = true;
+
+      float reach = std::abs( edit.w ) + scene.smoothness + 3.0f * built.voxelSize;
+      for ( uint32_t chunk = 0; chunk < chunkCount(); ++chunk )
+      {
+        glm::vec3 low     = job( chunk ).origin;
+        glm::vec3 nearest = glm::clamp( glm::vec3( edit ), low, low + glm::vec3( chunkSize() ) );
+        if ( glm::length( nearest - glm::vec3( edit ) ) <= reach )
+          dirty[chunk] = 1;
+      }
+      return true;
+    }
+
+    void clearEdits()
+    {
+      edits.clear();
+      editsChanged = true;
+      markAllDirty();
+    }
+
+    // First point of the surface along a ray, sphere traced through the CPU field with shortened steps since the
+    // hills only bound the distance. Where edits go when placed with the camera.
+    [[nodiscard]] std::optional<glm::vec3> raycast( glm::vec3 from, glm::vec3 direction, float maxDistance ) const
+    {
+      data::SdfScene edited = scene;
+      edited.editCount      = uint32_t( edits.size() );
+      direction             = glm::normalize( direction );
+      for ( float t = 0.0f; t < maxDistance; )
+      {
+        float d = sdfScene( from + t * direction, edited, edits );
+        if ( d < 0.01f )
+          return from + t * direction;
+        t += std::max( 0.8f * d, 0.01f );
+      }
+      return std::nullopt;
+    }
+
+    // Up to `count` dirty chunks, which are no longer dirty afterwards
+    [[nodiscard]] std::vector<data::MarchingCubesJob> takeJobs( uint32_t count )
+    {
+      std::vector<data::MarchingCubesJob> taken;
+      count = std::min( count, MarchingCubes::MaxJobs );
+      for ( uint32_t chunk = 0; chunk < dirty.size() && taken.size() < count; ++chunk )
+        if ( dirty[chunk] )
+        {
+          dirty[chunk] = 0;
+          taken.push_back( job( chunk ) );
+        }
+      return taken;
+    }
+
+    // The edits when they changed and a batch of `batch`, into any command buffer
+    void record( vk::raii::CommandBuffer const & cmd, BindlessHeap const & heap, std::span<const data::MarchingCubesJob> batch )
+    {
+      if ( editsChanged && !edits.empty() )
+      {
+        vk::MemoryBarrier2 before{ vk::PipelineStageFlagBits2::eComputeShader,
+                                   vk::AccessFlagBits2::eShaderStorageRead,
+                                   vk::PipelineStageFlagBits2::eTransfer,
+                                   vk::AccessFlagBits2::eTransferWrite };
+        cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( before ) );
+        cmd.updateBuffer<glm::vec4>( editBuffer.buffer, 0, edits );
+        vk::MemoryBarrier2 after{ vk::PipelineStageFlagBits2::eTransfer,
+                                  vk::AccessFlagBits2::eTransferWrite,
+                                  vk::PipelineStageFlagBits2::eComputeShader,
+                                  vk::AccessFlagBits2::eShaderStorageRead };
+        cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( after ) );
+      }
+      editsChanged = false;
+
+      data::SdfScene edited = scene;
+      edited.editBuffer     = editIndex;
+      edited.editCount      = uint32_t( edits.size() );
+      mesher.record( cmd, heap, surface, edited, batch );
+      meshed += batch.size();
+    }
+
+    // Meshes the next `budget` dirty chunks in the command buffer of `slot`, submit it before the scene. Empty
+    // when disabled or nothing is dirty.
+    [[nodiscard]] vk::CommandBuffer recordFrame( BindlessHeap const & heap, uint32_t slot )
+    {
+      recorded[slot] = false;
+      if ( !enabled || surface.empty() )
+        return nullptr;
+      std::vector<data::MarchingCubesJob> batch = takeJobs( budget );
+      if ( batch.empty() )
+        return nullptr;
+
+      auto & frameCmd = frameCmds[slot];
+      frameCmd.reset();
+      frameCmd.begin( vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+      frameCmd.resetQueryPool( *queries, slot * 2, 2 );
+      frameCmd.writeTimestamp2( vk::PipelineStageFlagBits2::eAllCommands, *queries, slot * 2 );
+      record( frameCmd, heap, batch );
+      frameCmd.writeTimestamp2( vk::PipelineStageFlagBits2::eAllCommands, *queries, slot * 2 + 1 );
+      frameCmd.end();
+
+      recorded[slot] = true;
+      return *frameCmd;
+    }
+
+    // Call after the slot's fence has been waited
+    void collect( uint32_t slot )
+    {
+      if ( !recorded[slot] )
+        return;
+      auto [result, ticks] = queries.getResults<uint64_t>( slot * 2, 2, 2 * sizeof( uint64_t ), sizeof( uint64_t ), vk::QueryResultFlagBits::e64 );
+      if ( result == vk::Result::eSuccess )
+        gpuMs = static_cast<float>( ticks[1] - ticks[0] ) * period * 1e-6f;
+    }
+
+  private:
+    vk::raii::Device const *         device         = nullptr;
+    vk::raii::PhysicalDevice const * physicalDevice = nullptr;
+    VmaAllocator                     allocator      = nullptr;
+    float                            period         = 1.0f;
+    bool                             editsChanged   = false;
+    SdfVolumeLayout                  built          = { glm::uvec3( 0 ) };  // of the current surface
+    vk::raii::CommandPool            commandPool    = nullptr;
+    vk::raii::CommandBuffers         frameCmds      = nullptr;
+    vk::raii::QueryPool              queries        = nullptr;
+
+    std::array<bool, global::state::MAX_FRAMES_IN_FLIGHT> recorded{};
+  };
+
+  // Meshes a whole SdfVolume with MarchingCubes and checks every chunk against meshChunk() run on the field the GPU
+  // sampled, so both sides agree on which edges cross:
+  //
+  //   full  every chunk: vertex positions and colors, the indices one by one, no open edges inside a chunk
+  //   edit  `edits` added and only the chunks they reach re-meshed, which then match the reference of the edited
+  //         field while every other chunk still matches its previous mesh and would not change when re-meshed
+  //
+  // The sampled field is compared with sdfScene() as well, float rounding of sin differs per device.
+  struct MarchingCubesValidation
+  {
+    struct Result
+    {
+      std::string pass;
+      uint32_t    chunks          = 0;  // meshed on the GPU
+      uint32_t    vertices        = 0;
+      uint32_t    triangles       = 0;
+      uint32_t    indexMismatches = 0;
+      uint32_t    openEdges       = 0;
+      uint32_t    stale           = 0;  // chunks an edit changed that were not re-meshed
+      uint32_t    overflows       = 0;  // chunks that did not fit their slot
+      float       maxFieldError   = 0.0f;
+      float       maxVertexError  = 0.0f;  // position or color
+      float       gpuMs           = 0.0f;
+      float       cpuMs           = 0.0f;  // sampling and meshing the same chunks
+      std::string error;                   // first failed check, empty when valid
+    };
+
+    data::SdfScene         scene;
+    SdfVolumeLayout        layout;
+    std::vector<glm::vec4> edits           = { glm::vec4( 0.0f, 74.0f, 0.0f, -12.0f ), glm::vec4( 45.0f, 0.0f, 40.0f, 10.0f ) };  // around the center
+    float                  fieldTolerance  = 1e-2f;
+    float                  vertexTolerance = 1e-2f;
+    std::vector<Result>    results;
+    std::string            error;  // of the last run started from the UI
+
+    void run( vk::raii::Device const &         device,
+              vk::raii::PhysicalDevice const & physicalDevice,
+              VmaAllocator                     allocator,
+              BindlessHeap &                   heap,
+              uint32_t                         queueFamily,
+              vk::raii::Queue const &          queue,
+              uint64_t                         frame )
+    {
+      OneShotQueue oneShot;
+      oneShot.init( device, physicalDevice, allocator, queueFamily, queue );
+
+      SdfVolume volume;
+      volume.scene  = scene;
+      volume.layout = layout;
+      volume.init( device, physicalDevice, allocator, queueFamily );
+      volume.rebuild( heap, frame );
+
+      results.clear();
+      std::vector<MarchingCubesMesh> previous( volume.chunkCount() );
+      std::vector<float>             previousField;
+      for ( bool editing : { false, true } )
+      {
+        Result result{};
+        result.pass = editing ? "edit" : "full";
+
+        std::vector<std::vector<float>> fieldBefore;
+        if ( editing )
+        {
+          for ( uint32_t chunk = 0; chunk < volume.chunkCount(); ++chunk )
+            fieldBefore.push_back( sampleChunk( volume.scene, volume.edits, volume.job( chunk ), layout.cells ) );
+          for ( glm::vec4 edit : edits )
+            volume.addEdit( glm::vec4( scene.center + glm::vec3( edit ), edit.w ) );
+        }
+
+        // Batch by batch, the field of every chunk is kept for the reference
+        std::vector<uint8_t>            remeshed( volume.chunkCount(), 0 );
+        std::vector<std::vector<float>> fields( volume.chunkCount() );
+        while ( volume.dirtyCount() > 0 )
+        {
+          std::vector<data::MarchingCubesJob> batch = volume.takeJobs( MarchingCubes::MaxJobs );
+          oneShot.submit(
+            [&]( vk::raii::CommandBuffer const & cmd )
+            {
+              oneShot.timestamp( cmd, 0 );
+              volume.record( cmd, heap, batch );
+              oneShot.timestamp( cmd, 1 );
+            } );
+          result.gpuMs += oneShot.milliseconds( 0, 1 );
+
+          std::vector<float>    field = oneShot.download<float>( volume.mesher.field.buffer, batch.size() * volume.mesher.samplesPerChunk() );
+          std::vector<uint32_t> state = oneShot.download<uint32_t>( volume.mesher.state.buffer, MarchingCubes::StateChunks );
+          result.overflows += state[MarchingCubes::StateOverflows];
+          for ( size_t j = 0; j < batch.size(); ++j )
+          {
+            auto begin = field.begin() + std::ptrdiff_t( j * volume.mesher.samplesPerChunk() );
+            fields[batch[j].slot].assign( begin, begin + volume.mesher.samplesPerChunk() );
+            remeshed[batch[j].slot] = 1;
+          }
+          result.chunks += uint32_t( batch.size() );
+        }
+
+        SurfaceChunks const &     surface  = volume.surface;
+        std::vector<data::Vertex> vertices = oneShot.download<data::Vertex>( surface.vertices.buffer, surface.vertices.size / sizeof( data::Vertex ) );
+        std::vector<uint32_t>     indices  = oneShot.download<uint32_t>( surface.indices.buffer, surface.indices.size / sizeof( uint32_t ) );
+        std::vector<uint32_t>     draws    = oneShot.download<uint32_t>( surface.draws.buffer, surface.draws.size / sizeof( uint32_t ) );
+
+        auto fail = [&]( std::string const & what )
+        {
+          if ( result.error.empty() )
+            result.error = what;
+        };
+
+        using Clock = std::chrono::steady_clock;
+        for ( uint32_t chunk = 0; chunk < volume.chunkCount(); ++chunk )
+        {
+          data::MarchingCubesJob job = volume.job( chunk );
+          if ( remeshed[chunk] )
+          {
+            auto               begin     = Clock::now();
+            std::vector<float> reference = sampleChunk( volume.scene, volume.edits, job, layout.cells );
+            for ( size_t s = 0; s < reference.size(); ++s )
+              result.maxFieldError = std::max( result.maxFieldError, std::abs( reference[s] - fields[chunk][s] ) );
+            previous[chunk] = meshChunk( fields[chunk], volume.scene, volume.edits, job, layout.cells );
+            result.cpuMs += std::chrono::duration<float, std::milli>( Clock::now() - begin ).count();
+          }
+          else if ( meshChunk( fieldBefore[chunk], volume.scene, volume.edits, job, layout.cells ).indices !=
+                    meshChunk( sampleChunk( volume.scene, volume.edits, job, layout.cells ), volume.scene, volume.edits, job, layout.cells ).indices )
+          {
+            ++result.stale;
+          }
+
+          MarchingCubesMesh const & expected   = previous[chunk];
+          size_t                    firstIndex = size_t( chunk ) * volume.surface.indicesPerSlot;
+          size_t                    base       = size_t( chunk ) * volume.surface.verticesPerSlot;
+          uint32_t                  drawn      = draws[SurfaceChunks::DrawsOffset / sizeof( uint32_t ) + 5 * size_t( chunk )];
+          if ( expected.vertices.size() > volume.surface.verticesPerSlot || expected.indices.size() > volume.surface.indicesPerSlot )
+          {
+            if ( drawn != 0 )
+              fail( "chunk " + std::to_string( chunk ) + " overflows its slot but is drawn" );
+            continue;
+          }
+
+          if ( drawn != expected.indices.size() )
+            fail( "chunk " + std::to_string( chunk ) + " draws " + std::to_string( drawn ) + " indices instead of " +
+                  std::to_string( expected.indices.size() ) );
+          for ( size_t i = 0; i < expected.indices.size(); ++i )
+            if ( indices[firstIndex + i] != expected.indices[i] )
+              ++result.indexMismatches;
+          for ( size_t v = 0; v < expected.vertices.size(); ++v )
+          {
+            data::Vertex const & gpu = vertices[base + v];
+            result.maxVertexError    = std::max( { result.maxVertexError,
+                                                   glm::length( gpu.position - expected.vertices[v].position ),
+                                                   glm::length( gpu.color - expected.vertices[v].color ) } );
+          }
+          result.openEdges += openEdges( expected, layout.cells );
+          result.vertices += uint32_t( expected.vertices.size() );
+          result.triangles += uint32_t( expected.indices.size() / 3 );
+        }
+
+        if ( draws[0] != volume.chunkCount() )
+          fail( "draw count is " + std::to_string( draws[0] ) + " instead of " + std::to_string( volume.chunkCount() ) );
+        if ( result.overflows > 0 )
+          fail( std::to_string( result.overflows ) + " chunks do not fit their slot" );
+        if ( result.maxFieldError > fieldTolerance )
+          fail( "field differs by up to " + std::to_string( result.maxFieldError ) );
+        if ( result.indexMismatches > 0 )
+          fail( std::to_string( result.indexMismatches ) + " indices differ" );
+        if ( result.maxVertexError > vertexTolerance )
+          fail( "vertices differ by up to " + std::to_string( result.maxVertexError ) );
+        if ( result.openEdges > 0 )
+          fail( std::to_string( result.openEdges ) + " open edges" );
+        if ( result.stale > 0 )
+          fail( std::to_string( result.stale ) + " chunks changed without being re-meshed" );
+        if ( editing && result.chunks == volume.chunkCount() )
+          fail( "the edits re-meshed every chunk" );
+
+        results.push_back( result );
+        isDebug( std::println( "[marching cubes] {}: {} chunks, {} vertices, {} triangles, field error {:.2e}, vertex error {:.2e}, "
+                               "GPU {:.3f} ms, CPU {:.1f} ms: {}",
+                               result.pass,
+                               result.chunks,
+                               result.vertices,
+                               result.triangles,
+                               result.maxFieldError,
+                               result.maxVertexError,
+                               result.gpuMs,
+                               result.cpuMs,
+                               result.error.empty() ? "valid" : result.error ) );
+      }
+      volume.destroy( heap, frame );
+    }
+  };
+}  // namespace core
@@ -1,36 +1,310 @@
 #pragma once
+#include "../data.hpp"
+#include "../setup.hpp"
+#include "../structs.hpp"
+#include "bindless.hpp"
+#include "meshlets.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <initializer_list>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+
+  struct SoftModel
+  {
+
+    // point cloud
+    // material = mesh shader (surface reconstruction) + fragment
+    // or
+    // skin that works like bones + some shader that reconstructs surface on nodes elimination;
+  };
+
+  // One level of detail, a range of the model's index buffer and of its meshlets
+  struct ModelLod
+  {
+    uint32_t firstIndex    = 0;
+    uint32_t indexCount    = 0;
+    float    minScreenSize = 0.0f;  // projected diameter in pixels from which this level is used, 0 for the coarsest
+    uint32_t firstMeshlet  = 0;
+    uint32_t meshletCount  = 0;
+
+    [[nodiscard]] uint32_t triangleCount() const
+    {
+      return indexCount / 3;
+    }
+  };
+
+  // Layout of Model::vertices
+  enum class VertexFormat : uint32_t
+  {
+    Float,      // data::Vertex
+    Quantized,  // data::QuantizedVertex, positions relative to Model::radius
+  };
+
+  // Mesh with its levels of detail, finest first. All levels share one vertex and one index buffer,
+  // indices are absolute so every level draws with vertexOffset 0. `meshlets` holds the packMeshlets() layout
+  // of every level for the mesh shader path, meshlet vertices are absolute as well.
+  struct Model
+  {
+    static constexpr uint32_t MaxLods = 4;
+
+    core::Buffer          vertices;
+    core::Buffer          indices;
+    core::Buffer          meshlets;
+    std::vector<ModelLod> lods;
+    float                 radius       = 0.0f;  // bounding sphere around the origin
+    VertexFormat          vertexFormat = VertexFormat::Float;
+
+    // Set by adopt(), the buffers then belong to a ResourceTable and vertices and meshlets have heap slots
+    ResourceHandle vertexHandle  = InvalidResource;
+    ResourceHandle indexHandle   = InvalidResource;
+    ResourceHandle meshletHandle = InvalidResource;
+
+    Model() = default;
+
+    Model( VmaAllocator                  allocator,
+           std::span<const data::Vertex> vertexData,
+           std::span<const uint32_t>     indexData,
+           std::vector<ModelLod>         lods_,
+           float                         radius_,
+           std::span<const uint32_t>     meshletData = {} )
+      : lods( std::move( lods_ ) ), radius( radius_ )
+    {
+      if ( lods.empty() || lods.size() > MaxLods )
+        throw std::runtime_error( "Model needs between 1 and " + std::to_string( MaxLods ) + " levels of detail" );
+
+      constexpr VmaAllocationCreateFlags upload  = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      constexpr vk::BufferUsageFlags     storage = vk::BufferUsageFlagBits::eStorageBuffer;  // the mesh shader path reads vertices and meshlets from the heap
+
+      vertices = core::createBuffer( allocator, vertexData.size_bytes(), vk::BufferUsageFlagBits::eVertexBuffer | storage, upload );
+      indices  = core::createBuffer( allocator, indexData.size_bytes(), vk::BufferUsageFlagBits::eIndexBuffer, upload );
+      std::memcpy( vertices.allocationInfo.pMappedData, vertexData.data(), vertexData.size_bytes() );
+      std::memcpy( indices.allocationInfo.pMappedData, indexData.data(), indexData.size_bytes() );
+      vmaFlushAllocation( allocator, vertices.allocation, 0, VK_WHOLE_SIZE );
+      vmaFlushAllocation( allocator, indices.allocation, 0, VK_WHOLE_SIZE );
+
+      if ( !meshletData.empty() )
+      {
+        meshlets = core::createBuffer( allocator, meshletData.size_bytes(), storage, upload );
+        std::memcpy( meshlets.allocationInfo.pMappedData, meshletData.data(), meshletData.size_bytes() );
+        vmaFlushAllocation( allocator, meshlets.allocation, 0, VK_WHOLE_SIZE );
+      }
+    }
+
+    // Of a model that was never adopted
+    void destroy( VmaAllocator allocator )
+    {
+      core::destroyBuffer( allocator, vertices );
+      core::destroyBuffer( allocator, indices );
+      core::destroyBuffer( allocator, meshlets );
+      lods.clear();
+    }
+
+    // Hands the buffers to `table` and makes vertices and meshlets visible in `heap`. The defragmenter may move
+    // the buffers from now on (host mapped ones stay), refresh() picks up the new ones.
+    void adopt( ResourceTable & table, BindlessHeap & heap )
+    {
+      vertexHandle = table.adoptBuffer( vertices );
+      indexHandle  = table.adoptBuffer( indices );
+      heap.registerResource( table, vertexHandle );
+      if ( meshlets.buffer )
+      {
+        meshletHandle = table.adoptBuffer( meshlets );
+        heap.registerResource( table, meshletHandle );
+      }
+    }
+
+    // After the table was patched, the buffers bind() uses follow the moved ones
+    void refresh( ResourceTable const & table )
+    {
+      if ( vertexHandle != InvalidResource )
+        vertices = table.buffer( vertexHandle );
+      if ( indexHandle != InvalidResource )
+        indices = table.buffer( indexHandle );
+      if ( meshletHandle != InvalidResource )
+        meshlets = table.buffer( meshletHandle );
+    }
+
+    // Of an adopted model, the table destroys the buffers once no frame in flight can read them anymore
+    void release( ResourceTable & table, BindlessHeap & heap, uint64_t frame )
+    {
+      for ( ResourceHandle handle : { vertexHandle, indexHandle, meshletHandle } )
+      {
+        if ( handle == InvalidResource )
+          continue;
+        heap.unregisterResource( handle, frame );
+        table.release( handle, frame );
+      }
+      vertices      = {};
+      indices       = {};
+      meshlets      = {};
+      vertexHandle  = InvalidResource;
+      indexHandle   = InvalidResource;
+      meshletHandle = InvalidResource;
+      lods.clear();
+    }
+
+    // Model space size of one unit of the position attribute
+    [[nodiscard]] float positionScale() const
+    {
+      return vertexFormat == VertexFormat::Quantized ? radius : 1.0f;
+    }
+
+    // Vertex path input state, position at location 0 and color at location 1. Quantized attributes are
+    // normalized formats, the vertex shader scales positions by positionScale().
+    void setVertexInput( vk::raii::CommandBuffer const & cmd ) const
+    {
+      bool quantized = vertexFormat == VertexFormat::Quantized;
+
+      vk::VertexInputBindingDescription2EXT binding{};
+      binding.setBinding( 0 )
+        .setStride( quantized ? sizeof( data::QuantizedVertex ) : sizeof( data::Vertex ) )
+        .setInputRate( vk::VertexInputRate::eVertex )
+        .setDivisor( 1 );
+
+      std::array<vk::VertexInputAttributeDescription2EXT, 2> attributes{};
+      if ( quantized )
+      {
+        attributes[0].setLocation( 0 ).setBinding( 0 ).setFormat( vk::Format::eR16G16B16A16Snorm ).setOffset( offsetof( data::QuantizedVertex, position ) );
+        attributes[1].setLocation( 1 ).setBinding( 0 ).setFormat( vk::Format::eR8G8B8A8Unorm ).setOffset( offsetof( data::QuantizedVertex, color ) );
+      }
+      else
+      {
+        attributes[0].setLocation( 0 ).setBinding( 0 ).setFormat( vk::Format::eR32G32B32Sfloat ).setOffset( offsetof( data::Vertex, position ) );
+        attributes[1].setLocation( 1 ).setBinding( 0 ).setFormat( vk::Format::eR32G32B32Sfloat ).setOffset( offsetof( data::Vertex, color ) );
+      }
+      cmd.setVertexInputEXT( binding, attributes );
+    }
+
+    void bind( vk::raii::CommandBuffer const & cmd ) const
+    {
+      cmd.bindVertexBuffers( 0, { vk::Buffer( vertices.buffer ) }, { vk::DeviceSize( 0 ) } );
+      cmd.bindIndexBuffer( indices.buffer, 0, vk::IndexType::eUint32 );
+    }
+  };
+
+  struct IndexedMesh
+  {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t>  indices;
+  };
+
+  // Unit icosphere, the icosahedron subdivided `subdivisions` times (20 * 4^subdivisions triangles)
+  inline IndexedMesh icosphere( uint32_t subdivisions )
+  {
+    float t = 1.6180339887f;  // golden ratio
+
+    IndexedMesh mesh;
+    mesh.positions = { { -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 }, { 0, -1, t }, { 0, 1, t },
+                       { 0, -1, -t }, { 0, 1, -t }, { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 } };
+    mesh.indices   = { 0, 11, 5, 0, 5,  1,  0,  1, 7, 0, 7,  10, 0, 10, 11, 1, 5, 9, 5, 11, 4,  11, 10, 2,  10, 7, 6, 7, 1, 8,
+                       3, 9,  4, 3, 4,  2,  3,  2, 6, 3, 6,  8,  3, 8,  9,  4, 9, 5, 2, 4,  11, 6,  2,  10, 8,  6, 7, 9, 8, 1 };
+    for ( auto & p : mesh.positions )
+      p = glm::normalize( p );
+
+    for ( uint32_t subdivision = 0; subdivision < subdivisions; ++subdivision )
+    {
+      std::unordered_map<uint64_t, uint32_t> midpoints;
+      midpoints.reserve( mesh.indices.size() );
+
+      auto midpoint = [&]( uint32_t a, uint32_t b )
+      {
+        auto [low, high] = std::minmax( a, b );
+        auto [it, added] = midpoints.try_emplace( uint64_t( low ) << 32 | high, static_cast<uint32_t>( mesh.positions.size() ) );
+        if ( added )
+          mesh.positions.push_back( glm::normalize( mesh.positions[a] + mesh.positions[b] ) );
+        return it->second;
+      };
 
-namespace core {
+      std::vector<uint32_t> next;
+      next.reserve( mesh.indices.size() * 4 );
+      for ( size_t i = 0; i < mesh.indices.size(); i += 3 )
+      {
+        uint32_t a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+        uint32_t ab = midpoint( a, b ), bc = midpoint( b, c ), ca = midpoint( c, a );
+        next.insert( next.end(), { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca } );
+      }
+      mesh.indices = std::move( next );
+    }
 
-    struct SoftModel{
+    return mesh;
+  }
 
-        // point cloud
-        // material = mesh shader (surface reconstruction) + fragment
-        // or
-        // skin that works like bones + some shader that reconstructs surface on nodes elimination;
-    };
+  // Icosphere LOD chain: level 0 is subdivided lodCount - 1 times, every following level once less,
+  // the coarsest is the plain icosahedron (20 triangles). minScreenSizes[i] becomes lods[i].minScreenSize.
+  // Meshlets of all levels are built on worker threads, or loaded from `meshletCache` when it matches.
+  inline Model createIcosphereModel( VmaAllocator                  allocator,
+                                     float                         radius,
+                                     std::span<const float>        minScreenSizes,
+                                     std::filesystem::path const & meshletCache = "./cache/icosphere.meshlets" )
+  {
+    uint32_t lodCount = static_cast<uint32_t>( minScreenSizes.size() );
 
-    struct Model{
+    // Tint per level so LOD switches are visible
+    constexpr std::array<glm::vec3, Model::MaxLods> tints = {
+      glm::vec3( 1.0f, 0.55f, 0.45f ), glm::vec3( 0.55f, 1.0f, 0.45f ), glm::vec3( 0.45f, 0.6f, 1.0f ), glm::vec3( 1.0f, 0.9f, 0.4f ) };
 
-        //mesh -> mesh chunks + material
+    std::vector<IndexedMesh>  levels;
+    std::vector<MeshletInput> inputs;
+    for ( uint32_t lod = 0; lod < lodCount; ++lod )
+      levels.push_back( icosphere( lodCount - 1 - lod ) );
+    for ( auto const & level : levels )
+      inputs.push_back( MeshletInput{ level.positions, level.indices } );
 
+    std::vector<MeshletMesh> levelMeshlets = loadOrBuildMeshlets( meshletCache, inputs );
 
-        Model()
-        {
+    std::vector<data::Vertex> vertices;
+    std::vector<uint32_t>     indices;
+    std::vector<ModelLod>     lods;
+    MeshletMesh               meshlets;
 
-        }
-    };
+    for ( uint32_t lod = 0; lod < lodCount; ++lod )
+    {
+      uint32_t base = static_cast<uint32_t>( vertices.size() );
+      for ( auto const & p : levels[lod].positions )
+        vertices.push_back( data::Vertex{ p * radius, tints[lod] * ( 0.6f + 0.4f * p.y ) } );
 
+      lods.push_back( ModelLod{ static_cast<uint32_t>( indices.size() ),
+                                static_cast<uint32_t>( levels[lod].indices.size() ),
+                                minScreenSizes[lod],
+                                static_cast<uint32_t>( meshlets.meshlets.size() ),
+                                static_cast<uint32_t>( levelMeshlets[lod].meshlets.size() ) } );
+      for ( uint32_t index : levels[lod].indices )
+        indices.push_back( base + index );
 
-    struct Material{
+      // Bounds were computed on the unit sphere
+      MeshletMesh & level = levelMeshlets[lod];
+      for ( uint32_t & vertex : level.vertices )
+        vertex += base;
+      for ( data::Meshlet & meshlet : level.meshlets )
+      {
+        meshlet.center *= radius;
+        meshlet.radius *= radius;
+      }
+      appendMeshlets( meshlets, level );
+    }
 
-        
-        Material(std::vector<std::string> shaders)
-        {
+    lods.back().minScreenSize = 0.0f;
+    return Model( allocator, vertices, indices, std::move( lods ), radius, packMeshlets( meshlets ) );
+  }
 
-        }
+  struct Material
+  {
 
-    };
-}
+    Material( std::vector<std::string> shaders ) {}
+  };
+}  // namespace core
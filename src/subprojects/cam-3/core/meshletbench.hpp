@@ -0,0 +1,125 @@
+#pragma once
+#include "../helper.hpp"
+#include "material.hpp"
+#include "meshlets.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <print>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace core
+{
+  // Measures buildMeshlets() on large meshes, CPU only.
+  //
+  // `meshCount` icospheres of `subdivisions` subdivisions are built once on one thread and once on `threads`
+  // workers (0 for every hardware thread). Every build is checked with validateMeshlets(), then written to a
+  // scratch cache file and loaded back, so the cache round trip is both verified and timed.
+  struct MeshletBenchmark
+  {
+    struct Result
+    {
+      uint32_t    threads      = 0;
+      uint64_t    triangles    = 0;  // over every mesh
+      float       buildMs      = 0.0f;
+      float       loadMs       = 0.0f;  // cache read of the same meshlets
+      uint64_t    cacheBytes   = 0;
+      uint32_t    meshlets     = 0;
+      float       avgVertices  = 0.0f;
+      float       avgTriangles = 0.0f;
+      std::string error;  // first failed check, empty when valid
+    };
+
+    uint32_t            subdivisions = 7;  // 327680 triangles per mesh
+    uint32_t            meshCount    = 8;
+    uint32_t            threads      = 0;
+    std::vector<Result> results;  // single-threaded first
+
+    void run( std::filesystem::path const & scratch = "./cache/meshletbench.meshlets" )
+    {
+      using Clock = std::chrono::steady_clock;
+
+      subdivisions = std::clamp( subdivisions, 0u, 9u );
+      meshCount    = std::max( meshCount, 1u );
+
+      // Rotated copies, so every mesh hashes and builds on its own
+      std::vector<IndexedMesh> meshes( meshCount, icosphere( subdivisions ) );
+      for ( uint32_t i = 0; i < meshCount; ++i )
+      {
+        float angle = 0.37f * float( i );
+        for ( auto & p : meshes[i].positions )
+          p = glm::vec3( p.x * std::cos( angle ) - p.z * std::sin( angle ), p.y, p.x * std::sin( angle ) + p.z * std::cos( angle ) );
+      }
+
+      std::vector<MeshletInput> inputs;
+      uint64_t                  triangles = 0;
+      for ( auto const & mesh : meshes )
+      {
+        inputs.push_back( MeshletInput{ mesh.positions, mesh.indices } );
+        triangles += mesh.indices.size() / 3;
+      }
+      uint64_t hash = meshletSourceHash( inputs );
+
+      uint32_t hardware = std::max( 1u, std::thread::hardware_concurrency() );
+      results.clear();
+      for ( uint32_t workers : { 1u, threads ? threads : hardware } )
+      {
+        Result result{};
+        result.threads   = workers;
+        result.triangles = triangles;
+
+        auto                     start = Clock::now();
+        std::vector<MeshletMesh> built = buildMeshlets( inputs, workers );
+        result.buildMs                 = std::chrono::duration<float, std::milli>( Clock::now() - start ).count();
+
+        uint64_t vertices = 0, emitted = 0;
+        for ( size_t i = 0; i < built.size() && result.error.empty(); ++i )
+        {
+          result.error = validateMeshlets( built[i], meshes[i].positions, meshes[i].indices );
+          result.meshlets += static_cast<uint32_t>( built[i].meshlets.size() );
+          vertices += built[i].vertices.size();
+          emitted += built[i].triangles.size() / 3;
+        }
+        if ( result.meshlets > 0 )
+        {
+          result.avgVertices  = float( vertices ) / float( result.meshlets );
+          result.avgTriangles = float( emitted ) / float( result.meshlets );
+        }
+
+        saveMeshletCache( scratch, hash, built );
+        result.cacheBytes = std::filesystem::file_size( scratch );
+
+        start         = Clock::now();
+        auto loaded   = loadMeshletCache( scratch, hash );
+        result.loadMs = std::chrono::duration<float, std::milli>( Clock::now() - start ).count();
+        if ( result.error.empty() && ( !loaded || loaded->size() != built.size() ) )
+          result.error = "cache did not load back";
+        for ( size_t i = 0; loaded && i < loaded->size() && result.error.empty(); ++i )
+          if ( ( *loaded )[i].vertices != built[i].vertices || ( *loaded )[i].triangles != built[i].triangles ||
+               ( *loaded )[i].meshlets.size() != built[i].meshlets.size() )
+            result.error = "cache differs from the build";
+
+        results.push_back( result );
+
+        isDebug( std::println( "[meshletbench] {} meshes, {} triangles, {} threads: build {:.1f} ms, {} meshlets ({:.1f}v {:.1f}t), cache {} B / {:.2f} ms, {}",
+                               meshCount,
+                               result.triangles,
+                               result.threads,
+                               result.buildMs,
+                               result.meshlets,
+                               result.avgVertices,
+                               result.avgTriangles,
+                               result.cacheBytes,
+                               result.loadMs,
+                               result.error.empty() ? "valid" : result.error ) );
+      }
+
+      std::filesystem::remove( scratch );
+    }
+  };
+}  // namespace core
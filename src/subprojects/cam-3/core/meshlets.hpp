@@ -0,0 +1,435 @@
+#pragma once
+#include "../data.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace core
+{
+  // Mesh shader output limits every meshlet stays within, mirrors instances.mesh
+  inline constexpr uint32_t MeshletMaxVertices  = 64;
+  inline constexpr uint32_t MeshletMaxTriangles = 124;
+
+  // Meshlets of one indexed triangle mesh
+  struct MeshletMesh
+  {
+    std::vector<data::Meshlet> meshlets;
+    std::vector<uint32_t>      vertices;   // mesh vertex index of every meshlet vertex
+    std::vector<uint8_t>       triangles;  // 3 meshlet vertex indices per triangle
+  };
+
+  struct MeshletInput
+  {
+    std::span<const glm::vec3> positions;
+    std::span<const uint32_t>  indices;  // triangle list into positions
+  };
+
+  namespace detail
+  {
+    // Bounding sphere around the AABB center and the normal cone of the meshlet's triangles
+    inline void computeMeshletBounds( data::Meshlet & meshlet, MeshletMesh const & mesh, std::span<const glm::vec3> positions )
+    {
+      auto vertex = [&]( uint32_t local ) { return positions[mesh.vertices[meshlet.vertexOffset + local]]; };
+
+      glm::vec3 low( std::numeric_limits<float>::max() ), high( std::numeric_limits<float>::lowest() );
+      for ( uint32_t i = 0; i < meshlet.vertexCount; ++i )
+      {
+        low  = glm::min( low, vertex( i ) );
+        high = glm::max( high, vertex( i ) );
+      }
+      meshlet.center = ( low + high ) * 0.5f;
+      meshlet.radius = 0.0f;
+      for ( uint32_t i = 0; i < meshlet.vertexCount; ++i )
+        meshlet.radius = std::max( meshlet.radius, glm::length( vertex( i ) - meshlet.center ) );
+
+      std::array<glm::vec3, MeshletMaxTriangles> normals;
+      uint32_t                                    normalCount = 0;
+      glm::vec3                                   sum( 0.0f );
+      for ( uint32_t t = 0; t < meshlet.triangleCount; ++t )
+      {
+        uint8_t const * corner = &mesh.triangles[( meshlet.triangleOffset + t ) * 3];
+        glm::vec3       normal = glm::cross( vertex( corner[1] ) - vertex( corner[0] ), vertex( corner[2] ) - vertex( corner[0] ) );
+        float           length = glm::length( normal );
+        if ( length <= 0.0f )
+          continue;
+        normals[normalCount++] = normal / length;
+        sum += normal / length;
+      }
+
+      // Never culled unless every normal is within ~84 degrees of the axis, like meshoptimizer's cluster bounds
+      meshlet.coneAxis   = glm::vec3( 0.0f );
+      meshlet.coneCutoff = 1.0f;
+      float sumLength    = glm::length( sum );
+      if ( normalCount == 0 || sumLength <= 0.0f )
+        return;
+
+      glm::vec3 axis    = sum / sumLength;
+      float     minimum = 1.0f;
+      for ( uint32_t i = 0; i < normalCount; ++i )
+        minimum = std::min( minimum, glm::dot( axis, normals[i] ) );
+      if ( minimum <= 0.1f )
+        return;
+
+      meshlet.coneAxis   = axis;
+      meshlet.coneCutoff = std::sqrt( 1.0f - minimum * minimum );
+    }
+  }  // namespace detail
+
+  // Greedy meshlet growth: a meshlet starts at a seed triangle and keeps taking the candidate triangle (one
+  // sharing a vertex with it) that adds the fewest new vertices, ties broken by the distance of its centroid to
+  // the meshlet's centroid. It ends when no candidate fits the limits any more. The next seed is a leftover
+  // candidate of the previous meshlet, so consecutive meshlets stay neighbours, or the first unused triangle.
+  // Triangle winding is preserved.
+  [[nodiscard]] inline MeshletMesh buildMeshlets( std::span<const glm::vec3> positions, std::span<const uint32_t> indices )
+  {
+    constexpr uint8_t  NoLocal = 0xFF;
+    constexpr uint32_t None    = std::numeric_limits<uint32_t>::max();
+
+    uint32_t triangleCount = static_cast<uint32_t>( indices.size() / 3 );
+    uint32_t vertexCount   = static_cast<uint32_t>( positions.size() );
+
+    // Triangles around every vertex
+    std::vector<uint32_t> adjacencyOffsets( vertexCount + 1, 0 );
+    std::vector<uint32_t> adjacency( triangleCount * 3 );
+    for ( uint32_t i = 0; i < triangleCount * 3; ++i )
+      adjacencyOffsets[indices[i] + 1]++;
+    for ( uint32_t v = 0; v < vertexCount; ++v )
+      adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    {
+      std::vector<uint32_t> cursor( adjacencyOffsets.begin(), adjacencyOffsets.end() - 1 );
+      for ( uint32_t i = 0; i < triangleCount * 3; ++i )
+        adjacency[cursor[indices[i]]++] = i / 3;
+    }
+
+    std::vector<glm::vec3> centroids( triangleCount );
+    for ( uint32_t t = 0; t < triangleCount; ++t )
+      centroids[t] = ( positions[indices[t * 3]] + positions[indices[t * 3 + 1]] + positions[indices[t * 3 + 2]] ) / 3.0f;
+
+    std::vector<uint8_t>  used( triangleCount, 0 );
+    std::vector<uint8_t>  local( vertexCount, NoLocal );  // meshlet vertex index of the meshlet being built
+    std::vector<uint32_t> queued( triangleCount, None );  // meshlet that already has the triangle as candidate
+    std::vector<uint32_t> candidates;
+
+    MeshletMesh mesh;
+    mesh.meshlets.reserve( triangleCount / MeshletMaxTriangles + 1 );
+    mesh.vertices.reserve( triangleCount );
+    mesh.triangles.reserve( indices.size() );
+
+    uint32_t remaining = triangleCount;
+    uint32_t nextSeed  = 0;
+    while ( remaining > 0 )
+    {
+      uint32_t      id = static_cast<uint32_t>( mesh.meshlets.size() );
+      data::Meshlet meshlet{};
+      meshlet.vertexOffset   = static_cast<uint32_t>( mesh.vertices.size() );
+      meshlet.triangleOffset = static_cast<uint32_t>( mesh.triangles.size() / 3 );
+      glm::vec3 centroidSum( 0.0f );
+
+      auto newVertices = [&]( uint32_t t )
+      {
+        uint32_t count = 0;
+        for ( uint32_t k = 0; k < 3; ++k )
+          count += local[indices[t * 3 + k]] == NoLocal ? 1 : 0;
+        return count;
+      };
+
+      auto add = [&]( uint32_t t )
+      {
+        used[t] = 1;
+        --remaining;
+        for ( uint32_t k = 0; k < 3; ++k )
+        {
+          uint32_t v = indices[t * 3 + k];
+          if ( local[v] == NoLocal )
+          {
+            local[v] = static_cast<uint8_t>( meshlet.vertexCount++ );
+            mesh.vertices.push_back( v );
+            for ( uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; ++a )
+            {
+              uint32_t neighbour = adjacency[a];
+              if ( !used[neighbour] && queued[neighbour] != id )
+              {
+                queued[neighbour] = id;
+                candidates.push_back( neighbour );
+              }
+            }
+          }
+          mesh.triangles.push_back( local[v] );
+        }
+        meshlet.triangleCount++;
+        centroidSum += centroids[t];
+      };
+
+      // Seed next to the previous meshlet when one of its candidates is left
+      uint32_t seed = None;
+      for ( uint32_t t : candidates )
+        if ( !used[t] )
+        {
+          seed = t;
+          break;
+        }
+      if ( seed == None )
+      {
+        while ( used[nextSeed] )
+          ++nextSeed;
+        seed = nextSeed;
+      }
+      candidates.clear();
+      add( seed );
+
+      while ( meshlet.triangleCount < MeshletMaxTriangles )
+      {
+        glm::vec3 center    = centroidSum / float( meshlet.triangleCount );
+        uint32_t  best      = None;
+        uint32_t  bestNew   = 4;
+        float     bestScore = std::numeric_limits<float>::max();
+
+        // Drops used candidates while scanning
+        size_t kept = 0;
+        for ( size_t i = 0; i < candidates.size(); ++i )
+        {
+          uint32_t t = candidates[i];
+          if ( used[t] )
+            continue;
+          candidates[kept++] = t;
+
+          uint32_t added = newVertices( t );
+          if ( meshlet.vertexCount + added > MeshletMaxVertices )
+            continue;
+
+          glm::vec3 offset = centroids[t] - center;
+          float     score  = glm::dot( offset, offset );
+          if ( added < bestNew || ( added == bestNew && score < bestScore ) )
+          {
+            best      = t;
+            bestNew   = added;
+            bestScore = score;
+          }
+        }
+        candidates.resize( kept );
+
+        if ( best == None )
+          break;
+        add( best );
+      }
+
+      for ( uint32_t i = 0; i < meshlet.vertexCount; ++i )
+        local[mesh.vertices[meshlet.vertexOffset + i]] = NoLocal;
+
+      mesh.meshlets.push_back( meshlet );
+      detail::computeMeshletBounds( mesh.meshlets.back(), mesh, positions );
+    }
+
+    return mesh;
+  }
+
+  // One mesh per task, `threads` 0 uses every hardware thread
+  [[nodiscard]] inline std::vector<MeshletMesh> buildMeshlets( std::span<const MeshletInput> meshes, uint32_t threads = 0 )
+  {
+    std::vector<MeshletMesh> result( meshes.size() );
+    parallelFor( meshes.size(), threads, [&]( size_t i ) { result[i] = buildMeshlets( meshes[i].positions, meshes[i].indices ); } );
+    return result;
+  }
+
+  // Appends `from` to `into`, offsets are rebased
+  inline void appendMeshlets( MeshletMesh & into, MeshletMesh const & from )
+  {
+    uint32_t vertexBase   = static_cast<uint32_t>( into.vertices.size() );
+    uint32_t triangleBase = static_cast<uint32_t>( into.triangles.size() / 3 );
+    for ( data::Meshlet meshlet : from.meshlets )
+    {
+      meshlet.vertexOffset += vertexBase;
+      meshlet.triangleOffset += triangleBase;
+      into.meshlets.push_back( meshlet );
+    }
+    into.vertices.insert( into.vertices.end(), from.vertices.begin(), from.vertices.end() );
+    into.triangles.insert( into.triangles.end(), from.triangles.begin(), from.triangles.end() );
+  }
+
+  // GPU layout of core::Model::meshlets: the meshlets, then the vertex indices, then one uint per triangle
+  // (a | b << 8 | c << 16). Offsets of every meshlet become uint offsets into the same buffer.
+  [[nodiscard]] inline std::vector<uint32_t> packMeshlets( MeshletMesh const & mesh )
+  {
+    constexpr uint32_t MeshletWords = sizeof( data::Meshlet ) / sizeof( uint32_t );
+
+    uint32_t vertexBase   = static_cast<uint32_t>( mesh.meshlets.size() ) * MeshletWords;
+    uint32_t triangleBase = vertexBase + static_cast<uint32_t>( mesh.vertices.size() );
+
+    std::vector<uint32_t> words( triangleBase + mesh.triangles.size() / 3 );
+    for ( size_t i = 0; i < mesh.meshlets.size(); ++i )
+    {
+      data::Meshlet meshlet = mesh.meshlets[i];
+      meshlet.vertexOffset += vertexBase;
+      meshlet.triangleOffset += triangleBase;
+      std::memcpy( &words[i * MeshletWords], &meshlet, sizeof( meshlet ) );
+    }
+    std::copy( mesh.vertices.begin(), mesh.vertices.end(), words.begin() + vertexBase );
+    for ( size_t t = 0; t < mesh.triangles.size() / 3; ++t )
+      words[triangleBase + t] = uint32_t( mesh.triangles[t * 3] ) | uint32_t( mesh.triangles[t * 3 + 1] ) << 8 | uint32_t( mesh.triangles[t * 3 + 2] ) << 16;
+
+    return words;
+  }
+
+  // CPU check of a build against its input: limits, local indices in range, every input triangle exactly once
+  // with its winding, every vertex inside its meshlet's sphere. Returns what failed first, empty when valid.
+  [[nodiscard]] inline std::string validateMeshlets( MeshletMesh const & mesh, std::span<const glm::vec3> positions, std::span<const uint32_t> indices )
+  {
+    // Rotated so the smallest index comes first, keeps the winding comparable
+    auto canonical = []( uint32_t a, uint32_t b, uint32_t c )
+    {
+      if ( b < a && b < c )
+        return std::array<uint32_t, 3>{ b, c, a };
+      if ( c < a && c < b )
+        return std::array<uint32_t, 3>{ c, a, b };
+      return std::array<uint32_t, 3>{ a, b, c };
+    };
+
+    std::vector<std::array<uint32_t, 3>> expected, built;
+    for ( size_t i = 0; i + 2 < indices.size(); i += 3 )
+      expected.push_back( canonical( indices[i], indices[i + 1], indices[i + 2] ) );
+
+    for ( size_t m = 0; m < mesh.meshlets.size(); ++m )
+    {
+      data::Meshlet const & meshlet = mesh.meshlets[m];
+      if ( meshlet.vertexCount > MeshletMaxVertices || meshlet.triangleCount > MeshletMaxTriangles || meshlet.triangleCount == 0 )
+        return "meshlet " + std::to_string( m ) + " exceeds the limits";
+      if ( meshlet.vertexOffset + meshlet.vertexCount > mesh.vertices.size() || ( meshlet.triangleOffset + meshlet.triangleCount ) * 3 > mesh.triangles.size() )
+        return "meshlet " + std::to_string( m ) + " points past the arrays";
+
+      for ( uint32_t i = 0; i < meshlet.vertexCount; ++i )
+        if ( glm::length( positions[mesh.vertices[meshlet.vertexOffset + i]] - meshlet.center ) > meshlet.radius * 1.0001f + 1e-6f )
+          return "meshlet " + std::to_string( m ) + " sphere misses a vertex";
+
+      for ( uint32_t t = 0; t < meshlet.triangleCount; ++t )
+      {
+        std::array<uint32_t, 3> corners;
+        for ( uint32_t k = 0; k < 3; ++k )
+        {
+          uint8_t index = mesh.triangles[( meshlet.triangleOffset + t ) * 3 + k];
+          if ( index >= meshlet.vertexCount )
+            return "meshlet " + std::to_string( m ) + " has a local index out of range";
+          corners[k] = mesh.vertices[meshlet.vertexOffset + index];
+        }
+        built.push_back( canonical( corners[0], corners[1], corners[2] ) );
+      }
+    }
+
+    std::sort( expected.begin(), expected.end() );
+    std::sort( built.begin(), built.end() );
+    if ( expected != built )
+      return "triangles differ from the input";
+    return {};
+  }
+
+  // FNV-1a over the inputs and the limits, identifies the source of a meshlet cache
+  [[nodiscard]] inline uint64_t meshletSourceHash( std::span<const MeshletInput> meshes )
+  {
+    uint64_t hash = 14695981039346656037ull;
+    auto     mix  = [&]( void const * data, size_t size )
+    {
+      auto const * bytes = static_cast<uint8_t const *>( data );
+      for ( size_t i = 0; i < size; ++i )
+        hash = ( hash ^ bytes[i] ) * 1099511628211ull;
+    };
+
+    std::array<uint32_t, 3> header = { MeshletMaxVertices, MeshletMaxTriangles, static_cast<uint32_t>( sizeof( data::Meshlet ) ) };
+    mix( header.data(), sizeof( header ) );
+    for ( auto const & mesh : meshes )
+    {
+      mix( mesh.positions.data(), mesh.positions.size_bytes() );
+      mix( mesh.indices.data(), mesh.indices.size_bytes() );
+    }
+    return hash;
+  }
+
+  // Cache file: uint32 magic, uint32 version, uint64 source hash, uint32 mesh count, then per mesh the meshlet,
+  // vertex and triangle counts followed by the three arrays as stored in MeshletMesh
+  inline constexpr uint32_t MeshletCacheMagic   = 0x4C48534D;  // "MSHL"
+  inline constexpr uint32_t MeshletCacheVersion = 1;
+
+  inline void saveMeshletCache( std::filesystem::path const & path, uint64_t sourceHash, std::span<const MeshletMesh> meshes )
+  {
+    if ( path.has_parent_path() )
+      std::filesystem::create_directories( path.parent_path() );
+
+    std::ofstream file( path, std::ios::binary | std::ios::trunc );
+    if ( !file )
+      throw std::runtime_error( "Failed to write meshlet cache: " + path.string() );
+
+    auto write = [&]( void const * data, size_t size ) { file.write( static_cast<char const *>( data ), static_cast<std::streamsize>( size ) ); };
+
+    uint32_t meshCount = static_cast<uint32_t>( meshes.size() );
+    write( &MeshletCacheMagic, sizeof( uint32_t ) );
+    write( &MeshletCacheVersion, sizeof( uint32_t ) );
+    write( &sourceHash, sizeof( sourceHash ) );
+    write( &meshCount, sizeof( meshCount ) );
+    for ( auto const & mesh : meshes )
+    {
+      std::array<uint32_t, 3> counts = { static_cast<uint32_t>( mesh.meshlets.size() ),
+                                         static_cast<uint32_t>( mesh.vertices.size() ),
+                                         static_cast<uint32_t>( mesh.triangles.size() / 3 ) };
+      write( counts.data(), sizeof( counts ) );
+      write( mesh.meshlets.data(), mesh.meshlets.size() * sizeof( data::Meshlet ) );
+      write( mesh.vertices.data(), mesh.vertices.size() * sizeof( uint32_t ) );
+      write( mesh.triangles.data(), mesh.triangles.size() );
+    }
+  }
+
+  // Empty when the file is missing, truncated or was built from other inputs
+  [[nodiscard]] inline std::optional<std::vector<MeshletMesh>> loadMeshletCache( std::filesystem::path const & path, uint64_t sourceHash )
+  {
+    std::ifstream file( path, std::ios::binary );
+    if ( !file )
+      return std::nullopt;
+
+    auto read = [&]( void * data, size_t size ) { return static_cast<bool>( file.read( static_cast<char *>( data ), static_cast<std::streamsize>( size ) ) ); };
+
+    uint32_t magic = 0, version = 0, meshCount = 0;
+    uint64_t hash  = 0;
+    if ( !read( &magic, sizeof( magic ) ) || !read( &version, sizeof( version ) ) || !read( &hash, sizeof( hash ) ) ||
+         !read( &meshCount, sizeof( meshCount ) ) )
+      return std::nullopt;
+    if ( magic != MeshletCacheMagic || version != MeshletCacheVersion || hash != sourceHash )
+      return std::nullopt;
+
+    std::vector<MeshletMesh> meshes( meshCount );
+    for ( auto & mesh : meshes )
+    {
+      std::array<uint32_t, 3> counts{};
+      if ( !read( counts.data(), sizeof( counts ) ) )
+        return std::nullopt;
+      mesh.meshlets.resize( counts[0] );
+      mesh.vertices.resize( counts[1] );
+      mesh.triangles.resize( size_t( counts[2] ) * 3 );
+      if ( !read( mesh.meshlets.data(), mesh.meshlets.size() * sizeof( data::Meshlet ) ) ||
+           !read( mesh.vertices.data(), mesh.vertices.size() * sizeof( uint32_t ) ) || !read( mesh.triangles.data(), mesh.triangles.size() ) )
+        return std::nullopt;
+    }
+    return meshes;
+  }
+
+  // Meshlets of `meshes` from the cache at `path` when it matches the inputs, built and cached otherwise
+  [[nodiscard]] inline std::vector<MeshletMesh> loadOrBuildMeshlets( std::filesystem::path const & path, std::span<const MeshletInput> meshes )
+  {
+    uint64_t hash = meshletSourceHash( meshes );
+    if ( auto cached = loadMeshletCache( path, hash ) )
+      return std::move( *cached );
+
+    std::vector<MeshletMesh> built = buildMeshlets( meshes );
+    saveMeshletCache( path, hash, built );
+    return built;
+  }
+}  // namespace core
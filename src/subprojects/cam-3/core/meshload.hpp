@@ -0,0 +1,1121 @@
+#pragma once
+#include "../data.hpp"
+#include "../helper.hpp"
+#include "../setup.hpp"
+#include "cooked.hpp"
+#include "mappedfile.hpp"
+#include "material.hpp"
+#include "meshlets.hpp"
+#include "meshopt.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <print>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <nlohmann/json.hpp>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Triangle mesh on the CPU between parsing and upload
+  struct MeshGeometry
+  {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> colors;
+    std::vector<uint32_t>  indices;
+  };
+
+  // Where the time of one load went, the stages run one after the other and each one uses every worker
+  struct MeshLoadStats
+  {
+    std::string path;
+    uint32_t    threads   = 0;
+    uint64_t    fileBytes = 0;
+    uint32_t    vertices  = 0;
+    uint32_t    triangles = 0;
+    uint32_t    meshlets  = 0;
+    double      parseMs    = 0.0;  // mapping and parsing
+    double      convertMs  = 0.0;  // index resolution, transforms, shading, normalization
+    double      optimizeMs = 0.0;  // index and vertex reordering, 0 when not optimized
+    double      meshletMs  = 0.0;
+    double      stagingMs  = 0.0;  // buffer creation and staging writes
+    double      cpuMs      = 0.0;  // all of the above
+    double      uploadMs   = 0.0;  // from the future being ready to the copy's fence, 0 when not uploaded
+
+    bool             optimized = false;
+    VertexCacheStats cacheBefore;  // of the file's index order
+    VertexCacheStats cacheAfter;   // of the uploaded order
+
+    // GPU time of the scene pass while this model was drawn, see MeshLoader::recordDrawTime()
+    double   drawMs     = 0.0;  // average
+    uint32_t drawFrames = 0;
+  };
+
+  // CPU side of a load: the model's device local buffers exist but hold nothing until `staging` was copied in
+  struct MeshUpload
+  {
+    Model          model;
+    core::Buffer   staging;  // vertices, then indices, then the packMeshlets() words
+    vk::DeviceSize indexOffset   = 0;
+    vk::DeviceSize meshletOffset = 0;
+    MeshLoadStats  stats;
+  };
+
+  namespace detail
+  {
+    inline double msSince( std::chrono::steady_clock::time_point start )
+    {
+      return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+    }
+
+    // Same lighting as the icosphere levels, for meshes without vertex colors
+    inline glm::vec3 shade( glm::vec3 normal )
+    {
+      return glm::vec3( 0.85f ) * ( 0.6f + 0.4f * normal.y );
+    }
+
+    // Area weighted vertex normals of `indices` (absolute, into positions) turned into colors[v - first]
+    inline void shadeFromFaces( std::span<const glm::vec3> positions, std::span<const uint32_t> indices, uint32_t first, std::span<glm::vec3> colors )
+    {
+      std::vector<glm::vec3> normals( colors.size(), glm::vec3( 0.0f ) );
+      for ( size_t i = 0; i + 2 < indices.size(); i += 3 )
+      {
+        uint32_t  a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        glm::vec3 n = glm::cross( positions[b] - positions[a], positions[c] - positions[a] );
+        normals[a - first] += n;
+        normals[b - first] += n;
+        normals[c - first] += n;
+      }
+      for ( size_t v = 0; v < normals.size(); ++v )
+      {
+        float length = glm::length( normals[v] );
+        colors[v]    = shade( length > 0.0f ? normals[v] / length : glm::vec3( 0.0f, 1.0f, 0.0f ) );
+      }
+    }
+
+    //=========================================================
+    // OBJ
+    //=========================================================
+
+    // Faces and vertices of one line aligned range of the file. Negative (relative) face indices can point
+    // into earlier chunks, so indices are stored relative to the chunk's first vertex with uint32 wrap around
+    // and rebased once every chunk's vertex count is known.
+    struct ObjChunk
+    {
+      std::vector<glm::vec3> positions;
+      std::vector<glm::vec3> colors;
+      std::vector<uint32_t>  indices;
+      std::vector<uint32_t>  absolute;  // entries of `indices` that already are absolute
+      uint32_t               colored = 0;
+    };
+
+    inline bool isBlank( char c )
+    {
+      return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline std::string_view nextToken( std::string_view & line )
+    {
+      size_t begin = 0;
+      while ( begin < line.size() && isBlank( line[begin] ) )
+        ++begin;
+      size_t end = begin;
+      while ( end < line.size() && !isBlank( line[end] ) )
+        ++end;
+      std::string_view token = line.substr( begin, end - begin );
+      line.remove_prefix( end );
+      return token;
+    }
+
+    inline bool parseFloat( std::string_view token, float & value )
+    {
+      return !token.empty() && std::from_chars( token.data(), token.data() + token.size(), value ).ec == std::errc{};
+    }
+
+    // v x y z [r g b] and f with any number of corners (fan triangulated), texture coordinates, normals and
+    // everything else are skipped
+    inline void parseObjChunk( std::string_view text, ObjChunk & chunk )
+    {
+      std::vector<std::pair<uint32_t, bool>> corners;
+
+      while ( !text.empty() )
+      {
+        size_t           newline = text.find( '\n' );
+        std::string_view line    = text.substr( 0, newline );
+        text.remove_prefix( newline == std::string_view::npos ? text.size() : newline + 1 );
+
+        std::string_view keyword = nextToken( line );
+        if ( keyword == "v" )
+        {
+          glm::vec3 p, c;
+          if ( !parseFloat( nextToken( line ), p.x ) || !parseFloat( nextToken( line ), p.y ) || !parseFloat( nextToken( line ), p.z ) )
+            throw std::runtime_error( "OBJ: malformed vertex" );
+          bool colored = parseFloat( nextToken( line ), c.r ) && parseFloat( nextToken( line ), c.g ) && parseFloat( nextToken( line ), c.b );
+          chunk.positions.push_back( p );
+          chunk.colors.push_back( colored ? c : glm::vec3( 1.0f ) );
+          chunk.colored += colored ? 1 : 0;
+        }
+        else if ( keyword == "f" )
+        {
+          corners.clear();
+          for ( std::string_view token = nextToken( line ); !token.empty(); token = nextToken( line ) )
+          {
+            int64_t index = 0;
+            if ( std::from_chars( token.data(), token.data() + token.size(), index ).ec != std::errc{} || index == 0 )
+              throw std::runtime_error( "OBJ: malformed face" );
+            if ( index > 0 )
+              corners.emplace_back( static_cast<uint32_t>( index - 1 ), true );
+            else
+              corners.emplace_back( static_cast<uint32_t>( int64_t( chunk.positions.size() ) + index ), false );
+          }
+          for ( size_t k = 2; k < corners.size(); ++k )
+            for ( auto const & [index, absolute] : { corners[0], corners[k - 1], corners[k] } )
+            {
+              if ( absolute )
+                chunk.absolute.push_back( static_cast<uint32_t>( chunk.indices.size() ) );
+              chunk.indices.push_back( index );
+            }
+        }
+      }
+    }
+
+    inline MeshGeometry loadObj( std::string_view text, uint32_t threads, MeshLoadStats & stats )
+    {
+      auto start = std::chrono::steady_clock::now();
+
+      // Line aligned chunks, a few per worker so uneven ones balance out
+      size_t                chunkCount = std::max<size_t>( 1, std::min<size_t>( size_t( threads ) * 4, text.size() / ( 64 * 1024 ) + 1 ) );
+      std::vector<size_t>   bounds     = { 0 };
+      std::vector<ObjChunk> chunks;
+      for ( size_t i = 1; i < chunkCount; ++i )
+      {
+        size_t split = text.find( '\n', std::max( bounds.back(), text.size() * i / chunkCount ) );
+        if ( split == std::string_view::npos )
+          break;
+        bounds.push_back( split + 1 );
+      }
+      bounds.push_back( text.size() );
+      chunks.resize( bounds.size() - 1 );
+
+      parallelFor( chunks.size(), threads, [&]( size_t i ) { parseObjChunk( text.substr( bounds[i], bounds[i + 1] - bounds[i] ), chunks[i] ); } );
+      stats.parseMs = msSince( start );
+      start         = std::chrono::steady_clock::now();
+
+      std::vector<uint32_t> vertexBase( chunks.size() + 1, 0 ), indexBase( chunks.size() + 1, 0 );
+      uint64_t              colored = 0;
+      for ( size_t i = 0; i < chunks.size(); ++i )
+      {
+        vertexBase[i + 1] = vertexBase[i] + static_cast<uint32_t>( chunks[i].positions.size() );
+        indexBase[i + 1]  = indexBase[i] + static_cast<uint32_t>( chunks[i].indices.size() );
+        colored += chunks[i].colored;
+      }
+
+      MeshGeometry mesh;
+      mesh.positions.resize( vertexBase.back() );
+      mesh.colors.resize( vertexBase.back() );
+      mesh.indices.resize( indexBase.back() );
+
+      parallelFor( chunks.size(),
+                   threads,
+                   [&]( size_t i )
+                   {
+                     ObjChunk & chunk = chunks[i];
+                     std::copy( chunk.positions.begin(), chunk.positions.end(), mesh.positions.begin() + vertexBase[i] );
+                     std::copy( chunk.colors.begin(), chunk.colors.end(), mesh.colors.begin() + vertexBase[i] );
+
+                     for ( uint32_t & index : chunk.indices )
+                       index += vertexBase[i];
+                     for ( uint32_t position : chunk.absolute )
+                       chunk.indices[position] -= vertexBase[i];
+                     for ( uint32_t index : chunk.indices )
+                       if ( index >= vertexBase.back() )
+                         throw std::runtime_error( "OBJ: face index out of range" );
+                     std::copy( chunk.indices.begin(), chunk.indices.end(), mesh.indices.begin() + indexBase[i] );
+                   } );
+
+      // Vertex colors only when every vertex has one
+      if ( colored != mesh.positions.size() )
+        shadeFromFaces( mesh.positions, mesh.indices, 0, mesh.colors );
+
+      stats.convertMs = msSince( start );
+      return mesh;
+    }
+
+    //=========================================================
+    // glTF 2.0
+    //=========================================================
+
+    constexpr uint32_t GltfFloat         = 5126;
+    constexpr uint32_t GltfUnsignedByte  = 5121;
+    constexpr uint32_t GltfUnsignedShort = 5123;
+    constexpr uint32_t GltfUnsignedInt   = 5125;
+
+    struct GltfAccessor
+    {
+      char const * data          = nullptr;
+      size_t       count         = 0;
+      size_t       stride        = 0;
+      uint32_t     componentType = 0;
+      uint32_t     components    = 0;
+
+      [[nodiscard]] glm::vec3 vec3( size_t i ) const
+      {
+        glm::vec3 v;
+        std::memcpy( &v, data + i * stride, sizeof( v ) );
+        return v;
+      }
+
+      // COLOR_0, float or normalized unsigned, alpha ignored
+      [[nodiscard]] glm::vec3 color( size_t i ) const
+      {
+        char const * element = data + i * stride;
+        glm::vec3    c;
+        for ( uint32_t k = 0; k < 3; ++k )
+          if ( componentType == GltfFloat )
+            std::memcpy( &c[k], element + k * 4, 4 );
+          else if ( componentType == GltfUnsignedShort )
+          {
+            uint16_t value;
+            std::memcpy( &value, element + k * 2, 2 );
+            c[k] = float( value ) / 65535.0f;
+          }
+          else
+            c[k] = float( static_cast<uint8_t>( element[k] ) ) / 255.0f;
+        return c;
+      }
+
+      [[nodiscard]] uint32_t index( size_t i ) const
+      {
+        char const * element = data + i * stride;
+        if ( componentType == GltfUnsignedInt )
+        {
+          uint32_t value;
+          std::memcpy( &value, element, 4 );
+          return value;
+        }
+        if ( componentType == GltfUnsignedShort )
+        {
+          uint16_t value;
+          std::memcpy( &value, element, 2 );
+          return value;
+        }
+        return static_cast<uint8_t>( element[0] );
+      }
+    };
+
+    // One primitive of one node, written to [firstVertex, firstVertex + vertexCount) of the combined mesh
+    struct GltfDraw
+    {
+      nlohmann::json const * primitive   = nullptr;
+      glm::mat4              transform   = glm::mat4( 1.0f );
+      uint32_t               firstVertex = 0;
+      uint32_t               firstIndex  = 0;
+      uint32_t               vertexCount = 0;
+      uint32_t               indexCount  = 0;
+    };
+
+    inline glm::mat4 gltfNodeTransform( nlohmann::json const & node )
+    {
+      if ( node.contains( "matrix" ) )
+      {
+        std::array<float, 16> m = node["matrix"].get<std::array<float, 16>>();
+        return glm::make_mat4( m.data() );
+      }
+      std::array<float, 3> t = node.value( "translation", std::array<float, 3>{ 0.0f, 0.0f, 0.0f } );
+      std::array<float, 4> r = node.value( "rotation", std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f } );
+      std::array<float, 3> s = node.value( "scale", std::array<float, 3>{ 1.0f, 1.0f, 1.0f } );
+      return glm::translate( glm::mat4( 1.0f ), glm::vec3( t[0], t[1], t[2] ) ) * glm::mat4_cast( glm::quat( r[3], r[0], r[1], r[2] ) ) *
+             glm::scale( glm::mat4( 1.0f ), glm::vec3( s[0], s[1], s[2] ) );
+    }
+
+    // Triangle primitives of the default scene with their node transforms. Embedded (data:) buffers, sparse
+    // accessors, quantized positions and morph targets are not supported.
+    inline MeshGeometry loadGltf( std::filesystem::path const & path, std::string_view file, uint32_t threads, MeshLoadStats & stats )
+    {
+      auto start = std::chrono::steady_clock::now();
+
+      std::string_view jsonText = file;
+      std::string_view binChunk;
+      if ( file.size() >= 12 && file.substr( 0, 4 ) == "glTF" )
+      {
+        // GLB: 12 byte header, then chunks of uint32 length, uint32 type and the data
+        size_t offset = 12;
+        while ( offset + 8 <= file.size() )
+        {
+          uint32_t length, type;
+          std::memcpy( &length, file.data() + offset, 4 );
+          std::memcpy( &type, file.data() + offset + 4, 4 );
+          if ( offset + 8 + length > file.size() )
+            throw std::runtime_error( "glTF: truncated GLB chunk" );
+          if ( type == 0x4E4F534A )  // JSON
+            jsonText = file.substr( offset + 8, length );
+          else if ( type == 0x004E4942 )  // BIN
+            binChunk = file.substr( offset + 8, length );
+          offset += 8 + ( ( length + 3 ) & ~3u );
+        }
+      }
+
+      nlohmann::json const gltf = nlohmann::json::parse( jsonText.begin(), jsonText.end() );
+
+      std::deque<MappedFile>        externalFiles;
+      std::vector<std::string_view> buffers;
+      for ( auto const & buffer : gltf.value( "buffers", nlohmann::json::array() ) )
+      {
+        if ( !buffer.contains( "uri" ) )
+        {
+          buffers.push_back( binChunk );
+          continue;
+        }
+        std::string uri = buffer["uri"].get<std::string>();
+        if ( uri.starts_with( "data:" ) )
+          throw std::runtime_error( "glTF: embedded buffers are not supported, use .glb or an external .bin" );
+        buffers.push_back( externalFiles.emplace_back( path.parent_path() / uri ).bytes() );
+      }
+
+      auto accessor = [&]( size_t index )
+      {
+        static constexpr std::pair<char const *, uint32_t> Types[] = { { "SCALAR", 1 }, { "VEC2", 2 }, { "VEC3", 3 }, { "VEC4", 4 } };
+
+        nlohmann::json const & json = gltf.at( "accessors" ).at( index );
+        if ( json.contains( "sparse" ) || !json.contains( "bufferView" ) )
+          throw std::runtime_error( "glTF: sparse accessors are not supported" );
+
+        GltfAccessor result;
+        result.count         = json.at( "count" ).get<size_t>();
+        result.componentType = json.at( "componentType" ).get<uint32_t>();
+        for ( auto const & [name, components] : Types )
+          if ( json.at( "type" ).get<std::string>() == name )
+            result.components = components;
+
+        size_t componentSize = result.componentType == GltfFloat || result.componentType == GltfUnsignedInt ? 4
+                             : result.componentType == GltfUnsignedShort                                    ? 2
+                                                                                                             : 1;
+        size_t elementSize   = componentSize * result.components;
+
+        nlohmann::json const & view   = gltf.at( "bufferViews" ).at( json.at( "bufferView" ).get<size_t>() );
+        std::string_view       buffer = buffers.at( view.at( "buffer" ).get<size_t>() );
+        size_t                 offset = view.value( "byteOffset", size_t( 0 ) ) + json.value( "byteOffset", size_t( 0 ) );
+        result.stride                 = view.value( "byteStride", elementSize );
+
+        size_t end = result.count == 0 ? offset : offset + result.stride * ( result.count - 1 ) + elementSize;
+        if ( elementSize == 0 || end > view.value( "byteOffset", size_t( 0 ) ) + view.at( "byteLength" ).get<size_t>() || end > buffer.size() )
+          throw std::runtime_error( "glTF: accessor " + std::to_string( index ) + " is out of bounds" );
+        result.data = buffer.data() + offset;
+        return result;
+      };
+
+      // Draws of the default scene, every mesh once without a transform when there is no scene
+      std::vector<GltfDraw> draws;
+      auto                  addMesh = [&]( size_t mesh, glm::mat4 const & transform )
+      {
+        for ( auto const & primitive : gltf.at( "meshes" ).at( mesh ).at( "primitives" ) )
+          if ( primitive.value( "mode", 4 ) == 4 && primitive.at( "attributes" ).contains( "POSITION" ) )
+            draws.push_back( GltfDraw{ &primitive, transform } );
+      };
+
+      if ( gltf.contains( "scenes" ) && !gltf["scenes"].empty() )
+      {
+        std::vector<std::pair<size_t, glm::mat4>> stack;
+        for ( auto const & node : gltf["scenes"].at( gltf.value( "scene", size_t( 0 ) ) ).value( "nodes", nlohmann::json::array() ) )
+          stack.emplace_back( node.get<size_t>(), glm::mat4( 1.0f ) );
+        while ( !stack.empty() )
+        {
+          auto [index, parent] = stack.back();
+          stack.pop_back();
+          nlohmann::json const & node      = gltf.at( "nodes" ).at( index );
+          glm::mat4              transform = parent * gltfNodeTransform( node );
+          if ( node.contains( "mesh" ) )
+            addMesh( node["mesh"].get<size_t>(), transform );
+          for ( auto const & child : node.value( "children", nlohmann::json::array() ) )
+            stack.emplace_back( child.get<size_t>(), transform );
+        }
+      }
+      else
+        for ( size_t mesh = 0; mesh < gltf.value( "meshes", nlohmann::json::array() ).size(); ++mesh )
+          addMesh( mesh, glm::mat4( 1.0f ) );
+
+      uint32_t vertexCount = 0, indexCount = 0;
+      for ( auto & draw : draws )
+      {
+        draw.firstVertex = vertexCount;
+        draw.firstIndex  = indexCount;
+        draw.vertexCount = static_cast<uint32_t>( accessor( draw.primitive->at( "attributes" ).at( "POSITION" ).get<size_t>() ).count );
+        draw.indexCount  = draw.primitive->contains( "indices" ) ? static_cast<uint32_t>( accessor( draw.primitive->at( "indices" ).get<size_t>() ).count )
+                                                                 : draw.vertexCount;
+        draw.indexCount -= draw.indexCount % 3;
+        vertexCount += draw.vertexCount;
+        indexCount += draw.indexCount;
+      }
+
+      stats.parseMs = msSince( start );
+      start         = std::chrono::steady_clock::now();
+
+      MeshGeometry mesh;
+      mesh.positions.resize( vertexCount );
+      mesh.colors.resize( vertexCount );
+      mesh.indices.resize( indexCount );
+
+      parallelFor( draws.size(),
+                   threads,
+                   [&]( size_t d )
+                   {
+                     GltfDraw const &       draw       = draws[d];
+                     nlohmann::json const & attributes = draw.primitive->at( "attributes" );
+                     GltfAccessor           positions  = accessor( attributes.at( "POSITION" ).get<size_t>() );
+                     if ( positions.componentType != GltfFloat || positions.components != 3 )
+                       throw std::runtime_error( "glTF: POSITION has to be float VEC3" );
+
+                     for ( uint32_t v = 0; v < draw.vertexCount; ++v )
+                       mesh.positions[draw.firstVertex + v] = glm::vec3( draw.transform * glm::vec4( positions.vec3( v ), 1.0f ) );
+
+                     // Mirroring transforms flip the winding back
+                     bool       mirrored = glm::determinant( glm::mat3( draw.transform ) ) < 0.0f;
+                     uint32_t * indices  = mesh.indices.data() + draw.firstIndex;
+                     if ( draw.primitive->contains( "indices" ) )
+                     {
+                       GltfAccessor source = accessor( draw.primitive->at( "indices" ).get<size_t>() );
+                       for ( uint32_t i = 0; i < draw.indexCount; ++i )
+                       {
+                         uint32_t index = source.index( i );
+                         if ( index >= draw.vertexCount )
+                           throw std::runtime_error( "glTF: index out of range" );
+                         indices[i] = draw.firstVertex + index;
+                       }
+                     }
+                     else
+                       for ( uint32_t i = 0; i < draw.indexCount; ++i )
+                         indices[i] = draw.firstVertex + i;
+                     if ( mirrored )
+                       for ( uint32_t i = 0; i < draw.indexCount; i += 3 )
+                         std::swap( indices[i + 1], indices[i + 2] );
+
+                     std::span<glm::vec3> colors( mesh.colors.data() + draw.firstVertex, draw.vertexCount );
+                     if ( attributes.contains( "COLOR_0" ) )
+                     {
+                       GltfAccessor source = accessor( attributes["COLOR_0"].get<size_t>() );
+                       for ( uint32_t v = 0; v < draw.vertexCount; ++v )
+                         colors[v] = source.color( v );
+                     }
+                     else if ( attributes.contains( "NORMAL" ) )
+                     {
+                       GltfAccessor source = accessor( attributes["NORMAL"].get<size_t>() );
+                       glm::mat3    normal = glm::transpose( glm::inverse( glm::mat3( draw.transform ) ) );
+                       for ( uint32_t v = 0; v < draw.vertexCount; ++v )
+                       {
+                         glm::vec3 n = normal * source.vec3( v );
+                         colors[v]   = shade( glm::length( n ) > 0.0f ? glm::normalize( n ) : glm::vec3( 0.0f, 1.0f, 0.0f ) );
+                       }
+                     }
+                     else
+                       shadeFromFaces( mesh.positions, std::span<const uint32_t>( indices, draw.indexCount ), draw.firstVertex, colors );
+                   } );
+
+      stats.convertMs = msSince( start );
+      return mesh;
+    }
+
+    // Centers the mesh on the origin and scales it to a bounding sphere of `radius`, so it drops into the
+    // instance layouts made for the icosphere
+    inline void normalizeMesh( MeshGeometry & mesh, float radius, uint32_t threads )
+    {
+      constexpr size_t Range  = 1 << 16;
+      size_t           ranges = ( mesh.positions.size() + Range - 1 ) / Range;
+
+      std::vector<glm::vec3> lows( ranges, glm::vec3( std::numeric_limits<float>::max() ) ), highs( ranges, glm::vec3( std::numeric_limits<float>::lowest() ) );
+      parallelFor( ranges,
+                   threads,
+                   [&]( size_t r )
+                   {
+                     for ( size_t v = r * Range; v < std::min( mesh.positions.size(), ( r + 1 ) * Range ); ++v )
+                     {
+                       lows[r]  = glm::min( lows[r], mesh.positions[v] );
+                       highs[r] = glm::max( highs[r], mesh.positions[v] );
+                     }
+                   } );
+      glm::vec3 low( std::numeric_limits<float>::max() ), high( std::numeric_limits<float>::lowest() );
+      for ( size_t r = 0; r < ranges; ++r )
+      {
+        low  = glm::min( low, lows[r] );
+        high = glm::max( high, highs[r] );
+      }
+      glm::vec3 center = ( low + high ) * 0.5f;
+
+      std::vector<float> extents( ranges, 0.0f );
+      parallelFor( ranges,
+                   threads,
+                   [&]( size_t r )
+                   {
+                     for ( size_t v = r * Range; v < std::min( mesh.positions.size(), ( r + 1 ) * Range ); ++v )
+                       extents[r] = std::max( extents[r], glm::length( mesh.positions[v] - center ) );
+                   } );
+      float extent = *std::max_element( extents.begin(), extents.end() );
+      float scale  = extent > 0.0f ? radius / extent : 1.0f;
+
+      parallelFor( ranges,
+                   threads,
+                   [&]( size_t r )
+                   {
+                     for ( size_t v = r * Range; v < std::min( mesh.positions.size(), ( r + 1 ) * Range ); ++v )
+                       mesh.positions[v] = ( mesh.positions[v] - center ) * scale;
+                   } );
+    }
+  }  // namespace detail
+
+  // Source file after every CPU stage, what loadMeshFile() uploads and cookMeshFile() writes out
+  struct PreparedMesh
+  {
+    MeshGeometry          mesh;
+    std::vector<uint32_t> meshletWords;  // packMeshlets() layout
+    uint32_t              meshletCount = 0;
+  };
+
+  // Maps, parses and converts an .obj, .gltf or .glb file on `threads` workers (0 for every hardware thread),
+  // normalizes it to `radius`, optionally optimizes its index order and builds its meshlets
+  [[nodiscard]] inline PreparedMesh
+    prepareMeshFile( std::filesystem::path const & path, uint32_t threads, bool optimize, float radius, MeshLoadStats & stats )
+  {
+    stats.path    = path.string();
+    stats.threads = workerCount( threads );
+    threads       = stats.threads;
+
+    PreparedMesh   prepared;
+    MeshGeometry & mesh = prepared.mesh;
+    {
+      MappedFile  file( path );
+      std::string extension = path.extension().string();
+      std::transform( extension.begin(), extension.end(), extension.begin(), []( char c ) { return static_cast<char>( std::tolower( c ) ); } );
+
+      stats.fileBytes = file.bytes().size();
+      if ( extension == ".obj" )
+        mesh = detail::loadObj( file.bytes(), threads, stats );
+      else if ( extension == ".gltf" || extension == ".glb" )
+        mesh = detail::loadGltf( path, file.bytes(), threads, stats );
+      else
+        throw std::runtime_error( "Unsupported mesh format: " + extension );
+    }
+    if ( mesh.indices.size() < 3 )
+      throw std::runtime_error( "No triangles in " + path.string() );
+
+    auto start = std::chrono::steady_clock::now();
+    detail::normalizeMesh( mesh, radius, threads );
+    stats.convertMs += detail::msSince( start );
+
+    // Cache order first, then the cluster order for overdraw, then the vertices in the order they are used
+    stats.cacheBefore = analyzeVertexCache( mesh.indices, static_cast<uint32_t>( mesh.positions.size() ) );
+    stats.cacheAfter  = stats.cacheBefore;
+    stats.optimized   = optimize;
+    if ( optimize )
+    {
+      start        = std::chrono::steady_clock::now();
+      mesh.indices = optimizeVertexCache( mesh.indices, static_cast<uint32_t>( mesh.positions.size() ) );
+      mesh.indices = optimizeOverdraw( mesh.indices, mesh.positions );
+
+      uint32_t              remapped = 0;
+      std::vector<uint32_t> remap    = vertexFetchRemap( mesh.indices, static_cast<uint32_t>( mesh.positions.size() ), remapped );
+      remapIndices( mesh.indices, remap );
+      remapVertices( mesh.positions, remap, remapped );
+      remapVertices( mesh.colors, remap, remapped );
+
+      stats.cacheAfter = analyzeVertexCache( mesh.indices, remapped );
+      stats.optimizeMs = detail::msSince( start );
+    }
+
+    // One index range per worker, meshlets do not cross ranges
+    start                  = std::chrono::steady_clock::now();
+    uint32_t triangleCount = static_cast<uint32_t>( mesh.indices.size() / 3 );
+    uint32_t ranges        = std::min( threads, std::max( 1u, triangleCount / 4096 ) );
+
+    std::vector<MeshletInput> inputs;
+    for ( uint32_t r = 0; r < ranges; ++r )
+    {
+      size_t first = size_t( triangleCount ) * r / ranges * 3, end = size_t( triangleCount ) * ( r + 1 ) / ranges * 3;
+      inputs.push_back( MeshletInput{ mesh.positions, std::span<const uint32_t>( mesh.indices ).subspan( first, end - first ) } );
+    }
+    MeshletMesh meshlets;
+    for ( auto const & part : buildMeshlets( inputs, threads ) )
+      appendMeshlets( meshlets, part );
+    prepared.meshletWords = packMeshlets( meshlets );
+    prepared.meshletCount = static_cast<uint32_t>( meshlets.meshlets.size() );
+    stats.meshletMs       = detail::msSince( start );
+
+    stats.vertices  = static_cast<uint32_t>( mesh.positions.size() );
+    stats.triangles = triangleCount;
+    stats.meshlets  = prepared.meshletCount;
+    return prepared;
+  }
+
+  // Loads a .cmesh file written by cookMeshFile(): mapped and validated, then copied to the staging buffer as a
+  // whole. parseMs is the mapping and validation, stagingMs the buffer creation and the copy.
+  [[nodiscard]] inline MeshUpload loadCookedMesh( std::filesystem::path const & path, VmaAllocator allocator )
+  {
+    auto begin = std::chrono::steady_clock::now();
+
+    MeshUpload upload;
+    upload.stats.path    = path.string();
+    upload.stats.threads = 1;
+
+    CookedFile           cooked( path );
+    CookedHeader const & header = cooked.header;
+    upload.stats.fileBytes      = header.fileBytes;
+    upload.stats.optimized      = ( header.flags & CookedOptimized ) != 0;
+    upload.stats.parseMs        = detail::msSince( begin );
+
+    auto             start = std::chrono::steady_clock::now();
+    std::string_view blobs = cooked.blobs();
+    upload.indexOffset     = header.indexOffset - header.vertexOffset;
+    upload.meshletOffset   = header.meshletOffset - header.vertexOffset;
+
+    upload.staging = core::createBuffer( allocator,
+                                         blobs.size(),
+                                         vk::BufferUsageFlagBits::eTransferSrc,
+                                         VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT );
+    std::memcpy( upload.staging.allocationInfo.pMappedData, blobs.data(), blobs.size() );
+    vmaFlushAllocation( allocator, upload.staging.allocation, 0, VK_WHOLE_SIZE );
+
+    // Source as well, see loadMeshFile()
+    constexpr vk::BufferUsageFlags transfer = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+    constexpr vk::BufferUsageFlags storage  = vk::BufferUsageFlagBits::eStorageBuffer;
+
+    // The vertex and index buffers take the alignment gaps as well, MeshLoader copies blob to blob
+    Model & model      = upload.model;
+    model.vertices     = core::createBuffer( allocator, upload.indexOffset, vk::BufferUsageFlagBits::eVertexBuffer | storage | transfer );
+    model.indices      = core::createBuffer( allocator, upload.meshletOffset - upload.indexOffset, vk::BufferUsageFlagBits::eIndexBuffer | transfer );
+    model.meshlets     = core::createBuffer( allocator, uint64_t( header.meshletWords ) * sizeof( uint32_t ), storage | transfer );
+    model.radius       = header.radius;
+    model.vertexFormat = VertexFormat::Quantized;
+    for ( uint32_t lod = 0; lod < header.lodCount; ++lod )
+    {
+      CookedLod const & l = header.lods[lod];
+      model.lods.push_back( ModelLod{ l.firstIndex, l.indexCount, l.minScreenSize, l.firstMeshlet, l.meshletCount } );
+    }
+    upload.stats.stagingMs = detail::msSince( start );
+
+    upload.stats.vertices  = header.vertexCount;
+    upload.stats.triangles = header.indexCount / 3;
+    upload.stats.meshlets  = header.meshletCount;
+    upload.stats.cpuMs     = detail::msSince( begin );
+    return upload;
+  }
+
+  // Loads an .obj, .gltf or .glb file into a single LOD Model through prepareMeshFile(), and writes the result
+  // to a staging buffer next to the model's device local buffers. .cmesh files go to loadCookedMesh() instead.
+  // Thread safe, nothing is submitted; MeshLoader records the copy.
+  [[nodiscard]] inline MeshUpload
+    loadMeshFile( std::filesystem::path const & path, VmaAllocator allocator, uint32_t threads = 0, bool optimize = true, float radius = data::modelRadius )
+  {
+    if ( path.extension() == ".cmesh" )
+      return loadCookedMesh( path, allocator );
+
+    auto begin = std::chrono::steady_clock::now();
+
+    MeshUpload   upload;
+    PreparedMesh prepared = prepareMeshFile( path, threads, optimize, radius, upload.stats );
+    threads               = upload.stats.threads;
+
+    MeshGeometry const &          mesh         = prepared.mesh;
+    std::vector<uint32_t> const & meshletWords = prepared.meshletWords;
+
+    auto start = std::chrono::steady_clock::now();
+
+    vk::DeviceSize vertexBytes  = mesh.positions.size() * sizeof( data::Vertex );
+    vk::DeviceSize indexBytes   = mesh.indices.size() * sizeof( uint32_t );
+    vk::DeviceSize meshletBytes = meshletWords.size() * sizeof( uint32_t );
+    upload.indexOffset          = vertexBytes;
+    upload.meshletOffset        = vertexBytes + indexBytes;
+
+    upload.staging = core::createBuffer( allocator,
+                                         vertexBytes + indexBytes + meshletBytes,
+                                         vk::BufferUsageFlagBits::eTransferSrc,
+                                         VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT );
+    auto * staging = static_cast<char *>( upload.staging.allocationInfo.pMappedData );
+
+    constexpr size_t Range  = 1 << 16;
+    size_t           chunks = ( mesh.positions.size() + Range - 1 ) / Range;
+    parallelFor( chunks,
+                 threads,
+                 [&]( size_t r )
+                 {
+                   auto * vertices = reinterpret_cast<data::Vertex *>( staging );
+                   for ( size_t v = r * Range; v < std::min( mesh.positions.size(), ( r + 1 ) * Range ); ++v )
+                     vertices[v] = data::Vertex{ mesh.positions[v], mesh.colors[v] };
+                 } );
+    std::memcpy( staging + upload.indexOffset, mesh.indices.data(), indexBytes );
+    std::memcpy( staging + upload.meshletOffset, meshletWords.data(), meshletBytes );
+    vmaFlushAllocation( allocator, upload.staging.allocation, 0, VK_WHOLE_SIZE );
+
+    // Source as well so the defragmenter can move the buffers once the model is adopted
+    constexpr vk::BufferUsageFlags transfer = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+    constexpr vk::BufferUsageFlags storage  = vk::BufferUsageFlagBits::eStorageBuffer;
+
+    Model & model  = upload.model;
+    model.vertices = core::createBuffer( allocator, vertexBytes, vk::BufferUsageFlagBits::eVertexBuffer | storage | transfer );
+    model.indices  = core::createBuffer( allocator, indexBytes, vk::BufferUsageFlagBits::eIndexBuffer | transfer );
+    model.meshlets = core::createBuffer( allocator, meshletBytes, storage | transfer );
+    model.radius   = radius;
+    model.lods     = { ModelLod{ 0, static_cast<uint32_t>( mesh.indices.size() ), 0.0f, 0, prepared.meshletCount } };
+    upload.stats.stagingMs = detail::msSince( start );
+    upload.stats.cpuMs     = detail::msSince( begin );
+    return upload;
+  }
+
+  // Offline half of the cooked format: prepares `source` like loadMeshFile() would, quantizes the vertices
+  // against the bounding radius and writes `output`. Returns the prepare stages' timings.
+  inline MeshLoadStats cookMeshFile( std::filesystem::path const & source,
+                                     std::filesystem::path const & output,
+                                     uint32_t                      threads  = 0,
+                                     bool                          optimize = true,
+                                     float                         radius   = data::modelRadius )
+  {
+    auto begin = std::chrono::steady_clock::now();
+
+    MeshLoadStats stats;
+    PreparedMesh  prepared = prepareMeshFile( source, threads, optimize, radius, stats );
+
+    CookedHeader header;
+    {
+      MappedFile file( source );
+      header.sourceHash = cookedSourceHash( file.bytes(), optimize, radius );
+    }
+    header.meshletCount = prepared.meshletCount;
+    header.lodCount     = 1;
+    header.lods[0]      = CookedLod{ 0, static_cast<uint32_t>( prepared.mesh.indices.size() ), 0, prepared.meshletCount, 0.0f };
+    header.flags        = optimize ? CookedOptimized : 0u;
+    header.radius       = radius;
+    header.boundsMin    = glm::vec3( std::numeric_limits<float>::max() );
+    header.boundsMax    = glm::vec3( std::numeric_limits<float>::lowest() );
+
+    std::vector<data::QuantizedVertex> vertices( prepared.mesh.positions.size() );
+    for ( size_t v = 0; v < vertices.size(); ++v )
+    {
+      vertices[v]      = quantizeVertex( prepared.mesh.positions[v], prepared.mesh.colors[v], radius );
+      header.boundsMin = glm::min( header.boundsMin, prepared.mesh.positions[v] );
+      header.boundsMax = glm::max( header.boundsMax, prepared.mesh.positions[v] );
+    }
+    writeCookedFile( output, header, vertices, prepared.mesh.indices, prepared.meshletWords );
+
+    stats.cpuMs = detail::msSince( begin );
+    return stats;
+  }
+
+  // Whether `output` was cooked from the current `source` with the same settings
+  [[nodiscard]] inline bool isCookCurrent( std::filesystem::path const & source,
+                                           std::filesystem::path const & output,
+                                           bool                          optimize = true,
+                                           float                         radius   = data::modelRadius )
+  {
+    auto header = peekCookedHeader( output );
+    if ( !header )
+      return false;
+    MappedFile file( source );
+    return header->sourceHash == cookedSourceHash( file.bytes(), optimize, radius );
+  }
+
+  // Frees everything a load created, for loads that never reach the renderer
+  inline void destroyMeshUpload( VmaAllocator allocator, MeshUpload & upload )
+  {
+    core::destroyBuffer( allocator, upload.staging );
+    upload.model.destroy( allocator );
+  }
+
+  // Background model loading for the render loop. start() runs loadMeshFile() through std::async; poll(),
+  // called once per frame, checks the future without waiting, submits the staging copy once it is ready and
+  // hands out the model when the copy's fence signaled. Neither call blocks on file I/O.
+  struct MeshLoader
+  {
+    static constexpr uint32_t WarmupFrames = 16;
+    static constexpr uint32_t DrawFrames   = 256;
+
+    std::vector<MeshLoadStats> history;  // every model handed out, the last one is being drawn
+    std::string                error;    // of the last failed load
+
+    void init( vk::raii::Device const & device_, VmaAllocator allocator_, uint32_t queueFamily, vk::raii::Queue const & queue_ )
+    {
+      device    = &device_;
+      allocator = allocator_;
+      queue     = &queue_;
+
+      commandPool = vk::raii::CommandPool( device_, vk::CommandPoolCreateInfo{ vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamily } );
+      cmd         = std::move( vk::raii::CommandBuffers( device_, vk::CommandBufferAllocateInfo{ commandPool, vk::CommandBufferLevel::ePrimary, 1 } ).front() );
+      fence       = vk::raii::Fence( device_, vk::FenceCreateInfo{} );
+    }
+
+    // Waits for a load in progress and frees what it created
+    void destroy()
+    {
+      if ( pending.valid() )
+      {
+        try
+        {
+          MeshUpload upload = pending.get();
+          destroyMeshUpload( allocator, upload );
+        }
+        catch ( std::exception const & )
+        {
+        }
+      }
+      if ( uploading )
+      {
+        (void)device->waitForFences( { *fence }, VK_TRUE, UINT64_MAX );
+        destroyMeshUpload( allocator, *uploading );
+        uploading.reset();
+      }
+    }
+
+    [[nodiscard]] bool busy() const
+    {
+      return pending.valid() || uploading.has_value();
+    }
+
+    // Ignored while another load is in progress. `optimize` reorders indices and vertices, see core/meshopt.hpp.
+    void start( std::filesystem::path const & path, uint32_t threads = 0, bool optimize = true )
+    {
+      if ( busy() )
+        return;
+      error.clear();
+      pending = std::async( std::launch::async,
+                            [path, threads, optimize, allocator = allocator] { return loadMeshFile( path, allocator, threads, optimize ); } );
+    }
+
+    // Once per frame with the slot's scene pass GPU time, averaged over DrawFrames frames after WarmupFrames
+    // into the newest history entry, so index orders of the same file can be compared
+    void recordDrawTime( float ms )
+    {
+      if ( history.empty() || history.back().drawFrames >= DrawFrames )
+        return;
+      if ( framesDrawn++ < WarmupFrames )
+        return;
+
+      MeshLoadStats & stats = history.back();
+      stats.drawMs          = ( stats.drawMs * stats.drawFrames + ms ) / ( stats.drawFrames + 1 );
+      stats.drawFrames++;
+    }
+
+    // Once per frame, never blocks. Returns the loaded model once it is resident, the caller owns it from then on.
+    [[nodiscard]] std::optional<Model> poll()
+    {
+      if ( pending.valid() && pending.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready )
+      {
+        std::optional<MeshUpload> upload;
+        try
+        {
+          upload = pending.get();
+          submitCopy( *upload );
+          // only once the fence is going to signal, busy() waits for it
+          uploading = std::move( upload );
+        }
+        catch ( std::exception const & e )
+        {
+          if ( upload )
+            destroyMeshUpload( allocator, *upload );
+          error = e.what();
+          isDebug( std::println( "[meshload] {}", error ) );
+        }
+      }
+
+      if ( !uploading || device->waitForFences( { *fence }, VK_TRUE, 0 ) != vk::Result::eSuccess )
+        return std::nullopt;
+
+      device->resetFences( { *fence } );
+      core::destroyBuffer( allocator, uploading->staging );
+      uploading->stats.uploadMs = detail::msSince( uploadStart );
+      history.push_back( uploading->stats );
+      framesDrawn = 0;
+
+      MeshLoadStats const & s = uploading->stats;
+      isDebug( std::println( "[meshload] {}: {} vertices, {} triangles, {} meshlets, {} threads: "
+                             "parse {:.1f} ms, convert {:.1f} ms, optimize {:.1f} ms, meshlets {:.1f} ms, staging {:.1f} ms, upload {:.1f} ms",
+                             s.path,
+                             s.vertices,
+                             s.triangles,
+                             s.meshlets,
+                             s.threads,
+                             s.parseMs,
+                             s.convertMs,
+                             s.optimizeMs,
+                             s.meshletMs,
+                             s.stagingMs,
+                             s.uploadMs ) );
+      isDebug( std::println( "[meshload] {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+                             s.path,
+                             s.cacheBefore.acmr,
+                             s.cacheAfter.acmr,
+                             s.cacheBefore.atvr,
+                             s.cacheAfter.atvr ) );
+
+      Model model = std::move( uploading->model );
+      uploading.reset();
+      return model;
+    }
+
+  private:
+    vk::raii::Device const *              device      = nullptr;
+    vk::raii::Queue const *               queue       = nullptr;
+    VmaAllocator                          allocator   = nullptr;
+    vk::raii::CommandPool                 commandPool = nullptr;
+    vk::raii::CommandBuffer               cmd         = nullptr;
+    vk::raii::Fence                       fence       = nullptr;
+    std::future<MeshUpload>               pending;
+    std::optional<MeshUpload>             uploading;  // copy submitted, waiting for the fence
+    std::chrono::steady_clock::time_point uploadStart;
+    uint32_t                              framesDrawn = 0;  // since the newest model was handed out
+
+    void submitCopy( MeshUpload const & upload )
+    {
+      uploadStart = std::chrono::steady_clock::now();
+
+      cmd.reset();
+      cmd.begin( vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+      cmd.copyBuffer( upload.staging.buffer, upload.model.vertices.buffer, vk::BufferCopy{ 0, 0, upload.indexOffset } );
+      cmd.copyBuffer( upload.staging.buffer, upload.model.indices.buffer, vk::BufferCopy{ upload.indexOffset, 0, upload.meshletOffset - upload.indexOffset } );
+      cmd.copyBuffer( upload.staging.buffer, upload.model.meshlets.buffer, vk::BufferCopy{ upload.meshletOffset, 0, upload.model.meshlets.size } );
+
+      // Frames are submitted to the same queue afterwards
+      vk::MemoryBarrier2 toReaders{ vk::PipelineStageFlagBits2::eTransfer,
+                                    vk::AccessFlagBits2::eTransferWrite,
+                                    vk::PipelineStageFlagBits2::eAllCommands,
+                                    vk::AccessFlagBits2::eVertexAttributeRead | vk::AccessFlagBits2::eIndexRead | vk::AccessFlagBits2::eShaderStorageRead };
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( toReaders ) );
+      cmd.end();
+
+      vk::CommandBufferSubmitInfo cmdInfo{ *cmd };
+      queue->submit2( vk::SubmitInfo2{}.setCommandBufferInfos( cmdInfo ), *fence );
+    }
+  };
+
+  // Benchmark: loads one file synchronously with 1, 2, 4 and 8 workers and keeps the stage timings, the
+  // GPU copy and the single-threaded index optimization are left out. writeTestObj() provides a large model
+  // when there is none at hand.
+  struct MeshLoadBenchmark
+  {
+    static constexpr std::array<uint32_t, 4> ThreadCounts = { 1, 2, 4, 8 };
+
+    std::vector<MeshLoadStats> results;
+    std::string                error;
+
+    void run( std::filesystem::path const & path, VmaAllocator allocator )
+    {
+      results.clear();
+      error.clear();
+      try
+      {
+        for ( uint32_t threads : ThreadCounts )
+        {
+          MeshUpload upload = loadMeshFile( path, allocator, threads, false );
+          destroyMeshUpload( allocator, upload );
+          results.push_back( upload.stats );
+
+          MeshLoadStats const & s = upload.stats;
+          isDebug( std::println( "[meshload] benchmark {} threads: {:.1f} ms (parse {:.1f}, convert {:.1f}, meshlets {:.1f}, staging {:.1f}), {:.0f} MB/s",
+                                 threads,
+                                 s.cpuMs,
+                                 s.parseMs,
+                                 s.convertMs,
+                                 s.meshletMs,
+                                 s.stagingMs,
+                                 double( s.fileBytes ) / ( 1024.0 * 1024.0 ) / ( s.cpuMs * 1e-3 ) ) );
+        }
+      }
+      catch ( std::exception const & e )
+      {
+        error = e.what();
+      }
+    }
+
+    // Icosphere with `subdivisions` subdivisions as OBJ, 20 * 4^subdivisions triangles
+    static void writeTestObj( std::filesystem::path const & path, uint32_t subdivisions )
+    {
+      if ( path.has_parent_path() )
+        std::filesystem::create_directories( path.parent_path() );
+
+      IndexedMesh   mesh = icosphere( subdivisions );
+      std::ofstream file( path, std::ios::trunc );
+      if ( !file )
+        throw std::runtime_error( "Failed to write " + path.string() );
+
+      for ( auto const & p : mesh.positions )
+        file << "v " << p.x << ' ' << p.y << ' ' << p.z << '\n';
+      for ( size_t i = 0; i < mesh.indices.size(); i += 3 )
+        file << "f " << mesh.indices[i] + 1 << ' ' << mesh.indices[i + 1] + 1 << ' ' << mesh.indices[i + 2] + 1 << '\n';
+    }
+  };
+
+  // Where the cooked form of `source` goes by default, next to it
+  [[nodiscard]] inline std::filesystem::path cookedPathFor( std::filesystem::path const & source )
+  {
+    return std::filesystem::path( source ).replace_extension( ".cmesh" );
+  }
+
+  // Benchmark: startup cost of a source file against its cooked form, CPU side of the load only. The source is
+  // loaded the way MeshLoader loads it (every worker, optimized), cooked next to itself and the cooked file
+  // loaded back. Both files were just read, so both loads come from the page cache.
+  struct CookedLoadBenchmark
+  {
+    MeshLoadStats source;
+    MeshLoadStats cook;
+    MeshLoadStats cooked;
+    std::string   error;
+
+    [[nodiscard]] bool valid() const
+    {
+      return !source.path.empty() && !cooked.path.empty();
+    }
+
+    void run( std::filesystem::path const & path, VmaAllocator allocator )
+    {
+      source = cook = cooked = {};
+      error.clear();
+      try
+      {
+        MeshUpload upload = loadMeshFile( path, allocator );
+        destroyMeshUpload( allocator, upload );
+        source = upload.stats;
+
+        cook = cookMeshFile( path, cookedPathFor( path ) );
+
+        upload = loadCookedMesh( cookedPathFor( path ), allocator );
+        destroyMeshUpload( allocator, upload );
+        cooked = upload.stats;
+
+        isDebug( std::println( "[meshload] {}: source {:.1f} ms ({} B), cooked {:.2f} ms ({} B, validate {:.2f}, staging {:.2f}), {:.0f}x",
+                               path.string(),
+                               source.cpuMs,
+                               source.fileBytes,
+                               cooked.cpuMs,
+                               cooked.fileBytes,
+                               cooked.parseMs,
+                               cooked.stagingMs,
+                               source.cpuMs / std::max( cooked.cpuMs, 1e-3 ) ) );
+      }
+      catch ( std::exception const & e )
+      {
+        error = e.what();
+      }
+    }
+  };
+}  // namespace core
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace core
+{
+  // Post-transform cache efficiency of an index order, simulated with a FIFO cache
+  struct VertexCacheStats
+  {
+    float acmr = 0.0f;  // vertex shader invocations per triangle, 0.5 is the limit for large regular meshes
+    float atvr = 0.0f;  // vertex shader invocations per referenced vertex, 1 is optimal
+  };
+
+  [[nodiscard]] inline VertexCacheStats analyzeVertexCache( std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize = 16 )
+  {
+    std::vector<uint32_t> timestamps( vertexCount, 0 );  // time the vertex entered the cache, 0 for never
+    std::vector<uint8_t>  referenced( vertexCount, 0 );
+    uint32_t              time = cacheSize + 1, misses = 0, unique = 0;
+
+    for ( uint32_t index : indices )
+    {
+      if ( time - timestamps[index] > cacheSize )
+      {
+        timestamps[index] = time++;
+        ++misses;
+      }
+      unique += referenced[index] ? 0 : 1;
+      referenced[index] = 1;
+    }
+
+    VertexCacheStats stats;
+    if ( indices.size() >= 3 )
+      stats.acmr = float( misses ) / float( indices.size() / 3 );
+    if ( unique > 0 )
+      stats.atvr = float( misses ) / float( unique );
+    return stats;
+  }
+
+  namespace detail
+  {
+    // Tom Forsyth, "Linear-Speed Vertex Cache Optimisation", 2006
+    constexpr uint32_t ForsythCacheSize = 32;
+
+    inline float forsythScore( int32_t cachePosition, uint32_t remaining )
+    {
+      constexpr float    CacheDecayPower   = 1.5f;
+      constexpr float    LastTriangleScore = 0.75f;
+      constexpr float    ValenceBoostScale = 2.0f;
+      constexpr float    ValenceBoostPower = 0.5f;
+      constexpr uint32_t ValenceTableSize  = 32;
+
+      // Both terms are looked up, pow() dominated the optimization time otherwise
+      static auto const tables = []
+      {
+        std::pair<std::array<float, ForsythCacheSize + 1>, std::array<float, ValenceTableSize>> t{};
+        for ( uint32_t p = 0; p < ForsythCacheSize; ++p )
+          t.first[p + 1] = p < 3 ? LastTriangleScore : std::pow( 1.0f - float( p - 3 ) / float( ForsythCacheSize - 3 ), CacheDecayPower );
+        for ( uint32_t v = 1; v < ValenceTableSize; ++v )
+          t.second[v] = ValenceBoostScale * std::pow( float( v ), -ValenceBoostPower );
+        return t;
+      }();
+
+      if ( remaining == 0 )
+        return -1.0f;
+
+      float valence = remaining < ValenceTableSize ? tables.second[remaining] : ValenceBoostScale * std::pow( float( remaining ), -ValenceBoostPower );
+      return tables.first[cachePosition + 1] + valence;
+    }
+  }  // namespace detail
+
+  // Greedy triangle order for the post-transform cache: every step emits the highest scoring triangle among
+  // the ones using a vertex in the simulated LRU cache, scores favour recently used vertices and vertices with
+  // few triangles left. Falls back to the first triangle not emitted yet when none of them is left.
+  [[nodiscard]] inline std::vector<uint32_t> optimizeVertexCache( std::span<const uint32_t> indices, uint32_t vertexCount )
+  {
+    constexpr uint32_t None          = std::numeric_limits<uint32_t>::max();
+    uint32_t           triangleCount = static_cast<uint32_t>( indices.size() / 3 );
+
+    // Triangles not emitted yet around every vertex, the first live[v] entries of its range
+    std::vector<uint32_t> offsets( vertexCount + 1, 0 ), live( vertexCount, 0 ), triangles( triangleCount * 3 );
+    for ( uint32_t i = 0; i < triangleCount * 3; ++i )
+      live[indices[i]]++;
+    for ( uint32_t v = 0; v < vertexCount; ++v )
+      offsets[v + 1] = offsets[v] + live[v];
+    {
+      std::vector<uint32_t> cursor( offsets.begin(), offsets.end() - 1 );
+      for ( uint32_t i = 0; i < triangleCount * 3; ++i )
+        triangles[cursor[indices[i]]++] = i / 3;
+    }
+
+    std::vector<int32_t> cachePosition( vertexCount, -1 );
+    std::vector<float>   vertexScore( vertexCount );
+    std::vector<uint8_t> emitted( triangleCount, 0 );
+    for ( uint32_t v = 0; v < vertexCount; ++v )
+      vertexScore[v] = detail::forsythScore( -1, live[v] );
+
+    uint32_t best      = None;
+    float    bestScore = -1.0f;
+    for ( uint32_t t = 0; t < triangleCount; ++t )
+    {
+      float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+      if ( score > bestScore )
+      {
+        best      = t;
+        bestScore = score;
+      }
+    }
+
+    std::array<uint32_t, detail::ForsythCacheSize + 3> cache, next;
+    uint32_t                                           cacheCount = 0;
+    uint32_t                                           cursor     = 0;
+
+    std::vector<uint32_t> result;
+    result.reserve( triangleCount * 3 );
+    while ( result.size() < size_t( triangleCount ) * 3 )
+    {
+      if ( best == None )
+      {
+        while ( emitted[cursor] )
+          ++cursor;
+        best = cursor;
+      }
+
+      uint32_t t = best;
+      emitted[t] = 1;
+      for ( uint32_t k = 0; k < 3; ++k )
+      {
+        uint32_t v = indices[t * 3 + k];
+        result.push_back( v );
+
+        uint32_t * first = &triangles[offsets[v]];
+        uint32_t * last  = first + live[v];
+        uint32_t * found = std::find( first, last, t );
+        if ( found != last )
+        {
+          std::swap( *found, *( last - 1 ) );
+          live[v]--;
+        }
+      }
+
+      // The triangle's vertices move to the front, the rest keeps its order
+      uint32_t nextCount = 0;
+      for ( uint32_t k = 0; k < 3; ++k )
+      {
+        uint32_t v = indices[t * 3 + k];
+        if ( std::find( next.begin(), next.begin() + nextCount, v ) == next.begin() + nextCount )
+          next[nextCount++] = v;
+      }
+      for ( uint32_t i = 0; i < cacheCount; ++i )
+        if ( std::find( next.begin(), next.begin() + nextCount, cache[i] ) == next.begin() + nextCount )
+          next[nextCount++] = cache[i];
+
+      // Vertices past the cache size were evicted, their scores change as well
+      for ( uint32_t i = 0; i < nextCount; ++i )
+        cachePosition[next[i]] = i < detail::ForsythCacheSize ? static_cast<int32_t>( i ) : -1;
+      for ( uint32_t i = 0; i < nextCount; ++i )
+        vertexScore[next[i]] = detail::forsythScore( cachePosition[next[i]], live[next[i]] );
+
+      best      = None;
+      bestScore = -1.0f;
+      for ( uint32_t i = 0; i < nextCount; ++i )
+      {
+        uint32_t v = next[i];
+        for ( uint32_t a = offsets[v]; a < offsets[v] + live[v]; ++a )
+        {
+          uint32_t u     = triangles[a];
+          float    score = vertexScore[indices[u * 3]] + vertexScore[indices[u * 3 + 1]] + vertexScore[indices[u * 3 + 2]];
+          if ( score > bestScore )
+          {
+            best      = u;
+            bestScore = score;
+          }
+        }
+      }
+
+      cacheCount = std::min( nextCount, detail::ForsythCacheSize );
+      std::copy( next.begin(), next.begin() + cacheCount, cache.begin() );
+    }
+
+    return result;
+  }
+
+  // Reorders clusters of a cache optimized index buffer so triangles facing outwards are drawn first, after
+  // Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007.
+  // Clusters start where the simulated cache missed all three vertices, and are split further wherever the
+  // running ACMR falls below `threshold` times the cluster's, so the cache efficiency loses at most that factor.
+  // Clusters are sorted by how far their centroid lies along their normal, measured from the mesh centroid.
+  [[nodiscard]] inline std::vector<uint32_t>
+    optimizeOverdraw( std::span<const uint32_t> indices, std::span<const glm::vec3> positions, float threshold = 1.05f )
+  {
+    constexpr uint32_t CacheSize     = 16;
+    uint32_t           triangleCount = static_cast<uint32_t>( indices.size() / 3 );
+    if ( triangleCount == 0 )
+      return {};
+
+    std::vector<uint32_t> timestamps( positions.size(), 0 );
+    uint32_t              time = CacheSize + 1;
+
+    auto misses = [&]( uint32_t t )
+    {
+      uint32_t count = 0;
+      for ( uint32_t k = 0; k < 3; ++k )
+        if ( time - timestamps[indices[t * 3 + k]] > CacheSize )
+        {
+          timestamps[indices[t * 3 + k]] = time++;
+          ++count;
+        }
+      return count;
+    };
+    auto flush = [&] { time += CacheSize + 1; };
+
+    std::vector<uint32_t> hard;
+    for ( uint32_t t = 0; t < triangleCount; ++t )
+      if ( misses( t ) == 3 || t == 0 )
+        hard.push_back( t );
+    hard.push_back( triangleCount );
+
+    std::vector<uint32_t> soft;
+    for ( size_t h = 0; h + 1 < hard.size(); ++h )
+    {
+      uint32_t start = hard[h], end = hard[h + 1];
+
+      flush();
+      uint32_t clusterMisses = 0;
+      for ( uint32_t t = start; t < end; ++t )
+        clusterMisses += misses( t );
+      float clusterThreshold = threshold * float( clusterMisses ) / float( end - start );
+
+      flush();
+      soft.push_back( start );
+      uint32_t runningMisses = 0, runningTriangles = 0;
+      for ( uint32_t t = start; t < end; ++t )
+      {
+        runningMisses += misses( t );
+        runningTriangles++;
+        if ( t + 1 < end && float( runningMisses ) / float( runningTriangles ) <= clusterThreshold )
+        {
+          soft.push_back( t + 1 );
+          runningMisses    = 0;
+          runningTriangles = 0;
+          flush();
+        }
+      }
+    }
+    soft.push_back( triangleCount );
+
+    // Area weighted centroids and normals
+    size_t                 clusterCount = soft.size() - 1;
+    std::vector<glm::vec3> centroids( clusterCount ), normals( clusterCount );
+    glm::vec3              meshCentroid( 0.0f );
+    float                  meshArea = 0.0f;
+    for ( size_t c = 0; c < clusterCount; ++c )
+    {
+      glm::vec3 centroid( 0.0f ), normal( 0.0f );
+      float     area = 0.0f;
+      for ( uint32_t t = soft[c]; t < soft[c + 1]; ++t )
+      {
+        glm::vec3 a = positions[indices[t * 3]], b = positions[indices[t * 3 + 1]], d = positions[indices[t * 3 + 2]];
+        glm::vec3 n = glm::cross( b - a, d - a );
+        float     w = glm::length( n );
+        centroid += ( a + b + d ) * ( w / 3.0f );
+        normal += n;
+        area += w;
+      }
+      meshCentroid += centroid;
+      meshArea += area;
+      float length = glm::length( normal );
+      centroids[c] = area > 0.0f ? centroid / area : positions[indices[soft[c] * 3]];
+      normals[c]   = length > 0.0f ? normal / length : glm::vec3( 0.0f );
+    }
+    if ( meshArea > 0.0f )
+      meshCentroid /= meshArea;
+
+    std::vector<float>    keys( clusterCount );
+    std::vector<uint32_t> order( clusterCount );
+    for ( size_t c = 0; c < clusterCount; ++c )
+      keys[c] = glm::dot( centroids[c] - meshCentroid, normals[c] );
+    std::iota( order.begin(), order.end(), 0u );
+    std::stable_sort( order.begin(), order.end(), [&]( uint32_t a, uint32_t b ) { return keys[a] > keys[b]; } );
+
+    std::vector<uint32_t> result;
+    result.reserve( indices.size() );
+    for ( uint32_t c : order )
+      result.insert( result.end(), indices.begin() + soft[c] * 3, indices.begin() + soft[c + 1] * 3 );
+    return result;
+  }
+
+  // New vertex numbering in the order the indices first use the vertices, so vertex fetch walks memory
+  // sequentially. remap[old] is the new index, ~0u for vertices no triangle references (they are dropped).
+  [[nodiscard]] inline std::vector<uint32_t> vertexFetchRemap( std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t & remappedCount )
+  {
+    std::vector<uint32_t> remap( vertexCount, ~0u );
+    remappedCount = 0;
+    for ( uint32_t index : indices )
+      if ( remap[index] == ~0u )
+        remap[index] = remappedCount++;
+    return remap;
+  }
+
+  inline void remapIndices( std::span<uint32_t> indices, std::span<const uint32_t> remap )
+  {
+    for ( uint32_t & index : indices )
+      index = remap[index];
+  }
+
+  template <typename T>
+  inline void remapVertices( std::vector<T> & vertices, std::span<const uint32_t> remap, uint32_t remappedCount )
+  {
+    std::vector<T> result( remappedCount );
+    for ( size_t v = 0; v < vertices.size(); ++v )
+      if ( remap[v] != ~0u )
+        result[remap[v]] = vertices[v];
+    vertices = std::move( result );
+  }
+}  // namespace core
@@ -0,0 +1,363 @@
+#pragma once
+#include "../data.hpp"
+#include "../features.hpp"
+#include "../setup.hpp"
+#include "../state.hpp"
+#include "bindless.hpp"
+#include "culling.hpp"
+#include "material.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // How the scene pass turns instances into primitives
+  enum class RenderPath : uint8_t
+  {
+    Vertex,  // compute culling, indexed indirect draws through the vertex stage
+    Mesh,    // VK_EXT_mesh_shader, culling in the task stage, no compute pass and no indirect buffers
+  };
+
+  [[nodiscard]] inline const char * toString( RenderPath path )
+  {
+    return path == RenderPath::Mesh ? "Mesh shaders" : "Vertex shaders";
+  }
+
+  // Mesh shaders when the device supports them, the vertex path otherwise
+  [[nodiscard]] inline RenderPath preferredRenderPath()
+  {
+    return cfg::supported.meshShader ? RenderPath::Mesh : RenderPath::Vertex;
+  }
+
+  // Task and mesh shader rendering of the instance buffer.
+  // instances.task runs one workgroup per taskInstances() instances: frustum test and LOD selection, then the
+  // surviving instances and the first meshlet of each go to the task payload and one mesh workgroup is launched
+  // per meshlet. taskInstances() is at most TaskGroupSize and small enough that a workgroup never launches more
+  // mesh workgroups than maxMeshWorkGroupCount[0] / maxMeshWorkGroupTotalCount allow, a model whose single
+  // instance exceeds that is drawn with the vertex path (fits()).
+  // instances.mesh outputs the triangles of one meshlet of one instance, or nothing when the meshlet's normal
+  // cone faces away from the camera.
+  // Meshlets are the ones of Model::meshlets (core::buildMeshlets), at most MeshletMaxVertices vertices and
+  // MeshletMaxTriangles triangles each.
+  struct MeshRenderer
+  {
+    static constexpr uint32_t TaskGroupSize = 64;  // mirrors instances.task
+
+    // Stats buffer layout:
+    //   uint lodInstances[Model::MaxLods]   visible instances per LOD, instances.task
+    //   uint meshlets                       mesh workgroups launched, instances.task
+    //   uint coneCulled                     meshlets rejected by their normal cone, instances.mesh
+    static constexpr vk::DeviceSize StatsSize = ( Model::MaxLods + 2 ) * sizeof( uint32_t );
+
+    // Read back from the GPU, MAX_FRAMES_IN_FLIGHT frames old
+    struct Stats
+    {
+      uint32_t                             drawn = 0;
+      std::array<uint32_t, Model::MaxLods> lodInstances{};
+      uint32_t                             meshlets   = 0;
+      uint32_t                             coneCulled = 0;
+      uint64_t                             triangles  = 0;  // of the selected LODs, before cone culling
+    };
+
+    Stats stats;
+
+    // `model` is drawn by every instance and has to outlive the renderer, it is read through the heap slots of its
+    // adopted buffers so a replaced or moved model needs nothing here. Does nothing without VK_EXT_mesh_shader.
+    void init( vk::raii::Device const &         device,
+               vk::raii::PhysicalDevice const & physicalDevice,
+               VmaAllocator                     allocator_,
+               BindlessHeap &                   heap,
+               Model const &                    model_ )
+    {
+      if ( !cfg::supported.meshShader )
+        return;
+
+      allocator = allocator_;
+      model     = &model_;
+
+      auto props = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceMeshShaderPropertiesEXT>()
+                     .get<vk::PhysicalDeviceMeshShaderPropertiesEXT>();
+      maxMeshGroups      = std::min( props.maxMeshWorkGroupCount[0], props.maxMeshWorkGroupTotalCount );
+      maxTaskGroups      = { props.maxTaskWorkGroupCount[0], props.maxTaskWorkGroupCount[1] };
+      maxTaskGroupsTotal = props.maxTaskWorkGroupTotalCount;
+
+      vk::PushConstantRange pushRange{ vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT, 0, sizeof( data::MeshPushConstants ) };
+      shaders.emplace( device,
+                       std::vector<std::string>{},
+                       std::vector<std::string>{ "triangle.frag" },
+                       pushRange,
+                       std::vector<vk::DescriptorSetLayout>{ *heap.layout },
+                       raii::MeshStages{ "instances.task", "instances.mesh" } );
+
+      vk::BufferUsageFlags usage =
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc;
+      counters      = core::createBuffer( allocator, StatsSize, usage );
+      countersIndex = heap.addStorageBuffer( counters.buffer );
+
+      for ( auto & buffer : readback )
+        buffer = core::createBuffer(
+          allocator, StatsSize, vk::BufferUsageFlagBits::eTransferDst, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT );
+    }
+
+    void destroy()
+    {
+      if ( !available() )
+        return;
+
+      core::destroyBuffer( allocator, counters );
+      for ( auto & buffer : readback )
+        core::destroyBuffer( allocator, buffer );
+      shaders.reset();
+    }
+
+    [[nodiscard]] bool available() const
+    {
+      return shaders.has_value();
+    }
+
+    // Instances per task workgroup: TaskGroupSize unless the meshlets of that many instances at their largest
+    // selectable LOD exceed the mesh workgroup limit, 0 when a single instance already does
+    [[nodiscard]] uint32_t taskInstances( bool lodEnabled ) const
+    {
+      uint32_t lodCount = lodEnabled ? static_cast<uint32_t>( model->lods.size() ) : 1;
+      uint32_t meshlets = 1;
+      for ( uint32_t lod = 0; lod < lodCount; ++lod )
+        meshlets = std::max( meshlets, model->lods[lod].meshletCount );
+      return std::min( TaskGroupSize, maxMeshGroups / meshlets );
+    }
+
+    // Whether draw() can launch `instanceCount` instances of the current model within the device limits
+    [[nodiscard]] bool fits( uint32_t instanceCount, bool lodEnabled ) const
+    {
+      if ( !available() )
+        return false;
+      uint32_t perGroup = taskInstances( lodEnabled );
+      if ( perGroup == 0 )
+        return false;
+      vk::Extent2D groups = taskGroups( instanceCount, perGroup );
+      return groups.height <= maxTaskGroups[1] && uint64_t( groups.width ) * groups.height <= maxTaskGroupsTotal;
+    }
+
+    // Clears the counters, outside of rendering and before draw()
+    void begin( vk::raii::CommandBuffer const & cmd )
+    {
+      // The previous frame may still be copying them out
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferRead,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite );
+      cmd.fillBuffer( counters.buffer, 0, StatsSize, 0 );
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite,
+               vk::PipelineStageFlagBits2::eTaskShaderEXT | vk::PipelineStageFlagBits2::eMeshShaderEXT,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+    }
+
+    // Inside a scene pass with its dynamic state set, binds the task/mesh stages and launches every instance.
+    // Only LOD 0 is used while `lodEnabled` is false. The caller checks fits() first.
+    void draw( vk::raii::CommandBuffer const & cmd,
+               BindlessHeap const &            heap,
+               glm::mat4 const &               view,
+               glm::mat4 const &               proj,
+               float                           znear,
+               float                           screenHeight,
+               uint32_t                        instanceBufferIndex,
+               uint32_t                        instanceCount,
+               bool                            lodEnabled )
+    {
+      data::MeshPushConstants pc{};
+      glm::mat4               viewProj = proj * view;
+      auto                    planes   = extractFrustumPlanes( viewProj );
+      std::copy( planes.begin(), planes.end(), pc.planes );
+      pc.viewProj       = viewProj;
+      pc.cameraPosition = glm::vec3( glm::inverse( view )[3] );
+      pc.radius         = model->radius;
+      uint32_t lodCount = lodEnabled ? static_cast<uint32_t>( model->lods.size() ) : 1;
+      for ( uint32_t lod = 0; lod < model->lods.size(); ++lod )
+      {
+        // selectLod() stops at the first zero, so the last selectable level has none
+        pc.lodScreenSizes[lod]  = lod + 1 < lodCount ? model->lods[lod].minScreenSize : 0.0f;
+        pc.lodFirstMeshlet[lod] = model->lods[lod].firstMeshlet;
+        pc.lodMeshlets[lod]     = model->lods[lod].meshletCount;
+      }
+      pc.instanceBuffer = instanceBufferIndex;
+      pc.instanceCount  = instanceCount;
+      pc.vertexBuffer   = heap.slotsOf( model->vertexHandle ).storageBuffer;
+      pc.vertexBuffer |= model->vertexFormat == VertexFormat::Quantized ? data::QuantizedVertexBit : 0u;
+      pc.meshletBuffer  = heap.slotsOf( model->meshletHandle ).storageBuffer;
+      pc.sizeScale      = -proj[1][1] * screenHeight;  // undo the Vulkan y flip
+      pc.znear          = znear;
+      pc.taskInstances  = taskInstances( lodEnabled );
+      pc.statsBuffer    = countersIndex;
+      pendingLodCount   = lodCount;
+
+      shaders->bindMeshStages( cmd );
+      heap.bind( cmd, *shaders->pipelineLayout, vk::PipelineBindPoint::eGraphics );
+      cmd.pushConstants<data::MeshPushConstants>( *shaders->pipelineLayout, shaders->pushConstantStages, 0, { pc } );
+      vk::Extent2D groups = taskGroups( instanceCount, pc.taskInstances );
+      cmd.drawMeshTasksEXT( groups.width, groups.height, 1 );
+    }
+
+    // Counters for the UI, read in collect() once this slot's fence signaled
+    void end( vk::raii::CommandBuffer const & cmd, uint32_t slot )
+    {
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eTaskShaderEXT | vk::PipelineStageFlagBits2::eMeshShaderEXT,
+               vk::AccessFlagBits2::eShaderStorageWrite,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferRead );
+      cmd.copyBuffer( counters.buffer, readback[slot].buffer, vk::BufferCopy{ 0, 0, StatsSize } );
+      barrier( cmd, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead );
+      pendingLods[slot] = pendingLodCount;
+    }
+
+    void collect( uint32_t slot )
+    {
+      if ( !pendingLods[slot] )
+        return;
+
+      uint32_t lodCount = *pendingLods[slot];
+      pendingLods[slot].reset();
+
+      vmaInvalidateAllocation( allocator, readback[slot].allocation, 0, VK_WHOLE_SIZE );
+      auto const * values = static_cast<uint32_t const *>( readback[slot].allocationInfo.pMappedData );
+
+      stats = Stats{};
+      for ( uint32_t lod = 0; lod < lodCount; ++lod )
+      {
+        stats.lodInstances[lod] = values[lod];
+        stats.drawn += values[lod];
+        stats.triangles += uint64_t( model->lods[lod].triangleCount() ) * values[lod];
+      }
+      stats.meshlets   = values[Model::MaxLods];
+      stats.coneCulled = values[Model::MaxLods + 1];
+    }
+
+  private:
+    VmaAllocator                      allocator = nullptr;
+    Model const *                     model     = nullptr;
+    std::optional<raii::ShaderBundle> shaders;  // triangle.frag with the task and mesh stage
+
+    core::Buffer counters;
+    uint32_t     countersIndex   = InvalidBindlessIndex;
+    uint32_t     pendingLodCount = 1;  // lod count of the last draw()
+
+    // VK_EXT_mesh_shader limits, read in init()
+    uint32_t                maxMeshGroups      = 0;  // per task workgroup, min of maxMeshWorkGroupCount[0] and the total
+    std::array<uint32_t, 2> maxTaskGroups      = {};
+    uint32_t                maxTaskGroupsTotal = 0;
+
+    // Task workgroups for `instanceCount` instances, rows of maxTaskWorkGroupCount[0] when x alone is not enough
+    [[nodiscard]] vk::Extent2D taskGroups( uint32_t instanceCount, uint32_t perGroup ) const
+    {
+      uint32_t count = ( instanceCount + perGroup - 1 ) / perGroup;
+      uint32_t width = std::clamp( count, 1u, maxTaskGroups[0] );
+      return { width, ( count + width - 1 ) / width };
+    }
+
+    std::array<core::Buffer, global::state::MAX_FRAMES_IN_FLIGHT>            readback;
+    std::array<std::optional<uint32_t>, global::state::MAX_FRAMES_IN_FLIGHT> pendingLods;
+
+    static void barrier( vk::raii::CommandBuffer const & cmd,
+                         vk::PipelineStageFlags2         srcStage,
+                         vk::AccessFlags2                srcAccess,
+                         vk::PipelineStageFlags2         dstStage,
+                         vk::AccessFlags2                dstAccess )
+    {
+      vk::MemoryBarrier2 memoryBarrier{ srcStage, srcAccess, dstStage, dstAccess };
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( memoryBarrier ) );
+    }
+  };
+
+  // Benchmark: renders the current view with every render path for FramesPerPath frames after WarmupFrames,
+  // the vertex path with CullMode::Frustum so both do the same culling work, and sums the GPU time of the
+  // cull and draw scopes of every measured frame
+  struct RenderPathComparison
+  {
+    static constexpr uint32_t                  WarmupFrames  = 16;
+    static constexpr uint32_t                  FramesPerPath = 128;
+    static constexpr std::array<RenderPath, 2> Paths         = { RenderPath::Vertex, RenderPath::Mesh };
+
+    struct Result
+    {
+      RenderPath path      = RenderPath::Vertex;
+      uint32_t   frames    = 0;
+      double     ms        = 0.0;  // sums over `frames`
+      double     drawn     = 0.0;
+      double     triangles = 0.0;
+    };
+
+    bool                active = false;
+    std::vector<Result> results;
+
+    void start( RenderPath currentPath, CullMode currentMode )
+    {
+      active    = true;
+      phase     = 0;
+      frame     = 0;
+      savedPath = currentPath;
+      savedMode = currentMode;
+      results.clear();
+      for ( RenderPath path : Paths )
+        results.push_back( { path } );
+      slotPhase.fill( -1 );
+    }
+
+    // Before recording a frame, selects the path and cull mode being measured
+    void apply( uint32_t slot, RenderPath & path, CullMode & mode )
+    {
+      if ( !active )
+        return;
+
+      if ( phase < Paths.size() )
+      {
+        path            = Paths[phase];
+        mode            = CullMode::Frustum;
+        slotPhase[slot] = frame >= WarmupFrames ? static_cast<int32_t>( phase ) : -1;
+        if ( ++frame == WarmupFrames + FramesPerPath )
+        {
+          frame = 0;
+          ++phase;
+        }
+        return;
+      }
+
+      path   = savedPath;
+      mode   = savedMode;
+      active = std::any_of( slotPhase.begin(), slotPhase.end(), []( int32_t p ) { return p >= 0; } );
+    }
+
+    // After the slot's fence signaled, attributes the read back results to the path it rendered with.
+    // `ms` is the GPU time of the slot's cull and draw scopes.
+    void record( uint32_t slot, float ms, InstanceCuller::Stats const & vertexStats, MeshRenderer::Stats const & meshStats )
+    {
+      if ( slotPhase[slot] < 0 )
+        return;
+
+      Result & result = results[static_cast<size_t>( slotPhase[slot] )];
+      bool     mesh   = result.path == RenderPath::Mesh;
+      result.frames++;
+      result.ms += ms;
+      result.drawn += mesh ? meshStats.drawn : vertexStats.drawn;
+      result.triangles += double( mesh ? meshStats.triangles : vertexStats.triangles );
+      slotPhase[slot] = -1;
+    }
+
+  private:
+    uint32_t                                                 phase     = 0;
+    uint32_t                                                 frame     = 0;
+    RenderPath                                               savedPath = RenderPath::Vertex;
+    CullMode                                                 savedMode = CullMode::Frustum;
+    std::array<int32_t, global::state::MAX_FRAMES_IN_FLIGHT> slotPhase{};
+  };
+}  // namespace core
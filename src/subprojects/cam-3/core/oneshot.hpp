@@ -0,0 +1,127 @@
+#pragma once
+#include "../setup.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Records and submits one command buffer at a time and waits for it, for benchmarks and validation harnesses
+  // of the compute modules. Also moves data between the host and buffers with transfer usage, and reads back
+  // timestamps written into its query pool.
+  struct OneShotQueue
+  {
+    void init( vk::raii::Device const &         device_,
+               vk::raii::PhysicalDevice const & physicalDevice,
+               VmaAllocator                     allocator_,
+               uint32_t                         queueFamily,
+               vk::raii::Queue const &          queue_,
+               uint32_t                         timestamps = 2 )
+    {
+      device    = &device_;
+      allocator = allocator_;
+      queue     = &queue_;
+      period    = physicalDevice.getProperties().limits.timestampPeriod;
+
+      commandPool = vk::raii::CommandPool( device_, vk::CommandPoolCreateInfo{ vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamily } );
+      cmd   = std::move( vk::raii::CommandBuffers( device_, vk::CommandBufferAllocateInfo{ commandPool, vk::CommandBufferLevel::ePrimary, 1 } ).front() );
+      fence = vk::raii::Fence( device_, vk::FenceCreateInfo{} );
+
+      vk::QueryPoolCreateInfo queryInfo{};
+      queryTotal = std::max( timestamps, 2u );
+      queryInfo.setQueryType( vk::QueryType::eTimestamp ).setQueryCount( queryTotal );
+      queries = vk::raii::QueryPool( device_, queryInfo );
+    }
+
+    [[nodiscard]] uint32_t queryCount() const
+    {
+      return queryTotal;
+    }
+
+    // Calls record( cmd ) between begin and end, submits and waits. Shader and transfer writes are made visible
+    // to everything afterwards, including the host and later submits that write the same buffers.
+    template <typename Record>
+    void submit( Record && record )
+    {
+      cmd.reset();
+      cmd.begin( vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+      cmd.resetQueryPool( *queries, 0, queryTotal );
+      record( cmd );
+      vk::MemoryBarrier2 toReaders{ vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer,
+                                    vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferWrite,
+                                    vk::PipelineStageFlagBits2::eAllCommands | vk::PipelineStageFlagBits2::eHost,
+                                    vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite | vk::AccessFlagBits2::eHostRead };
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( toReaders ) );
+      cmd.end();
+
+      vk::CommandBufferSubmitInfo cmdInfo{ *cmd };
+      queue->submit2( vk::SubmitInfo2{}.setCommandBufferInfos( cmdInfo ), *fence );
+      (void)device->waitForFences( { *fence }, VK_TRUE, UINT64_MAX );
+      device->resetFences( { *fence } );
+    }
+
+    // Inside submit(), after everything recorded before it
+    void timestamp( vk::raii::CommandBuffer const & target, uint32_t query ) const
+    {
+      target.writeTimestamp2( vk::PipelineStageFlagBits2::eAllCommands, *queries, query );
+    }
+
+    // Time between two timestamps of the last submit, 0 when they are not available
+    [[nodiscard]] float milliseconds( uint32_t begin, uint32_t end ) const
+    {
+      auto [beginResult, first] = queries.getResult<uint64_t>( begin, 1, sizeof( uint64_t ), vk::QueryResultFlagBits::e64 );
+      auto [endResult, last]    = queries.getResult<uint64_t>( end, 1, sizeof( uint64_t ), vk::QueryResultFlagBits::e64 );
+      if ( beginResult != vk::Result::eSuccess || endResult != vk::Result::eSuccess )
+        return 0.0f;
+      return static_cast<float>( last - first ) * period * 1e-6f;
+    }
+
+    // Copies `values` to the start of a buffer with eTransferDst usage and waits for it
+    template <typename T>
+    void upload( vk::Buffer buffer, std::span<const T> values )
+    {
+      if ( values.empty() )
+        return;
+      constexpr VmaAllocationCreateFlags writable = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+      core::Buffer staging = core::createBuffer( allocator, values.size_bytes(), vk::BufferUsageFlagBits::eTransferSrc, writable );
+      std::memcpy( staging.allocationInfo.pMappedData, values.data(), values.size_bytes() );
+      vmaFlushAllocation( allocator, staging.allocation, 0, VK_WHOLE_SIZE );
+      submit( [&]( vk::raii::CommandBuffer const & target ) { target.copyBuffer( staging.buffer, buffer, vk::BufferCopy{ 0, 0, values.size_bytes() } ); } );
+      core::destroyBuffer( allocator, staging );
+    }
+
+    // Copies the first `elements` values of a buffer with eTransferSrc usage to the host and waits for it
+    template <typename T>
+    [[nodiscard]] std::vector<T> download( vk::Buffer buffer, size_t elements )
+    {
+      constexpr VmaAllocationCreateFlags readback = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+      vk::DeviceSize bytes   = sizeof( T ) * vk::DeviceSize( std::max<size_t>( elements, 1 ) );
+      core::Buffer   staging = core::createBuffer( allocator, bytes, vk::BufferUsageFlagBits::eTransferDst, readback );
+      submit( [&]( vk::raii::CommandBuffer const & target ) { target.copyBuffer( buffer, staging.buffer, vk::BufferCopy{ 0, 0, bytes } ); } );
+
+      vmaInvalidateAllocation( allocator, staging.allocation, 0, VK_WHOLE_SIZE );
+      auto const *   data = static_cast<T const *>( staging.allocationInfo.pMappedData );
+      std::vector<T> result( data, data + elements );
+      core::destroyBuffer( allocator, staging );
+      return result;
+    }
+
+  private:
+    vk::raii::Device const * device      = nullptr;
+    VmaAllocator             allocator   = nullptr;
+    vk::raii::Queue const *  queue       = nullptr;
+    float                    period      = 1.0f;  // ns per timestamp tick
+    uint32_t                 queryTotal  = 0;
+    vk::raii::CommandPool    commandPool = nullptr;
+    vk::raii::CommandBuffer  cmd         = nullptr;
+    vk::raii::Fence          fence       = nullptr;
+    vk::raii::QueryPool      queries     = nullptr;
+  };
+}  // namespace core
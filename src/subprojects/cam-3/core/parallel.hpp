@@ -0,0 +1,62 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace core
+{
+  // Workers for a `threads` argument, 0 means every hardware thread
+  [[nodiscard]] inline uint32_t workerCount( uint32_t threads )
+  {
+    return threads ? threads : std::max( 1u, std::thread::hardware_concurrency() );
+  }
+
+  // fn( i ) for every i below count, on workerCount( threads ) workers taking batches of indices from a shared
+  // counter. Batches are small enough that a few slow items do not leave the other workers idle. The first
+  // exception thrown by fn stops the remaining work and is rethrown here.
+  template <typename Fn>
+  inline void parallelFor( size_t count, uint32_t threads, Fn && fn )
+  {
+    uint32_t workers = static_cast<uint32_t>( std::min<size_t>( workerCount( threads ), count ) );
+    size_t   batch   = std::max<size_t>( 1, count / ( size_t( std::max( workers, 1u ) ) * 16 ) );
+
+    std::atomic<size_t> next = 0;
+    std::exception_ptr  error;
+    std::mutex          errorMutex;
+
+    auto work = [&]
+    {
+      try
+      {
+        for ( size_t first = next.fetch_add( batch ); first < count; first = next.fetch_add( batch ) )
+          for ( size_t i = first; i < std::min( first + batch, count ); ++i )
+            fn( i );
+      }
+      catch ( ... )
+      {
+        std::lock_guard lock( errorMutex );
+        if ( !error )
+          error = std::current_exception();
+        next = count;
+      }
+    };
+
+    if ( workers <= 1 )
+      work();
+    else
+    {
+      std::vector<std::jthread> pool;
+      pool.reserve( workers );
+      for ( uint32_t w = 0; w < workers; ++w )
+        pool.emplace_back( work );
+    }
+
+    if ( error )
+      std::rethrow_exception( error );
+  }
+}  // namespace core
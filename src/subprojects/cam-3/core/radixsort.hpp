@@ -0,0 +1,498 @@
+#pragma once
+#include "../data.hpp"
+#include "../setup.hpp"
+#include "bindless.hpp"
+#include "compute.hpp"
+#include "oneshot.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Value of data::RadixSortPushConstants::pass, mirrors radixsort.glsl
+  enum class RadixSortPass : uint32_t
+  {
+    Histogram = 0,
+    Scatter   = 1,
+  };
+
+  // Keys, and optionally values, sorted in place by RadixSort::record(). Both buffers need storage and transfer
+  // usage, an odd number of digit passes ends with a copy back from the scratch buffers. Without a valueIndex
+  // only the keys are sorted.
+  struct RadixSortBuffers
+  {
+    vk::Buffer keys;
+    uint32_t   keyIndex = InvalidBindlessIndex;
+    vk::Buffer values;
+    uint32_t   valueIndex = InvalidBindlessIndex;
+  };
+
+  // Stable LSD radix sort of 32-bit keys (and 32-bit values) on the GPU, recorded as compute passes into any
+  // command buffer. Keys are sorted 4 bits per pass, as many passes as the significant key bits need:
+  //
+  //   fill       partition counters, histograms and lookback status = 0
+  //   Histogram  per tile of TileSize keys, the digit counts of every pass in one read of the keys
+  //   Scatter    per pass, onesweep: each tile ranks its keys by digit, adds the counts of the tiles before it
+  //              through decoupled lookback, and writes them to their place in the other buffer
+  //
+  // Devices with subgroup arithmetic in compute shaders scan with subgroup operations, others in shared memory.
+  // The passes ping-pong between the caller's buffers and scratch buffers of the capacity.
+  struct RadixSort
+  {
+    static constexpr uint32_t GroupSize      = 128;
+    static constexpr uint32_t ItemsPerThread = 8;
+    static constexpr uint32_t TileSize       = GroupSize * ItemsPerThread;
+    static constexpr uint32_t DigitBits      = 4;
+    static constexpr uint32_t Digits         = 1u << DigitBits;
+    static constexpr uint32_t MaxPasses      = 32 / DigitBits;
+    static constexpr uint32_t MaxKeys        = ( 1u << 30 ) - 1;  // counts have to fit below the lookback flags
+
+    core::Buffer keysTemp;    // uint[capacity]
+    core::Buffer valuesTemp;  // uint[capacity]
+    core::Buffer state;       // counters, histograms and lookback status of radixsort.glsl
+    uint32_t     keysTempIndex   = InvalidBindlessIndex;
+    uint32_t     valuesTempIndex = InvalidBindlessIndex;
+    uint32_t     stateIndex      = InvalidBindlessIndex;
+    uint32_t     capacity        = 0;
+    bool         subgroups       = false;  // radixsort_subgroup.comp is in use
+
+    // `preferSubgroups` false forces the portable shader, for comparing both paths
+    void init( vk::raii::Device const &         device,
+               vk::raii::PhysicalDevice const & physicalDevice,
+               VmaAllocator                     allocator_,
+               BindlessHeap const &             heap,
+               bool                             preferSubgroups = true )
+    {
+      allocator = allocator_;
+      subgroups = preferSubgroups && subgroupArithmeticSupported( physicalDevice );
+      shader    = ComputeShader( device, subgroups ? "radixsort_subgroup.comp" : "radixsort.comp", sizeof( data::RadixSortPushConstants ), { *heap.layout } );
+    }
+
+    // Nothing may still use the previous buffers
+    void resize( BindlessHeap & heap, uint32_t capacity_, uint64_t frame )
+    {
+      destroy( heap, frame );
+      if ( capacity_ > MaxKeys )
+        throw std::runtime_error( "Radix sort of " + std::to_string( capacity_ ) + " keys exceeds " + std::to_string( MaxKeys ) );
+      capacity = capacity_;
+
+      constexpr vk::BufferUsageFlags usage =
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc;
+      auto create = [&]( core::Buffer & buffer, uint32_t & index, vk::DeviceSize bytes )
+      {
+        buffer = core::createBuffer( allocator, std::max<vk::DeviceSize>( bytes, sizeof( uint32_t ) ), usage );
+        index  = heap.addStorageBuffer( buffer.buffer );
+      };
+      create( keysTemp, keysTempIndex, sizeof( uint32_t ) * vk::DeviceSize( capacity ) );
+      create( valuesTemp, valuesTempIndex, sizeof( uint32_t ) * vk::DeviceSize( capacity ) );
+      create( state, stateIndex, stateBytes( MaxPasses, partitionCount( capacity ) ) );
+    }
+
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      for ( uint32_t * index : { &keysTempIndex, &valuesTempIndex, &stateIndex } )
+      {
+        heap.remove( BindlessHeap::StorageBuffers, *index, frame );
+        *index = InvalidBindlessIndex;
+      }
+      for ( core::Buffer * buffer : { &keysTemp, &valuesTemp, &state } )
+        core::destroyBuffer( allocator, *buffer );
+      capacity = 0;
+    }
+
+    // Digit passes for keys whose bits above `keyBits` are zero
+    [[nodiscard]] static uint32_t passCount( uint32_t keyBits )
+    {
+      return std::clamp( ( keyBits + DigitBits - 1 ) / DigitBits, 1u, MaxPasses );
+    }
+
+    [[nodiscard]] static uint32_t partitionCount( uint32_t count )
+    {
+      return ( count + TileSize - 1 ) / TileSize;
+    }
+
+    [[nodiscard]] static vk::DeviceSize stateBytes( uint32_t passes, uint32_t partitions )
+    {
+      return sizeof( uint32_t ) * ( MaxPasses + vk::DeviceSize( MaxPasses ) * Digits + vk::DeviceSize( passes ) * partitions * Digits );
+    }
+
+    // Keys and values read and written by the passes, the histogram pass reads the keys once
+    [[nodiscard]] static uint64_t bytesMoved( uint32_t count, uint32_t keyBits, bool values )
+    {
+      uint64_t perPass = 2 * sizeof( uint32_t ) * uint64_t( values ? 2 : 1 );
+      return uint64_t( count ) * ( sizeof( uint32_t ) + perPass * passCount( keyBits ) );
+    }
+
+    // Sorts the first `count` <= capacity keys by their low `keyBits` bits. Waits for earlier compute use of the
+    // scratch buffers, the keys have to be visible to compute shaders. The result is visible to compute shaders
+    // and transfers recorded afterwards.
+    void record( vk::raii::CommandBuffer const & cmd, BindlessHeap const & heap, RadixSortBuffers const & target, uint32_t count, uint32_t keyBits = 32 ) const
+    {
+      if ( count == 0 )
+        return;
+      if ( count > capacity )
+        throw std::runtime_error( "Radix sort of " + std::to_string( count ) + " keys exceeds the capacity of " + std::to_string( capacity ) );
+
+      uint32_t passes     = passCount( keyBits );
+      uint32_t partitions = partitionCount( count );
+      bool     values     = target.valueIndex != InvalidBindlessIndex;
+
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite );
+      cmd.fillBuffer( state.buffer, 0, stateBytes( passes, partitions ), 0 );
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+
+      data::RadixSortPushConstants pc{};
+      pc.stateBuffer = stateIndex;
+      pc.count       = count;
+      pc.partitions  = partitions;
+      pc.passCount   = passes;
+      pc.keyBuffer   = target.keyIndex;
+      pc.pass        = static_cast<uint32_t>( RadixSortPass::Histogram );
+      dispatch( cmd, heap, pc );
+
+      pc.pass = static_cast<uint32_t>( RadixSortPass::Scatter );
+      for ( uint32_t digitPass = 0; digitPass < passes; ++digitPass )
+      {
+        bool toTemp       = digitPass % 2 == 0;
+        pc.keyBuffer      = toTemp ? target.keyIndex : keysTempIndex;
+        pc.keyOutBuffer   = toTemp ? keysTempIndex : target.keyIndex;
+        pc.valueBuffer    = !values ? InvalidBindlessIndex : toTemp ? target.valueIndex : valuesTempIndex;
+        pc.valueOutBuffer = !values ? InvalidBindlessIndex : toTemp ? valuesTempIndex : target.valueIndex;
+        pc.digitPass      = digitPass;
+        computeBarrier( cmd );
+        dispatch( cmd, heap, pc );
+      }
+
+      if ( passes % 2 == 0 )
+      {
+        barrier( cmd,
+                 vk::PipelineStageFlagBits2::eComputeShader,
+                 vk::AccessFlagBits2::eShaderStorageWrite,
+                 vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer,
+                 vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferRead );
+        return;
+      }
+
+      // The last pass wrote the scratch buffers
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageWrite,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferRead );
+      vk::DeviceSize bytes = sizeof( uint32_t ) * vk::DeviceSize( count );
+      cmd.copyBuffer( keysTemp.buffer, target.keys, vk::BufferCopy{ 0, 0, bytes } );
+      if ( values )
+        cmd.copyBuffer( valuesTemp.buffer, target.values, vk::BufferCopy{ 0, 0, bytes } );
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite,
+               vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferRead );
+    }
+
+  private:
+    VmaAllocator  allocator = nullptr;
+    ComputeShader shader;
+
+    void dispatch( vk::raii::CommandBuffer const & cmd, BindlessHeap const & heap, data::RadixSortPushConstants const & pc ) const
+    {
+      shader.bind( cmd );
+      heap.bind( cmd, *shader.layout, vk::PipelineBindPoint::eCompute );
+      shader.push( cmd, pc );
+      cmd.dispatch( pc.partitions, 1, 1 );
+    }
+
+    static void barrier( vk::raii::CommandBuffer const & cmd,
+                         vk::PipelineStageFlags2         srcStage,
+                         vk::AccessFlags2                srcAccess,
+                         vk::PipelineStageFlags2         dstStage,
+                         vk::AccessFlags2                dstAccess )
+    {
+      vk::MemoryBarrier2 memoryBarrier{ srcStage, srcAccess, dstStage, dstAccess };
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( memoryBarrier ) );
+    }
+
+    static void computeBarrier( vk::raii::CommandBuffer const & cmd )
+    {
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageWrite,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+    }
+  };
+
+  // Key and value buffers of a RadixSort harness, allocated together with the sort's scratch buffers
+  struct RadixSortScratch
+  {
+    RadixSort    sort;
+    core::Buffer keys;
+    core::Buffer values;
+    core::Buffer source;  // keys restored before every timed sort
+    uint32_t     keyIndex   = InvalidBindlessIndex;
+    uint32_t     valueIndex = InvalidBindlessIndex;
+
+    void create( vk::raii::Device const &         device,
+                 vk::raii::PhysicalDevice const & physicalDevice,
+                 VmaAllocator                     allocator_,
+                 BindlessHeap &                   heap,
+                 bool                             preferSubgroups,
+                 uint32_t                         capacity,
+                 uint64_t                         frame )
+    {
+      allocator = allocator_;
+      sort.init( device, physicalDevice, allocator, heap, preferSubgroups );
+      sort.resize( heap, capacity, frame );
+
+      constexpr vk::BufferUsageFlags usage =
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc;
+      vk::DeviceSize bytes = sizeof( uint32_t ) * vk::DeviceSize( std::max( capacity, 1u ) );
+      keys                 = core::createBuffer( allocator, bytes, usage );
+      values               = core::createBuffer( allocator, bytes, usage );
+      source               = core::createBuffer( allocator, bytes, usage );
+      keyIndex             = heap.addStorageBuffer( keys.buffer );
+      valueIndex           = heap.addStorageBuffer( values.buffer );
+    }
+
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      heap.remove( BindlessHeap::StorageBuffers, keyIndex, frame );
+      heap.remove( BindlessHeap::StorageBuffers, valueIndex, frame );
+      keyIndex   = InvalidBindlessIndex;
+      valueIndex = InvalidBindlessIndex;
+      for ( core::Buffer * buffer : { &keys, &values, &source } )
+        core::destroyBuffer( allocator, *buffer );
+      sort.destroy( heap, frame );
+    }
+
+    [[nodiscard]] RadixSortBuffers target( bool withValues ) const
+    {
+      return { keys.buffer, keyIndex, withValues ? values.buffer : vk::Buffer{}, withValues ? valueIndex : InvalidBindlessIndex };
+    }
+
+    // Random keys below 2^keyBits
+    [[nodiscard]] static std::vector<uint32_t> randomKeys( uint32_t count, uint32_t keyBits, uint32_t seed )
+    {
+      std::mt19937          rng( seed );
+      uint32_t              mask = keyBits >= 32 ? 0xFFFFFFFFu : ( 1u << keyBits ) - 1;
+      std::vector<uint32_t> keys( count );
+      for ( uint32_t & key : keys )
+        key = rng() & mask;
+      return keys;
+    }
+
+  private:
+    VmaAllocator allocator = nullptr;
+  };
+
+  // Sorts random keys on both paths, keys only and with their input index as value, and checks the result against
+  // std::stable_sort: the same keys in the same order, and equal keys in input order.
+  struct RadixSortValidation
+  {
+    struct Result
+    {
+      uint32_t    count     = 0;
+      uint32_t    keyBits   = 0;
+      bool        values    = false;
+      bool        subgroups = false;
+      float       gpuMs     = 0.0f;
+      float       cpuMs     = 0.0f;  // std::stable_sort of the indices
+      std::string error;             // first mismatch, empty when valid
+    };
+
+    uint32_t            count   = 1000000;
+    uint32_t            keyBits = 32;  // fewer bits give more equal keys, odd digit pass counts end with a copy
+    uint32_t            seed    = 1;
+    std::vector<Result> results;
+
+    void run( vk::raii::Device const &         device,
+              vk::raii::PhysicalDevice const & physicalDevice,
+              VmaAllocator                     allocator,
+              BindlessHeap &                   heap,
+              uint32_t                         queueFamily,
+              vk::raii::Queue const &          queue,
+              uint64_t                         frame )
+    {
+      using Clock = std::chrono::steady_clock;
+
+      uint32_t              n    = std::clamp( count, 1u, RadixSort::MaxKeys );
+      std::vector<uint32_t> keys = RadixSortScratch::randomKeys( n, keyBits, seed );
+      std::vector<uint32_t> indices( n );
+      std::iota( indices.begin(), indices.end(), 0u );
+
+      auto                  begin = Clock::now();
+      std::vector<uint32_t> order = indices;
+      std::stable_sort( order.begin(), order.end(), [&]( uint32_t a, uint32_t b ) { return keys[a] < keys[b]; } );
+      float cpuMs = std::chrono::duration<float, std::milli>( Clock::now() - begin ).count();
+
+      OneShotQueue runner;
+      runner.init( device, physicalDevice, allocator, queueFamily, queue );
+
+      results.clear();
+      for ( bool preferSubgroups : { false, true } )
+      {
+        if ( preferSubgroups && !subgroupArithmeticSupported( physicalDevice ) )
+          break;
+
+        RadixSortScratch scratch;
+        scratch.create( device, physicalDevice, allocator, heap, preferSubgroups, n, frame );
+        for ( bool values : { false, true } )
+        {
+          runner.upload<uint32_t>( scratch.keys.buffer, keys );
+          runner.upload<uint32_t>( scratch.values.buffer, indices );
+          runner.submit(
+            [&]( vk::raii::CommandBuffer const & cmd )
+            {
+              runner.timestamp( cmd, 0 );
+              scratch.sort.record( cmd, heap, scratch.target( values ), n, keyBits );
+              runner.timestamp( cmd, 1 );
+            } );
+
+          Result result{};
+          result.count     = n;
+          result.keyBits   = keyBits;
+          result.values    = values;
+          result.subgroups = scratch.sort.subgroups;
+          result.gpuMs     = runner.milliseconds( 0, 1 );
+          result.cpuMs     = cpuMs;
+
+          std::vector<uint32_t> sortedKeys   = runner.download<uint32_t>( scratch.keys.buffer, n );
+          std::vector<uint32_t> sortedValues = values ? runner.download<uint32_t>( scratch.values.buffer, n ) : std::vector<uint32_t>{};
+          for ( uint32_t i = 0; i < n && result.error.empty(); ++i )
+          {
+            if ( sortedKeys[i] != keys[order[i]] )
+              result.error = "key " + std::to_string( i ) + " is " + std::to_string( sortedKeys[i] ) + ", expected " + std::to_string( keys[order[i]] );
+            else if ( values && sortedValues[i] != order[i] )
+              result.error = "value " + std::to_string( i ) + " is " + std::to_string( sortedValues[i] ) + ", expected " + std::to_string( order[i] );
+          }
+
+          results.push_back( result );
+          isDebug( std::println( "[radixsort] {} {}-bit keys{}, {}: GPU {:.3f} ms, CPU {:.2f} ms: {}",
+                                 result.count,
+                                 result.keyBits,
+                                 values ? " and values" : "",
+                                 result.subgroups ? "subgroups" : "portable",
+                                 result.gpuMs,
+                                 result.cpuMs,
+                                 result.error.empty() ? "valid" : result.error ) );
+        }
+        scratch.destroy( heap, frame );
+      }
+    }
+  };
+
+  // GPU time of RadixSort over key counts from 64k to 16M, keys only and with values, on both paths. The keys are
+  // restored from a copy before every sort, only the sort is timed.
+  struct RadixSortBenchmark
+  {
+    static constexpr std::array<uint32_t, 5> Counts = { 1u << 16, 1u << 18, 1u << 20, 1u << 22, 1u << 24 };
+
+    struct Result
+    {
+      uint32_t count              = 0;
+      bool     values             = false;
+      bool     subgroups          = false;
+      float    ms                 = 0.0f;  // per sort
+      float    keysPerSecond      = 0.0f;  // millions
+      float    gigabytesPerSecond = 0.0f;  // RadixSort::bytesMoved
+    };
+
+    uint32_t            keyBits    = 32;
+    uint32_t            iterations = 16;
+    std::vector<Result> results;
+
+    void run( vk::raii::Device const &         device,
+              vk::raii::PhysicalDevice const & physicalDevice,
+              VmaAllocator                     allocator,
+              BindlessHeap &                   heap,
+              uint32_t                         queueFamily,
+              vk::raii::Queue const &          queue,
+              uint64_t                         frame )
+    {
+      uint32_t repeats = std::max( iterations, 1u );
+      uint32_t largest = Counts.back();
+
+      OneShotQueue runner;
+      runner.init( device, physicalDevice, allocator, queueFamily, queue, 2 * repeats );
+
+      results.clear();
+      for ( bool preferSubgroups : { false, true } )
+      {
+        if ( preferSubgroups && !subgroupArithmeticSupported( physicalDevice ) )
+          break;
+
+        RadixSortScratch scratch;
+        scratch.create( device, physicalDevice, allocator, heap, preferSubgroups, largest, frame );
+        runner.upload<uint32_t>( scratch.source.buffer, RadixSortScratch::randomKeys( largest, keyBits, 1 ) );
+
+        for ( bool values : { false, true } )
+          for ( uint32_t count : Counts )
+          {
+            runner.submit(
+              [&]( vk::raii::CommandBuffer const & cmd )
+              {
+                for ( uint32_t i = 0; i < repeats; ++i )
+                {
+                  vk::MemoryBarrier2 toCopy{ vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer,
+                                             vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite |
+                                               vk::AccessFlagBits2::eTransferWrite,
+                                             vk::PipelineStageFlagBits2::eTransfer,
+                                             vk::AccessFlagBits2::eTransferWrite };
+                  cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( toCopy ) );
+                  cmd.copyBuffer( scratch.source.buffer, scratch.keys.buffer, vk::BufferCopy{ 0, 0, sizeof( uint32_t ) * vk::DeviceSize( count ) } );
+                  vk::MemoryBarrier2 toSort{ vk::PipelineStageFlagBits2::eTransfer,
+                                             vk::AccessFlagBits2::eTransferWrite,
+                                             vk::PipelineStageFlagBits2::eComputeShader,
+                                             vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite };
+                  cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( toSort ) );
+
+                  runner.timestamp( cmd, 2 * i );
+                  scratch.sort.record( cmd, heap, scratch.target( values ), count, keyBits );
+                  runner.timestamp( cmd, 2 * i + 1 );
+                }
+              } );
+
+            Result result{};
+            result.count     = count;
+            result.values    = values;
+            result.subgroups = scratch.sort.subgroups;
+            for ( uint32_t i = 0; i < repeats; ++i )
+              result.ms += runner.milliseconds( 2 * i, 2 * i + 1 ) / float( repeats );
+            if ( result.ms > 0.0f )
+            {
+              result.keysPerSecond      = float( count ) / result.ms * 1e-3f;
+              result.gigabytesPerSecond = float( RadixSort::bytesMoved( count, keyBits, values ) ) / result.ms * 1e-6f;
+            }
+            results.push_back( result );
+
+            isDebug( std::println( "[radixsort] {} keys{}, {}: {:.3f} ms, {:.0f} M keys/s, {:.1f} GB/s",
+                                   result.count,
+                                   values ? " and values" : "",
+                                   result.subgroups ? "subgroups" : "portable",
+                                   result.ms,
+                                   result.keysPerSecond,
+                                   result.gigabytesPerSecond ) );
+          }
+        scratch.destroy( heap, frame );
+      }
+    }
+  };
+}  // namespace core
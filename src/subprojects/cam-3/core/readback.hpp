@@ -0,0 +1,353 @@
+#pragma once
+#include "../helper.hpp"
+#include "../setup.hpp"
+#include "../state.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <print>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // One frame of a ReadbackRing as the host sees it after the GPU finished its copies. Spans stay valid while
+  // the consumer runs only.
+  struct ReadbackFrame
+  {
+    uint64_t frame   = 0;  // frame count the copies were recorded in
+    uint64_t latency = 0;  // frames between recording and delivery
+
+    // What was copied into `stream` this frame as T, empty when nothing was
+    template <typename T>
+    [[nodiscard]] std::span<const T> view( uint32_t stream ) const
+    {
+      return { reinterpret_cast<T const *>( data + offsets[stream] ), size_t( written[stream] / sizeof( T ) ) };
+    }
+
+    [[nodiscard]] vk::DeviceSize bytes( uint32_t stream ) const
+    {
+      return written[stream];
+    }
+
+    std::byte const *               data = nullptr;
+    std::span<const vk::DeviceSize> offsets;
+    std::span<const vk::DeviceSize> written;
+  };
+
+  // Asynchronous GPU to host readback. Every frame the GPU copies the source buffers of a set of streams into the
+  // next slot of a ring of host cached buffers and signals a timeline semaphore with the slot's value. The host
+  // polls the counter and hands slots it has passed to a consumer, oldest first, so results arrive a few frames
+  // after they were recorded and nothing ever waits:
+  //
+  //   record  per frame, into the command buffer of the frame slot: copies of every stream, submitted after the
+  //           commands writing the sources with signalInfo() among the submit's signal semaphores
+  //   poll    per frame, delivers every finished slot as a ReadbackFrame and frees it
+  //
+  // When every slot is still waiting for the host the frame is dropped instead, which only happens when poll() is
+  // called less often than record().
+  struct ReadbackRing
+  {
+    static constexpr uint32_t       MaxSlots  = 8;
+    static constexpr vk::DeviceSize Alignment = 256;  // of every stream, covers nonCoherentAtomSize on current devices
+
+    uint64_t delivered = 0;
+    uint64_t dropped   = 0;  // frames not recorded for lack of a free slot, or recorded and discarded by configure()
+    uint64_t latency   = 0;  // of the last delivered frame
+
+    void init( vk::raii::Device const & device, VmaAllocator allocator_, uint32_t queueFamily, uint32_t slots = global::state::MAX_FRAMES_IN_FLIGHT + 1 )
+    {
+      if ( slots < 2 || slots > MaxSlots )
+        throw std::runtime_error( "Readback rings have 2 to " + std::to_string( MaxSlots ) + " slots" );
+      allocator = allocator_;
+      slotCount = slots;
+
+      vk::SemaphoreTypeCreateInfo timeline{ vk::SemaphoreType::eTimeline, 0 };
+      semaphore   = vk::raii::Semaphore( device, vk::SemaphoreCreateInfo{}.setPNext( &timeline ) );
+      commandPool = vk::raii::CommandPool( device, vk::CommandPoolCreateInfo{ vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamily } );
+      frameCmds   = vk::raii::CommandBuffers(
+        device, vk::CommandBufferAllocateInfo{ commandPool, vk::CommandBufferLevel::ePrimary, uint32_t( global::state::MAX_FRAMES_IN_FLIGHT ) } );
+    }
+
+    // One stream per entry of `capacities`, in bytes. Reallocates every slot, nothing may still use the previous
+    // ones (wait for the device first); frames not delivered yet are dropped.
+    void configure( std::span<const vk::DeviceSize> capacities )
+    {
+      destroy();
+      vk::DeviceSize total = 0;
+      for ( vk::DeviceSize capacity : capacities )
+      {
+        offsets.push_back( total );
+        total += ( capacity + Alignment - 1 ) / Alignment * Alignment;
+      }
+      streamCapacities.assign( capacities.begin(), capacities.end() );
+      if ( total == 0 )
+        return;
+
+      constexpr VmaAllocationCreateFlags readback = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      for ( uint32_t i = 0; i < slotCount; ++i )
+      {
+        slots[i].buffer = core::createBuffer( allocator, total, vk::BufferUsageFlagBits::eTransferDst, readback );
+        slots[i].written.assign( capacities.size(), 0 );
+      }
+    }
+
+    void destroy()
+    {
+      for ( Slot & slot : slots )
+      {
+        if ( slot.pending )
+          ++dropped;
+        core::destroyBuffer( allocator, slot.buffer );
+        slot = Slot{};
+      }
+      offsets.clear();
+      streamCapacities.clear();
+      head = 0;
+      tail = 0;
+    }
+
+    [[nodiscard]] uint32_t streamCount() const
+    {
+      return uint32_t( offsets.size() );
+    }
+
+    [[nodiscard]] vk::DeviceSize bytesPerSlot() const
+    {
+      return slots[0].buffer.size;
+    }
+
+    // Copies recorded by record( cmd ), which calls copy() for the streams it fills, into the command buffer of
+    // frame slot `frameSlot`. nullptr when no stream is configured or every ring slot is taken, nothing has to be
+    // submitted or signaled then.
+    template <typename Record>
+    [[nodiscard]] vk::CommandBuffer record( uint32_t frameSlot, uint64_t frame, Record && record )
+    {
+      if ( streamCount() == 0 || !slots[0].buffer.buffer )
+        return nullptr;
+      Slot & slot = slots[head];
+      if ( slot.pending )
+      {
+        ++dropped;
+        return nullptr;
+      }
+
+      auto & cmd = frameCmds[frameSlot];
+      cmd.reset();
+      cmd.begin( vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferWrite,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferRead | vk::AccessFlagBits2::eTransferWrite );
+
+      std::fill( slot.written.begin(), slot.written.end(), vk::DeviceSize( 0 ) );
+      recording = &slot;
+      record( cmd );
+      recording = nullptr;
+
+      barrier(
+        cmd, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead );
+      cmd.end();
+
+      slot.value   = ++timelineValue;
+      slot.frame   = frame;
+      slot.pending = true;
+      head         = ( head + 1 ) % slotCount;
+      return *cmd;
+    }
+
+    // Inside record(): `bytes` of `source` from `sourceOffset` into `stream`, at most its capacity
+    void copy( vk::raii::CommandBuffer const & cmd, uint32_t stream, vk::Buffer source, vk::DeviceSize sourceOffset, vk::DeviceSize bytes )
+    {
+      if ( !recording )
+        throw std::runtime_error( "Readback copies have to be recorded inside ReadbackRing::record()" );
+      if ( stream >= streamCount() || bytes > streamCapacities[stream] )
+        throw std::runtime_error( "Readback of " + std::to_string( bytes ) + " bytes does not fit into stream " + std::to_string( stream ) );
+      if ( bytes == 0 )
+        return;
+      cmd.copyBuffer( source, recording->buffer.buffer, vk::BufferCopy{ sourceOffset, offsets[stream], bytes } );
+      recording->written[stream] = bytes;
+    }
+
+    // Signals the value of the last record() that returned a command buffer, add it to that frame's submit
+    [[nodiscard]] vk::SemaphoreSubmitInfo signalInfo() const
+    {
+      return vk::SemaphoreSubmitInfo{}.setSemaphore( *semaphore ).setValue( timelineValue ).setStageMask( vk::PipelineStageFlagBits2::eAllCommands );
+    }
+
+    // Hands every slot the GPU has finished to consume( ReadbackFrame const & ), oldest first, and frees them.
+    // Never waits, returns the number of frames delivered.
+    template <typename Consume>
+    uint32_t poll( uint64_t frame, Consume && consume )
+    {
+      if ( !*semaphore )
+        return 0;
+      uint64_t completed = semaphore.getCounterValue();
+      uint32_t count     = 0;
+      while ( slots[tail].pending && slots[tail].value <= completed )
+      {
+        Slot & slot = slots[tail];
+        vmaInvalidateAllocation( allocator, slot.buffer.allocation, 0, VK_WHOLE_SIZE );
+
+        ReadbackFrame view;
+        view.frame   = slot.frame;
+        view.latency = frame - slot.frame;
+        view.data    = static_cast<std::byte const *>( slot.buffer.allocationInfo.pMappedData );
+        view.offsets = offsets;
+        view.written = slot.written;
+        consume( view );
+
+        slot.pending = false;
+        latency      = view.latency;
+        tail         = ( tail + 1 ) % slotCount;
+        ++delivered;
+        ++count;
+      }
+      return count;
+    }
+
+  private:
+    struct Slot
+    {
+      core::Buffer                buffer;
+      std::vector<vk::DeviceSize> written;  // bytes copied per stream
+      uint64_t                    value   = 0;
+      uint64_t                    frame   = 0;
+      bool                        pending = false;  // recorded and not delivered yet
+    };
+
+    VmaAllocator                allocator     = nullptr;
+    vk::raii::Semaphore         semaphore     = nullptr;  // timeline, the value of every slot recorded so far
+    vk::raii::CommandPool       commandPool   = nullptr;
+    vk::raii::CommandBuffers    frameCmds     = nullptr;
+    std::array<Slot, MaxSlots>  slots;
+    uint32_t                    slotCount     = 0;
+    uint32_t                    head          = 0;  // next slot recorded
+    uint32_t                    tail          = 0;  // next slot delivered
+    uint64_t                    timelineValue = 0;
+    Slot *                      recording     = nullptr;
+    std::vector<vk::DeviceSize> offsets;
+    std::vector<vk::DeviceSize> streamCapacities;
+
+    static void barrier( vk::raii::CommandBuffer const & cmd,
+                         vk::PipelineStageFlags2         srcStage,
+                         vk::AccessFlags2                srcAccess,
+                         vk::PipelineStageFlags2         dstStage,
+                         vk::AccessFlags2                dstAccess )
+    {
+      vk::MemoryBarrier2 memoryBarrier{ srcStage, srcAccess, dstStage, dstAccess };
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( memoryBarrier ) );
+    }
+  };
+
+  // Streams `megabytes` per frame through a ReadbackRing while enabled. Every frame fills a device buffer with a
+  // word derived from the frame count and copies it into the ring, the consumer checks every word of every
+  // delivered frame and that frames arrive in order.
+  struct ReadbackStress
+  {
+    bool         enabled        = false;
+    uint32_t     megabytes      = 16;
+    uint64_t     frames         = 0;  // delivered since the start
+    uint64_t     bytes          = 0;
+    uint64_t     corrupted      = 0;     // frames with a wrong word or out of order
+    float        pollMs         = 0.0f;  // host time of the last poll, verification included
+    float        averageLatency = 0.0f;  // in frames
+    std::string  error;                  // first failure
+    ReadbackRing ring;
+
+    void init( vk::raii::Device const & device, VmaAllocator allocator_, uint32_t queueFamily )
+    {
+      allocator = allocator_;
+      ring.init( device, allocator_, queueFamily );
+    }
+
+    // Reallocates for `megabytes` and clears the statistics, nothing may still use the previous buffers
+    void start()
+    {
+      stop();
+      vk::DeviceSize size = vk::DeviceSize( std::max( megabytes, 1u ) ) << 20;
+      source = core::createBuffer( allocator, size, vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst );
+      std::array<vk::DeviceSize, 1> capacities = { size };
+      ring.configure( capacities );
+      frames         = 0;
+      bytes          = 0;
+      corrupted      = 0;
+      averageLatency = 0.0f;
+      lastFrame      = 0;
+      ring.delivered = 0;
+      ring.dropped   = 0;
+      error.clear();
+      enabled = true;
+    }
+
+    // Nothing may still use the buffers
+    void stop()
+    {
+      enabled = false;
+      ring.destroy();
+      core::destroyBuffer( allocator, source );
+    }
+
+    [[nodiscard]] static uint32_t pattern( uint64_t frame )
+    {
+      return uint32_t( frame * 2654435761u ) ^ 0xA5A5A5A5u;
+    }
+
+    [[nodiscard]] vk::CommandBuffer record( uint32_t frameSlot, uint64_t frame )
+    {
+      if ( !enabled )
+        return nullptr;
+      return ring.record( frameSlot,
+                          frame,
+                          [&]( vk::raii::CommandBuffer const & cmd )
+                          {
+                            cmd.fillBuffer( source.buffer, 0, VK_WHOLE_SIZE, pattern( frame ) );
+                            vk::MemoryBarrier2 filled{ vk::PipelineStageFlagBits2::eTransfer,
+                                                       vk::AccessFlagBits2::eTransferWrite,
+                                                       vk::PipelineStageFlagBits2::eTransfer,
+                                                       vk::AccessFlagBits2::eTransferRead };
+                            cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( filled ) );
+                            ring.copy( cmd, 0, source.buffer, 0, source.size );
+                          } );
+    }
+
+    void collect( uint64_t frame )
+    {
+      if ( !enabled )
+        return;
+      auto begin = std::chrono::steady_clock::now();
+      ring.poll( frame,
+                 [&]( ReadbackFrame const & delivered )
+                 {
+                   std::span<const uint32_t> words    = delivered.view<uint32_t>( 0 );
+                   uint32_t                  expected = pattern( delivered.frame );
+                   bool                      ordered  = frames == 0 || delivered.frame > lastFrame;
+                   bool                      intact   = std::all_of( words.begin(), words.end(), [&]( uint32_t word ) { return word == expected; } );
+                   if ( !ordered || !intact )
+                   {
+                     ++corrupted;
+                     if ( error.empty() )
+                       error = "frame " + std::to_string( delivered.frame ) + " arrived out of order or with other contents";
+                   }
+                   lastFrame = delivered.frame;
+                   ++frames;
+                   bytes += delivered.bytes( 0 );
+                   averageLatency += ( float( delivered.latency ) - averageLatency ) / float( frames );
+                 } );
+      pollMs = std::chrono::duration<float, std::milli>( std::chrono::steady_clock::now() - begin ).count();
+    }
+
+  private:
+    VmaAllocator allocator = nullptr;
+    core::Buffer source;
+    uint64_t     lastFrame = 0;
+  };
+}  // namespace core
@@ -0,0 +1,257 @@
+#pragma once
+#include "../setup.hpp"
+#include "../state.hpp"
+#include "../structs.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Stable handle into the ResourceTable. Stays valid when the underlying VkBuffer/VkImage is replaced
+  // (defragmentation moves, reallocation), so anything that stores a handle instead of a raw Vulkan object
+  // only has to look it up again when the generation changes.
+  using ResourceHandle = uint32_t;
+
+  inline constexpr ResourceHandle InvalidResource = UINT32_MAX;
+
+  enum class ResourceKind : uint8_t
+  {
+    Buffer,
+    Texture
+  };
+
+  struct ResourceEntry
+  {
+    ResourceKind         kind = ResourceKind::Buffer;
+    core::Buffer         buffer;
+    core::Texture        texture;
+    vk::BufferUsageFlags bufferUsage;
+    vk::ImageUsageFlags  imageUsage;
+    vk::ImageAspectFlags aspect;
+    vk::ImageLayout      layout     = vk::ImageLayout::eUndefined;  // layout the texture is left in between frames, see setLayout()
+    uint32_t             generation = 0;                            // bumped every time the Vulkan handle changes
+    bool                 alive      = false;
+    bool                 pinned     = false;  // never moved by the defragmenter, see ResourceTable::createBuffer
+  };
+
+  // Indirection table for VMA backed buffers and textures.
+  // Every allocation stores its handle (+1) in pUserData so VMA callbacks and defragmentation moves can find
+  // the owning entry. Allocations without user data (swapchain targets etc.) are never touched.
+  // The instance buffer and the model's buffers live here next to the allocations churned from the Memory window.
+  // Buffers the GPU rewrites while frames are in flight would be pinned anyway and are still created with
+  // core::createBuffer.
+  struct ResourceTable
+  {
+    vk::Device   device    = nullptr;
+    VmaAllocator allocator = nullptr;
+
+    std::vector<ResourceEntry>  entries;
+    std::vector<ResourceHandle> freeHandles;
+
+    // Handles whose Vulkan objects changed since the last takePatched(), consumers rebuild descriptors from it
+    std::vector<ResourceHandle> patched;
+
+    // Set while a defragmentation pass owns the allocations, releases are held back until it is cleared
+    bool locked = false;
+
+    struct Retired
+    {
+      ResourceHandle handle;
+      uint64_t       frame;
+    };
+
+    std::vector<Retired> retired;
+
+    void init( vk::Device device_, VmaAllocator allocator_ )
+    {
+      device    = device_;
+      allocator = allocator_;
+    }
+
+    // A pinned resource is never moved. Pin everything the GPU writes while frames are in flight: frames recorded
+    // between the defragmenter's copy and the table patch still write the old object, and those writes are lost.
+    // Host mapped buffers are pinned as well, the CPU writes them at arbitrary times through the old mapping.
+    [[nodiscard]] ResourceHandle createBuffer( vk::DeviceSize size, vk::BufferUsageFlags usage, VmaAllocationCreateFlags flags = 0, bool pinned = false )
+    {
+      // transfer bits are needed so the defragmenter can copy the contents into the new location
+      usage |= vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+      return adoptBuffer( core::createBuffer( allocator, size, usage, flags ), pinned );
+    }
+
+    // Takes over a buffer made with core::createBuffer, for loaders that create their buffers on other threads.
+    // It is destroyed with the table from now on. Buffers without both transfer usages cannot be copied and stay
+    // pinned, like host mapped ones.
+    [[nodiscard]] ResourceHandle adoptBuffer( core::Buffer buffer, bool pinned = false )
+    {
+      constexpr vk::BufferUsageFlags transfer = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+
+      ResourceHandle  handle = acquireHandle();
+      ResourceEntry & entry  = entries[handle];
+      entry                  = ResourceEntry{};
+      entry.kind             = ResourceKind::Buffer;
+      entry.bufferUsage      = vk::BufferUsageFlags( buffer.usage );
+      entry.buffer           = buffer;
+      entry.alive            = true;
+      entry.pinned           = pinned || buffer.allocationInfo.pMappedData != nullptr || ( entry.bufferUsage & transfer ) != transfer;
+
+      vmaSetAllocationUserData( allocator, entry.buffer.allocation, toUserData( handle ) );
+      return handle;
+    }
+
+    [[nodiscard]] ResourceHandle
+      createTexture( vk::Extent2D extent, vk::Format format, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspect, bool pinned = false )
+    {
+      usage |= vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst;
+
+      ResourceHandle  handle = acquireHandle();
+      ResourceEntry & entry  = entries[handle];
+      entry                  = ResourceEntry{};
+      entry.kind             = ResourceKind::Texture;
+      entry.imageUsage       = usage;
+      entry.aspect           = aspect;
+      entry.texture          = core::createTexture( device, allocator, extent, format, usage, aspect );
+      entry.alive            = true;
+      entry.pinned           = pinned;
+
+      vmaSetAllocationUserData( allocator, entry.texture.allocation, toUserData( handle ) );
+      return handle;
+    }
+
+    // Owners call this after every layout transition of a texture that outlives the frame. The defragmenter copies a
+    // moved texture out of this layout and leaves the new image in it, contents in eUndefined are not carried over.
+    void setLayout( ResourceHandle handle, vk::ImageLayout layout )
+    {
+      entries[handle].layout = layout;
+    }
+
+    // Queue the resource for destruction once no frame in flight can reference it anymore
+    void release( ResourceHandle handle, uint64_t frame )
+    {
+      if ( handle >= entries.size() || !entries[handle].alive )
+        return;
+
+      entries[handle].alive = false;
+      retired.push_back( { handle, frame } );
+    }
+
+    // Destroy everything released at least MAX_FRAMES_IN_FLIGHT frames ago
+    void collect( uint64_t frame )
+    {
+      if ( locked )
+        return;
+
+      std::erase_if(
+        retired,
+        [&]( Retired const & r )
+        {
+          if ( frame - r.frame < global::state::MAX_FRAMES_IN_FLIGHT )
+            return false;
+          destroyEntry( r.handle );
+          return true;
+        } );
+    }
+
+    [[nodiscard]] ResourceEntry & operator[]( ResourceHandle handle )
+    {
+      return entries[handle];
+    }
+
+    [[nodiscard]] core::Buffer const & buffer( ResourceHandle handle ) const
+    {
+      return entries[handle].buffer;
+    }
+
+    [[nodiscard]] core::Texture const & texture( ResourceHandle handle ) const
+    {
+      return entries[handle].texture;
+    }
+
+    [[nodiscard]] size_t aliveCount() const
+    {
+      return std::count_if( entries.begin(), entries.end(), []( ResourceEntry const & e ) { return e.alive; } );
+    }
+
+    // Called by the defragmenter once the copy into the new allocation finished
+    void patchBuffer( ResourceHandle handle, VkBuffer newBuffer )
+    {
+      ResourceEntry & entry = entries[handle];
+      entry.buffer.buffer   = newBuffer;
+      entry.generation++;
+      patched.push_back( handle );
+    }
+
+    void patchTexture( ResourceHandle handle, vk::Image newImage, vk::ImageView newView )
+    {
+      ResourceEntry & entry   = entries[handle];
+      entry.texture.image     = newImage;
+      entry.texture.imageView = newView;
+      entry.generation++;
+      patched.push_back( handle );
+    }
+
+    // Refresh cached VmaAllocationInfo (offset / memory) after VMA swapped the allocation contents
+    void refreshAllocationInfo( ResourceHandle handle )
+    {
+      ResourceEntry & entry = entries[handle];
+      if ( entry.kind == ResourceKind::Buffer )
+        vmaGetAllocationInfo( allocator, entry.buffer.allocation, &entry.buffer.allocationInfo );
+    }
+
+    [[nodiscard]] std::vector<ResourceHandle> takePatched()
+    {
+      return std::exchange( patched, {} );
+    }
+
+    void destroyAll()
+    {
+      for ( ResourceHandle handle = 0; handle < entries.size(); ++handle )
+        destroyEntry( handle );
+
+      entries.clear();
+      freeHandles.clear();
+      retired.clear();
+      patched.clear();
+    }
+
+    [[nodiscard]] static void * toUserData( ResourceHandle handle )
+    {
+      return reinterpret_cast<void *>( static_cast<uintptr_t>( handle ) + 1 );
+    }
+
+    [[nodiscard]] static ResourceHandle fromUserData( void * userData )
+    {
+      return userData ? static_cast<ResourceHandle>( reinterpret_cast<uintptr_t>( userData ) - 1 ) : InvalidResource;
+    }
+
+  private:
+    ResourceHandle acquireHandle()
+    {
+      if ( !freeHandles.empty() )
+      {
+        ResourceHandle handle = freeHandles.back();
+        freeHandles.pop_back();
+        return handle;
+      }
+      entries.emplace_back();
+      return static_cast<ResourceHandle>( entries.size() - 1 );
+    }
+
+    void destroyEntry( ResourceHandle handle )
+    {
+      ResourceEntry & entry = entries[handle];
+      if ( entry.kind == ResourceKind::Buffer && entry.buffer.allocation )
+        core::destroyBuffer( allocator, entry.buffer );
+      if ( entry.kind == ResourceKind::Texture && entry.texture.allocation )
+        core::destroyTexture( device, allocator, entry.texture );
+
+      if ( !entry.alive && std::find( freeHandles.begin(), freeHandles.end(), handle ) == freeHandles.end() )
+        freeHandles.push_back( handle );
+      entry.alive = false;
+    }
+  };
+}  // namespace core
@@ -0,0 +1,573 @@
+#pragma once
+#include "../data.hpp"
+#include "../setup.hpp"
+#include "bindless.hpp"
+#include "compute.hpp"
+#include "oneshot.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Value of data::ScanPushConstants::pass, mirrors scanpasses.glsl
+  enum class ScanPass : uint32_t
+  {
+    Scan    = 0,
+    Reduce  = 1,
+    Compact = 2,
+  };
+
+  // Value of data::ScanPushConstants::op, mirrors scanpasses.glsl
+  enum class ScanOp : uint32_t
+  {
+    Add = 0,
+    Min = 1,
+    Max = 2,
+  };
+
+  [[nodiscard]] inline uint32_t scanIdentity( ScanOp op )
+  {
+    return op == ScanOp::Min ? 0xFFFFFFFFu : 0u;
+  }
+
+  [[nodiscard]] inline uint32_t scanCombine( ScanOp op, uint32_t a, uint32_t b )
+  {
+    if ( op == ScanOp::Min )
+      return std::min( a, b );
+    if ( op == ScanOp::Max )
+      return std::max( a, b );
+    return a + b;
+  }
+
+  // Workgroup shape of core::Scan, specialization constants 0 and 1 of scanpasses.glsl. A workgroup handles one tile of
+  // groupSize * itemsPerThread elements.
+  struct ScanConfig
+  {
+    uint32_t groupSize      = 256;
+    uint32_t itemsPerThread = 8;
+
+    [[nodiscard]] uint32_t tileSize() const
+    {
+      return groupSize * itemsPerThread;
+    }
+  };
+
+  // Prefix scan, reduction and stream compaction of uint buffers on the GPU, recorded into any command buffer.
+  // Buffers are passed as heap slots of storage buffers:
+  //
+  //   recordScan     inclusive or exclusive scan with add, min or max, one pass with decoupled lookback
+  //   recordReduce   add, min or max of the whole input into word 0 of a result buffer, one pass of atomics
+  //   recordCompact  the elements (or indices) whose flag is set, in input order, one pass with decoupled lookback,
+  //                  the kept count into word 0 of a result buffer
+  //
+  // Devices with subgroup arithmetic in compute shaders scan with subgroup operations, others in shared memory.
+  struct Scan
+  {
+    static constexpr uint32_t MaxItemsPerThread = 32;  // compaction keeps the flags of an invocation in one word
+
+    ScanConfig   config;
+    core::Buffer status;  // uint[1 + 3 * partitions] lookback state of scanpasses.glsl
+    uint32_t     statusIndex = InvalidBindlessIndex;
+    uint32_t     capacity    = 0;
+    bool         subgroups   = false;  // scan_subgroup.comp is in use
+
+    // `preferSubgroups` false forces the portable shader, for comparing both paths
+    void init( vk::raii::Device const &         device,
+               vk::raii::PhysicalDevice const & physicalDevice,
+               VmaAllocator                     allocator_,
+               BindlessHeap const &             heap,
+               ScanConfig                       config_         = {},
+               bool                             preferSubgroups = true )
+    {
+      auto const & limits = physicalDevice.getProperties().limits;
+      if ( config_.groupSize == 0 || config_.groupSize > limits.maxComputeWorkGroupSize[0] || config_.groupSize > limits.maxComputeWorkGroupInvocations )
+        throw std::runtime_error( "Scan workgroup size " + std::to_string( config_.groupSize ) + " is not supported" );
+      if ( config_.itemsPerThread == 0 || config_.itemsPerThread > MaxItemsPerThread )
+        throw std::runtime_error( "Scan items per invocation have to be 1 to " + std::to_string( MaxItemsPerThread ) );
+
+      allocator = allocator_;
+      config    = config_;
+      subgroups = preferSubgroups && subgroupArithmeticSupported( physicalDevice );
+      shader    = ComputeShader( device,
+                              subgroups ? "scan_subgroup.comp" : "scan.comp",
+                              sizeof( data::ScanPushConstants ),
+                              { *heap.layout },
+                              { config.groupSize, config.itemsPerThread } );
+    }
+
+    // Nothing may still use the previous buffer
+    void resize( BindlessHeap & heap, uint32_t capacity_, uint64_t frame )
+    {
+      destroy( heap, frame );
+      capacity = capacity_;
+
+      constexpr vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+      status      = core::createBuffer( allocator, statusBytes( partitionCount( capacity ) ), usage );
+      statusIndex = heap.addStorageBuffer( status.buffer );
+    }
+
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      heap.remove( BindlessHeap::StorageBuffers, statusIndex, frame );
+      statusIndex = InvalidBindlessIndex;
+      core::destroyBuffer( allocator, status );
+      capacity = 0;
+    }
+
+    [[nodiscard]] uint32_t partitionCount( uint32_t count ) const
+    {
+      return ( count + config.tileSize() - 1 ) / config.tileSize();
+    }
+
+    [[nodiscard]] static vk::DeviceSize statusBytes( uint32_t partitions )
+    {
+      return sizeof( uint32_t ) * ( 1 + 3 * vk::DeviceSize( partitions ) );
+    }
+
+    // output[i] = input[0] op ... op input[i], or up to input[i - 1] when exclusive. `input` and `output` may be
+    // the same buffer. Waits for earlier compute use of the status buffer, the input has to be visible to compute
+    // shaders. Like every record call here, the result is visible to compute shaders, indirect commands and
+    // transfers recorded afterwards.
+    void recordScan( vk::raii::CommandBuffer const & cmd,
+                     BindlessHeap const &            heap,
+                     uint32_t                        input,
+                     uint32_t                        output,
+                     uint32_t                        count,
+                     ScanOp                          op        = ScanOp::Add,
+                     bool                            exclusive = false ) const
+    {
+      data::ScanPushConstants pc{};
+      pc.inputBuffer  = input;
+      pc.outputBuffer = output;
+      pc.flagBuffer   = InvalidBindlessIndex;
+      pc.resultBuffer = InvalidBindlessIndex;
+      pc.count        = count;
+      pc.pass         = static_cast<uint32_t>( ScanPass::Scan );
+      pc.op           = static_cast<uint32_t>( op );
+      pc.exclusive    = exclusive ? 1 : 0;
+      recordLookback( cmd, heap, pc );
+    }
+
+    // Word 0 of `result` (heap slot `resultIndex`) = input[0] op ... op input[count - 1], the identity for no input
+    void recordReduce( vk::raii::CommandBuffer const & cmd,
+                       BindlessHeap const &            heap,
+                       uint32_t                        input,
+                       vk::Buffer                      result,
+                       uint32_t                        resultIndex,
+                       uint32_t                        count,
+                       ScanOp                          op = ScanOp::Add ) const
+    {
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferRead,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite );
+      cmd.fillBuffer( result, 0, sizeof( uint32_t ), scanIdentity( op ) );
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+
+      data::ScanPushConstants pc{};
+      pc.inputBuffer  = input;
+      pc.outputBuffer = InvalidBindlessIndex;
+      pc.flagBuffer   = InvalidBindlessIndex;
+      pc.statusBuffer = statusIndex;
+      pc.resultBuffer = resultIndex;
+      pc.count        = count;
+      pc.pass         = static_cast<uint32_t>( ScanPass::Reduce );
+      pc.op           = static_cast<uint32_t>( op );
+      dispatch( cmd, heap, pc );
+      resultBarrier( cmd );
+    }
+
+    // Appends input[i] (or i when `input` is InvalidBindlessIndex) to `output` for every i with flags[i] != 0 (or
+    // input[i] != 0 when `flags` is InvalidBindlessIndex), in input order. The kept count goes to word 0 of the
+    // storage buffer at heap slot `resultIndex`.
+    void recordCompact( vk::raii::CommandBuffer const & cmd,
+                        BindlessHeap const &            heap,
+                        uint32_t                        input,
+                        uint32_t                        flags,
+                        uint32_t                        output,
+                        uint32_t                        resultIndex,
+                        uint32_t                        count ) const
+    {
+      if ( input == InvalidBindlessIndex && flags == InvalidBindlessIndex )
+        throw std::runtime_error( "Compaction needs an input or flags" );
+
+      data::ScanPushConstants pc{};
+      pc.inputBuffer  = input;
+      pc.outputBuffer = output;
+      pc.flagBuffer   = flags;
+      pc.resultBuffer = resultIndex;
+      pc.count        = count;
+      pc.pass         = static_cast<uint32_t>( ScanPass::Compact );
+      pc.op           = static_cast<uint32_t>( ScanOp::Add );
+      recordLookback( cmd, heap, pc );
+    }
+
+  private:
+    VmaAllocator  allocator = nullptr;
+    ComputeShader shader;
+
+    // Scan and compaction, both take their partitions from the cleared status buffer
+    void recordLookback( vk::raii::CommandBuffer const & cmd, BindlessHeap const & heap, data::ScanPushConstants & pc ) const
+    {
+      if ( pc.count == 0 )
+        return;
+      if ( pc.count > capacity )
+        throw std::runtime_error( "Scan of " + std::to_string( pc.count ) + " elements exceeds the capacity of " + std::to_string( capacity ) );
+
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite );
+      cmd.fillBuffer( status.buffer, 0, statusBytes( partitionCount( pc.count ) ), 0 );
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+
+      pc.statusBuffer = statusIndex;
+      dispatch( cmd, heap, pc );
+      resultBarrier( cmd );
+    }
+
+    void dispatch( vk::raii::CommandBuffer const & cmd, BindlessHeap const & heap, data::ScanPushConstants const & pc ) const
+    {
+      uint32_t groups = partitionCount( pc.count );
+      if ( groups == 0 )
+        return;
+
+      shader.bind( cmd );
+      heap.bind( cmd, *shader.layout, vk::PipelineBindPoint::eCompute );
+      shader.push( cmd, pc );
+      cmd.dispatch( groups, 1, 1 );
+    }
+
+    static void resultBarrier( vk::raii::CommandBuffer const & cmd )
+    {
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageWrite,
+               vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eIndirectCommandRead |
+                 vk::AccessFlagBits2::eTransferRead );
+    }
+
+    static void barrier( vk::raii::CommandBuffer const & cmd,
+                         vk::PipelineStageFlags2         srcStage,
+                         vk::AccessFlags2                srcAccess,
+                         vk::PipelineStageFlags2         dstStage,
+                         vk::AccessFlags2                dstAccess )
+    {
+      vk::MemoryBarrier2 memoryBarrier{ srcStage, srcAccess, dstStage, dstAccess };
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( memoryBarrier ) );
+    }
+  };
+
+  // Input, output and result buffers of a Scan harness, allocated together with the scan's status buffer
+  struct ScanScratch
+  {
+    Scan         scan;
+    core::Buffer input;
+    core::Buffer output;
+    core::Buffer result;  // uint
+    uint32_t     inputIndex  = InvalidBindlessIndex;
+    uint32_t     outputIndex = InvalidBindlessIndex;
+    uint32_t     resultIndex = InvalidBindlessIndex;
+
+    void create( vk::raii::Device const &         device,
+                 vk::raii::PhysicalDevice const & physicalDevice,
+                 VmaAllocator                     allocator_,
+                 BindlessHeap &                   heap,
+                 ScanConfig                       config,
+                 bool                             preferSubgroups,
+                 uint32_t                         capacity,
+                 uint64_t                         frame )
+    {
+      allocator = allocator_;
+      scan.init( device, physicalDevice, allocator, heap, config, preferSubgroups );
+      scan.resize( heap, capacity, frame );
+
+      constexpr vk::BufferUsageFlags usage =
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc;
+      vk::DeviceSize bytes = sizeof( uint32_t ) * vk::DeviceSize( std::max( capacity, 1u ) );
+      input                = core::createBuffer( allocator, bytes, usage );
+      output               = core::createBuffer( allocator, bytes, usage );
+      result               = core::createBuffer( allocator, sizeof( uint32_t ), usage );
+      inputIndex           = heap.addStorageBuffer( input.buffer );
+      outputIndex          = heap.addStorageBuffer( output.buffer );
+      resultIndex          = heap.addStorageBuffer( result.buffer );
+    }
+
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      for ( uint32_t * index : { &inputIndex, &outputIndex, &resultIndex } )
+      {
+        heap.remove( BindlessHeap::StorageBuffers, *index, frame );
+        *index = InvalidBindlessIndex;
+      }
+      for ( core::Buffer * buffer : { &input, &output, &result } )
+        core::destroyBuffer( allocator, *buffer );
+      scan.destroy( heap, frame );
+    }
+
+  private:
+    VmaAllocator allocator = nullptr;
+  };
+
+  // Runs every operation of Scan on random input on both paths and compares with the standard library:
+  // std::inclusive_scan and std::exclusive_scan with add, min (in place) and max, std::reduce, and std::copy_if
+  // of values and of indices. Counts around the tile size catch partial tiles and single partitions.
+  struct ScanValidation
+  {
+    struct Result
+    {
+      uint32_t    count     = 0;
+      bool        subgroups = false;
+      uint32_t    checks    = 0;  // passed
+      std::string error;          // first failed check, empty when valid
+    };
+
+    uint32_t            count = 1000003;
+    uint32_t            seed  = 1;
+    std::vector<Result> results;
+    std::string         error;  // of the last run started from the UI, when it could not run
+
+    void run( vk::raii::Device const &         device,
+              vk::raii::PhysicalDevice const & physicalDevice,
+              VmaAllocator                     allocator,
+              BindlessHeap &                   heap,
+              ScanConfig                       config,
+              uint32_t                         queueFamily,
+              vk::raii::Queue const &          queue,
+              uint64_t                         frame )
+    {
+      uint32_t                tile    = config.tileSize();
+      std::array<uint32_t, 6> counts  = { 1, 7, tile - 1, tile, tile + 1, std::max( count, 1u ) };
+      uint32_t                largest = *std::max_element( counts.begin(), counts.end() );
+
+      OneShotQueue runner;
+      runner.init( device, physicalDevice, allocator, queueFamily, queue );
+
+      results.clear();
+      for ( bool preferSubgroups : { false, true } )
+      {
+        if ( preferSubgroups && !subgroupArithmeticSupported( physicalDevice ) )
+          break;
+
+        ScanScratch scratch;
+        scratch.create( device, physicalDevice, allocator, heap, config, preferSubgroups, largest, frame );
+        for ( uint32_t n : counts )
+        {
+          if ( n == 0 )
+            continue;
+          Result result{};
+          result.count     = n;
+          result.subgroups = scratch.scan.subgroups;
+          check( runner, heap, scratch, n, result );
+          results.push_back( result );
+          isDebug( std::println( "[scan] {} elements, {}, {} checks: {}",
+                                 result.count,
+                                 result.subgroups ? "subgroups" : "portable",
+                                 result.checks,
+                                 result.error.empty() ? "valid" : result.error ) );
+        }
+        scratch.destroy( heap, frame );
+      }
+    }
+
+  private:
+    void check( OneShotQueue & runner, BindlessHeap const & heap, ScanScratch & scratch, uint32_t n, Result & result ) const
+    {
+      std::mt19937          rng( seed + n );
+      std::vector<uint32_t> values( n );
+      for ( uint32_t & value : values )
+        value = rng() % 4 == 0 ? 0 : rng();  // every fourth dropped by compaction
+
+      auto compare = [&]( std::string const & what, std::vector<uint32_t> const & expected, vk::Buffer buffer )
+      {
+        if ( !result.error.empty() )
+          return;
+        std::vector<uint32_t> actual = runner.download<uint32_t>( buffer, expected.size() );
+        auto [gpu, cpu]              = std::mismatch( actual.begin(), actual.end(), expected.begin() );
+        if ( gpu == actual.end() )
+        {
+          ++result.checks;
+          return;
+        }
+        result.error = what + " differs at " + std::to_string( gpu - actual.begin() ) + ": " + std::to_string( *gpu ) + ", expected " +
+                       std::to_string( *cpu );
+      };
+
+      auto scan = [&]( ScanOp op, bool exclusive, bool inPlace )
+      {
+        runner.upload<uint32_t>( scratch.input.buffer, values );
+        uint32_t output = inPlace ? scratch.inputIndex : scratch.outputIndex;
+        runner.submit( [&]( vk::raii::CommandBuffer const & cmd ) { scratch.scan.recordScan( cmd, heap, scratch.inputIndex, output, n, op, exclusive ); } );
+
+        std::vector<uint32_t> expected( n );
+        auto                  combine = [op]( uint32_t a, uint32_t b ) { return scanCombine( op, a, b ); };
+        if ( exclusive )
+          std::exclusive_scan( values.begin(), values.end(), expected.begin(), scanIdentity( op ), combine );
+        else
+          std::inclusive_scan( values.begin(), values.end(), expected.begin(), combine );
+        compare( std::string( exclusive ? "exclusive" : "inclusive" ) + " scan", expected, inPlace ? scratch.input.buffer : scratch.output.buffer );
+      };
+      scan( ScanOp::Add, false, false );
+      scan( ScanOp::Add, true, false );
+      scan( ScanOp::Min, false, true );
+      scan( ScanOp::Max, true, false );
+
+      runner.upload<uint32_t>( scratch.input.buffer, values );
+      for ( ScanOp op : { ScanOp::Add, ScanOp::Min, ScanOp::Max } )
+      {
+        runner.submit( [&]( vk::raii::CommandBuffer const & cmd )
+                       { scratch.scan.recordReduce( cmd, heap, scratch.inputIndex, scratch.result.buffer, scratch.resultIndex, n, op ); } );
+        uint32_t expected =
+          std::reduce( values.begin(), values.end(), scanIdentity( op ), [op]( uint32_t a, uint32_t b ) { return scanCombine( op, a, b ); } );
+        compare( "reduction", { expected }, scratch.result.buffer );
+      }
+
+      for ( bool indices : { false, true } )
+      {
+        runner.submit(
+          [&]( vk::raii::CommandBuffer const & cmd )
+          {
+            uint32_t input = indices ? InvalidBindlessIndex : scratch.inputIndex;
+            uint32_t flags = indices ? scratch.inputIndex : InvalidBindlessIndex;
+            scratch.scan.recordCompact( cmd, heap, input, flags, scratch.outputIndex, scratch.resultIndex, n );
+          } );
+        std::vector<uint32_t> expected;
+        for ( uint32_t i = 0; i < n; ++i )
+          if ( values[i] != 0 )
+            expected.push_back( indices ? i : values[i] );
+        compare( "compacted count", { uint32_t( expected.size() ) }, scratch.result.buffer );
+        compare( indices ? "compacted indices" : "compacted values", expected, scratch.output.buffer );
+      }
+    }
+  };
+
+  // GPU time and bandwidth of every Scan operation over element counts from 64k to 16M on both paths. A quarter of
+  // the input is zero, which compaction drops.
+  struct ScanBenchmark
+  {
+    static constexpr std::array<uint32_t, 5> Counts = { 1u << 16, 1u << 18, 1u << 20, 1u << 22, 1u << 24 };
+
+    struct Result
+    {
+      uint32_t count              = 0;
+      ScanPass pass               = ScanPass::Scan;
+      bool     subgroups          = false;
+      float    ms                 = 0.0f;
+      float    gigabytesPerSecond = 0.0f;  // input read plus output written
+    };
+
+    uint32_t            iterations = 16;
+    std::vector<Result> results;
+    std::string         error;  // of the last run started from the UI, when it could not run
+
+    void run( vk::raii::Device const &         device,
+              vk::raii::PhysicalDevice const & physicalDevice,
+              VmaAllocator                     allocator,
+              BindlessHeap &                   heap,
+              ScanConfig                       config,
+              uint32_t                         queueFamily,
+              vk::raii::Queue const &          queue,
+              uint64_t                         frame )
+    {
+      uint32_t repeats = std::max( iterations, 1u );
+      uint32_t largest = Counts.back();
+
+      std::mt19937          rng( 1 );
+      std::vector<uint32_t> values( largest );
+      for ( uint32_t & value : values )
+        value = rng() % 4 == 0 ? 0 : rng() % 256;
+      std::vector<uint32_t> keptBefore( largest + 1, 0 );  // nonzero values among the first i
+      for ( uint32_t i = 0; i < largest; ++i )
+        keptBefore[i + 1] = keptBefore[i] + ( values[i] != 0 ? 1 : 0 );
+
+      OneShotQueue runner;
+      runner.init( device, physicalDevice, allocator, queueFamily, queue, 2 * repeats );
+
+      results.clear();
+      for ( bool preferSubgroups : { false, true } )
+      {
+        if ( preferSubgroups && !subgroupArithmeticSupported( physicalDevice ) )
+          break;
+
+        ScanScratch scratch;
+        scratch.create( device, physicalDevice, allocator, heap, config, preferSubgroups, largest, frame );
+        runner.upload<uint32_t>( scratch.input.buffer, values );
+
+        for ( ScanPass pass : { ScanPass::Scan, ScanPass::Reduce, ScanPass::Compact } )
+          for ( uint32_t count : Counts )
+          {
+            runner.submit(
+              [&]( vk::raii::CommandBuffer const & cmd )
+              {
+                for ( uint32_t i = 0; i < repeats; ++i )
+                {
+                  runner.timestamp( cmd, 2 * i );
+                  if ( pass == ScanPass::Scan )
+                    scratch.scan.recordScan( cmd, heap, scratch.inputIndex, scratch.outputIndex, count );
+                  else if ( pass == ScanPass::Reduce )
+                    scratch.scan.recordReduce( cmd, heap, scratch.inputIndex, scratch.result.buffer, scratch.resultIndex, count );
+                  else
+                  {
+                    uint32_t flags = InvalidBindlessIndex;  // the input values
+                    scratch.scan.recordCompact( cmd, heap, scratch.inputIndex, flags, scratch.outputIndex, scratch.resultIndex, count );
+                  }
+                  runner.timestamp( cmd, 2 * i + 1 );
+                }
+              } );
+
+            Result result{};
+            result.count     = count;
+            result.pass      = pass;
+            result.subgroups = scratch.scan.subgroups;
+            for ( uint32_t i = 0; i < repeats; ++i )
+              result.ms += runner.milliseconds( 2 * i, 2 * i + 1 ) / float( repeats );
+
+            uint64_t written = pass == ScanPass::Scan ? count : pass == ScanPass::Compact ? keptBefore[count] : 0;
+            if ( result.ms > 0.0f )
+              result.gigabytesPerSecond = float( sizeof( uint32_t ) * ( uint64_t( count ) + written ) ) / result.ms * 1e-6f;
+            results.push_back( result );
+
+            isDebug( std::println( "[scan] {} {} elements, {}: {:.3f} ms, {:.1f} GB/s",
+                                   passName( pass ),
+                                   result.count,
+                                   result.subgroups ? "subgroups" : "portable",
+                                   result.ms,
+                                   result.gigabytesPerSecond ) );
+          }
+        scratch.destroy( heap, frame );
+      }
+    }
+
+    [[nodiscard]] static char const * passName( ScanPass pass )
+    {
+      switch ( pass )
+      {
+        case ScanPass::Scan: return "scan";
+        case ScanPass::Reduce: return "reduce";
+        case ScanPass::Compact: return "compact";
+      }
+      return "";
+    }
+  };
+}  // namespace core
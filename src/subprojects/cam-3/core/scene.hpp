@@ -0,0 +1,539 @@
+#pragma once
+#include "../data.hpp"
+#include "../features.hpp"
+#include "../setup.hpp"
+#include "../state.hpp"
+#include "bindless.hpp"
+#include "instanceformat.hpp"
+#include "instances.hpp"
+#include "oneshot.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Components of Scene::registry. An entity is drawn while it has a SceneRenderable, with the defaults of
+  // the components it lacks.
+  struct SceneTransform
+  {
+    glm::vec3 position = glm::vec3( 0.0f );
+    float     scale    = 1.0f;
+    glm::vec4 rotation = glm::vec4( 0.0f, 0.0f, 0.0f, 1.0f );  // quaternion xyzw
+  };
+
+  struct SceneMaterial
+  {
+    glm::vec4 color = glm::vec4( 1.0f );
+  };
+
+  struct SceneRenderable
+  {
+    static constexpr uint32_t NoSlot = ~0u;
+
+    uint32_t slot = NoSlot;  // instance in Scene::buffer, assigned when the component is added
+  };
+
+  // Tag of the entities whose instance changed since the last upload
+  struct SceneDirty
+  {
+  };
+
+  // Entities on an entt::registry, drawn from an instance buffer in data::instanceFormat that follows them by
+  // uploading only what changed. Every entity with a SceneRenderable owns one instance slot for its lifetime;
+  // released slots are hidden (scale 0) and handed to the next SceneRenderable, so the buffer layout never moves.
+  //
+  // The observer is a set of registry signals: adding a component, or changing a SceneTransform or SceneMaterial
+  // through registry.patch() / registry.replace(), tags the entity with SceneDirty. Writing through registry.get()
+  // is not seen. Every frame recordFrame() takes the tagged slots in order and merges them into runs, joining runs that
+  // are at most `mergeGap` slots apart and then the closest ones until at most `maxRuns` are left. The runs are
+  // encoded back to back into this frame slot's staging buffer, each as a small buffer of its own, and copied in
+  // one command with a region per run (and per stream for PackedSoA).
+  struct Scene
+  {
+    static constexpr uint32_t MaxEntities = InstanceGenerator::MaxInstances;
+
+    struct Stats
+    {
+      uint32_t       touched = 0;  // entities the animation patched
+      uint32_t       dirty   = 0;  // slots changed
+      uint32_t       runs    = 0;
+      uint32_t       regions = 0;
+      vk::DeviceSize bytes   = 0;     // uploaded, with the clean slots inside merged runs
+      float          touchMs = 0.0f;  // patching the touched entities
+      float          flushMs = 0.0f;  // collecting, merging and encoding the changes
+      float          gpuMs   = 0.0f;  // the copies, of the last collected frame
+    };
+
+    entt::registry registry;
+
+    core::Buffer buffer;  // device local, capacity instances
+    uint32_t     bufferIndex = InvalidBindlessIndex;
+    uint32_t     capacity    = 0;  // instance slots, the instance count the scene draws
+
+    bool     animated      = false;  // touch the entities every frame
+    bool     clustered     = false;  // touch consecutive slots instead of random ones
+    float    touchFraction = 0.01f;  // of the live entities per frame
+    float    touchDistance = 0.5f;   // largest move of a touched entity per axis
+    uint32_t mergeGap      = 4;      // clean slots a run may cover to save a region
+    uint32_t maxRuns       = 4096;
+
+    Stats       stats;
+    float       populateMs = 0.0f;
+    uint32_t    mismatches = 0;  // slots that differed in the last verify()
+    bool        verified   = false;
+    std::string error;
+
+    void init( vk::raii::Device const &         device,
+               vk::raii::PhysicalDevice const & physicalDevice,
+               VmaAllocator                     allocator_,
+               uint32_t                         queueFamily,
+               vk::raii::Queue const &          queue )
+    {
+      allocator = allocator_;
+      period    = physicalDevice.getProperties().limits.timestampPeriod;
+      oneShot.init( device, physicalDevice, allocator_, queueFamily, queue );
+
+      commandPool = vk::raii::CommandPool( device, vk::CommandPoolCreateInfo{ vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamily } );
+      frameCmds   = vk::raii::CommandBuffers(
+        device, vk::CommandBufferAllocateInfo{ commandPool, vk::CommandBufferLevel::ePrimary, uint32_t( global::state::MAX_FRAMES_IN_FLIGHT ) } );
+
+      vk::QueryPoolCreateInfo queryInfo{};
+      queryInfo.setQueryType( vk::QueryType::eTimestamp ).setQueryCount( 2 * uint32_t( global::state::MAX_FRAMES_IN_FLIGHT ) );
+      queries = vk::raii::QueryPool( device, queryInfo );
+
+      registry.on_construct<SceneRenderable>().connect<&Scene::acquireSlot>( *this );
+      registry.on_destroy<SceneRenderable>().connect<&Scene::releaseSlot>( *this );
+      registry.on_construct<SceneTransform>().connect<&Scene::markDirty>( *this );
+      registry.on_update<SceneTransform>().connect<&Scene::markDirty>( *this );
+      registry.on_construct<SceneMaterial>().connect<&Scene::markDirty>( *this );
+      registry.on_update<SceneMaterial>().connect<&Scene::markDirty>( *this );
+    }
+
+    // Replaces every entity with one per instance of `params`, laid out like InstanceGenerator places them, and
+    // uploads them whole. Nothing may still use the previous buffer.
+    void populate( BindlessHeap & heap, InstanceParams const & params, uint64_t frame )
+    {
+      if ( params.count() == 0 || params.count() > MaxEntities )
+        throw std::runtime_error( "Entity count has to be between 1 and " + std::to_string( MaxEntities ) );
+
+      auto begin = std::chrono::steady_clock::now();
+      destroy( heap, frame );
+      capacity = uint32_t( params.count() );
+      slotEntities.assign( capacity, entt::null );
+
+      uint32_t seed = pcgHash( params.seed );
+      for ( uint32_t i = 0; i < capacity; ++i )
+      {
+        uint32_t           state    = i + seed;
+        glm::vec3          position = params.layout == InstanceLayout::Ball ? ballPosition( params, state ) : gridPosition( params, i, state );
+        data::InstanceData instance = instanceAttributes( params, position, state );
+        entt::entity       entity   = registry.create();
+        registry.emplace<SceneTransform>( entity, instance.position, instance.scale, instance.rotation );
+        registry.emplace<SceneMaterial>( entity, instance.color );
+        registry.emplace<SceneRenderable>( entity );
+      }
+
+      buffer = core::createBuffer( allocator,
+                                   instanceStride( data::instanceFormat ) * vk::DeviceSize( capacity ),
+                                   vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc );
+      bufferIndex                = heap.addStorageBuffer( buffer.buffer );
+      std::vector<uint8_t> bytes = encodeAll();
+      oneShot.upload( buffer.buffer, std::span<const uint8_t>( bytes ) );
+      registry.clear<SceneDirty>();
+      released.clear();
+
+      populateMs = std::chrono::duration<float, std::milli>( std::chrono::steady_clock::now() - begin ).count();
+      isDebug( std::println( "[scene] {} entities in {:.1f} ms, {:.1f} MB of instances", capacity, populateMs, double( bytes.size() ) / ( 1024.0 * 1024.0 ) ) );
+    }
+
+    // Nothing may still use the buffers
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      heap.remove( BindlessHeap::StorageBuffers, bufferIndex, frame );
+      bufferIndex = InvalidBindlessIndex;
+      core::destroyBuffer( allocator, buffer );
+      for ( auto & staging : stagings )
+        core::destroyBuffer( allocator, staging );
+      recorded.fill( false );
+
+      capacity = 0;
+      registry.clear();
+      slotEntities.clear();
+      freeSlots.clear();
+      released.clear();
+      nextSlot = 0;
+      live     = 0;
+      verified = false;
+    }
+
+    [[nodiscard]] bool drawable() const
+    {
+      return capacity > 0;
+    }
+
+    [[nodiscard]] uint32_t liveCount() const
+    {
+      return live;
+    }
+
+    [[nodiscard]] uint32_t freeCount() const
+    {
+      return capacity - live;
+    }
+
+    // Adds up to `count` entities next to random live ones, as many as there are free slots
+    void spawn( uint32_t count, uint64_t seed )
+    {
+      count = std::min( count, freeCount() );
+      for ( uint32_t i = 0; i < count; ++i )
+      {
+        uint32_t       state    = pcgHash( uint32_t( seed ) ^ ( i * 0x9E3779B9u ) );
+        entt::entity   neighbor = liveEntity( state );
+        bool           nearby   = neighbor != entt::null && registry.all_of<SceneTransform>( neighbor );
+        SceneTransform origin   = nearby ? registry.get<SceneTransform>( neighbor ) : SceneTransform{};
+        float          x = nextRandom( state ), y = nextRandom( state ), z = nextRandom( state );
+        origin.position += ( glm::vec3( x, y, z ) * 2.0f - 1.0f ) * data::gridSpacing;
+
+        entt::entity entity = registry.create();
+        registry.emplace<SceneTransform>( entity, origin );
+        registry.emplace<SceneMaterial>( entity, glm::vec4( 1.0f, 0.8f, 0.3f, 1.0f ) );
+        registry.emplace<SceneRenderable>( entity );
+      }
+    }
+
+    // Destroys up to `count` random live entities
+    void despawn( uint32_t count, uint64_t seed )
+    {
+      count = std::min( count, live );
+      for ( uint32_t i = 0; i < count; ++i )
+      {
+        uint32_t state = pcgHash( uint32_t( seed ) ^ ( i * 0x9E3779B9u ) );
+        for ( uint32_t attempt = 0; attempt < 64; ++attempt )
+          if ( entt::entity entity = liveEntity( state ); entity != entt::null )
+          {
+            registry.destroy( entity );
+            break;
+          }
+      }
+    }
+
+    // Uploads the changes since the last call into the instance buffer, after this slot's fence wait. Returns
+    // nothing when there are none.
+    [[nodiscard]] vk::CommandBuffer recordFrame( uint32_t slot, uint64_t frame )
+    {
+      recorded[slot] = false;
+      if ( capacity == 0 )
+        return nullptr;
+
+      using Clock = std::chrono::steady_clock;
+      float gpuMs = stats.gpuMs;
+      stats       = Stats{};
+      stats.gpuMs = gpuMs;
+
+      auto begin = Clock::now();
+      if ( animated )
+        touch( frame );
+      auto touched  = Clock::now();
+      stats.touchMs = std::chrono::duration<float, std::milli>( touched - begin ).count();
+
+      if ( !stageChanges( slot ) )
+        return nullptr;
+      stats.flushMs = std::chrono::duration<float, std::milli>( Clock::now() - touched ).count();
+
+      auto & frameCmd = frameCmds[slot];
+      frameCmd.reset();
+      frameCmd.begin( vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+      frameCmd.resetQueryPool( *queries, slot * 2, 2 );
+      frameCmd.writeTimestamp2( vk::PipelineStageFlagBits2::eAllCommands, *queries, slot * 2 );
+
+      // The previous frame may still read the instances this one overwrites
+      vk::PipelineStageFlags2 readers = vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eVertexShader;
+      if ( cfg::supported.meshShader )
+        readers |= vk::PipelineStageFlagBits2::eTaskShaderEXT | vk::PipelineStageFlagBits2::eMeshShaderEXT;
+      vk::MemoryBarrier2 fromReaders{ readers, vk::AccessFlagBits2::eNone, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite };
+      frameCmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( fromReaders ) );
+      frameCmd.copyBuffer( stagings[slot].buffer, buffer.buffer, regions );
+      vk::MemoryBarrier2 toReaders{
+        vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, readers, vk::AccessFlagBits2::eShaderStorageRead
+      };
+      frameCmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( toReaders ) );
+
+      frameCmd.writeTimestamp2( vk::PipelineStageFlagBits2::eAllCommands, *queries, slot * 2 + 1 );
+      frameCmd.end();
+
+      recorded[slot] = true;
+      return *frameCmd;
+    }
+
+    // Call after the slot's fence has been waited
+    void collect( uint32_t slot )
+    {
+      if ( !recorded[slot] )
+        return;
+      recorded[slot] = false;
+
+      auto [result, ticks] = queries.getResults<uint64_t>( slot * 2, 2, 2 * sizeof( uint64_t ), sizeof( uint64_t ), vk::QueryResultFlagBits::e64 );
+      if ( result == vk::Result::eSuccess )
+        stats.gpuMs = static_cast<float>( ticks[1] - ticks[0] ) * period * 1e-6f;
+    }
+
+    // Reads the instance buffer back and compares it with the registry, slot by slot. Pending changes are uploaded
+    // first, the same way recordFrame() does. Nothing may still use the buffers.
+    void verify()
+    {
+      verified   = false;
+      mismatches = 0;
+      if ( capacity == 0 )
+        return;
+
+      if ( stageChanges( 0 ) )
+        oneShot.submit( [&]( vk::raii::CommandBuffer const & cmd ) { cmd.copyBuffer( stagings[0].buffer, buffer.buffer, regions ); } );
+      std::vector<uint8_t> expected = encodeAll();
+      std::vector<uint8_t> actual   = oneShot.download<uint8_t>( buffer.buffer, expected.size() );
+
+      // Compare through a single-instance encoding, every format's bytes of a slot then sit together
+      std::array<uint8_t, sizeof( data::InstanceData )> mine{};
+      std::array<uint8_t, sizeof( data::InstanceData )> theirs{};
+      for ( uint32_t slot = 0; slot < capacity; ++slot )
+      {
+        gatherInstance( expected.data(), slot, mine.data() );
+        gatherInstance( actual.data(), slot, theirs.data() );
+        if ( mine != theirs )
+          ++mismatches;
+      }
+      verified = true;
+      isDebug( std::println( "[scene] verify: {} of {} slots differ", mismatches, capacity ) );
+    }
+
+  private:
+    struct Run
+    {
+      uint32_t first = 0;
+      uint32_t count = 0;
+    };
+
+    VmaAllocator             allocator   = nullptr;
+    float                    period      = 1.0f;  // ns per timestamp tick
+    OneShotQueue             oneShot;
+    vk::raii::CommandPool    commandPool = nullptr;
+    vk::raii::CommandBuffers frameCmds   = nullptr;
+    vk::raii::QueryPool      queries     = nullptr;
+
+    std::array<core::Buffer, global::state::MAX_FRAMES_IN_FLIGHT> stagings{};  // per frame slot, grown on demand
+    std::array<bool, global::state::MAX_FRAMES_IN_FLIGHT>         recorded{};
+
+    std::vector<entt::entity>   slotEntities;  // [capacity], entt::null for free slots
+    std::vector<uint32_t>       freeSlots;     // released, reused last in first out
+    std::vector<uint32_t>       released;      // released since the last upload, to hide
+    std::vector<uint32_t>       dirtySlots;
+    std::vector<uint32_t>       gaps;
+    std::vector<Run>            runs;
+    std::vector<vk::BufferCopy> regions;
+    uint32_t                    nextSlot = 0;  // slots below have been handed out
+    uint32_t                    live     = 0;
+
+    void markDirty( entt::registry & target, entt::entity entity )
+    {
+      if ( !target.all_of<SceneDirty>( entity ) )
+        target.emplace<SceneDirty>( entity );
+    }
+
+    void acquireSlot( entt::registry & target, entt::entity entity )
+    {
+      SceneRenderable & renderable = target.get<SceneRenderable>( entity );
+      if ( !freeSlots.empty() )
+      {
+        renderable.slot = freeSlots.back();
+        freeSlots.pop_back();
+      }
+      else if ( nextSlot < capacity )
+        renderable.slot = nextSlot++;
+      else
+        return;
+      slotEntities[renderable.slot] = entity;
+      ++live;
+      markDirty( target, entity );
+    }
+
+    // Only touches the scene's own lists, the entity may be in the middle of being destroyed
+    void releaseSlot( entt::registry & target, entt::entity entity )
+    {
+      uint32_t slot = target.get<SceneRenderable>( entity ).slot;
+      if ( slot == SceneRenderable::NoSlot )
+        return;
+      slotEntities[slot] = entt::null;
+      freeSlots.push_back( slot );
+      released.push_back( slot );
+      --live;
+    }
+
+    // The live entity of a random slot, entt::null when the drawn slot is free
+    [[nodiscard]] entt::entity liveEntity( uint32_t & state ) const
+    {
+      if ( nextSlot == 0 )
+        return entt::null;
+      state = pcgHash( state );
+      return slotEntities[state % nextSlot];
+    }
+
+    [[nodiscard]] data::InstanceData instanceOf( uint32_t slot ) const
+    {
+      entt::entity entity = slotEntities[slot];
+      if ( entity == entt::null )
+        return data::InstanceData{ glm::vec3( 0.0f ), 0.0f };
+
+      SceneTransform const * transform = registry.try_get<SceneTransform>( entity );
+      SceneMaterial const *  material  = registry.try_get<SceneMaterial>( entity );
+      SceneTransform         t         = transform ? *transform : SceneTransform{};
+      return data::InstanceData{ t.position, t.scale, t.rotation, material ? material->color : glm::vec4( 1.0f ) };
+    }
+
+    [[nodiscard]] std::vector<uint8_t> encodeAll() const
+    {
+      std::vector<uint8_t> bytes( instanceStride( data::instanceFormat ) * size_t( capacity ) );
+      for ( uint32_t slot = 0; slot < capacity; ++slot )
+        storeInstance( data::instanceFormat, bytes.data(), slot, capacity, instanceOf( slot ) );
+      return bytes;
+    }
+
+    // Copies the bytes of one slot of a whole buffer in data::instanceFormat to `out`
+    void gatherInstance( uint8_t const * bytes, uint32_t slot, uint8_t * out ) const
+    {
+      std::vector<vk::BufferCopy> copies;
+      appendInstanceCopies( data::instanceFormat, 0, slot, 1, capacity, copies );
+      for ( vk::BufferCopy const & copy : copies )
+      {
+        std::memcpy( out, bytes + copy.dstOffset, copy.size );
+        out += copy.size;
+      }
+    }
+
+    // Patches the SceneTransform and SceneMaterial of touchFraction of the live entities, through the registry so
+    // the observer sees them
+    void touch( uint64_t frame )
+    {
+      uint32_t count = std::min( uint32_t( std::ceil( touchFraction * float( live ) ) ), live );
+      uint32_t start = pcgHash( uint32_t( frame ) );
+      for ( uint32_t i = 0; i < count; ++i )
+      {
+        uint32_t     state  = pcgHash( start + i );
+        entt::entity entity = clustered ? slotEntities[( start + i ) % nextSlot] : liveEntity( state );
+        if ( entity == entt::null || !registry.all_of<SceneTransform>( entity ) )
+          continue;
+
+        float     x = nextRandom( state ), y = nextRandom( state ), z = nextRandom( state );
+        glm::vec3 move = ( glm::vec3( x, y, z ) * 2.0f - 1.0f ) * touchDistance;
+        registry.patch<SceneTransform>( entity, [move]( SceneTransform & transform ) { transform.position += move; } );
+        float r = nextRandom( state ), g = nextRandom( state ), b = nextRandom( state );
+        registry.emplace_or_replace<SceneMaterial>( entity, glm::vec4( glm::vec3( r, g, b ) * 0.6f + 0.4f, 1.0f ) );
+        ++stats.touched;
+      }
+    }
+
+    // Collects, merges and encodes the changes into the staging buffer of `slot` and fills `regions`, false
+    // when nothing changed
+    bool stageChanges( uint32_t slot )
+    {
+      collectDirty();
+      stats.dirty = uint32_t( dirtySlots.size() );
+      if ( dirtySlots.empty() )
+        return false;
+      mergeRuns();
+
+      constexpr size_t stride = instanceStride( data::instanceFormat );
+      vk::DeviceSize   needed = 0;
+      for ( Run const & run : runs )
+        needed += stride * vk::DeviceSize( run.count );
+      reserveStaging( slot, needed );
+
+      auto *         mapped = static_cast<uint8_t *>( stagings[slot].allocationInfo.pMappedData );
+      vk::DeviceSize offset = 0;
+      regions.clear();
+      for ( Run const & run : runs )
+      {
+        for ( uint32_t i = 0; i < run.count; ++i )
+          storeInstance( data::instanceFormat, mapped + offset, i, run.count, instanceOf( run.first + i ) );
+        appendInstanceCopies( data::instanceFormat, offset, run.first, run.count, capacity, regions );
+        offset += stride * vk::DeviceSize( run.count );
+      }
+      vmaFlushAllocation( allocator, stagings[slot].allocation, 0, offset );
+
+      stats.runs    = uint32_t( runs.size() );
+      stats.regions = uint32_t( regions.size() );
+      stats.bytes   = offset;
+      return true;
+    }
+
+    // Sorted slots of the tagged entities and of the released slots, the tags are cleared
+    void collectDirty()
+    {
+      dirtySlots.assign( released.begin(), released.end() );
+      released.clear();
+      for ( entt::entity entity : registry.view<SceneDirty>() )
+      {
+        SceneRenderable const * renderable = registry.try_get<SceneRenderable>( entity );
+        if ( renderable && renderable->slot != SceneRenderable::NoSlot )
+          dirtySlots.push_back( renderable->slot );
+      }
+      registry.clear<SceneDirty>();
+
+      std::sort( dirtySlots.begin(), dirtySlots.end() );
+      dirtySlots.erase( std::unique( dirtySlots.begin(), dirtySlots.end() ), dirtySlots.end() );
+    }
+
+    // Runs over dirtySlots: gaps up to mergeGap are always covered, beyond maxRuns the smallest remaining gaps
+    void mergeRuns()
+    {
+      gaps.clear();
+      for ( size_t i = 1; i < dirtySlots.size(); ++i )
+        if ( uint32_t gap = dirtySlots[i] - dirtySlots[i - 1] - 1; gap > mergeGap )
+          gaps.push_back( gap );
+
+      uint32_t limit = mergeGap;
+      uint32_t most  = std::max( maxRuns, 1u );
+      if ( gaps.size() + 1 > most )
+      {
+        // Covering every gap up to the one that leaves `most` runs, ties included
+        auto split = gaps.begin() + ( gaps.size() + 1 - most ) - 1;
+        std::nth_element( gaps.begin(), split, gaps.end() );
+        limit = *split;
+      }
+
+      runs.clear();
+      runs.push_back( Run{ dirtySlots.front(), 1 } );
+      for ( size_t i = 1; i < dirtySlots.size(); ++i )
+      {
+        Run & run = runs.back();
+        if ( dirtySlots[i] - ( run.first + run.count ) <= limit )
+          run.count = dirtySlots[i] - run.first + 1;
+        else
+          runs.push_back( Run{ dirtySlots[i], 1 } );
+      }
+    }
+
+    // This slot's fence was waited, its staging buffer is free to replace
+    void reserveStaging( uint32_t slot, vk::DeviceSize bytes )
+    {
+      if ( stagings[slot].buffer && stagings[slot].size >= bytes )
+        return;
+      constexpr VmaAllocationCreateFlags upload = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      core::destroyBuffer( allocator, stagings[slot] );
+      vk::DeviceSize size = std::bit_ceil( std::max<vk::DeviceSize>( bytes, 1 << 16 ) );
+      stagings[slot]      = core::createBuffer( allocator, size, vk::BufferUsageFlagBits::eTransferSrc, upload );
+    }
+  };
+}  // namespace core
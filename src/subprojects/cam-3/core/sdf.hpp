@@ -0,0 +1,65 @@
+#pragma once
+#include "../data.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <span>
+
+// CPU side of the terrain distance field, mirrors shaders/sdf.glsl. `edits` holds what the shaders read from
+// SdfScene::editBuffer.
+namespace core
+{
+  [[nodiscard]] inline float sdfBox( glm::vec3 p, glm::vec3 halfSize )
+  {
+    glm::vec3 q = glm::abs( p ) - halfSize;
+    return glm::length( glm::max( q, 0.0f ) ) + std::min( std::max( q.x, std::max( q.y, q.z ) ), 0.0f );
+  }
+
+  [[nodiscard]] inline float sdfSmoothMin( float a, float b, float k )
+  {
+    if ( std::abs( a - b ) >= k )
+      return std::min( a, b );
+    float h = std::clamp( 0.5f + 0.5f * ( b - a ) / k, 0.0f, 1.0f );
+    return b + ( a - b ) * h - k * h * ( 1.0f - h );
+  }
+
+  [[nodiscard]] inline float sdfScene( glm::vec3 p, data::SdfScene const & scene, std::span<const glm::vec4> edits )
+  {
+    glm::vec3 q = p - scene.center;
+    float     d = glm::length( q ) - scene.radius;
+
+    glm::vec3 w = q * scene.frequency;
+    d -= scene.amplitude * ( std::sin( w.x ) * std::sin( w.y ) * std::sin( w.z ) + 0.5f * std::sin( 2.0f * w.x + 1.3f ) * std::sin( 2.0f * w.z + 0.7f ) );
+
+    if ( scene.mesa > 0.0f )
+      d = std::min( d, sdfBox( q - glm::vec3( 0.0f, scene.radius, 0.0f ), glm::vec3( scene.mesa ) ) );
+
+    for ( size_t i = 0; i < std::min<size_t>( scene.editCount, edits.size() ); ++i )
+    {
+      glm::vec4 edit   = edits[i];
+      float     sphere = glm::length( p - glm::vec3( edit ) ) - std::abs( edit.w );
+      d                = edit.w >= 0.0f ? sdfSmoothMin( d, sphere, scene.smoothness ) : -sdfSmoothMin( -d, sphere, scene.smoothness );
+    }
+    return d;
+  }
+
+  [[nodiscard]] inline glm::vec3 sdfNormal( glm::vec3 p, data::SdfScene const & scene, std::span<const glm::vec4> edits, float h )
+  {
+    constexpr glm::vec3 a( 1.0f, -1.0f, -1.0f ), b( -1.0f, -1.0f, 1.0f ), c( -1.0f, 1.0f, -1.0f ), d( 1.0f, 1.0f, 1.0f );
+
+    glm::vec3 n = a * sdfScene( p + a * h, scene, edits ) + b * sdfScene( p + b * h, scene, edits ) + c * sdfScene( p + c * h, scene, edits ) +
+                  d * sdfScene( p + d * h, scene, edits );
+    return glm::normalize( n );
+  }
+
+  [[nodiscard]] inline glm::vec3 sdfColor( glm::vec3 p, glm::vec3 normal, data::SdfScene const & scene )
+  {
+    glm::vec3 up     = glm::normalize( p - scene.center );
+    float     t      = std::clamp( ( glm::dot( normal, up ) - 0.6f ) / 0.25f, 0.0f, 1.0f );
+    float     flat   = t * t * ( 3.0f - 2.0f * t );
+    glm::vec3 albedo = glm::vec3( 0.45f, 0.4f, 0.35f ) * ( 1.0f - flat ) + glm::vec3( 0.3f, 0.55f, 0.25f ) * flat;
+    float     light  = std::max( glm::dot( normal, glm::normalize( glm::vec3( 0.4f, 0.8f, -0.45f ) ) ), 0.0f );
+    return albedo * ( 0.35f + 0.65f * light );
+  }
+}  // namespace core
@@ -0,0 +1,223 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <stop_token>
+#include <thread>
+
+namespace core
+{
+  // Hands the latest value from one writer thread to one reader thread, neither side ever locks or waits. The
+  // writer fills back() and publishes it, which swaps it with the middle slot; the reader takes the middle slot
+  // when it holds something newer than its front(). Values published in between are overwritten, not queued.
+  template <typename T>
+  struct TripleBuffer
+  {
+    // Writer side
+    [[nodiscard]] T & back()
+    {
+      return slots[backIndex].value;
+    }
+
+    void publish()
+    {
+      backIndex = middle.exchange( uint8_t( backIndex | Fresh ), std::memory_order_acq_rel ) & Index;
+    }
+
+    // Reader side, true when front() changed
+    bool acquire()
+    {
+      if ( !( middle.load( std::memory_order_relaxed ) & Fresh ) )
+        return false;
+      frontIndex = middle.exchange( frontIndex, std::memory_order_acq_rel ) & Index;
+      return true;
+    }
+
+    [[nodiscard]] T const & front() const
+    {
+      return slots[frontIndex].value;
+    }
+
+  private:
+    static constexpr uint8_t Index = 3;
+    static constexpr uint8_t Fresh = 4;  // the middle slot was published since the reader last took it
+
+    struct alignas( 64 ) Slot
+    {
+      T value{};
+    };
+
+    std::array<Slot, 3>               slots{};
+    alignas( 64 ) std::atomic<uint8_t> middle     = 1;
+    alignas( 64 ) uint8_t              backIndex  = 0;  // writer only
+    alignas( 64 ) uint8_t              frontIndex = 2;  // reader only
+  };
+
+  // What the render thread feeds into the simulation, the latest value is used by every tick
+  struct SimulationInput
+  {
+    glm::vec3 move = glm::vec3( 0.0f );  // unit direction of the camera movement, or zero
+  };
+
+  struct SimulationState
+  {
+    glm::vec3 cameraPosition = glm::vec3( 0.0f );
+    uint64_t  tick           = 0;
+  };
+
+  // The two states around the latest tick, `current` is the state at `time`
+  struct SimulationSnapshot
+  {
+    SimulationState                       previous;
+    SimulationState                       current;
+    std::chrono::steady_clock::time_point time;
+    float                                 dt = 0.0f;
+  };
+
+  // Advances SimulationState at a fixed rate on its own thread, so simulated speed no longer depends on the frame
+  // rate or the present mode. Tick n runs at start + n / rate on the steady clock and publishes the states before
+  // and after it through a TripleBuffer. The render thread shows the state one tick in the past, interpolated between
+  // the two, which keeps motion smooth when frames and ticks do not line up.
+  //
+  // A thread that falls more than MaxCatchUp ticks behind (a debugger, a suspended machine) skips the missed ticks
+  // instead of running them all at once. The statistics are measured on the simulation thread, independently of
+  // vsync: ticks per second, the cost of a tick and the tick rate that cost would allow.
+  struct FixedStepSimulation
+  {
+    static constexpr uint32_t MaxCatchUp = 8;
+
+    struct Stats
+    {
+      std::atomic<uint64_t> ticks          = 0;
+      std::atomic<uint64_t> skipped        = 0;     // ticks dropped after falling behind
+      std::atomic<float>    ticksPerSecond = 0.0f;  // over the last second
+      std::atomic<float>    stepMs         = 0.0f;  // running average of one tick
+      std::atomic<float>    wakeLateMs     = 0.0f;  // running average of how late the thread woke for a tick
+    };
+
+    std::atomic<float> rate      = 120.0f;  // ticks per second
+    std::atomic<float> moveSpeed = 6.0f;    // camera units per second, the 0.1 per frame it replaces at 60 fps
+    Stats              stats;
+
+    // Starts ticking from `position`, restarts a running simulation
+    void start( glm::vec3 position )
+    {
+      stop();
+      SimulationSnapshot & initial = snapshots.back();
+      initial.previous             = SimulationState{ position, 0 };
+      initial.current              = initial.previous;
+      initial.time                 = std::chrono::steady_clock::now();
+      initial.dt                   = 1.0f / std::max( rate.load(), 1.0f );
+      snapshots.publish();
+      thread = std::jthread( [this, position]( std::stop_token token ) { run( token, SimulationState{ position, 0 } ); } );
+    }
+
+    void stop()
+    {
+      if ( thread.joinable() )
+      {
+        thread.request_stop();
+        thread.join();
+      }
+    }
+
+    // Render thread, the input every following tick uses
+    void setInput( SimulationInput const & input )
+    {
+      inputs.back() = input;
+      inputs.publish();
+    }
+
+    // Render thread, the camera at `now` one tick in the past
+    [[nodiscard]] glm::vec3 cameraPosition( std::chrono::steady_clock::time_point now )
+    {
+      snapshots.acquire();
+      SimulationSnapshot const & snapshot = snapshots.front();
+      alpha = std::clamp( std::chrono::duration<float>( now - snapshot.time ).count() / std::max( snapshot.dt, 1e-6f ), 0.0f, 1.0f );
+      return glm::mix( snapshot.previous.cameraPosition, snapshot.current.cameraPosition, alpha );
+    }
+
+    // Interpolation factor of the last cameraPosition() between the previous and the current tick
+    [[nodiscard]] float interpolation() const
+    {
+      return alpha;
+    }
+
+    [[nodiscard]] uint64_t latestTick() const
+    {
+      return snapshots.front().current.tick;
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    TripleBuffer<SimulationInput>    inputs;
+    TripleBuffer<SimulationSnapshot> snapshots;
+    float                            alpha = 0.0f;
+    std::jthread                     thread;
+
+    void step( SimulationState & state, SimulationInput const & input, float dt ) const
+    {
+      state.cameraPosition += input.move * ( moveSpeed.load( std::memory_order_relaxed ) * dt );
+      ++state.tick;
+    }
+
+    void run( std::stop_token token, SimulationState state )
+    {
+      SimulationInput input;
+      Clock::time_point next        = Clock::now();
+      Clock::time_point windowStart = next;
+      uint64_t          windowTicks = 0;
+
+      while ( !token.stop_requested() )
+      {
+        float dt       = 1.0f / std::max( rate.load( std::memory_order_relaxed ), 1.0f );
+        auto  interval = std::chrono::duration_cast<Clock::duration>( std::chrono::duration<float>( dt ) );
+        std::this_thread::sleep_until( next );
+
+        Clock::time_point now = Clock::now();
+        float late = std::chrono::duration<float, std::milli>( now - next ).count();
+        stats.wakeLateMs.store( 0.95f * stats.wakeLateMs.load( std::memory_order_relaxed ) + 0.05f * late, std::memory_order_relaxed );
+
+        for ( uint32_t steps = 0; next <= now && steps < MaxCatchUp; ++steps )
+        {
+          if ( inputs.acquire() )
+            input = inputs.front();
+
+          SimulationState   before    = state;
+          Clock::time_point stepStart = Clock::now();
+          step( state, input, dt );
+          float ms = std::chrono::duration<float, std::milli>( Clock::now() - stepStart ).count();
+          stats.stepMs.store( 0.95f * stats.stepMs.load( std::memory_order_relaxed ) + 0.05f * ms, std::memory_order_relaxed );
+
+          SimulationSnapshot & snapshot = snapshots.back();
+          snapshot.previous             = before;
+          snapshot.current              = state;
+          snapshot.time                 = next;
+          snapshot.dt                   = dt;
+          snapshots.publish();
+
+          next += interval;
+          ++windowTicks;
+          stats.ticks.fetch_add( 1, std::memory_order_relaxed );
+        }
+        if ( next <= now )
+        {
+          stats.skipped.fetch_add( uint64_t( ( now - next ) / interval ) + 1, std::memory_order_relaxed );
+          next = now + interval;
+        }
+
+        float elapsed = std::chrono::duration<float>( now - windowStart ).count();
+        if ( elapsed >= 1.0f )
+        {
+          stats.ticksPerSecond.store( float( windowTicks ) / elapsed, std::memory_order_relaxed );
+          windowTicks = 0;
+          windowStart = now;
+        }
+      }
+    }
+  };
+}  // namespace core
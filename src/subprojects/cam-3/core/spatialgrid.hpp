@@ -0,0 +1,298 @@
+#pragma once
+#include "../data.hpp"
+#include "../setup.hpp"
+#include "bindless.hpp"
+#include "compute.hpp"
+#include "parallel.hpp"
+#include "scan.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Value of data::GridPushConstants::pass, mirrors grid.comp
+  enum class GridPass : uint32_t
+  {
+    Count   = 0,
+    Scatter = 1,
+  };
+
+  // Cell and bucket of a position, the same functions as in grid.glsl
+  [[nodiscard]] inline glm::ivec3 gridCell( glm::vec3 position, float cellSize )
+  {
+    return glm::ivec3( glm::floor( position / cellSize ) );
+  }
+
+  [[nodiscard]] inline uint32_t gridHash( glm::ivec3 cell, uint32_t tableMask )
+  {
+    return ( uint32_t( cell.x ) * 73856093u ^ uint32_t( cell.y ) * 19349663u ^ uint32_t( cell.z ) * 83492791u ) & tableMask;
+  }
+
+  // Buckets for `count` spheres, one per sphere rounded up to a power of two
+  [[nodiscard]] inline uint32_t gridTableSize( uint32_t count )
+  {
+    return std::bit_ceil( std::max( count, 1u ) );
+  }
+
+  // Uniform grid broadphase on the GPU: a counting sort of spheres (vec4 position, radius) into the buckets of a
+  // hashed grid, recorded as compute passes into any command buffer. Consumers find the spheres of a bucket
+  // through grid.glsl: gridBucketStart(bucket) to gridBucketStart(bucket + 1) in `sorted`.
+  //
+  //   fill     bucket counts = 0
+  //   Count    per sphere, atomic increment of its bucket, the old count is its rank inside the bucket
+  //   Scan     exclusive core::Scan of the counts in place, the sphere count lands behind the last bucket
+  //   Scatter  per sphere, sorted[bucket start + rank] = sphere
+  //
+  // The cell size has to be at least the largest sphere diameter for the 27 neighbor cells to hold every contact.
+  struct SpatialGrid
+  {
+    static constexpr uint32_t GroupSize = 256;
+    static constexpr uint32_t MaxTable  = 1u << 22;  // enough for InstanceGenerator::MaxInstances spheres
+
+    core::Buffer cells;   // uint[tableSize + 1], bucket starts after the scan, the sphere count last
+    core::Buffer keys;    // uint[capacity], bucket of every sphere
+    core::Buffer ranks;   // uint[capacity]
+    core::Buffer sorted;  // uint[capacity], sphere indices by bucket
+    uint32_t     cellIndex   = InvalidBindlessIndex;
+    uint32_t     keyIndex    = InvalidBindlessIndex;
+    uint32_t     rankIndex   = InvalidBindlessIndex;
+    uint32_t     sortedIndex = InvalidBindlessIndex;
+    uint32_t     capacity    = 0;
+    uint32_t     tableSize   = 0;
+
+    void init( vk::raii::Device const & device, vk::raii::PhysicalDevice const & physicalDevice, VmaAllocator allocator_, BindlessHeap const & heap )
+    {
+      allocator = allocator_;
+      shader    = ComputeShader( device, "grid.comp", sizeof( data::GridPushConstants ), { *heap.layout } );
+      scan.init( device, physicalDevice, allocator_, heap );
+    }
+
+    // Nothing may still use the previous buffers
+    void resize( BindlessHeap & heap, uint32_t capacity_, uint64_t frame )
+    {
+      destroy( heap, frame );
+      capacity  = capacity_;
+      tableSize = gridTableSize( capacity );
+      if ( tableSize > MaxTable )
+        throw std::runtime_error( "Grid of " + std::to_string( capacity ) + " spheres exceeds " + std::to_string( MaxTable ) + " buckets" );
+
+      constexpr vk::BufferUsageFlags usage =
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc;
+      auto create = [&]( core::Buffer & buffer, uint32_t & index, uint32_t words )
+      {
+        buffer = core::createBuffer( allocator, sizeof( uint32_t ) * vk::DeviceSize( std::max( words, 1u ) ), usage );
+        index  = heap.addStorageBuffer( buffer.buffer );
+      };
+      create( cells, cellIndex, tableSize + 1 );
+      create( keys, keyIndex, capacity );
+      create( ranks, rankIndex, capacity );
+      create( sorted, sortedIndex, capacity );
+      scan.resize( heap, tableSize + 1, frame );
+    }
+
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      for ( uint32_t * index : { &cellIndex, &keyIndex, &rankIndex, &sortedIndex } )
+      {
+        heap.remove( BindlessHeap::StorageBuffers, *index, frame );
+        *index = InvalidBindlessIndex;
+      }
+      for ( core::Buffer * buffer : { &cells, &keys, &ranks, &sorted } )
+        core::destroyBuffer( allocator, *buffer );
+      scan.destroy( heap, frame );
+      capacity  = 0;
+      tableSize = 0;
+    }
+
+    [[nodiscard]] uint32_t tableMask() const
+    {
+      return tableSize - 1;
+    }
+
+    // Every pass for `count` <= capacity spheres in the storage buffer at heap slot `spheres`. Waits for
+    // earlier compute reads of the grid, the result is visible to compute shaders recorded afterwards.
+    void record( vk::raii::CommandBuffer const & cmd, BindlessHeap const & heap, uint32_t spheres, uint32_t count, float cellSize ) const
+    {
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite );
+      cmd.fillBuffer( cells.buffer, 0, VK_WHOLE_SIZE, 0 );
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+
+      recordPass( cmd, heap, GridPass::Count, spheres, count, cellSize );
+      recordScan( cmd, heap );
+      recordPass( cmd, heap, GridPass::Scatter, spheres, count, cellSize );
+      computeBarrier( cmd );
+    }
+
+    // Exclusive scan of the bucket counts, for callers that fill the counts themselves
+    void recordScan( vk::raii::CommandBuffer const & cmd, BindlessHeap const & heap ) const
+    {
+      computeBarrier( cmd );
+      scan.recordScan( cmd, heap, cellIndex, cellIndex, tableSize + 1, ScanOp::Add, true );
+    }
+
+    void recordPass( vk::raii::CommandBuffer const & cmd, BindlessHeap const & heap, GridPass pass, uint32_t spheres, uint32_t count, float cellSize ) const
+    {
+      data::GridPushConstants pc{};
+      pc.sphereBuffer = spheres;
+      pc.cellBuffer   = cellIndex;
+      pc.keyBuffer    = keyIndex;
+      pc.rankBuffer   = rankIndex;
+      pc.sortedBuffer = sortedIndex;
+      pc.count        = count;
+      pc.tableMask    = tableMask();
+      pc.cellSize     = cellSize;
+      pc.pass         = static_cast<uint32_t>( pass );
+
+      uint32_t groups = ( count + GroupSize - 1 ) / GroupSize;
+      if ( groups == 0 )
+        return;
+
+      shader.bind( cmd );
+      heap.bind( cmd, *shader.layout, vk::PipelineBindPoint::eCompute );
+      shader.push( cmd, pc );
+      cmd.dispatch( groups, 1, 1 );
+    }
+
+  private:
+    VmaAllocator  allocator = nullptr;
+    ComputeShader shader;
+    Scan          scan;
+
+    static void barrier( vk::raii::CommandBuffer const & cmd,
+                         vk::PipelineStageFlags2         srcStage,
+                         vk::AccessFlags2                srcAccess,
+                         vk::PipelineStageFlags2         dstStage,
+                         vk::AccessFlags2                dstAccess )
+    {
+      vk::MemoryBarrier2 memoryBarrier{ srcStage, srcAccess, dstStage, dstAccess };
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( memoryBarrier ) );
+    }
+
+    static void computeBarrier( vk::raii::CommandBuffer const & cmd )
+    {
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageWrite,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+    }
+  };
+
+  // The same broadphase and collision pass on CPU worker threads, to validate SpatialGrid and verlet.comp
+  // against and to run without a GPU. Bucket order within a bucket depends on thread timing like on the GPU.
+  struct GridReference
+  {
+    uint32_t              tableSize = 0;
+    std::vector<uint32_t> bucketStart;  // [tableSize + 1], global offsets into sorted
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> sorted;
+
+    void build( std::span<const glm::vec4> spheres, float cellSize, uint32_t threads = 0 )
+    {
+      uint32_t count = static_cast<uint32_t>( spheres.size() );
+      tableSize      = gridTableSize( count );
+      bucketStart.assign( tableSize + 1, 0 );
+      keys.resize( count );
+      sorted.resize( count );
+
+      std::vector<uint32_t> ranks( count );
+      parallelFor( count,
+                   threads,
+                   [&]( uint32_t i )
+                   {
+                     keys[i]  = gridHash( gridCell( glm::vec3( spheres[i] ), cellSize ), tableSize - 1 );
+                     ranks[i] = std::atomic_ref<uint32_t>( bucketStart[keys[i]] ).fetch_add( 1, std::memory_order_relaxed );
+                   } );
+      std::exclusive_scan( bucketStart.begin(), bucketStart.end(), bucketStart.begin(), 0u );
+      parallelFor( count, threads, [&]( uint32_t i ) { sorted[bucketStart[keys[i]] + ranks[i]] = i; } );
+    }
+
+    // One collision pass of verlet.comp over the built grid into `resolved`, returns the contact count
+    uint64_t collide( std::span<const glm::vec4> spheres,
+                      std::span<glm::vec4>       resolved,
+                      float                      cellSize,
+                      float                      relaxation,
+                      glm::vec3                  boundsMin,
+                      glm::vec3                  boundsMax,
+                      uint32_t                   threads = 0 ) const
+    {
+      std::atomic<uint64_t> contacts = 0;
+      parallelFor( static_cast<uint32_t>( spheres.size() ),
+                   threads,
+                   [&]( uint32_t i )
+                   {
+                     glm::vec4                self = spheres[i];
+                     glm::ivec3               cell = gridCell( glm::vec3( self ), cellSize );
+                     glm::vec3                correction( 0.0f );
+                     std::array<uint32_t, 27> visited{};
+                     uint32_t                 visits = 0;
+                     uint32_t                 found  = 0;
+                     for ( int z = -1; z <= 1; ++z )
+                       for ( int y = -1; y <= 1; ++y )
+                         for ( int x = -1; x <= 1; ++x )
+                         {
+                           uint32_t bucket = gridHash( cell + glm::ivec3( x, y, z ), tableSize - 1 );
+                           if ( std::find( visited.begin(), visited.begin() + visits, bucket ) != visited.begin() + visits )
+                             continue;
+                           visited[visits++] = bucket;
+
+                           for ( uint32_t k = bucketStart[bucket]; k < bucketStart[bucket + 1]; ++k )
+                           {
+                             uint32_t other = sorted[k];
+                             if ( other == i )
+                               continue;
+                             glm::vec3 delta    = glm::vec3( self ) - glm::vec3( spheres[other] );
+                             float     distance = glm::length( delta );
+                             float     overlap  = self.w + spheres[other].w - distance;
+                             if ( overlap <= 0.0f || distance <= 1e-6f )
+                               continue;
+                             correction += delta / distance * ( overlap * 0.5f );
+                             ++found;
+                           }
+                         }
+
+                     glm::vec3 low  = boundsMin + self.w;
+                     glm::vec3 high = boundsMax - self.w;
+                     resolved[i]    = glm::vec4( glm::clamp( glm::vec3( self ) + correction * relaxation, low, high ), self.w );
+                     if ( found )
+                       contacts.fetch_add( found, std::memory_order_relaxed );
+                   } );
+      return contacts.load();
+    }
+
+    // Every overlapping ordered pair by testing all of them, for checking the grid on small counts
+    [[nodiscard]] static uint64_t bruteForceContacts( std::span<const glm::vec4> spheres )
+    {
+      uint64_t contacts = 0;
+      for ( size_t i = 0; i < spheres.size(); ++i )
+        for ( size_t j = 0; j < spheres.size(); ++j )
+        {
+          float distance = glm::length( glm::vec3( spheres[i] ) - glm::vec3( spheres[j] ) );
+          if ( i != j && spheres[i].w + spheres[j].w - distance > 0.0f && distance > 1e-6f )
+            ++contacts;
+        }
+      return contacts;
+    }
+  };
+}  // namespace core
@@ -0,0 +1,158 @@
+#pragma once
+#include "../data.hpp"
+#include "../setup.hpp"
+#include "bindless.hpp"
+#include "instanceformat.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Chunked triangle meshes written by a GPU or CPU mesher and drawn by the scene pass in one
+  // vkCmdDrawIndexedIndirectCount. Every slot owns a fixed range of data::Vertex and of uint indices, the indices
+  // are relative to the slot's first vertex. The draw buffer holds the draw count followed by one command per slot:
+  //
+  //   word 0            number of commands drawn, the highest slot a mesher wrote plus one
+  //   from DrawsOffset  vk::DrawIndexedIndirectCommand per slot, firstIndex and vertexOffset fixed at creation,
+  //                     indexCount written by the mesher and 0 while the slot is empty
+  //
+  // Vertices are in world space, the draw reads a single identity instance so triangle.vert applies no transform.
+  struct SurfaceChunks
+  {
+    static constexpr vk::DeviceSize DrawsOffset = 16;
+
+    core::Buffer vertices;  // data::Vertex
+    core::Buffer indices;
+    core::Buffer draws;
+    core::Buffer instance;  // one identity instance in data::instanceFormat
+    uint32_t     vertexIndex     = InvalidBindlessIndex;
+    uint32_t     indexIndex      = InvalidBindlessIndex;
+    uint32_t     drawIndex       = InvalidBindlessIndex;
+    uint32_t     instanceIndex   = InvalidBindlessIndex;
+    uint32_t     slots           = 0;
+    uint32_t     verticesPerSlot = 0;
+    uint32_t     indicesPerSlot  = 0;
+    vk::Buffer   selection       = nullptr;  // host-written draws in the layout of `draws` that replace them when set
+
+    // Nothing may still use the previous buffers
+    void create( VmaAllocator allocator_, BindlessHeap & heap, uint32_t slots_, uint32_t verticesPerSlot_, uint32_t indicesPerSlot_, uint64_t frame )
+    {
+      if ( slots_ == 0 || verticesPerSlot_ == 0 || indicesPerSlot_ < 3 )
+        throw std::runtime_error( "Surface chunks need slots with room for a triangle" );
+
+      destroy( heap, frame );
+      allocator       = allocator_;
+      slots           = slots_;
+      verticesPerSlot = verticesPerSlot_;
+      indicesPerSlot  = indicesPerSlot_;
+
+      constexpr VmaAllocationCreateFlags upload  = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      constexpr vk::BufferUsageFlags     storage =
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+
+      vertices = core::createBuffer(
+        allocator, sizeof( data::Vertex ) * vk::DeviceSize( slots ) * verticesPerSlot, vk::BufferUsageFlagBits::eVertexBuffer | storage );
+      indices = core::createBuffer( allocator, sizeof( uint32_t ) * vk::DeviceSize( slots ) * indicesPerSlot, vk::BufferUsageFlagBits::eIndexBuffer | storage );
+      draws   = core::createBuffer( allocator,
+                                  DrawsOffset + sizeof( vk::DrawIndexedIndirectCommand ) * vk::DeviceSize( slots ),
+                                  vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst | storage,
+                                  upload );
+      instance = core::createBuffer( allocator, instanceStride( data::instanceFormat ), vk::BufferUsageFlagBits::eStorageBuffer, upload );
+
+      auto * bytes = static_cast<std::byte *>( draws.allocationInfo.pMappedData );
+      std::memset( bytes, 0, DrawsOffset );
+      for ( uint32_t slot = 0; slot < slots; ++slot )
+      {
+        vk::DrawIndexedIndirectCommand command{ 0, 1, slot * indicesPerSlot, int32_t( slot * verticesPerSlot ), 0 };
+        std::memcpy( bytes + DrawsOffset + sizeof( command ) * slot, &command, sizeof( command ) );
+      }
+      storeInstance( data::instanceFormat, instance.allocationInfo.pMappedData, 0, 1, data::InstanceData{ glm::vec3( 0.0f ) } );
+      vmaFlushAllocation( allocator, draws.allocation, 0, VK_WHOLE_SIZE );
+      vmaFlushAllocation( allocator, instance.allocation, 0, VK_WHOLE_SIZE );
+
+      vertexIndex   = heap.addStorageBuffer( vertices.buffer );
+      indexIndex    = heap.addStorageBuffer( indices.buffer );
+      drawIndex     = heap.addStorageBuffer( draws.buffer );
+      instanceIndex = heap.addStorageBuffer( instance.buffer );
+    }
+
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      for ( uint32_t * index : { &vertexIndex, &indexIndex, &drawIndex, &instanceIndex } )
+      {
+        heap.remove( BindlessHeap::StorageBuffers, *index, frame );
+        *index = InvalidBindlessIndex;
+      }
+      for ( core::Buffer * buffer : { &vertices, &indices, &draws, &instance } )
+        core::destroyBuffer( allocator, *buffer );
+      slots = 0;
+    }
+
+    // Draws the first indexCounts[slot] indices of every slot, for meshes the host copied into the slots. Nothing
+    // may be drawing the surface or writing its draws on the GPU.
+    void setIndexCounts( std::span<const uint32_t> indexCounts )
+    {
+      if ( indexCounts.size() > slots )
+        throw std::runtime_error( "Index counts for " + std::to_string( indexCounts.size() ) + " slots of " + std::to_string( slots ) );
+
+      auto *   bytes = static_cast<std::byte *>( draws.allocationInfo.pMappedData );
+      uint32_t count = static_cast<uint32_t>( indexCounts.size() );
+      std::memcpy( bytes, &count, sizeof( count ) );
+      for ( uint32_t slot = 0; slot < count; ++slot )
+        std::memcpy( bytes + DrawsOffset + sizeof( vk::DrawIndexedIndirectCommand ) * slot, &indexCounts[slot], sizeof( uint32_t ) );
+      vmaFlushAllocation( allocator, draws.allocation, 0, VK_WHOLE_SIZE );
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+      return slots == 0;
+    }
+
+    [[nodiscard]] vk::DeviceSize bytes() const
+    {
+      return vertices.size + indices.size + draws.size;
+    }
+
+    // Inside a scene pass with the vertex stages and the heap bound, `pc` holds the camera
+    void draw( vk::raii::CommandBuffer const & cmd, vk::PipelineLayout layout, data::PushConstants pc ) const
+    {
+      if ( empty() )
+        return;
+
+      // The packed formats store the scale in unorm8, which does not hit 1 exactly
+      float scale = 1.0f;
+      if ( data::instanceFormat != data::InstanceFormat::Float )
+        scale = glm::unpackUnorm4x8( glm::packUnorm4x8( glm::vec4( 0.0f, 0.0f, 0.0f, 1.0f / data::instanceMaxScale ) ) ).w * data::instanceMaxScale;
+
+      pc.instanceBuffer = instanceIndex;
+      pc.visibleBuffer  = InvalidBindlessIndex;
+      pc.instanceCount  = 1;
+      pc.positionScale  = 1.0f / scale;
+      cmd.pushConstants<data::PushConstants>( layout, vk::ShaderStageFlagBits::eVertex, 0, { pc } );
+
+      vk::VertexInputBindingDescription2EXT binding{};
+      binding.setBinding( 0 ).setStride( sizeof( data::Vertex ) ).setInputRate( vk::VertexInputRate::eVertex ).setDivisor( 1 );
+      std::array<vk::VertexInputAttributeDescription2EXT, 2> attributes{};
+      attributes[0].setLocation( 0 ).setBinding( 0 ).setFormat( vk::Format::eR32G32B32Sfloat ).setOffset( offsetof( data::Vertex, position ) );
+      attributes[1].setLocation( 1 ).setBinding( 0 ).setFormat( vk::Format::eR32G32B32Sfloat ).setOffset( offsetof( data::Vertex, color ) );
+      cmd.setVertexInputEXT( binding, attributes );
+
+      cmd.bindVertexBuffers( 0, { vk::Buffer( vertices.buffer ) }, { vk::DeviceSize( 0 ) } );
+      cmd.bindIndexBuffer( indices.buffer, 0, vk::IndexType::eUint32 );
+      vk::Buffer source = selection ? selection : vk::Buffer( draws.buffer );
+      cmd.drawIndexedIndirectCount( source, DrawsOffset, source, 0, slots, sizeof( vk::DrawIndexedIndirectCommand ) );
+    }
+
+  private:
+    VmaAllocator allocator = nullptr;
+  };
+}  // namespace core
@@ -0,0 +1,107 @@
+#pragma once
+#include "../state.hpp"
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Timestamp queries per frame slot. Scopes are recorded into the frame's command buffers and read back
+  // the next time the slot comes around (after its fence was waited), so results lag MAX_FRAMES_IN_FLIGHT frames.
+  struct GpuTimer
+  {
+    static constexpr uint32_t MaxScopes = 16;
+
+    struct Scope
+    {
+      std::string_view name;
+      float            ms = 0.0f;
+    };
+
+    void init( vk::raii::Device const & device, vk::raii::PhysicalDevice const & physicalDevice )
+    {
+      period = physicalDevice.getProperties().limits.timestampPeriod;
+
+      vk::QueryPoolCreateInfo info{};
+      info.setQueryType( vk::QueryType::eTimestamp ).setQueryCount( MaxScopes * 2 * global::state::MAX_FRAMES_IN_FLIGHT );
+      pool = vk::raii::QueryPool( device, info );
+    }
+
+    // First command of the frame, resets the queries owned by this slot
+    void begin( vk::raii::CommandBuffer const & cmd, uint32_t slot )
+    {
+      current = slot;
+      names[slot].clear();
+      cmd.resetQueryPool( *pool, base( slot ), MaxScopes * 2 );
+    }
+
+    [[nodiscard]] uint32_t beginScope( vk::raii::CommandBuffer const & cmd, std::string_view name )
+    {
+      uint32_t id = static_cast<uint32_t>( names[current].size() );
+      if ( id >= MaxScopes )
+        return UINT32_MAX;
+
+      names[current].push_back( name );
+      cmd.writeTimestamp2( vk::PipelineStageFlagBits2::eAllCommands, *pool, base( current ) + id * 2 );
+      return id;
+    }
+
+    void endScope( vk::raii::CommandBuffer const & cmd, uint32_t id )
+    {
+      if ( id != UINT32_MAX )
+        cmd.writeTimestamp2( vk::PipelineStageFlagBits2::eAllCommands, *pool, base( current ) + id * 2 + 1 );
+    }
+
+    // Call after the slot's fence has been waited, before begin() records into it again
+    void collect( uint32_t slot )
+    {
+      uint32_t count = static_cast<uint32_t>( names[slot].size() );
+      if ( count == 0 )
+        return;
+
+      auto [result, ticks] = pool.getResults<uint64_t>( base( slot ), count * 2, count * 2 * sizeof( uint64_t ), sizeof( uint64_t ), vk::QueryResultFlagBits::e64 );
+      if ( result != vk::Result::eSuccess )
+        return;
+
+      scopes.clear();
+      for ( uint32_t i = 0; i < count; ++i )
+        scopes.push_back( { names[slot][i], static_cast<float>( ticks[i * 2 + 1] - ticks[i * 2] ) * period * 1e-6f } );
+    }
+
+    // Latest result of a scope, 0 when it was not recorded
+    [[nodiscard]] float ms( std::string_view name ) const
+    {
+      for ( auto const & scope : scopes )
+        if ( scope.name == name )
+          return scope.ms;
+      return 0.0f;
+    }
+
+    // Sum of the latest results of every scope whose name starts with `prefix`
+    [[nodiscard]] float msPrefix( std::string_view prefix ) const
+    {
+      float sum = 0.0f;
+      for ( auto const & scope : scopes )
+        if ( scope.name.starts_with( prefix ) )
+          sum += scope.ms;
+      return sum;
+    }
+
+    std::vector<Scope> scopes;
+
+  private:
+    vk::raii::QueryPool pool    = nullptr;
+    float               period  = 1.0f;  // nanoseconds per tick
+    uint32_t            current = 0;
+
+    std::array<std::vector<std::string_view>, global::state::MAX_FRAMES_IN_FLIGHT> names;
+
+    static uint32_t base( uint32_t slot )
+    {
+      return slot * MaxScopes * 2;
+    }
+  };
+}  // namespace core
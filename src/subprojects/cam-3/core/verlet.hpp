@@ -0,0 +1,661 @@
+#pragma once
+#include "../data.hpp"
+#include "../helper.hpp"
+#include "../setup.hpp"
+#include "../state.hpp"
+#include "bindless.hpp"
+#include "compute.hpp"
+#include "instanceformat.hpp"
+#include "instances.hpp"
+#include "oneshot.hpp"
+#include "readback.hpp"
+#include "spatialgrid.hpp"
+#include "xpbd.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <print>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Value of data::VerletPushConstants::pass, mirrors verlet.comp
+  enum class VerletPass : uint32_t
+  {
+    Seed      = 0,
+    Integrate = 1,
+    Collide   = 2,
+    Encode    = 3,
+  };
+
+  struct VerletParams
+  {
+    uint32_t   count        = 100000;
+    uint32_t   substeps     = 8;
+    float      frameTime    = 1.0f / 60.0f;  // simulated per frame, fixed so results do not depend on the frame rate
+    glm::vec3  gravity      = glm::vec3( 0.0f, -9.81f, 0.0f );
+    float      damping      = 0.0005f;
+    float      radius       = 0.5f;
+    glm::vec3  boundsMin    = glm::vec3( -100.0f, -60.0f, -100.0f );
+    glm::vec3  boundsMax    = glm::vec3( 100.0f, 60.0f, 100.0f );
+    float      launchSpeed  = 10.0f;
+    float      colorSpeed   = 30.0f;
+    uint32_t   seed         = 1;
+    bool       collisions   = true;  // sphere-sphere contacts through SpatialGrid after every integration
+    float      relaxation   = 0.8f;
+    uint32_t   softBodies   = 0;  // lattice cubes held together by springs, in place of the first spheres
+    uint32_t   softBodySize = 4;  // spheres per edge
+    XpbdParams springs;           // solved after every integration, before collisions
+  };
+
+  // Verlet sphere simulation on the GPU. Positions are kept at full precision in three vec4 buffers (position,
+  // radius) whose roles rotate: integration overwrites the previous positions with the next ones and swaps them
+  // with the current, collisions resolve the current positions into the spare buffer and swap those. The last
+  // pass of a frame encodes the spheres into an instance buffer in data::instanceFormat that the scene draws in
+  // place of InstanceGenerator's. Nothing is read back, the passes are recorded into a command buffer per frame
+  // slot that is submitted ahead of the scene.
+  //
+  // The packed instance formats quantize positions to ~2 mm, more than gravity moves a sphere in one substep,
+  // which is why the simulation state is not the instance buffer itself.
+  //
+  // Soft bodies replace the first spheres with lattice cubes at rest whose springs XpbdSolver solves in place on
+  // the current positions after every integration, the velocity follows implicitly from the corrected position.
+  struct VerletSim
+  {
+    static constexpr uint32_t GroupSize  = 64;
+    static constexpr uint32_t MaxSpheres = InstanceGenerator::MaxInstances;
+
+    VerletParams                params;
+    std::array<core::Buffer, 3> spheres;
+    std::array<uint32_t, 3>     sphereIndices = { InvalidBindlessIndex, InvalidBindlessIndex, InvalidBindlessIndex };
+    core::Buffer                instances;
+    uint32_t                    instanceIndex = InvalidBindlessIndex;
+    SpatialGrid                 grid;
+    XpbdSolver                  xpbd;
+    uint32_t                    count    = 0;
+    uint32_t                    current  = 0;  // spheres[current] holds the latest positions
+    uint32_t                    previous = 1;
+    uint32_t                    spare    = 2;
+    uint64_t                    substeps = 0;  // since the last reset
+    bool                        paused   = false;
+    float                       gpuMs    = 0.0f;  // passes of the last collected frame
+    std::string                 error;            // of the last reset or benchmark started from the UI
+
+    void init( vk::raii::Device const &         device_,
+               vk::raii::PhysicalDevice const & physicalDevice,
+               VmaAllocator                     allocator_,
+               BindlessHeap const &             heap,
+               uint32_t                         queueFamily,
+               vk::raii::Queue const &          queue_ )
+    {
+      allocator = allocator_;
+      period    = physicalDevice.getProperties().limits.timestampPeriod;
+
+      shader = ComputeShader( device_, "verlet.comp", sizeof( data::VerletPushConstants ), { *heap.layout } );
+      grid.init( device_, physicalDevice, allocator_, heap );
+      xpbd.init( device_, allocator_, heap );
+      oneShot.init( device_, physicalDevice, allocator_, queueFamily, queue_ );
+      commandPool = vk::raii::CommandPool( device_, vk::CommandPoolCreateInfo{ vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamily } );
+      frameCmds   = vk::raii::CommandBuffers(
+        device_, vk::CommandBufferAllocateInfo{ commandPool, vk::CommandBufferLevel::ePrimary, uint32_t( global::state::MAX_FRAMES_IN_FLIGHT ) } );
+
+      // A pair per frame slot, one-shot submits are timed by oneShot
+      vk::QueryPoolCreateInfo queryInfo{};
+      queryInfo.setQueryType( vk::QueryType::eTimestamp ).setQueryCount( 2 * uint32_t( global::state::MAX_FRAMES_IN_FLIGHT ) );
+      queries = vk::raii::QueryPool( device_, queryInfo );
+    }
+
+    // Nothing may still use the buffers (wait for the device first)
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      for ( uint32_t i = 0; i < 3; ++i )
+      {
+        heap.remove( BindlessHeap::StorageBuffers, sphereIndices[i], frame );
+        sphereIndices[i] = InvalidBindlessIndex;
+        core::destroyBuffer( allocator, spheres[i] );
+      }
+      heap.remove( BindlessHeap::StorageBuffers, instanceIndex, frame );
+      instanceIndex = InvalidBindlessIndex;
+      core::destroyBuffer( allocator, instances );
+      grid.destroy( heap, frame );
+      xpbd.destroy( heap, frame );
+      count = 0;
+    }
+
+    // Reallocates the buffers for `params_.count` spheres and seeds them, waits for the dispatch. Nothing may
+    // still use the previous buffers.
+    void reset( BindlessHeap & heap, VerletParams const & params_, uint64_t frame )
+    {
+      if ( params_.count == 0 || params_.count > MaxSpheres )
+        throw std::runtime_error( "Sphere count has to be between 1 and " + std::to_string( MaxSpheres ) );
+      if ( params_.radius <= 0.0f || params_.radius > data::instanceMaxScale * data::modelRadius )
+        throw std::runtime_error( "Sphere radius has to be between 0 and " + std::to_string( data::instanceMaxScale * data::modelRadius ) );
+
+      glm::vec3 extent = params_.boundsMax - params_.boundsMin;
+      if ( params_.radius * 2.0f > std::min( { extent.x, extent.y, extent.z } ) )
+        throw std::runtime_error( "Spheres do not fit into the container" );
+
+      SoftBodies bodies;
+      if ( params_.softBodies > 0 )
+      {
+        bodies = buildSoftBodies( params_.softBodies, params_.softBodySize, params_.radius, params_.boundsMin, params_.boundsMax );
+        if ( bodies.spheres.size() > params_.count )
+          throw std::runtime_error( "Soft bodies need " + std::to_string( bodies.spheres.size() ) + " spheres" );
+      }
+
+      destroy( heap, frame );
+      params   = params_;
+      count    = params.count;
+      current  = 0;
+      previous = 1;
+      spare    = 2;
+      substeps = 0;
+
+      constexpr vk::BufferUsageFlags usage =
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc;
+      for ( uint32_t i = 0; i < 3; ++i )
+      {
+        spheres[i]       = core::createBuffer( allocator, sizeof( glm::vec4 ) * vk::DeviceSize( count ), usage );
+        sphereIndices[i] = heap.addStorageBuffer( spheres[i].buffer );
+      }
+      instances     = core::createBuffer( allocator, instanceStride( data::instanceFormat ) * vk::DeviceSize( count ), usage );
+      instanceIndex = heap.addStorageBuffer( instances.buffer );
+      grid.resize( heap, count, frame );
+
+      oneShot.submit( [&]( vk::raii::CommandBuffer const & cmd ) { dispatch( cmd, heap, VerletPass::Seed, true ); } );
+      if ( bodies.spheres.empty() )
+        return;
+
+      // At rest: the previous positions equal the current ones
+      oneShot.upload( spheres[current].buffer, std::span<const glm::vec4>( bodies.spheres ) );
+      oneShot.upload( spheres[previous].buffer, std::span<const glm::vec4>( bodies.spheres ) );
+      xpbd.build( heap, std::move( bodies.springs ), count, frame );
+      oneShot.submit(
+        [&]( vk::raii::CommandBuffer const & cmd )
+        {
+          xpbd.recordUpload( cmd );
+          dispatch( cmd, heap, VerletPass::Encode, true );
+        } );
+      xpbd.releaseStaging();
+    }
+
+    // Passes of one frame into the command buffer of `slot`, submit it before the scene. Empty while paused.
+    [[nodiscard]] vk::CommandBuffer record( BindlessHeap const & heap, uint32_t slot )
+    {
+      recorded[slot] = false;
+      if ( count == 0 || paused )
+        return nullptr;
+
+      auto & frameCmd = frameCmds[slot];
+      frameCmd.reset();
+      frameCmd.begin( vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+      frameCmd.resetQueryPool( *queries, slot * 2, 2 );
+      frameCmd.writeTimestamp2( vk::PipelineStageFlagBits2::eAllCommands, *queries, slot * 2 );
+      recordFrame( frameCmd, heap );
+      frameCmd.writeTimestamp2( vk::PipelineStageFlagBits2::eAllCommands, *queries, slot * 2 + 1 );
+      frameCmd.end();
+
+      recorded[slot] = true;
+      return *frameCmd;
+    }
+
+    // Call after the slot's fence has been waited
+    void collect( uint32_t slot )
+    {
+      if ( !recorded[slot] )
+        return;
+      auto [result, ticks] = queries.getResults<uint64_t>( slot * 2, 2, 2 * sizeof( uint64_t ), sizeof( uint64_t ), vk::QueryResultFlagBits::e64 );
+      if ( result == vk::Result::eSuccess )
+        gpuMs = static_cast<float>( ticks[1] - ticks[0] ) * period * 1e-6f;
+    }
+
+    // Simulates `frames` frames in one submit and waits, returns the GPU time per frame
+    float time( BindlessHeap const & heap, uint32_t frames )
+    {
+      oneShot.submit(
+        [&]( vk::raii::CommandBuffer const & cmd )
+        {
+          oneShot.timestamp( cmd, 0 );
+          for ( uint32_t i = 0; i < frames; ++i )
+            recordFrame( cmd, heap );
+          oneShot.timestamp( cmd, 1 );
+        } );
+      return frames ? oneShot.milliseconds( 0, 1 ) / float( frames ) : 0.0f;
+    }
+
+    // One broadphase and collision pass on the current positions without integrating, contacts are added to
+    // word 0 of the storage buffer at heap slot `statsBuffer`. Waits for it.
+    void collideOnce( BindlessHeap const & heap, uint32_t statsBuffer )
+    {
+      oneShot.submit( [&]( vk::raii::CommandBuffer const & cmd ) { recordCollide( cmd, heap, false, statsBuffer ); } );
+    }
+
+    // Sphere state streamed per substep plus the instance encode once per frame. Neighbor reads of the
+    // collision pass are not counted, they depend on the packing.
+    [[nodiscard]] vk::DeviceSize bytesPerFrame() const
+    {
+      vk::DeviceSize integrate = 3 * sizeof( glm::vec4 );
+      vk::DeviceSize collide   = params.collisions ? 4 * sizeof( glm::vec4 ) + 7 * sizeof( uint32_t ) : 0;
+      vk::DeviceSize springs   = xpbd.bytesPerIteration() * std::max( params.springs.iterations, 1u );
+      vk::DeviceSize substep   = vk::DeviceSize( count ) * ( integrate + collide ) + springs;
+      return substep * std::max( params.substeps, 1u ) + vk::DeviceSize( count ) * instanceStride( data::instanceFormat );
+    }
+
+  private:
+    VmaAllocator             allocator = nullptr;
+    float                    period    = 1.0f;
+    ComputeShader            shader;
+    OneShotQueue             oneShot;
+    vk::raii::CommandPool    commandPool = nullptr;
+    vk::raii::CommandBuffers frameCmds   = nullptr;
+    vk::raii::QueryPool      queries     = nullptr;
+
+    std::array<bool, global::state::MAX_FRAMES_IN_FLIGHT> recorded{};
+
+    void dispatch( vk::raii::CommandBuffer const & target,
+                   BindlessHeap const &            heap,
+                   VerletPass                      pass,
+                   bool                            writeInstances,
+                   uint32_t                        statsBuffer = InvalidBindlessIndex )
+    {
+      data::VerletPushConstants pc{};
+      pc.gravity        = params.gravity;
+      pc.dt             = substepTime();
+      pc.boundsMin      = params.boundsMin;
+      pc.damping        = params.damping;
+      pc.boundsMax      = params.boundsMax;
+      pc.radius         = params.radius;
+      pc.currentBuffer  = sphereIndices[current];
+      pc.previousBuffer = sphereIndices[previous];
+      pc.targetBuffer   = sphereIndices[spare];
+      pc.instanceBuffer = instanceIndex;
+      pc.count          = count;
+      pc.pass           = static_cast<uint32_t>( pass );
+      pc.writeInstances = writeInstances ? 1 : 0;
+      pc.seed           = params.seed;
+      pc.launchSpeed    = params.launchSpeed;
+      pc.colorSpeed     = params.colorSpeed;
+      pc.instanceScale  = params.radius / data::modelRadius;
+      pc.relaxation     = params.relaxation;
+      pc.cellBuffer     = grid.cellIndex;
+      pc.sortedBuffer   = grid.sortedIndex;
+      pc.tableMask      = grid.tableMask();
+      pc.cellSize       = cellSize();
+      pc.statsBuffer    = statsBuffer;
+
+      shader.bind( target );
+      heap.bind( target, *shader.layout, vk::PipelineBindPoint::eCompute );
+      shader.push( target, pc );
+      target.dispatch( ( count + GroupSize - 1 ) / GroupSize, 1, 1 );
+    }
+
+    [[nodiscard]] float substepTime() const
+    {
+      return params.frameTime / float( std::max( params.substeps, 1u ) );
+    }
+
+    // Every sphere has the same radius, so one diameter per cell keeps all contacts within the 27 neighbors
+    [[nodiscard]] float cellSize() const
+    {
+      return 2.0f * params.radius;
+    }
+
+    static void barrier( vk::raii::CommandBuffer const & target,
+                         vk::PipelineStageFlags2         srcStage,
+                         vk::AccessFlags2                srcAccess,
+                         vk::PipelineStageFlags2         dstStage,
+                         vk::AccessFlags2                dstAccess )
+    {
+      vk::MemoryBarrier2 memoryBarrier{ srcStage, srcAccess, dstStage, dstAccess };
+      target.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( memoryBarrier ) );
+    }
+
+    static void computeBarrier( vk::raii::CommandBuffer const & target )
+    {
+      barrier( target,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageWrite,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+    }
+
+    void recordCollide( vk::raii::CommandBuffer const & target, BindlessHeap const & heap, bool writeInstances, uint32_t statsBuffer )
+    {
+      grid.record( target, heap, sphereIndices[current], count, cellSize() );
+      dispatch( target, heap, VerletPass::Collide, writeInstances, statsBuffer );
+      std::swap( current, spare );
+    }
+
+    // The previous frame may still draw the instance buffer when this one starts, and every pass reads what the
+    // one before wrote. The barriers cover commands across submits on the same queue.
+    void recordFrame( vk::raii::CommandBuffer const & target, BindlessHeap const & heap )
+    {
+      barrier( target,
+               vk::PipelineStageFlagBits2::eAllCommands,
+               vk::AccessFlagBits2::eShaderStorageRead,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+
+      uint32_t steps   = std::max( params.substeps, 1u );
+      bool     springs = xpbd.springCount > 0;
+      for ( uint32_t i = 0; i < steps; ++i )
+      {
+        bool last = i + 1 == steps;
+        dispatch( target, heap, VerletPass::Integrate, last && !params.collisions && !springs );
+        std::swap( current, previous );
+        if ( springs )
+        {
+          computeBarrier( target );
+          xpbd.record( target, heap, sphereIndices[current], substepTime(), params.springs );
+          if ( last && !params.collisions )
+            dispatch( target, heap, VerletPass::Encode, true );
+        }
+        if ( params.collisions )
+        {
+          if ( !springs )
+            computeBarrier( target );
+          recordCollide( target, heap, last, InvalidBindlessIndex );
+        }
+        ++substeps;
+        if ( !last )
+          computeBarrier( target );
+      }
+
+      barrier( target,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageWrite,
+               vk::PipelineStageFlagBits2::eAllCommands,
+               vk::AccessFlagBits2::eShaderStorageRead );
+    }
+  };
+
+  // Physics sensors of VerletSim: the first `tracked` spheres are copied into a ReadbackRing every frame and
+  // summarized on the host when they arrive, a few frames later, without waiting for the GPU
+  struct SphereSensors
+  {
+    struct Reading
+    {
+      uint64_t  frame    = 0;  // the positions are of the end of this frame
+      uint64_t  latency  = 0;  // frames until they arrived
+      uint32_t  count    = 0;
+      glm::vec3 centroid = glm::vec3( 0.0f );
+      float     lowest   = 0.0f;
+      float     highest  = 0.0f;
+    };
+
+    bool         enabled = false;
+    uint32_t     tracked = 1024;
+    Reading      last;
+    ReadbackRing ring;
+
+    void init( vk::raii::Device const & device, VmaAllocator allocator, uint32_t queueFamily )
+    {
+      ring.init( device, allocator, queueFamily );
+    }
+
+    // Reallocates the ring for `tracked` spheres, nothing may still use it
+    void start()
+    {
+      std::array<vk::DeviceSize, 1> capacities = { sizeof( glm::vec4 ) * vk::DeviceSize( std::max( tracked, 1u ) ) };
+      ring.configure( capacities );
+      last    = Reading{};
+      enabled = true;
+    }
+
+    // Nothing may still use the ring
+    void stop()
+    {
+      enabled = false;
+      ring.destroy();
+    }
+
+    // After sim.record() for the same frame, whose passes the copy has to follow
+    [[nodiscard]] vk::CommandBuffer record( VerletSim const & sim, uint32_t frameSlot, uint64_t frame )
+    {
+      if ( !enabled || sim.count == 0 )
+        return nullptr;
+      vk::DeviceSize bytes = sizeof( glm::vec4 ) * vk::DeviceSize( std::min( std::max( tracked, 1u ), sim.count ) );
+      return ring.record(
+        frameSlot, frame, [&]( vk::raii::CommandBuffer const & cmd ) { ring.copy( cmd, 0, sim.spheres[sim.current].buffer, 0, bytes ); } );
+    }
+
+    void collect( uint64_t frame )
+    {
+      if ( !enabled )
+        return;
+      ring.poll( frame,
+                 [&]( ReadbackFrame const & delivered )
+                 {
+                   std::span<const glm::vec4> spheres = delivered.view<glm::vec4>( 0 );
+                   if ( spheres.empty() )
+                     return;
+
+                   Reading reading{};
+                   reading.frame   = delivered.frame;
+                   reading.latency = delivered.latency;
+                   reading.count   = uint32_t( spheres.size() );
+                   reading.lowest  = spheres.front().y;
+                   reading.highest = spheres.front().y;
+                   for ( glm::vec4 const & sphere : spheres )
+                   {
+                     reading.centroid += glm::vec3( sphere );
+                     reading.lowest  = std::min( reading.lowest, sphere.y );
+                     reading.highest = std::max( reading.highest, sphere.y );
+                   }
+                   reading.centroid /= float( reading.count );
+                   last = reading;
+                 } );
+    }
+  };
+
+  // GPU time per frame of VerletSim over sphere counts from 10k to 4M, each in a scratch simulation with the
+  // same parameters. Counts above VerletSim::MaxSpheres are clamped to it.
+  struct VerletBenchmark
+  {
+    static constexpr std::array<uint32_t, 7> Counts = { 10000, 50000, 100000, 500000, 1000000, 2000000, 4000000 };
+
+    struct Result
+    {
+      uint32_t count              = 0;
+      uint32_t substeps           = 0;
+      float    msPerFrame         = 0.0f;
+      float    msPerSubstep       = 0.0f;
+      float    spheresPerSecond   = 0.0f;  // millions of sphere substeps
+      float    gigabytesPerSecond = 0.0f;
+    };
+
+    uint32_t            warmupFrames = 8;
+    uint32_t            frames       = 32;
+    std::vector<Result> results;
+
+    void run( vk::raii::Device const &         device,
+              vk::raii::PhysicalDevice const & physicalDevice,
+              VmaAllocator                     allocator,
+              BindlessHeap &                   heap,
+              VerletParams const &             params,
+              uint32_t                         queueFamily,
+              vk::raii::Queue const &          queue,
+              uint64_t                         frame )
+    {
+      VerletSim sim;
+      sim.init( device, physicalDevice, allocator, heap, queueFamily, queue );
+
+      results.clear();
+      for ( uint32_t count : Counts )
+      {
+        VerletParams scratch = params;
+        scratch.count        = std::min( count, VerletSim::MaxSpheres );
+        sim.reset( heap, scratch, frame );
+        (void)sim.time( heap, warmupFrames );
+
+        Result result{};
+        result.count      = scratch.count;
+        result.substeps   = std::max( scratch.substeps, 1u );
+        result.msPerFrame = sim.time( heap, std::max( frames, 1u ) );
+        if ( result.msPerFrame > 0.0f )
+        {
+          result.msPerSubstep       = result.msPerFrame / float( result.substeps );
+          result.spheresPerSecond   = float( result.count ) * float( result.substeps ) / result.msPerFrame * 1e-3f;
+          result.gigabytesPerSecond = float( sim.bytesPerFrame() ) / result.msPerFrame * 1e-6f;
+        }
+        results.push_back( result );
+
+        isDebug( std::println( "[verlet] {} spheres, {} substeps: {:.3f} ms/frame, {:.1f} M sphere substeps/s, {:.1f} GB/s",
+                               result.count,
+                               result.substeps,
+                               result.msPerFrame,
+                               result.spheresPerSecond,
+                               result.gigabytesPerSecond ) );
+      }
+      sim.destroy( heap, frame );
+    }
+  };
+
+  // Checks SpatialGrid and the collision pass of verlet.comp against GridReference. `count` spheres are seeded
+  // on the GPU into a box packed tightly enough for most of them to touch, read back, and run through one
+  // broadphase and collision pass on both sides:
+  //
+  //   buckets   every bucket start of the GPU grid equals the CPU one
+  //   sorted    every bucket holds the same spheres (their order inside a bucket depends on atomics)
+  //   contacts  the same number of overlapping pairs, and for small counts the same as testing every pair
+  //   error     largest difference of the resolved positions, float summation order differs per bucket
+  struct GridValidation
+  {
+    static constexpr uint32_t BruteForceLimit = 8192;
+
+    struct Result
+    {
+      uint32_t    count         = 0;
+      uint64_t    contactsGpu   = 0;
+      uint64_t    contactsCpu   = 0;
+      uint64_t    contactsBrute = 0;  // only up to BruteForceLimit spheres
+      float       maxError      = 0.0f;
+      float       cpuBuildMs    = 0.0f;
+      float       cpuCollideMs  = 0.0f;
+      uint32_t    threads       = 0;
+      std::string error;  // first failed check, empty when valid
+    };
+
+    uint32_t            count     = 100000;
+    uint32_t            threads   = 0;
+    float               tolerance = 1e-4f;
+    std::vector<Result> results;
+
+    void run( vk::raii::Device const &         device,
+              vk::raii::PhysicalDevice const & physicalDevice,
+              VmaAllocator                     allocator,
+              BindlessHeap &                   heap,
+              uint32_t                         queueFamily,
+              vk::raii::Queue const &          queue,
+              uint64_t                         frame )
+    {
+      using Clock = std::chrono::steady_clock;
+
+      VerletSim    sim;
+      OneShotQueue oneShot;
+      sim.init( device, physicalDevice, allocator, heap, queueFamily, queue );
+      oneShot.init( device, physicalDevice, allocator, queueFamily, queue );
+
+      // One cube of the sphere diameter per sphere, seeded uniformly so that a good share of them overlap
+      VerletParams params;
+      params.count       = std::clamp( count, 1u, VerletSim::MaxSpheres );
+      params.launchSpeed = 0.0f;
+      float side         = std::cbrt( float( params.count ) ) * 2.0f * params.radius;
+      params.boundsMin   = glm::vec3( -0.5f * side );
+      params.boundsMax   = glm::vec3( 0.5f * side );
+      sim.reset( heap, params, frame );
+
+      constexpr VmaAllocationCreateFlags readback   = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      core::Buffer                       stats      = core::createBuffer( allocator, sizeof( uint32_t ), vk::BufferUsageFlagBits::eStorageBuffer, readback );
+      uint32_t                           statsIndex = heap.addStorageBuffer( stats.buffer );
+      *static_cast<uint32_t *>( stats.allocationInfo.pMappedData ) = 0;
+      vmaFlushAllocation( allocator, stats.allocation, 0, VK_WHOLE_SIZE );
+
+      std::vector<glm::vec4> input = oneShot.download<glm::vec4>( sim.spheres[sim.current].buffer, sim.count );
+      sim.collideOnce( heap, statsIndex );
+      std::vector<glm::vec4> resolved = oneShot.download<glm::vec4>( sim.spheres[sim.current].buffer, sim.count );
+      std::vector<uint32_t>  cells    = oneShot.download<uint32_t>( sim.grid.cells.buffer, sim.grid.tableSize + 1 );
+      std::vector<uint32_t>  sorted   = oneShot.download<uint32_t>( sim.grid.sorted.buffer, sim.count );
+
+      Result result{};
+      result.count   = sim.count;
+      result.threads = workerCount( threads );
+
+      vmaInvalidateAllocation( allocator, stats.allocation, 0, VK_WHOLE_SIZE );
+      result.contactsGpu = *static_cast<uint32_t const *>( stats.allocationInfo.pMappedData );
+
+      GridReference reference;
+      auto          begin = Clock::now();
+      reference.build( input, 2.0f * params.radius, threads );
+      auto                   built = Clock::now();
+      std::vector<glm::vec4> expected( input.size() );
+      result.contactsCpu  = reference.collide( input, expected, 2.0f * params.radius, params.relaxation, params.boundsMin, params.boundsMax, threads );
+      result.cpuBuildMs   = std::chrono::duration<float, std::milli>( built - begin ).count();
+      result.cpuCollideMs = std::chrono::duration<float, std::milli>( Clock::now() - built ).count();
+      if ( result.count <= BruteForceLimit )
+        result.contactsBrute = GridReference::bruteForceContacts( input );
+
+      auto fail = [&]( std::string const & what )
+      {
+        if ( result.error.empty() )
+          result.error = what;
+      };
+
+      if ( reference.tableSize != sim.grid.tableSize )
+        fail( "table size " + std::to_string( sim.grid.tableSize ) + ", expected " + std::to_string( reference.tableSize ) );
+      else
+      {
+        for ( uint32_t bucket = 0; bucket < reference.tableSize && result.error.empty(); ++bucket )
+        {
+          uint32_t start = cells[bucket];
+          uint32_t end   = cells[bucket + 1];
+          if ( start != reference.bucketStart[bucket] || end != reference.bucketStart[bucket + 1] )
+          {
+            fail( "bucket " + std::to_string( bucket ) + " spans [" + std::to_string( start ) + ", " + std::to_string( end ) + "), expected [" +
+                  std::to_string( reference.bucketStart[bucket] ) + ", " + std::to_string( reference.bucketStart[bucket + 1] ) + ")" );
+            break;
+          }
+          std::sort( sorted.begin() + start, sorted.begin() + end );
+          std::vector<uint32_t> cpu( reference.sorted.begin() + start, reference.sorted.begin() + end );
+          std::sort( cpu.begin(), cpu.end() );
+          if ( !std::equal( cpu.begin(), cpu.end(), sorted.begin() + start ) )
+            fail( "bucket " + std::to_string( bucket ) + " holds other spheres" );
+        }
+      }
+
+      if ( result.contactsGpu != result.contactsCpu )
+        fail( std::to_string( result.contactsGpu ) + " contacts, the reference finds " + std::to_string( result.contactsCpu ) );
+      if ( result.count <= BruteForceLimit && result.contactsCpu != result.contactsBrute )
+        fail( "the grid finds " + std::to_string( result.contactsCpu ) + " contacts, testing every pair " + std::to_string( result.contactsBrute ) );
+
+      for ( size_t i = 0; i < resolved.size(); ++i )
+        result.maxError = std::max( result.maxError, glm::length( glm::vec3( resolved[i] ) - glm::vec3( expected[i] ) ) );
+      if ( result.maxError > tolerance )
+        fail( "resolved positions differ by up to " + std::to_string( result.maxError ) );
+
+      results.push_back( result );
+      isDebug( std::println( "[grid] {} spheres, {} contacts (CPU {}), max error {:.2e}, CPU build {:.2f} ms, collide {:.2f} ms: {}",
+                             result.count,
+                             result.contactsGpu,
+                             result.contactsCpu,
+                             result.maxError,
+                             result.cpuBuildMs,
+                             result.cpuCollideMs,
+                             result.error.empty() ? "valid" : result.error ) );
+
+      heap.remove( BindlessHeap::StorageBuffers, statsIndex, frame );
+      core::destroyBuffer( allocator, stats );
+      sim.destroy( heap, frame );
+    }
+  };
+}  // namespace core
@@ -0,0 +1,700 @@
+#pragma once
+#include "../data.hpp"
+#include "../helper.hpp"
+#include "../setup.hpp"
+#include "bindless.hpp"
+#include "compute.hpp"
+#include "oneshot.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <numeric>
+#include <print>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace core
+{
+  // Solver settings, take effect on the next solve
+  struct XpbdParams
+  {
+    float    compliance   = 1e-6f;  // inverse stiffness in m/N, 0 is rigid
+    float    breakStretch = 0.0f;   // springs stretched beyond this fraction of their rest length break, 0 never
+    uint32_t iterations   = 1;      // over every color per substep
+  };
+
+  // Spheres and springs of soft bodies, every body a cube lattice of size^3 spheres
+  struct SoftBodies
+  {
+    std::vector<glm::vec4>    spheres;  // position, radius
+    std::vector<data::Spring> springs;  // between lattice neighbors along edges, face and body diagonals
+    uint32_t                  springsPerBody = 0;
+  };
+
+  // Lattice spacing of soft bodies, neighbors do not touch so collisions leave the rest shape alone
+  [[nodiscard]] inline float softBodySpacing( float radius )
+  {
+    return 2.2f * radius;
+  }
+
+  // `bodies` cubes at rest, in layers from the top of the container down. Throws when they do not fit.
+  [[nodiscard]] inline SoftBodies buildSoftBodies( uint32_t bodies, uint32_t size, float radius, glm::vec3 boundsMin, glm::vec3 boundsMax )
+  {
+    if ( size < 2 )
+      throw std::runtime_error( "Soft bodies need at least 2 spheres per edge" );
+
+    float      spacing = softBodySpacing( radius );
+    float      pitch   = float( size + 1 ) * spacing;  // one lattice step between bodies
+    glm::vec3  extent  = boundsMax - boundsMin - 2.0f * radius;
+    glm::uvec3 fit     = glm::uvec3( glm::max( ( extent + 2.0f * spacing ) / pitch, glm::vec3( 0.0f ) ) );
+    if ( uint64_t( fit.x ) * fit.y * fit.z < bodies )
+      throw std::runtime_error( std::to_string( bodies ) + " soft bodies do not fit into the container" );
+
+    // The 13 lattice directions whose first nonzero component is positive, every neighbor pair once
+    std::vector<glm::ivec3> directions;
+    for ( int z = -1; z <= 1; ++z )
+      for ( int y = -1; y <= 1; ++y )
+        for ( int x = -1; x <= 1; ++x )
+        {
+          glm::ivec3 d( x, y, z );
+          if ( x > 0 || ( x == 0 && y > 0 ) || ( x == 0 && y == 0 && z > 0 ) )
+            directions.push_back( d );
+        }
+
+    SoftBodies result;
+    uint32_t   perBody = size * size * size;
+    result.spheres.reserve( size_t( bodies ) * perBody );
+    for ( uint32_t body = 0; body < bodies; ++body )
+    {
+      uint32_t  column = body % fit.x;
+      uint32_t  row    = body / fit.x % fit.z;
+      uint32_t  layer  = body / ( fit.x * fit.z );
+      glm::vec3 origin = glm::vec3( boundsMin.x, boundsMax.y, boundsMin.z ) +
+                         glm::vec3( radius, -radius - float( size - 1 ) * spacing, radius ) +
+                         glm::vec3( float( column ), -float( layer ), float( row ) ) * pitch;
+      uint32_t  first  = uint32_t( result.spheres.size() );
+
+      auto sphereAt = [&]( glm::ivec3 p ) { return first + ( uint32_t( p.z ) * size + uint32_t( p.y ) ) * size + uint32_t( p.x ); };
+      for ( uint32_t z = 0; z < size; ++z )
+        for ( uint32_t y = 0; y < size; ++y )
+          for ( uint32_t x = 0; x < size; ++x )
+            result.spheres.emplace_back( origin + glm::vec3( x, y, z ) * spacing, radius );
+
+      size_t before = result.springs.size();
+      for ( uint32_t z = 0; z < size; ++z )
+        for ( uint32_t y = 0; y < size; ++y )
+          for ( uint32_t x = 0; x < size; ++x )
+            for ( glm::ivec3 d : directions )
+            {
+              glm::ivec3 p( x, y, z );
+              glm::ivec3 q = p + d;
+              if ( glm::any( glm::lessThan( q, glm::ivec3( 0 ) ) ) || glm::any( glm::greaterThanEqual( q, glm::ivec3( int( size ) ) ) ) )
+                continue;
+              result.springs.push_back( data::Spring{ sphereAt( p ), sphereAt( q ), glm::length( glm::vec3( d ) ) * spacing } );
+            }
+      result.springsPerBody = uint32_t( result.springs.size() - before );
+    }
+    return result;
+  }
+
+  // Greedy edge coloring of the constraint graph: every spring takes the lowest color that neither of its spheres
+  // has yet, which needs at most 2 * degree - 1 colors. The springs are reordered by color, returns the first
+  // spring of every color and the spring count last.
+  [[nodiscard]] inline std::vector<uint32_t> colorSprings( std::vector<data::Spring> & springs, uint32_t sphereCount, uint32_t maxColors = 64 )
+  {
+    std::vector<uint64_t> used( sphereCount, 0 );  // colors taken at every sphere
+    std::vector<uint32_t> colors( springs.size() );
+    uint32_t              colorCount = 0;
+    uint64_t              allowed    = maxColors >= 64 ? ~uint64_t( 0 ) : ( uint64_t( 1 ) << maxColors ) - 1;
+    for ( size_t i = 0; i < springs.size(); ++i )
+    {
+      data::Spring const & spring = springs[i];
+      if ( spring.a >= sphereCount || spring.b >= sphereCount || spring.a == spring.b )
+        throw std::runtime_error( "Spring " + std::to_string( i ) + " does not connect two of the " + std::to_string( sphereCount ) + " spheres" );
+
+      uint64_t free = ~( used[spring.a] | used[spring.b] ) & allowed;
+      if ( free == 0 )
+        throw std::runtime_error( "Springs need more than " + std::to_string( maxColors ) + " colors" );
+      uint32_t color = uint32_t( std::countr_zero( free ) );
+      used[spring.a] |= uint64_t( 1 ) << color;
+      used[spring.b] |= uint64_t( 1 ) << color;
+      colors[i]  = color;
+      colorCount = std::max( colorCount, color + 1 );
+    }
+
+    std::vector<uint32_t> offsets( colorCount + 1, 0 );
+    for ( uint32_t color : colors )
+      ++offsets[color + 1];
+    std::partial_sum( offsets.begin(), offsets.end(), offsets.begin() );
+
+    std::vector<data::Spring> sorted( springs.size() );
+    std::vector<uint32_t>     next( offsets.begin(), offsets.end() - 1 );
+    for ( size_t i = 0; i < springs.size(); ++i )
+      sorted[next[colors[i]]++] = springs[i];
+    springs.swap( sorted );
+    return offsets;
+  }
+
+  // XPBD distance constraints on the GPU, see xpbd.comp. Springs are colored on the CPU when built, a solve
+  // records one dispatch per color and iteration on the spheres (vec4 position, radius) of a storage buffer,
+  // corrected in place. Lambdas are cleared per solve, which is one substep; with a single iteration they are all
+  // zero, so the buffer is neither cleared nor read.
+  struct XpbdSolver
+  {
+    static constexpr uint32_t GroupSize = 64;
+    static constexpr uint32_t MaxColors = 64;
+
+    core::Buffer          springs;  // data::Spring, sorted by color
+    core::Buffer          lambdas;  // float per spring
+    core::Buffer          stats;    // uint, broken springs, host visible
+    uint32_t              springIndex = InvalidBindlessIndex;
+    uint32_t              lambdaIndex = InvalidBindlessIndex;
+    uint32_t              statsIndex  = InvalidBindlessIndex;
+    uint32_t              springCount = 0;
+    std::vector<uint32_t> colorOffsets;  // first spring of every color, springCount last
+
+    void init( vk::raii::Device const & device, VmaAllocator allocator_, BindlessHeap const & heap )
+    {
+      allocator = allocator_;
+      shader    = ComputeShader( device, "xpbd.comp", sizeof( data::XpbdPushConstants ), { *heap.layout } );
+    }
+
+    // Colors `springs_` between `sphereCount` spheres and allocates the buffers, nothing may still use the previous
+    // ones. The springs are staged, recordUpload() copies them.
+    void build( BindlessHeap & heap, std::vector<data::Spring> springs_, uint32_t sphereCount, uint64_t frame )
+    {
+      colorOffsets = colorSprings( springs_, sphereCount, MaxColors );
+      destroy( heap, frame );
+      if ( springs_.empty() )
+        return;
+      springCount = uint32_t( springs_.size() );
+
+      constexpr vk::BufferUsageFlags usage =
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc;
+      constexpr VmaAllocationCreateFlags writable = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      constexpr VmaAllocationCreateFlags readback = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+      springs     = core::createBuffer( allocator, sizeof( data::Spring ) * vk::DeviceSize( springCount ), usage );
+      springIndex = heap.addStorageBuffer( springs.buffer );
+      lambdas     = core::createBuffer( allocator, sizeof( float ) * vk::DeviceSize( springCount ), usage );
+      lambdaIndex = heap.addStorageBuffer( lambdas.buffer );
+      stats       = core::createBuffer( allocator, sizeof( uint32_t ), vk::BufferUsageFlagBits::eStorageBuffer, readback );
+      statsIndex  = heap.addStorageBuffer( stats.buffer );
+      *static_cast<uint32_t *>( stats.allocationInfo.pMappedData ) = 0;
+      vmaFlushAllocation( allocator, stats.allocation, 0, VK_WHOLE_SIZE );
+
+      staging = core::createBuffer( allocator, sizeof( data::Spring ) * vk::DeviceSize( springCount ), vk::BufferUsageFlagBits::eTransferSrc, writable );
+      std::memcpy( staging.allocationInfo.pMappedData, springs_.data(), sizeof( data::Spring ) * springs_.size() );
+      vmaFlushAllocation( allocator, staging.allocation, 0, VK_WHOLE_SIZE );
+    }
+
+    // Copies the springs staged by build(), visible to compute shaders recorded afterwards. Call releaseStaging()
+    // once the command buffer has executed.
+    void recordUpload( vk::raii::CommandBuffer const & cmd ) const
+    {
+      if ( !staging.buffer )
+        return;
+      cmd.copyBuffer( staging.buffer, springs.buffer, vk::BufferCopy{ 0, 0, sizeof( data::Spring ) * vk::DeviceSize( springCount ) } );
+      barrier( cmd,
+               vk::PipelineStageFlagBits2::eTransfer,
+               vk::AccessFlagBits2::eTransferWrite,
+               vk::PipelineStageFlagBits2::eComputeShader,
+               vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+    }
+
+    void releaseStaging()
+    {
+      core::destroyBuffer( allocator, staging );
+    }
+
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      for ( uint32_t * index : { &springIndex, &lambdaIndex, &statsIndex } )
+      {
+        heap.remove( BindlessHeap::StorageBuffers, *index, frame );
+        *index = InvalidBindlessIndex;
+      }
+      for ( core::Buffer * buffer : { &springs, &lambdas, &stats, &staging } )
+        core::destroyBuffer( allocator, *buffer );
+      springCount = 0;
+    }
+
+    [[nodiscard]] uint32_t colorCount() const
+    {
+      return colorOffsets.empty() ? 0 : uint32_t( colorOffsets.size() - 1 );
+    }
+
+    // As of the last finished solve that wrote it, the count is only ever increased
+    [[nodiscard]] uint32_t brokenCount() const
+    {
+      if ( !stats.buffer )
+        return 0;
+      vmaInvalidateAllocation( allocator, stats.allocation, 0, VK_WHOLE_SIZE );
+      return *static_cast<uint32_t const *>( stats.allocationInfo.pMappedData );
+    }
+
+    // One substep over the spheres in the storage buffer at heap slot `spheres`, `dt` long. Earlier compute writes
+    // of the spheres have to be visible, the result is visible to compute shaders recorded afterwards.
+    void record( vk::raii::CommandBuffer const & cmd, BindlessHeap const & heap, uint32_t spheres, float dt, XpbdParams const & params ) const
+    {
+      if ( springCount == 0 )
+        return;
+
+      uint32_t iterations = std::max( params.iterations, 1u );
+      if ( iterations > 1 )
+      {
+        barrier( cmd,
+                 vk::PipelineStageFlagBits2::eComputeShader,
+                 vk::AccessFlagBits2::eShaderStorageWrite,
+                 vk::PipelineStageFlagBits2::eTransfer,
+                 vk::AccessFlagBits2::eTransferWrite );
+        cmd.fillBuffer( lambdas.buffer, 0, VK_WHOLE_SIZE, 0 );
+        barrier( cmd,
+                 vk::PipelineStageFlagBits2::eTransfer,
+                 vk::AccessFlagBits2::eTransferWrite,
+                 vk::PipelineStageFlagBits2::eComputeShader,
+                 vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+      }
+
+      data::XpbdPushConstants pc{};
+      pc.sphereBuffer = spheres;
+      pc.springBuffer = springIndex;
+      pc.lambdaBuffer = iterations > 1 ? lambdaIndex : InvalidBindlessIndex;
+      pc.statsBuffer  = statsIndex;
+      pc.alphaTilde   = params.compliance / ( dt * dt );
+      pc.breakStretch = params.breakStretch;
+
+      shader.bind( cmd );
+      heap.bind( cmd, *shader.layout, vk::PipelineBindPoint::eCompute );
+      for ( uint32_t iteration = 0; iteration < iterations; ++iteration )
+        for ( uint32_t color = 0; color < colorCount(); ++color )
+        {
+          pc.first = colorOffsets[color];
+          pc.count = colorOffsets[color + 1] - colorOffsets[color];
+          shader.push( cmd, pc );
+          cmd.dispatch( ( pc.count + GroupSize - 1 ) / GroupSize, 1, 1 );
+          barrier( cmd,
+                   vk::PipelineStageFlagBits2::eComputeShader,
+                   vk::AccessFlagBits2::eShaderStorageWrite,
+                   vk::PipelineStageFlagBits2::eComputeShader,
+                   vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite );
+        }
+    }
+
+    // Spring and both spheres read, both spheres written, per spring and iteration
+    [[nodiscard]] vk::DeviceSize bytesPerIteration() const
+    {
+      return vk::DeviceSize( springCount ) * ( sizeof( data::Spring ) + 4 * sizeof( glm::vec4 ) );
+    }
+
+  private:
+    VmaAllocator  allocator = nullptr;
+    ComputeShader shader;
+    core::Buffer  staging;
+
+    static void barrier( vk::raii::CommandBuffer const & cmd,
+                         vk::PipelineStageFlags2         srcStage,
+                         vk::AccessFlags2                srcAccess,
+                         vk::PipelineStageFlags2         dstStage,
+                         vk::AccessFlags2                dstAccess )
+    {
+      vk::MemoryBarrier2 memoryBarrier{ srcStage, srcAccess, dstStage, dstAccess };
+      cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( memoryBarrier ) );
+    }
+  };
+
+  // CPU reference of XpbdSolver with the same colors and update order. Positions are kept as structure of arrays,
+  // springs of a color are gathered into batches of Lanes and the per-lane arithmetic is written without branches,
+  // which the compiler turns into SIMD on every target; springs of a color share no sphere, so the scatter back
+  // cannot conflict.
+  struct XpbdReference
+  {
+    static constexpr uint32_t Lanes = 8;
+
+    std::vector<float>        x, y, z;
+    std::vector<data::Spring> springs;
+    std::vector<uint32_t>     colorOffsets;
+    std::vector<float>        lambdas;
+    uint32_t                  broken = 0;
+
+    void load( std::span<const glm::vec4> spheres, std::vector<data::Spring> springs_, std::vector<uint32_t> colorOffsets_ )
+    {
+      x.resize( spheres.size() );
+      y.resize( spheres.size() );
+      z.resize( spheres.size() );
+      for ( size_t i = 0; i < spheres.size(); ++i )
+      {
+        x[i] = spheres[i].x;
+        y[i] = spheres[i].y;
+        z[i] = spheres[i].z;
+      }
+      springs      = std::move( springs_ );
+      colorOffsets = std::move( colorOffsets_ );
+      lambdas.assign( springs.size(), 0.0f );
+      broken = 0;
+    }
+
+    [[nodiscard]] glm::vec3 position( size_t sphere ) const
+    {
+      return glm::vec3( x[sphere], y[sphere], z[sphere] );
+    }
+
+    // One substep, `dt` long
+    void solve( float dt, XpbdParams const & params )
+    {
+      std::fill( lambdas.begin(), lambdas.end(), 0.0f );
+      float    alphaTilde = params.compliance / ( dt * dt );
+      uint32_t iterations = std::max( params.iterations, 1u );
+      for ( uint32_t iteration = 0; iteration < iterations; ++iteration )
+        for ( size_t color = 0; color + 1 < colorOffsets.size(); ++color )
+          for ( uint32_t first = colorOffsets[color]; first < colorOffsets[color + 1]; first += Lanes )
+            solveBatch( first, std::min( Lanes, colorOffsets[color + 1] - first ), alphaTilde, params.breakStretch );
+    }
+
+  private:
+    void solveBatch( uint32_t first, uint32_t lanes, float alphaTilde, float breakStretch )
+    {
+      alignas( 32 ) std::array<float, Lanes> ax{}, ay{}, az{}, bx{}, by{}, bz{}, rest{}, lambda{}, active{};
+      for ( uint32_t l = 0; l < lanes; ++l )
+      {
+        data::Spring const & spring = springs[first + l];
+        ax[l]                       = x[spring.a];
+        ay[l]                       = y[spring.a];
+        az[l]                       = z[spring.a];
+        bx[l]                       = x[spring.b];
+        by[l]                       = y[spring.b];
+        bz[l]                       = z[spring.b];
+        rest[l]                     = spring.restLength;
+        lambda[l]                   = lambdas[first + l];
+        active[l]                   = spring.broken ? 0.0f : 1.0f;
+      }
+
+      alignas( 32 ) std::array<float, Lanes> cx{}, cy{}, cz{}, breaks{};
+      for ( uint32_t l = 0; l < Lanes; ++l )
+      {
+        float dx       = ax[l] - bx[l];
+        float dy       = ay[l] - by[l];
+        float dz       = az[l] - bz[l];
+        float distance = std::sqrt( dx * dx + dy * dy + dz * dz );
+        float c        = distance - rest[l];
+        float valid    = active[l] > 0.0f && distance > 1e-6f ? 1.0f : 0.0f;
+        float snapped  = breakStretch > 0.0f && c > breakStretch * rest[l] ? valid : 0.0f;
+        float dLambda  = ( valid - snapped ) * ( -c - alphaTilde * lambda[l] ) / ( 2.0f + alphaTilde );
+        float scale    = dLambda / std::max( distance, 1e-6f );
+        lambda[l] += dLambda;
+        cx[l]     = dx * scale;
+        cy[l]     = dy * scale;
+        cz[l]     = dz * scale;
+        breaks[l] = snapped;
+      }
+
+      for ( uint32_t l = 0; l < lanes; ++l )
+      {
+        data::Spring & spring = springs[first + l];
+        x[spring.a] += cx[l];
+        y[spring.a] += cy[l];
+        z[spring.a] += cz[l];
+        x[spring.b] -= cx[l];
+        y[spring.b] -= cy[l];
+        z[spring.b] -= cz[l];
+        lambdas[first + l] = lambda[l];
+        if ( breaks[l] > 0.0f )
+        {
+          spring.broken = 1;
+          ++broken;
+        }
+      }
+    }
+  };
+
+  // Scratch spheres of soft bodies in a storage buffer for the XPBD harnesses, solved by an XpbdSolver through a
+  // OneShotQueue. Keeps the springs colored the same way for XpbdReference.
+  struct XpbdScratch
+  {
+    core::Buffer              spheres;
+    uint32_t                  sphereIndex = InvalidBindlessIndex;
+    XpbdSolver                solver;
+    std::vector<glm::vec4>    initial;
+    std::vector<data::Spring> springs;  // as built
+    std::vector<data::Spring> colored;  // sorted by color
+    std::vector<uint32_t>     colorOffsets;
+
+    // Soft bodies with their spheres displaced by up to `jitter` lattice steps, so that every spring starts out
+    // violated
+    void create( vk::raii::Device const & device,
+                 VmaAllocator             allocator_,
+                 BindlessHeap &           heap,
+                 OneShotQueue &           oneShot,
+                 uint32_t                 bodies,
+                 uint32_t                 size,
+                 float                    jitter,
+                 uint32_t                 seed,
+                 uint64_t                 frame )
+    {
+      allocator              = allocator_;
+      constexpr float radius = 0.5f;
+      SoftBodies      built  = buildSoftBodies( bodies, size, radius, glm::vec3( -1000.0f ), glm::vec3( 1000.0f ) );
+
+      std::mt19937                          random( seed );
+      std::uniform_real_distribution<float> offset( -jitter * softBodySpacing( radius ), jitter * softBodySpacing( radius ) );
+      initial = std::move( built.spheres );
+      for ( glm::vec4 & sphere : initial )
+        sphere += glm::vec4( offset( random ), offset( random ), offset( random ), 0.0f );
+      springs      = std::move( built.springs );
+      colored      = springs;
+      colorOffsets = colorSprings( colored, uint32_t( initial.size() ), XpbdSolver::MaxColors );
+
+      constexpr vk::BufferUsageFlags usage =
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc;
+      spheres     = core::createBuffer( allocator, sizeof( glm::vec4 ) * vk::DeviceSize( initial.size() ), usage );
+      sphereIndex = heap.addStorageBuffer( spheres.buffer );
+      solver.init( device, allocator, heap );
+      restart( heap, oneShot, frame );
+    }
+
+    // Back to the jittered positions with no spring broken
+    void restart( BindlessHeap & heap, OneShotQueue & oneShot, uint64_t frame )
+    {
+      oneShot.upload( spheres.buffer, std::span<const glm::vec4>( initial ) );
+      solver.build( heap, springs, uint32_t( initial.size() ), frame );
+      oneShot.submit( [&]( vk::raii::CommandBuffer const & cmd ) { solver.recordUpload( cmd ); } );
+      solver.releaseStaging();
+    }
+
+    void destroy( BindlessHeap & heap, uint64_t frame )
+    {
+      solver.destroy( heap, frame );
+      heap.remove( BindlessHeap::StorageBuffers, sphereIndex, frame );
+      sphereIndex = InvalidBindlessIndex;
+      core::destroyBuffer( allocator, spheres );
+    }
+
+  private:
+    VmaAllocator allocator = nullptr;
+  };
+
+  // Checks XpbdSolver against XpbdReference on jittered soft bodies, `substeps` solves on both sides:
+  //
+  //   solve  breaking disabled, largest difference of the positions, float rounding differs per device
+  //   break  springs broken with `breakStretch`: the GPU count, the flags it set and the CPU count agree
+  struct XpbdValidation
+  {
+    struct Result
+    {
+      std::string pass;
+      uint32_t    springs   = 0;
+      uint32_t    colors    = 0;
+      uint32_t    brokenGpu = 0;
+      uint32_t    brokenCpu = 0;
+      float       maxError  = 0.0f;
+      float       gpuMs     = 0.0f;
+      float       cpuMs     = 0.0f;
+      std::string error;  // first failed check, empty when valid
+    };
+
+    uint32_t            bodies       = 512;
+    uint32_t            size         = 4;
+    uint32_t            substeps     = 8;
+    float               dt           = 1.0f / 480.0f;
+    float               jitter       = 0.2f;
+    float               breakStretch = 0.15f;
+    XpbdParams          params       = { 1e-6f, 0.0f, 4 };
+    uint32_t            seed         = 1;
+    float               tolerance    = 1e-3f;
+    std::vector<Result> results;
+    std::string         error;  // of the last run started from the UI
+
+    void run( vk::raii::Device const &         device,
+              vk::raii::PhysicalDevice const & physicalDevice,
+              VmaAllocator                     allocator,
+              BindlessHeap &                   heap,
+              uint32_t                         queueFamily,
+              vk::raii::Queue const &          queue,
+              uint64_t                         frame )
+    {
+      using Clock = std::chrono::steady_clock;
+
+      OneShotQueue oneShot;
+      oneShot.init( device, physicalDevice, allocator, queueFamily, queue );
+      XpbdScratch scratch;
+      scratch.create( device, allocator, heap, oneShot, std::max( bodies, 1u ), std::max( size, 2u ), jitter, seed, frame );
+
+      results.clear();
+      for ( bool breaking : { false, true } )
+      {
+        XpbdParams solved   = params;
+        solved.breakStretch = breaking ? breakStretch : 0.0f;
+        scratch.restart( heap, oneShot, frame );
+
+        oneShot.submit(
+          [&]( vk::raii::CommandBuffer const & cmd )
+          {
+            oneShot.timestamp( cmd, 0 );
+            for ( uint32_t step = 0; step < substeps; ++step )
+              scratch.solver.record( cmd, heap, scratch.sphereIndex, dt, solved );
+            oneShot.timestamp( cmd, 1 );
+          } );
+        std::vector<glm::vec4>    solvedGpu = oneShot.download<glm::vec4>( scratch.spheres.buffer, scratch.initial.size() );
+        std::vector<data::Spring> flagged   = oneShot.download<data::Spring>( scratch.solver.springs.buffer, scratch.solver.springCount );
+
+        XpbdReference reference;
+        reference.load( scratch.initial, scratch.colored, scratch.colorOffsets );
+        auto begin = Clock::now();
+        for ( uint32_t step = 0; step < substeps; ++step )
+          reference.solve( dt, solved );
+
+        Result result{};
+        result.pass      = breaking ? "break" : "solve";
+        result.springs   = scratch.solver.springCount;
+        result.colors    = scratch.solver.colorCount();
+        result.brokenGpu = scratch.solver.brokenCount();
+        result.brokenCpu = reference.broken;
+        result.gpuMs     = oneShot.milliseconds( 0, 1 );
+        result.cpuMs     = std::chrono::duration<float, std::milli>( Clock::now() - begin ).count();
+
+        auto fail = [&]( std::string const & what )
+        {
+          if ( result.error.empty() )
+            result.error = what;
+        };
+
+        uint32_t flags = uint32_t( std::count_if( flagged.begin(), flagged.end(), []( data::Spring const & spring ) { return spring.broken != 0; } ) );
+        if ( flags != result.brokenGpu )
+          fail( std::to_string( flags ) + " springs flagged as broken, " + std::to_string( result.brokenGpu ) + " counted" );
+        if ( result.brokenGpu != result.brokenCpu )
+          fail( std::to_string( result.brokenGpu ) + " springs broken, the reference breaks " + std::to_string( result.brokenCpu ) );
+        if ( !breaking && result.brokenGpu != 0 )
+          fail( "springs broke with breaking disabled" );
+
+        for ( size_t i = 0; i < solvedGpu.size(); ++i )
+          result.maxError = std::max( result.maxError, glm::length( glm::vec3( solvedGpu[i] ) - reference.position( i ) ) );
+        if ( !breaking && result.maxError > tolerance )
+          fail( "solved positions differ by up to " + std::to_string( result.maxError ) );
+
+        results.push_back( result );
+        isDebug( std::println( "[xpbd] {}: {} springs in {} colors, {} broken (CPU {}), max error {:.2e}, GPU {:.3f} ms, CPU {:.2f} ms: {}",
+                               result.pass,
+                               result.springs,
+                               result.colors,
+                               result.brokenGpu,
+                               result.brokenCpu,
+                               result.maxError,
+                               result.gpuMs,
+                               result.cpuMs,
+                               result.error.empty() ? "valid" : result.error ) );
+      }
+      scratch.destroy( heap, frame );
+    }
+  };
+
+  // Solver iterations per second against the spring count, on the GPU and with XpbdReference on one CPU thread.
+  // Every count is rounded up to whole soft bodies of `size`^3 spheres, breaking is disabled.
+  struct XpbdBenchmark
+  {
+    static constexpr std::array<uint32_t, 5> Counts = { 10000, 100000, 500000, 1000000, 4000000 };
+
+    struct Result
+    {
+      uint32_t springs                = 0;
+      uint32_t colors                 = 0;
+      float    gpuMsPerIteration      = 0.0f;
+      float    gpuIterationsPerSecond = 0.0f;
+      float    gpuGigabytesPerSecond  = 0.0f;
+      float    cpuMsPerIteration      = 0.0f;  // 0 above cpuLimit springs
+      float    cpuIterationsPerSecond = 0.0f;
+    };
+
+    uint32_t            size       = 4;
+    uint32_t            iterations = 32;
+    uint32_t            cpuLimit   = 1000000;
+    float               dt         = 1.0f / 480.0f;
+    XpbdParams          params;
+    std::vector<Result> results;
+
+    void run( vk::raii::Device const &         device,
+              vk::raii::PhysicalDevice const & physicalDevice,
+              VmaAllocator                     allocator,
+              BindlessHeap &                   heap,
+              uint32_t                         queueFamily,
+              vk::raii::Queue const &          queue,
+              uint64_t                         frame )
+    {
+      using Clock = std::chrono::steady_clock;
+
+      OneShotQueue oneShot;
+      oneShot.init( device, physicalDevice, allocator, queueFamily, queue );
+
+      uint32_t edge           = std::max( size, 2u );
+      uint32_t springsPerBody = buildSoftBodies( 1, edge, 0.5f, glm::vec3( -10.0f ), glm::vec3( 10.0f ) ).springsPerBody;
+
+      XpbdParams timed   = params;
+      timed.breakStretch = 0.0f;
+      timed.iterations   = std::max( iterations, 1u );
+
+      results.clear();
+      for ( uint32_t count : Counts )
+      {
+        XpbdScratch scratch;
+        scratch.create( device, allocator, heap, oneShot, ( count + springsPerBody - 1 ) / springsPerBody, edge, 0.2f, 1, frame );
+
+        // The first submit warms up, the second is timed
+        for ( uint32_t run = 0; run < 2; ++run )
+          oneShot.submit(
+            [&]( vk::raii::CommandBuffer const & cmd )
+            {
+              oneShot.timestamp( cmd, 0 );
+              scratch.solver.record( cmd, heap, scratch.sphereIndex, dt, timed );
+              oneShot.timestamp( cmd, 1 );
+            } );
+
+        Result result{};
+        result.springs           = scratch.solver.springCount;
+        result.colors            = scratch.solver.colorCount();
+        result.gpuMsPerIteration = oneShot.milliseconds( 0, 1 ) / float( timed.iterations );
+        if ( result.gpuMsPerIteration > 0.0f )
+        {
+          result.gpuIterationsPerSecond = 1e3f / result.gpuMsPerIteration;
+          result.gpuGigabytesPerSecond  = float( scratch.solver.bytesPerIteration() ) / result.gpuMsPerIteration * 1e-6f;
+        }
+
+        if ( result.springs <= cpuLimit )
+        {
+          XpbdParams single = timed;
+          single.iterations = 1;
+          XpbdReference reference;
+          reference.load( scratch.initial, scratch.colored, scratch.colorOffsets );
+          uint32_t cpuIterations = std::max( 1u, std::min( timed.iterations, 10000000u / result.springs ) );
+          auto     begin         = Clock::now();
+          for ( uint32_t i = 0; i < cpuIterations; ++i )
+            reference.solve( dt, single );
+          result.cpuMsPerIteration = std::chrono::duration<float, std::milli>( Clock::now() - begin ).count() / float( cpuIterations );
+          if ( result.cpuMsPerIteration > 0.0f )
+            result.cpuIterationsPerSecond = 1e3f / result.cpuMsPerIteration;
+        }
+        results.push_back( result );
+        scratch.destroy( heap, frame );
+
+        isDebug( std::println( "[xpbd] {} springs in {} colors: GPU {:.3f} ms/iteration ({:.0f}/s, {:.1f} GB/s), CPU {:.3f} ms/iteration ({:.0f}/s)",
+                               result.springs,
+                               result.colors,
+                               result.gpuMsPerIteration,
+                               result.gpuIterationsPerSecond,
+                               result.gpuGigabytesPerSecond,
+                               result.cpuMsPerIteration,
+                               result.cpuIterationsPerSecond ) );
+      }
+    }
+  };
+}  // namespace core
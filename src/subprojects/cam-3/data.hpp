@@ -13,53 +13,341 @@ namespace data
   {
     glm::mat4 view;
     glm::mat4 proj;
+    uint32_t  instanceBuffer;               // bindless storage buffer index of the per-instance data
+    uint32_t  visibleBuffer = 0xFFFFFFFFu;  // compacted instance indices written by culling, ~0u draws every instance
+    uint32_t  instanceCount = 0;            // locates the streams of InstanceFormat::PackedSoA
+    float     positionScale = 1.0f;         // core::Model::positionScale(), model space size of one position unit
+  };
+
+  struct CullPushConstants
+  {
+    glm::mat4 view;
+    glm::vec4 planes[6];
+    glm::vec4 projection;  // P00, P11 (not flipped), P22, P32 of the scene projection
+    float     znear;
+    float     radius;          // model bounds, scaled by every instance's scale
+    float     screenHeight;    // pixels, for the projected size used by LOD selection
+    float     lodHysteresis;   // relative band around every LOD threshold
+    glm::vec4 lodScreenSizes;  // core::ModelLod::minScreenSize of every level
+    uint32_t  instanceBuffer;
+    uint32_t  visibleBuffer;  // lists appended to in this phase, one region of instanceCount per LOD
+    uint32_t  drawBuffer;
+    uint32_t  instanceCount;
+    uint32_t  historyBuffer;  // per instance, bit 0 visible after the last late phase, LOD above
+    uint32_t  pyramidTexture;
+    uint32_t  pyramidSampler;
+    uint32_t  phase;  // core::CullPhase
+    uint32_t  lodCount;
+  };
+
+  // Task and mesh shader path, culls and selects LODs per task workgroup of instances
+  struct MeshPushConstants
+  {
+    glm::mat4  viewProj;
+    glm::vec4  planes[6];
+    glm::vec3  cameraPosition;
+    float      radius;  // model bounds, scaled by every instance's scale
+    glm::vec4  lodScreenSizes;   // zero from the last selectable level on
+    glm::uvec4 lodFirstMeshlet;  // core::ModelLod::firstMeshlet of every level
+    glm::uvec4 lodMeshlets;      // core::ModelLod::meshletCount of every level
+    uint32_t   instanceBuffer;
+    uint32_t   instanceCount;
+    uint32_t   vertexBuffer;   // heap slot, QuantizedVertexBit set when the vertices are data::QuantizedVertex
+    uint32_t   meshletBuffer;  // core::Model::meshlets
+    float      sizeScale;  // P11 * screen height, projected diameter in pixels = radius * sizeScale / distance
+    float      znear;
+    uint32_t   taskInstances;  // instances per task workgroup, see core::MeshRenderer::taskInstances()
+    uint32_t   statsBuffer;
+  };
+
+  struct InstanceGenPushConstants
+  {
+    glm::uvec3 gridCount;
+    float      spacing;
+    float      jitter;  // fraction of spacing
+    float      ballRadius;
+    uint32_t   seed;
+    uint32_t   layout;  // core::InstanceLayout
+    uint32_t   instanceBuffer;
+    uint32_t   instanceCount;
+    uint32_t   format;  // InstanceFormat written
+    float      scaleJitter;
+    uint32_t   randomRotation;
+    uint32_t   randomColor;
+  };
+
+  // One pass of core::VerletSim, see verlet.comp
+  struct VerletPushConstants
+  {
+    glm::vec3 gravity;
+    float     dt;  // substep
+    glm::vec3 boundsMin;
+    float     damping;  // fraction of the velocity lost per substep
+    glm::vec3 boundsMax;
+    float     radius;
+    uint32_t  currentBuffer;   // vec4 position, radius
+    uint32_t  previousBuffer;  // the integration overwrites it with the next position
+    uint32_t  targetBuffer;    // collision output
+    uint32_t  instanceBuffer;  // instanceFormat
+    uint32_t  count;
+    uint32_t  pass;  // core::VerletPass
+    uint32_t  writeInstances;
+    uint32_t  seed;
+    float     launchSpeed;    // initial speed in a random direction
+    float     colorSpeed;     // speed drawn fully warm
+    float     instanceScale;  // radius / modelRadius
+    float     relaxation;     // fraction of every overlap resolved per collision pass
+    uint32_t  cellBuffer;     // core::SpatialGrid of the current positions
+    uint32_t  sortedBuffer;
+    uint32_t  tableMask;
+    float     cellSize;
+    uint32_t  statsBuffer;  // contacts are counted into word 0 unless ~0u
+  };
+  static_assert( sizeof( VerletPushConstants ) <= 128, "guaranteed push constant size" );
+
+  // One color of core::XpbdSolver, see xpbd.comp
+  struct XpbdPushConstants
+  {
+    uint32_t sphereBuffer;  // vec4 position, radius, corrected in place
+    uint32_t springBuffer;  // data::Spring, sorted by color
+    uint32_t lambdaBuffer;  // ~0u when every lambda starts at zero, one iteration per substep
+    uint32_t statsBuffer;   // word 0 counts broken springs
+    uint32_t first;         // of the color
+    uint32_t count;
+    float    alphaTilde;    // compliance / dt^2
+    float    breakStretch;  // springs stretched beyond this fraction of their rest length break, 0 never
+  };
+
+  // Distance constraint between two spheres of core::VerletSim
+  struct Spring
+  {
+    uint32_t a;
+    uint32_t b;
+    float    restLength;
+    uint32_t broken = 0;  // set by the solver, the spring is skipped from then on
+  };
+  static_assert( sizeof( Spring ) == 16 );
+
+  // One pass of core::SpatialGrid, see grid.comp
+  struct GridPushConstants
+  {
+    uint32_t sphereBuffer;  // vec4 position, radius
+    uint32_t cellBuffer;
+    uint32_t keyBuffer;
+    uint32_t rankBuffer;
+    uint32_t sortedBuffer;
+    uint32_t count;
+    uint32_t tableMask;
+    float    cellSize;
+    uint32_t pass;  // core::GridPass
+  };
+
+  // One pass of core::RadixSort, see radixsort.glsl
+  struct RadixSortPushConstants
+  {
+    uint32_t keyBuffer;
+    uint32_t valueBuffer;  // ~0u sorts keys only
+    uint32_t keyOutBuffer;
+    uint32_t valueOutBuffer;
+    uint32_t stateBuffer;
+    uint32_t count;
+    uint32_t partitions;  // tiles of core::RadixSort::TileSize keys
+    uint32_t passCount;   // digit passes for the key bits
+    uint32_t digitPass;
+    uint32_t pass;  // core::RadixSortPass
+  };
+
+  // One dispatch of core::Scan, see scanpasses.glsl
+  struct ScanPushConstants
+  {
+    uint32_t inputBuffer;  // ~0u lets compaction write the indices of the kept elements
+    uint32_t outputBuffer;
+    uint32_t flagBuffer;  // compaction keeps elements with a nonzero flag, ~0u tests the input values
+    uint32_t statusBuffer;
+    uint32_t resultBuffer;  // word 0 receives the reduction or the kept count
+    uint32_t count;
+    uint32_t pass;  // core::ScanPass
+    uint32_t op;    // core::ScanOp
+    uint32_t exclusive;
+  };
+
+  // Signed distance field of the terrain, mirrors SdfScene in sdf.glsl. A sphere with rolling hills and a box on
+  // top, then spheres added or carved by the edits.
+  struct SdfScene
+  {
+    glm::vec3 center     = glm::vec3( 0.0f, 0.0f, 160.0f );
+    float     radius     = 60.0f;
+    float     amplitude  = 4.0f;   // of the hills
+    float     frequency  = 0.12f;  // of the hills, per unit
+    float     mesa       = 14.0f;  // half size of the box on top, 0 for none
+    float     smoothness = 2.0f;   // blend distance of the edits
+    uint32_t  editBuffer = 0xFFFFFFFFu;  // glm::vec4 center, radius per edit, a negative radius carves
+    uint32_t  editCount  = 0;
+    uint32_t  pad[2]     = {};
+  };
+  static_assert( sizeof( SdfScene ) == 48, "SdfScene has to match the std430 layout in sdf.glsl" );
+
+  // One pass of core::MarchingCubes over a batch of chunks, see marchingcubes.comp
+  struct MarchingCubesPushConstants
+  {
+    SdfScene scene;
+    uint32_t jobBuffer;           // data::MarchingCubesJob per chunk of the batch
+    uint32_t fieldBuffer;         // float per sample
+    uint32_t caseBuffer;          // per sample, cube index of the cell it is the corner 0 of | edge mask << 8
+    uint32_t vertexOffsetBuffer;  // per sample, vertex count, exclusive prefix sum after the scan
+    uint32_t indexOffsetBuffer;   // per cell, index count, exclusive prefix sum after the scan
+    uint32_t activeBuffer;        // batch cells with triangles, compacted
+    uint32_t stateBuffer;         // core::MarchingCubes::State words
+    uint32_t tableBuffer;         // core::MarchingCubesTable::words()
+    uint32_t vertexBuffer;        // core::SurfaceChunks
+    uint32_t indexBuffer;
+    uint32_t drawBuffer;
+    uint32_t cells;  // per chunk edge
+    uint32_t jobCount;
+    uint32_t verticesPerSlot;
+    uint32_t indicesPerSlot;
+    uint32_t pass;  // core::MarchingCubesPass
+  };
+  static_assert( sizeof( MarchingCubesPushConstants ) <= 128, "guaranteed push constant size" );
+
+  // Chunk of a core::MarchingCubes batch, meshed into slot `slot` of a core::SurfaceChunks
+  struct MarchingCubesJob
+  {
+    glm::vec3 origin;  // sample 0
+    float     voxelSize;
+    uint32_t  slot;
+    uint32_t  pad[3] = {};
+  };
+  static_assert( sizeof( MarchingCubesJob ) == 32 );
+
+  // One pass of core::DualContouring over a batch of data::MarchingCubesJob chunks, see dualcontouring.comp
+  struct DualContouringPushConstants
+  {
+    SdfScene scene;
+    uint32_t jobBuffer;
+    uint32_t fieldBuffer;   // float per sample
+    uint32_t flagBuffer;    // per cell, 1 when the surface crosses it
+    uint32_t activeBuffer;  // batch cells the surface crosses, compacted
+    uint32_t stateBuffer;   // core::DualContouring::State words
+    uint32_t cellBuffer;    // data::DualContouringCell per active cell
+    uint32_t cells;         // owned per chunk edge
+    uint32_t jobCount;
+    uint32_t pass;  // core::DualContouringPass
+  };
+  static_assert( sizeof( DualContouringPushConstants ) <= 128, "guaranteed push constant size" );
+
+  // Quadratic error function and vertex of a cell the surface crosses, mirrors Cell in dualcontouring.comp (scalar
+  // layout). Positions are in voxels from the chunk origin, so the CPU can merge the QEFs of neighbor cells.
+  struct DualContouringCell
+  {
+    glm::vec3 vertex;   // minimizer of the QEF, clamped to the cell
+    float     error;    // QEF residual at the vertex
+    glm::vec3 massSum;  // sum of the edge intersections
+    float     count;    // edge intersections
+    float     ata[6];   // sum of n n^T: xx, xy, xz, yy, yz, zz
+    glm::vec3 atb;      // sum of n (n . p)
+    float     btb;      // sum of (n . p)^2
+    uint32_t  cell;     // in the batch, chunk * (cells + 1)^3 + local cell
+    uint32_t  corners;  // bit c set when corner c is inside
+  };
+  static_assert( sizeof( DualContouringCell ) == 80, "DualContouringCell has to match the scalar layout in dualcontouring.comp" );
+
+  struct InstanceBenchPushConstants
+  {
+    glm::mat4 viewProj;
+    uint32_t  instanceBuffer;
+    uint32_t  instanceCount;
+    uint32_t  format;  // InstanceFormat
+    uint32_t  resultBuffer;
+  };
+
+  struct DepthPyramidPushConstants
+  {
+    uint32_t   depthTexture;
+    uint32_t   depthSampler;
+    uint32_t   counterBuffer;
+    uint32_t   levelCount;
+    glm::uvec2 size;       // level 0
+    glm::uvec2 depthSize;  // the depth target, at least level 0 in both dimensions
+    uint32_t   groupCount;
+    uint32_t   pad;
+    uint32_t   levels[16];  // storage image slot of every level
   };
 
   struct Vertex
   {
-    glm::vec2 position;
+    glm::vec3 position;
     glm::vec3 color;
   };
 
-  struct InstanceData
+  // Vertex of cooked models, position in snorm16 of the model's bounding radius and color in unorm8
+  struct QuantizedVertex
   {
-    glm::vec3 position;
+    int16_t position[4];  // w unused
+    uint8_t color[4];     // a unused
   };
+  static_assert( sizeof( QuantizedVertex ) == 12 );
 
-  inline constexpr float side   = 1.0f;
-  inline constexpr float height = side * 0.86602540378f;  // sqrt(3)/2
+  // MeshPushConstants::vertexBuffer flag, the mesh shader decodes QuantizedVertex scaled by the radius
+  inline constexpr uint32_t QuantizedVertexBit = 0x80000000u;
 
-  inline constexpr std::array<Vertex, 3> triangleVertices = {
-    Vertex{ glm::vec2( 0.0f, -height / 3.0f ), glm::vec3( 1.0f, 0.5f, 0.5f ) },         // bottom
-    Vertex{ glm::vec2( 0.5f, height * 2.0f / 3.0f ), glm::vec3( 0.5f, 1.0f, 0.5f ) },   // right
-    Vertex{ glm::vec2( -0.5f, height * 2.0f / 3.0f ), glm::vec3( 0.5f, 0.5f, 1.0f ) },  // left
+  // One cluster of a mesh, built by core::buildMeshlets(). On the CPU the offsets index MeshletMesh::vertices and
+  // MeshletMesh::triangles, in core::Model::meshlets they are uint offsets into the same buffer.
+  struct Meshlet
+  {
+    glm::vec3 center;  // bounding sphere
+    float     radius;
+    glm::vec3 coneAxis;        // normal cone, zero when the normals spread too far to ever cull
+    float     coneCutoff;      // back facing from p when dot(center - p, coneAxis) >= coneCutoff * |center - p| + radius
+    uint32_t  vertexOffset;    // mesh vertex index of every meshlet vertex
+    uint32_t  triangleOffset;  // 3 meshlet vertex indices per triangle (one uint each, 8 bits per index, on the GPU)
+    uint32_t  vertexCount;
+    uint32_t  triangleCount;
   };
 
-  inline constexpr int    gridMin       = -20;
-  inline constexpr int    gridMax       = 20;
-  inline constexpr int    gridCount     = gridMax - gridMin + 1;
-  inline constexpr size_t instanceCount = static_cast<size_t>( gridCount ) * gridCount * gridCount;
+  // Per-instance data as the shaders see it after decoding, stored as is by InstanceFormat::Float
+  struct InstanceData
+  {
+    glm::vec3 position;
+    float     scale = 1.0f;
+    glm::vec4 rotation{ 0.0f, 0.0f, 0.0f, 1.0f };  // quaternion xyzw
+    glm::vec4 color{ 1.0f };
+  };
 
-  // Generate instances at compile time
-  inline constexpr auto createInstances()
+  // InstanceFormat::Packed, 16 bytes
+  struct InstancePacked
   {
-    std::array<InstanceData, instanceCount> instancesPos{};
-    size_t                                  index = 0;
+    uint32_t positionXY;  // unorm16 x | unorm16 y << 16, inside the chunk
+    uint32_t positionZ;   // unorm16 z | chunk << 16, chunk = 3 x signed 5 bit chunk coordinate
+    uint32_t rotation;    // octahedral axis snorm10 x | snorm10 y << 10 | unorm12 angle << 20
+    uint32_t colorScale;  // unorm8 rgb | unorm8 scale / instanceMaxScale << 24
+  };
+
+  // Memory layout of the instance buffer, mirrors instance.glsl
+  enum class InstanceFormat : uint32_t
+  {
+    Float     = 0,  // InstanceData, 48 bytes
+    Packed    = 1,  // InstancePacked
+    PackedSoA = 2,  // the words of InstancePacked in three streams: positions (8 bytes), rotations, colorScales
+  };
+
+  // Format of this subproject's instance buffer, shaders are compiled with INSTANCE_FORMAT set to it.
+  // PackedSoA lets culling skip the rotation stream.
+  inline constexpr InstanceFormat instanceFormat = InstanceFormat::PackedSoA;
 
-    for ( int x = gridMin; x <= gridMax; ++x )
-    {
-      for ( int y = gridMin; y <= gridMax; ++y )
-      {
-        for ( int z = gridMin; z <= gridMax; ++z )
-        {
-          instancesPos[index++] = InstanceData{ glm::vec3( float( x ) * 3.0f, float( y ) * 3.0f, float( z ) * 3.0f ) };
-        }
-      }
-    }
+  // Quantization ranges of the packed formats. Positions are unorm16 inside a chunk of instanceChunkSize,
+  // chunk coordinates range from -16 to 15 per axis.
+  inline constexpr float instanceChunkSize = 128.0f;
+  inline constexpr float instanceMaxScale  = 4.0f;
 
-    return instancesPos;
-  }
+  // Every instance draws an icosphere, LOD 0 is subdivided three times (1280 triangles), LOD 3 is the
+  // icosahedron (20 triangles). Screen sizes are the projected diameter in pixels from which a level is used.
+  inline constexpr float                modelRadius         = 1.0f;
+  inline constexpr std::array<float, 4> modelLodScreenSizes = { 96.0f, 32.0f, 12.0f, 0.0f };
 
-  inline constexpr std::array<InstanceData, instanceCount> instancesPos = createInstances();
+  // Default instance layout, a 41^3 grid 3 units apart around the origin. The instance buffer is filled at
+  // startup by core::InstanceGenerator and can be regenerated with other parameters from the Instances window.
+  inline constexpr uint32_t gridCount   = 41;
+  inline constexpr float    gridSpacing = 3.0f;
 
 }  // namespace data
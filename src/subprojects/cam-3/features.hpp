@@ -1,6 +1,7 @@
 #pragma once
 #include "vulkan/vulkan.hpp"
 
+#include <string_view>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 #include <vulkan/vulkan_raii.hpp>
@@ -33,9 +34,18 @@ namespace cfg {
   inline vk::PhysicalDeviceVulkan12Features vulkan12Features = 
       vk::PhysicalDeviceVulkan12Features()
           .setBufferDeviceAddress(true)
+          .setDrawIndirectCount(true)
+          .setSamplerFilterMinmax(true)
           .setDescriptorIndexing(true)
           .setRuntimeDescriptorArray(true)
           .setDescriptorBindingPartiallyBound(true)
+          .setDescriptorBindingUpdateUnusedWhilePending(true)
+          .setDescriptorBindingSampledImageUpdateAfterBind(true)
+          .setDescriptorBindingStorageImageUpdateAfterBind(true)
+          .setDescriptorBindingStorageBufferUpdateAfterBind(true)
+          .setShaderSampledImageArrayNonUniformIndexing(true)
+          .setShaderStorageImageArrayNonUniformIndexing(true)
+          .setShaderStorageBufferArrayNonUniformIndexing(true)
           .setTimelineSemaphore(true)
           .setVulkanMemoryModel(true)
           .setVulkanMemoryModelDeviceScope(true)
@@ -113,6 +123,8 @@ namespace cfg {
           .setFragmentStoresAndAtomics(true)
           .setVertexPipelineStoresAndAtomics(true)
           .setShaderInt64(true)
+          .setMultiDrawIndirect(true)
+          .setDrawIndirectFirstInstance(true)
           .setRobustBufferAccess(true)
           .setWideLines(true);
   
@@ -149,6 +161,75 @@ namespace cfg {
     // VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME,
   };
 
+  // -------------------------------------------------------------------------
+  // Optional extensions, enabled only when the selected device supports them.
+  // resolveDeviceExtensions() links the feature struct of every supported one
+  // in front of enabledFeaturesChain and records the result in `supported`.
+  // -------------------------------------------------------------------------
+
+  // clang-format off
+  inline vk::PhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures =
+      vk::PhysicalDeviceDescriptorBufferFeaturesEXT()
+          .setDescriptorBuffer(true);
+
+  inline vk::PhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures =
+      vk::PhysicalDeviceMeshShaderFeaturesEXT()
+          .setTaskShader(true)
+          .setMeshShader(true);
+  // clang-format on
+
+  struct SupportedFeatures
+  {
+    bool descriptorBuffer = false;
+    bool meshShader       = false;  // task and mesh stages, every graphics shader object bind has to cover them
+  };
+
+  inline SupportedFeatures supported;
+
+  [[nodiscard]] inline std::vector<const char *> resolveDeviceExtensions( vk::raii::PhysicalDevice const & physicalDevice )
+  {
+    std::vector<const char *> extensions = getRequiredExtensions;
+
+    auto available = physicalDevice.enumerateDeviceExtensionProperties();
+    auto has       = [&]( const char * name )
+    {
+      for ( auto const & ext : available )
+        if ( std::string_view( ext.extensionName.data() ) == name )
+          return true;
+      return false;
+    };
+
+    auto enable = [&]( const char * name, auto & features )
+    {
+      extensions.push_back( name );
+      features.setPNext( enabledFeaturesChain.pNext );
+      enabledFeaturesChain.setPNext( &features );
+    };
+
+    if ( has( VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME ) )
+    {
+      auto query = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceDescriptorBufferFeaturesEXT>();
+      if ( query.get<vk::PhysicalDeviceDescriptorBufferFeaturesEXT>().descriptorBuffer )
+      {
+        enable( VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME, descriptorBufferFeatures );
+        supported.descriptorBuffer = true;
+      }
+    }
+
+    if ( has( VK_EXT_MESH_SHADER_EXTENSION_NAME ) )
+    {
+      auto query = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+      auto mesh  = query.get<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+      if ( mesh.taskShader && mesh.meshShader )
+      {
+        enable( VK_EXT_MESH_SHADER_EXTENSION_NAME, meshShaderFeatures );
+        supported.meshShader = true;
+      }
+    }
+
+    return extensions;
+  }
+
   inline const std::vector<const char *> InstanceExtensions = {
     VK_KHR_SURFACE_EXTENSION_NAME,
     VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME,
@@ -1,10 +1,13 @@
 #pragma once
+#include "data.hpp"
 
 #include <string>
+#include <utility>
 #include <vector>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <print>
 #include <sstream>
 #include <stdexcept>
@@ -38,6 +41,8 @@ namespace core
         case vk::ShaderStageFlagBits::eMissKHR: return shaderc_miss_shader;
         case vk::ShaderStageFlagBits::eAnyHitKHR: return shaderc_anyhit_shader;
         case vk::ShaderStageFlagBits::eCallableKHR: return shaderc_callable_shader;
+        case vk::ShaderStageFlagBits::eTaskEXT: return shaderc_task_shader;
+        case vk::ShaderStageFlagBits::eMeshEXT: return shaderc_mesh_shader;
         default: throw std::invalid_argument( "Unsupported Vulkan shader stage" );
       }
     }
@@ -65,6 +70,8 @@ namespace core
       if ( ext == "rmiss" ) return vk::ShaderStageFlagBits::eMissKHR;
       if ( ext == "rahit" ) return vk::ShaderStageFlagBits::eAnyHitKHR;
       if ( ext == "rcall" ) return vk::ShaderStageFlagBits::eCallableKHR;
+      if ( ext == "task" ) return vk::ShaderStageFlagBits::eTaskEXT;
+      if ( ext == "mesh" ) return vk::ShaderStageFlagBits::eMeshEXT;
 
       throw std::invalid_argument( "Unknown shader extension: " + ext );
     }
@@ -101,6 +108,67 @@ namespace core
       return buffer.str();
     }
 
+    // Macros every shader is compiled with, see data::instanceFormat
+    inline std::vector<std::pair<std::string, std::string>> const & shaderDefines()
+    {
+      static const std::vector<std::pair<std::string, std::string>> defines = {
+        { "INSTANCE_FORMAT", std::to_string( static_cast<uint32_t>( data::instanceFormat ) ) },
+      };
+      return defines;
+    }
+
+    // The macros are part of the name, SPIR-V cached by a build with other values is not picked up
+    inline std::string compiledShaderPath( const std::string & shaderName )
+    {
+      std::string path = "./compiled/" + shaderName;
+      for ( auto const & [name, value] : shaderDefines() )
+        path += "." + name + "_" + value;
+      return path + ".spv";
+    }
+
+    // Resolves #include "file.glsl" relative to ./shaders
+    class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface
+    {
+      struct Include
+      {
+        std::string            name;
+        std::string            content;
+        shaderc_include_result result;
+      };
+
+    public:
+      shaderc_include_result * GetInclude( const char * requested, shaderc_include_type, const char *, size_t ) override
+      {
+        std::string path    = std::string( "./shaders/" ) + requested;
+        auto *      include = new Include{};
+        if ( std::filesystem::exists( path ) )
+        {
+          include->name    = path;
+          include->content = readShaderSource( path );
+        }
+        else
+          include->content = "Cannot open include file: " + path;  // an empty source name reports the error
+
+        include->result = { include->name.data(), include->name.size(), include->content.data(), include->content.size(), include };
+        return &include->result;
+      }
+
+      void ReleaseInclude( shaderc_include_result * result ) override
+      {
+        delete static_cast<Include *>( result->user_data );
+      }
+    };
+
+    // Newest of the shader and the shared *.glsl files it may include
+    inline std::filesystem::file_time_type shaderSourceTime( const std::string & sourcePath )
+    {
+      auto newest = std::filesystem::last_write_time( sourcePath );
+      for ( auto const & entry : std::filesystem::directory_iterator( "./shaders" ) )
+        if ( entry.path().extension() == ".glsl" )
+          newest = std::max( newest, entry.last_write_time() );
+      return newest;
+    }
+
     // Compile GLSL → SPIR-V using shaderc
     inline std::vector<uint32_t> compileShader( const std::string & shaderName )
     {
@@ -113,6 +181,11 @@ namespace core
       shaderc::Compiler compiler;
       shaderc::CompileOptions options;
       options.SetOptimizationLevel( shaderc_optimization_level_performance );
+      // Subgroup operations and later mesh/task shaders need SPIR-V newer than the Vulkan 1.0 default
+      options.SetTargetEnvironment( shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3 );
+      options.SetIncluder( std::make_unique<ShaderIncluder>() );
+      for ( auto const & [name, value] : shaderDefines() )
+        options.AddMacroDefinition( name, value );
 
       shaderc::SpvCompilationResult result =
         compiler.CompileGlslToSpv( source, kind, shaderName.c_str(), options );
@@ -127,7 +200,7 @@ namespace core
 
       // Save to ./compiled
       std::filesystem::create_directories( "./compiled" );
-      std::string outputPath = "./compiled/" + shaderName + ".spv";
+      std::string outputPath = compiledShaderPath( shaderName );
 
       std::ofstream outFile( outputPath, std::ios::binary );
       if ( !outFile.is_open() )
@@ -142,12 +215,12 @@ namespace core
     inline std::vector<uint32_t> getShaderCode( const std::string & shaderName )
     {
       std::string sourcePath = "./shaders/" + shaderName;
-      std::string compiledPath = "./compiled/" + shaderName + ".spv";
+      std::string compiledPath = compiledShaderPath( shaderName );
 
       if ( !std::filesystem::exists( sourcePath ) )
         throw std::runtime_error( "Shader source file does not exist: " + sourcePath );
 
-      auto sourceTime = std::filesystem::last_write_time( sourcePath );
+      auto sourceTime = shaderSourceTime( sourcePath );
 
       bool compiledExists = std::filesystem::exists( compiledPath );
       bool needsRecompilation = !compiledExists;
@@ -19,7 +19,7 @@
 #include <print>
 #include <vk_mem_alloc.h>
 
-int main()
+int main( int argc, char ** argv )
 {
   try
   {
@@ -40,8 +40,13 @@ int main()
 
     global::obj::queueFamilyIndices = core::findQueueFamilies( global::obj::physicalDevice, global::obj::surface );
 
-    global::obj::device =
-      core::createDevice( global::obj::physicalDevice, global::obj::queueFamilyIndices, cfg::enabledFeaturesChain, cfg::getRequiredExtensions );
+    // Links the feature structs of supported optional extensions into cfg::enabledFeaturesChain
+    std::vector<const char *> deviceExtensions = cfg::resolveDeviceExtensions( global::obj::physicalDevice );
+
+    global::obj::device = core::createDevice( global::obj::physicalDevice, global::obj::queueFamilyIndices, cfg::enabledFeaturesChain, deviceExtensions );
+
+    global::obj::renderPath = core::preferredRenderPath();
+    isDebug( std::println( "render path: {}", core::toString( global::obj::renderPath ) ) );
 
     global::obj::graphicsQueue = vk::raii::Queue( global::obj::device, global::obj::queueFamilyIndices.graphicsFamily.value(), 0 );
     global::obj::presentQueue  = vk::raii::Queue( global::obj::device, global::obj::queueFamilyIndices.presentFamily.value(), 0 );
@@ -54,7 +59,15 @@ int main()
 
     global::obj::allocator = core::raii::Allocator( global::obj::instance, global::obj::physicalDevice, global::obj::device );
 
+    global::obj::resources.init( *global::obj::device, global::obj::allocator );
+    global::obj::defragmenter.init( global::obj::device,
+                                    global::obj::allocator,
+                                    global::obj::resources,
+                                    global::obj::queueFamilyIndices.graphicsFamily.value(),
+                                    global::obj::graphicsQueue );
+
     global::obj::descriptorPool = core::createDescriptorPool( global::obj::device );
+    global::obj::bindless.init( global::obj::device, global::obj::physicalDevice );
 
     //=========================================================
     // ImGui setup
@@ -97,7 +110,7 @@ int main()
       global::obj::allocator,
       global::state::screenSize,
       vk::Format::eD32Sfloat,
-      vk::ImageUsageFlagBits::eDepthStencilAttachment,
+      vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled,
       vk::ImageAspectFlagBits::eDepth );
 
     global::obj::basicTargetTexture = core::createTexture(
@@ -112,52 +125,52 @@ int main()
       global::obj::device,
       { "triangle.vert" },
       { "triangle.frag" },
-      vk::PushConstantRange{ vk::ShaderStageFlagBits::eVertex, 0, sizeof( data::PushConstants ) } );
-
-    VkDeviceSize bufferSize = sizeof( data::triangleVertices );
-
-    VkBufferCreateInfo bufferInfo = {};
-    bufferInfo.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size               = bufferSize;
-    bufferInfo.usage              = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-    bufferInfo.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
-
-    VmaAllocationCreateInfo allocInfo = {};
-    allocInfo.usage                   = VMA_MEMORY_USAGE_AUTO;
-    allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
-
-    vmaCreateBuffer(
-      global::obj::allocator,
-      &bufferInfo,
-      &allocInfo,
-      &global::obj::vertexBuffer.buffer,
-      &global::obj::vertexBuffer.allocation,
-      &global::obj::vertexBuffer.allocationInfo );
-    global::obj::vertexBuffer.size = bufferSize;
-
-    // Copy vertex data to buffer (already mapped)
-    memcpy( global::obj::vertexBuffer.allocationInfo.pMappedData, data::triangleVertices.data(), static_cast<size_t>( bufferSize ) );
-
-    uint32_t     instanceCount      = static_cast<uint32_t>( data::instancesPos.size() );
-    VkDeviceSize instanceBufferSize = sizeof( data::InstanceData ) * data::instancesPos.size();
-
-    VkBufferCreateInfo instanceBufferInfo = {};
-    instanceBufferInfo.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    instanceBufferInfo.size               = instanceBufferSize;
-    instanceBufferInfo.usage              = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-    instanceBufferInfo.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
-
-    vmaCreateBuffer(
-      global::obj::allocator,
-      &instanceBufferInfo,
-      &allocInfo,
-      &global::obj::instanceBuffer.buffer,
-      &global::obj::instanceBuffer.allocation,
-      &global::obj::instanceBuffer.allocationInfo );
-    global::obj::instanceBuffer.size = instanceBufferSize;
-
-    // Copy instance data to buffer
-    memcpy( global::obj::instanceBuffer.allocationInfo.pMappedData, data::instancesPos.data(), static_cast<size_t>( instanceBufferSize ) );
+      vk::PushConstantRange{ vk::ShaderStageFlagBits::eVertex, 0, sizeof( data::PushConstants ) },
+      { *global::obj::bindless.layout } );
+
+    global::obj::model = core::createIcosphereModel( global::obj::allocator, data::modelRadius, data::modelLodScreenSizes );
+    global::obj::model.adopt( global::obj::resources, global::obj::bindless );
+
+    global::obj::instances.init( global::obj::device,
+                                 global::obj::allocator,
+                                 global::obj::resources,
+                                 global::obj::bindless,
+                                 global::obj::queueFamilyIndices.graphicsFamily.value(),
+                                 global::obj::graphicsQueue );
+    global::obj::instances.generate( global::obj::bindless, global::obj::instanceParams, global::state::frameCount );
+    isDebug( std::println( "{} instances generated with {} in {:.2f} ms",
+                           global::obj::instances.count,
+                           core::toString( global::obj::instances.results.back().params.source ),
+                           global::obj::instances.results.back().ms ) );
+
+    global::obj::verlet.init( global::obj::device,
+                              global::obj::physicalDevice,
+                              global::obj::allocator,
+                              global::obj::bindless,
+                              global::obj::queueFamilyIndices.graphicsFamily.value(),
+                              global::obj::graphicsQueue );
+    global::obj::cpuVerlet.init( global::obj::allocator );
+    global::obj::scene.init( global::obj::device,
+                             global::obj::physicalDevice,
+                             global::obj::allocator,
+                             global::obj::queueFamilyIndices.graphicsFamily.value(),
+                             global::obj::graphicsQueue );
+    global::obj::sphereSensors.init( global::obj::device, global::obj::allocator, global::obj::queueFamilyIndices.graphicsFamily.value() );
+    global::obj::readbackStress.init( global::obj::device, global::obj::allocator, global::obj::queueFamilyIndices.graphicsFamily.value() );
+    global::obj::sdfVolume.init(
+      global::obj::device, global::obj::physicalDevice, global::obj::allocator, global::obj::queueFamilyIndices.graphicsFamily.value() );
+    global::obj::sdfClipmap.init(
+      global::obj::device, global::obj::physicalDevice, global::obj::allocator, global::obj::queueFamilyIndices.graphicsFamily.value() );
+
+    global::obj::culler.init( global::obj::device, global::obj::allocator, global::obj::bindless, global::obj::instances.count, global::obj::model );
+    global::obj::meshRenderer.init( global::obj::device, global::obj::physicalDevice, global::obj::allocator, global::obj::bindless, global::obj::model );
+
+    // The icosphere is drawn until a model file given on the command line finished loading
+    global::obj::meshLoader.init(
+      global::obj::device, global::obj::allocator, global::obj::queueFamilyIndices.graphicsFamily.value(), global::obj::graphicsQueue );
+    if ( argc > 1 )
+      global::obj::meshLoader.start( argv[1] );
+    global::obj::gpuTimer.init( global::obj::device, global::obj::physicalDevice );
 
     vk::CommandPoolCreateInfo cmdPoolInfo{ vk::CommandPoolCreateFlagBits::eResetCommandBuffer, global::obj::queueFamilyIndices.graphicsFamily.value() };
     global::obj::commandPool = vk::raii::CommandPool{ global::obj::device, cmdPoolInfo };
@@ -183,6 +196,7 @@ int main()
 
     // std::this_thread::sleep_for(std::chrono::milliseconds(500));
     size_t currentFrame = 0;
+    global::obj::simulation.start( global::state::cameraPosition );
 
     while ( !glfwWindowShouldClose( global::obj::window ) )
     {
@@ -191,9 +205,8 @@ int main()
       // Compute the camera direction in the XZ plane from cameraRotation.y (yaw)
       float     yaw     = global::state::cameraRotation.x;
       glm::vec3 forward = glm::vec3( std::sin( yaw ), 0.0f, std::cos( yaw ) );
-      glm::vec3   left      = glm::cross( glm::vec3( 0.0f, 1.0f, 0.0f ), forward );
-      const float moveSpeed = 0.1f;
-      glm::vec3   moveStep  = glm::vec3( 0 );
+      glm::vec3 left     = glm::cross( glm::vec3( 0.0f, 1.0f, 0.0f ), forward );
+      glm::vec3 moveStep = glm::vec3( 0 );
 
       if ( global::state::keysPressed.contains( core::Key::A ) )
       {
@@ -219,9 +232,9 @@ int main()
       {
         moveStep.y -= 1;
       }
-      // std::println("{} {}", moveStep.x, glm::normalize(moveStep).x);
-      if ( moveStep != glm::vec3( 0.0f ) )
-        global::state::cameraPosition += glm::normalize( moveStep ) * moveSpeed;
+      // The simulation thread moves the camera at its own fixed rate, the frame shows it interpolated between ticks
+      global::obj::simulation.setInput( { moveStep != glm::vec3( 0.0f ) ? glm::normalize( moveStep ) : glm::vec3( 0.0f ) } );
+      global::state::cameraPosition = global::obj::simulation.cameraPosition( std::chrono::steady_clock::now() );
 
       if ( global::state::framebufferResized )
       {
@@ -237,9 +250,22 @@ int main()
           global::obj::depthTexture,
           global::obj::basicTargetTexture,
           global::obj::window );
+        global::obj::culler.pyramid.invalidate();
         continue;
       }
 
+      // Advance background compaction and free resources no frame in flight can still reference
+      global::obj::defragmenter.step( global::state::frameCount );
+      global::obj::resources.collect( global::state::frameCount );
+      std::vector<core::ResourceHandle> moved = global::obj::resources.takePatched();
+      global::obj::bindless.patch( global::obj::resources, moved, global::state::frameCount );
+      if ( !moved.empty() )
+        global::obj::model.refresh( global::obj::resources );
+      global::obj::bindless.collect( global::state::frameCount );
+
+      if ( auto loaded = global::obj::meshLoader.poll() )
+        ui::replaceModel( std::move( *loaded ) );
+
       if ( global::state::imguiMode )
       {
         // Start ImGui frame
@@ -251,6 +277,22 @@ int main()
         ui::renderPresentModeWindow();
         ui::renderPipelineStateWindow();
         ui::logging();
+        ui::renderDefragWindow();
+        ui::renderBindingWindow();
+        ui::renderCullingWindow();
+        ui::renderRenderPathWindow();
+        ui::renderInstancesWindow();
+        ui::renderSceneWindow();
+        ui::renderSpheresWindow();
+        ui::renderConstraintsWindow();
+        ui::renderReadbackWindow();
+        ui::renderSortWindow();
+        ui::renderScanWindow();
+        ui::renderMeshletsWindow();
+        ui::renderTerrainWindow();
+        ui::renderClipmapWindow();
+        ui::renderSimulationWindow();
+        ui::renderModelWindow();
 
         ImGui::Render();
       }
@@ -277,18 +319,95 @@ int main()
         // Only reset the fence after successful image acquisition to prevent deadlock on exception
         global::obj::device.resetFences( { *presentFence } );
 
+        // This slot's previous frame has finished, its counters and timestamps can be read
+        uint32_t frameSlot = static_cast<uint32_t>( currentFrame );
+        global::obj::culler.collect( frameSlot );
+        global::obj::meshRenderer.collect( frameSlot );
+        global::obj::gpuTimer.collect( frameSlot );
+        global::obj::verlet.collect( frameSlot );
+        if ( global::obj::sceneSource == core::SceneSource::CpuSpheres )
+          global::obj::cpuVerlet.frame( frameSlot );
+        global::obj::sdfVolume.collect( frameSlot );
+        global::obj::sdfClipmap.collect( frameSlot );
+        global::obj::scene.collect( frameSlot );
+        global::obj::sphereSensors.collect( global::state::frameCount );
+        global::obj::readbackStress.collect( global::state::frameCount );
+        global::obj::meshLoader.recordDrawTime( global::obj::gpuTimer.msPrefix( "draw" ) );
+        global::obj::cullSweep.record( frameSlot,
+                                       global::obj::culler.stats.drawn,
+                                       global::obj::culler.stats.triangles,
+                                       global::obj::gpuTimer.msPrefix( "cull" ) + global::obj::gpuTimer.ms( "depth pyramid" ),
+                                       global::obj::gpuTimer.msPrefix( "draw" ) );
+        global::obj::cullSweep.apply( frameSlot, global::state::cameraRotation );
+
+        global::obj::renderPathComparison.record( frameSlot,
+                                                  global::obj::gpuTimer.msPrefix( "cull" ) + global::obj::gpuTimer.msPrefix( "draw" ),
+                                                  global::obj::culler.stats,
+                                                  global::obj::meshRenderer.stats );
+        global::obj::renderPathComparison.apply( frameSlot, global::obj::renderPath, global::obj::culler.mode );
+
         // Record command buffers for this frame: scene -> offscreen, then blit+imgui -> swapchain
         auto & cmdScene   = global::obj::cmdScene[currentFrame];
         auto & cmdOverlay = global::obj::cmdOverlay[currentFrame];
 
+        // The instance buffer the scene draws. GPU spheres step and changed entities are copied in their own command
+        // buffers submitted ahead of the scene, CPU spheres were stepped above and are read from this slot's instances.
+        vk::CommandBuffer cmdSpheres;
+        vk::CommandBuffer cmdEntities;
+        uint32_t          sceneInstances = global::obj::instances.bufferIndex( global::obj::bindless );
+        uint32_t          sceneCount     = global::obj::instances.count;
+        switch ( global::obj::sceneSource )
+        {
+          case core::SceneSource::Instances: break;
+          case core::SceneSource::GpuSpheres:
+            cmdSpheres     = global::obj::verlet.record( global::obj::bindless, frameSlot );
+            sceneInstances = global::obj::verlet.instanceIndex;
+            sceneCount     = global::obj::verlet.count;
+            break;
+          case core::SceneSource::CpuSpheres:
+            sceneInstances = global::obj::cpuVerlet.instanceIndices[frameSlot];
+            sceneCount     = global::obj::cpuVerlet.count;
+            break;
+          case core::SceneSource::Entities:
+            cmdEntities    = global::obj::scene.recordFrame( frameSlot, global::state::frameCount );
+            sceneInstances = global::obj::scene.bufferIndex;
+            sceneCount     = global::obj::scene.capacity;
+            break;
+        }
+
+        // Readback copies follow the passes that wrote their sources and signal their ring's timeline
+        vk::CommandBuffer cmdSensors =
+          cmdSpheres ? global::obj::sphereSensors.record( global::obj::verlet, frameSlot, global::state::frameCount ) : vk::CommandBuffer{};
+        vk::CommandBuffer cmdStress = global::obj::readbackStress.record( frameSlot, global::state::frameCount );
+
+        // Dirty terrain chunks are re-meshed ahead of the scene, which draws every chunk's latest mesh, or the dual
+        // contouring of the last comparison in its place
+        vk::CommandBuffer                          cmdTerrain   = global::obj::sdfVolume.recordFrame( global::obj::bindless, frameSlot );
+        core::DualContouringComparison const &     contoured    = global::obj::dualContouringComparison;
+        bool                                       dual         = contoured.show && !contoured.surface.empty();
+        std::array<core::SurfaceChunks const *, 2> terrain      = { dual ? &contoured.surface : &global::obj::sdfVolume.surface };
+        uint32_t                                   terrainCount = dual || global::obj::sdfVolume.enabled ? 1 : 0;
+
+        // Missing clipmap chunks are generated the same way, the scene draws the coarser level until they are collected
+        vk::CommandBuffer cmdClipmap = global::obj::sdfClipmap.recordFrame( global::obj::bindless, frameSlot, global::state::cameraPosition );
+        if ( global::obj::sdfClipmap.enabled )
+          terrain[terrainCount++] = &global::obj::sdfClipmap.surface;
+
         pipelines::basic::recordCommandBufferOffscreen(
           cmdScene,
           shaderBundle,
           global::obj::basicTargetTexture,
-          global::obj::vertexBuffer.buffer,
-          global::obj::instanceBuffer.buffer,
-          instanceCount,
-          global::obj::depthTexture );
+          global::obj::model,
+          global::obj::bindless,
+          sceneInstances,
+          sceneCount,
+          global::obj::depthTexture,
+          global::obj::culler,
+          global::obj::meshRenderer,
+          global::obj::renderPath,
+          global::obj::gpuTimer,
+          frameSlot,
+          std::span<core::SurfaceChunks const * const>( terrain.data(), terrainCount ) );
 
         pipelines::overlay::recordCommandBuffer( cmdOverlay, global::obj::basicTargetTexture, global::obj::swapchainBundle, imageIndex );
 
@@ -299,19 +418,39 @@ int main()
           vk::SemaphoreSubmitInfo{}.setSemaphore( *imageAvailable ).setStageMask( vk::PipelineStageFlagBits2::eColorAttachmentOutput )
         };
 
-        std::array<vk::SemaphoreSubmitInfo, 1> signalSemaphoreInfos = {
+        std::array<vk::SemaphoreSubmitInfo, 3> signalSemaphoreInfos = {
           vk::SemaphoreSubmitInfo{}.setSemaphore( *renderFinished ).setStageMask( vk::PipelineStageFlagBits2::eBottomOfPipe ),
           // vk::SemaphoreSubmitInfo{}.setSemaphore( *syncSemaphore ).setValue( renderCompleteValue ).setStageMask( vk::PipelineStageFlagBits2::eAllCommands )
         };
-
-        std::array<vk::CommandBufferSubmitInfo, 2> cmdBufferInfos{ vk::CommandBufferSubmitInfo{}.setCommandBuffer( *cmdScene ),
-                                                                   vk::CommandBufferSubmitInfo{}.setCommandBuffer( *cmdOverlay ) };
+        uint32_t signalSemaphoreCount = 1;
+        if ( cmdSensors )
+          signalSemaphoreInfos[signalSemaphoreCount++] = global::obj::sphereSensors.ring.signalInfo();
+        if ( cmdStress )
+          signalSemaphoreInfos[signalSemaphoreCount++] = global::obj::readbackStress.ring.signalInfo();
+
+        std::array<vk::CommandBufferSubmitInfo, 8> cmdBufferInfos{};
+        uint32_t                                   cmdBufferCount = 0;
+        if ( cmdSpheres )
+          cmdBufferInfos[cmdBufferCount++].setCommandBuffer( cmdSpheres );
+        if ( cmdSensors )
+          cmdBufferInfos[cmdBufferCount++].setCommandBuffer( cmdSensors );
+        if ( cmdStress )
+          cmdBufferInfos[cmdBufferCount++].setCommandBuffer( cmdStress );
+        if ( cmdTerrain )
+          cmdBufferInfos[cmdBufferCount++].setCommandBuffer( cmdTerrain );
+        if ( cmdClipmap )
+          cmdBufferInfos[cmdBufferCount++].setCommandBuffer( cmdClipmap );
+        if ( cmdEntities )
+          cmdBufferInfos[cmdBufferCount++].setCommandBuffer( cmdEntities );
+        cmdBufferInfos[cmdBufferCount++].setCommandBuffer( *cmdScene );
+        cmdBufferInfos[cmdBufferCount++].setCommandBuffer( *cmdOverlay );
 
         vk::SubmitInfo2 submitInfo{};
-        submitInfo.setCommandBufferInfoCount( cmdBufferInfos.size() )
+        submitInfo.setCommandBufferInfoCount( cmdBufferCount )
           .setPCommandBufferInfos( cmdBufferInfos.data() )
           .setWaitSemaphoreInfos( waitSemaphoreInfos )
-          .setSignalSemaphoreInfos( signalSemaphoreInfos );
+          .setSignalSemaphoreInfoCount( signalSemaphoreCount )
+          .setPSignalSemaphoreInfos( signalSemaphoreInfos.data() );
 
         global::obj::graphicsQueue.submit2( submitInfo );
 
@@ -339,6 +478,7 @@ int main()
         }
 
         currentFrame = ( currentFrame + 1 ) % global::state::MAX_FRAMES_IN_FLIGHT;
+        global::state::frameCount++;
 
         global::state::keysDown.clear();
         global::state::keysUp.clear();
@@ -357,6 +497,7 @@ int main()
           global::obj::depthTexture,
           global::obj::basicTargetTexture,
           global::obj::window );
+        global::obj::culler.pyramid.invalidate();
         continue;
       }
     }
@@ -365,11 +506,26 @@ int main()
 
     core::shutdownImGui();
 
+    global::obj::meshLoader.destroy();
+    global::obj::defragmenter.finish();
+    global::obj::model.release( global::obj::resources, global::obj::bindless, global::state::frameCount );
+    global::obj::instances.destroy( global::obj::bindless, global::state::frameCount );
+    global::obj::resources.destroyAll();
+    global::obj::culler.destroy();
+    global::obj::meshRenderer.destroy();
+
     core::destroyTexture( global::obj::device, global::obj::allocator, global::obj::depthTexture );
     core::destroyTexture( global::obj::device, global::obj::allocator, global::obj::basicTargetTexture );
     // Cleanup VMA resources;
-    vmaDestroyBuffer( global::obj::allocator, global::obj::vertexBuffer.buffer, global::obj::vertexBuffer.allocation );
-    vmaDestroyBuffer( global::obj::allocator, global::obj::instanceBuffer.buffer, global::obj::instanceBuffer.allocation );
+    global::obj::verlet.destroy( global::obj::bindless, global::state::frameCount );
+    global::obj::cpuVerlet.destroy( global::obj::bindless, global::state::frameCount );
+    global::obj::scene.destroy( global::obj::bindless, global::state::frameCount );
+    global::obj::sdfVolume.destroy( global::obj::bindless, global::state::frameCount );
+    global::obj::dualContouringComparison.destroy( global::obj::bindless, global::state::frameCount );
+    global::obj::sdfClipmap.destroy( global::obj::bindless, global::state::frameCount );
+    global::obj::simulation.stop();
+    global::obj::sphereSensors.stop();
+    global::obj::readbackStress.stop();
     // vmaDestroyAllocator( allocator );
   }
 
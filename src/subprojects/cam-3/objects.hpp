@@ -1,5 +1,27 @@
 #pragma once
 #define GLFW_INCLUDE_NONE
+#include "core/bindbench.hpp"
+#include "core/binding.hpp"
+#include "core/bindless.hpp"
+#include "core/clipmap.hpp"
+#include "core/cpuverlet.hpp"
+#include "core/culling.hpp"
+#include "core/defrag.hpp"
+#include "core/dualcontouring.hpp"
+#include "core/instancebench.hpp"
+#include "core/instances.hpp"
+#include "core/marchingcubes.hpp"
+#include "core/material.hpp"
+#include "core/meshletbench.hpp"
+#include "core/meshload.hpp"
+#include "core/meshpath.hpp"
+#include "core/radixsort.hpp"
+#include "core/resources.hpp"
+#include "core/scan.hpp"
+#include "core/scene.hpp"
+#include "core/simulation.hpp"
+#include "core/timer.hpp"
+#include "core/verlet.hpp"
 #include "setup.hpp"
 #include "structs.hpp"
 #include <GLFW/glfw3.h>
@@ -38,6 +60,11 @@ namespace global
 
     inline vk::raii::DescriptorPool descriptorPool = nullptr;
 
+    // Global update-after-bind descriptor set, shaders index into it through push constants
+    inline core::BindlessHeap bindless;
+
+    inline core::BindingBenchmark bindingBenchmark;
+
     // inline core::raii::IMGUI IMGUI;
 
     inline vk::raii::CommandPool commandPool = nullptr;
@@ -48,8 +75,83 @@ namespace global
     inline vk::raii::CommandBuffers cmdScene = nullptr;
     inline vk::raii::CommandBuffers cmdOverlay = nullptr;
 
-    inline core::Buffer vertexBuffer;
-    inline core::Buffer instanceBuffer;
+    inline core::Model model;
+
+    // Background loading of model files, a loaded model replaces `model`
+    inline core::MeshLoader          meshLoader;
+    inline core::MeshLoadBenchmark   meshLoadBenchmark;
+    inline core::CookedLoadBenchmark cookedLoadBenchmark;
+
+    // Instance buffer, filled at startup and regenerated from the Instances window
+    inline core::InstanceGenerator       instances;
+    inline core::InstanceParams          instanceParams;
+    inline core::InstanceFormatBenchmark instanceBenchmark;
+
+    // What the scene draws, switched with ui::setSceneSource()
+    inline core::SceneSource sceneSource = core::SceneSource::Instances;
+
+    // EnTT entities drawn in place of the instances from the Scene window
+    inline core::Scene scene;
+
+    // GPU Verlet spheres, drawn in place of the instances from the Spheres window
+    inline core::VerletSim       verlet;
+    inline core::VerletParams    verletParams;
+    inline core::VerletBenchmark verletBenchmark;
+    inline core::GridValidation  gridValidation;
+
+    // The same spheres stepped on the CPU threads, drawn in place of the instances from the Spheres window
+    inline core::CpuVerletSim       cpuVerlet;
+    inline core::CpuVerletBenchmark cpuVerletBenchmark;
+
+    // Asynchronous readback of sphere positions and its stress test, from the Spheres and Readback windows
+    inline core::SphereSensors  sphereSensors;
+    inline core::ReadbackStress readbackStress;
+
+    // XPBD spring checks and timings, run from the Constraints window
+    inline core::XpbdValidation xpbdValidation;
+    inline core::XpbdBenchmark  xpbdBenchmark;
+
+    // GPU radix sort checks and timings, run from the Sorting window
+    inline core::RadixSortValidation radixSortValidation;
+    inline core::RadixSortBenchmark  radixSortBenchmark;
+
+    // Scan, reduction and compaction checks and timings with the workgroup shape picked in the Scan window
+    inline core::ScanConfig     scanConfig;
+    inline core::ScanValidation scanValidation;
+    inline core::ScanBenchmark  scanBenchmark;
+
+    // Editable marching cubes terrain drawn by the scene pass, its checks against the CPU mesher and the comparison with
+    // dual contouring, from the Terrain window
+    inline core::SdfVolume                sdfVolume;
+    inline core::MarchingCubesValidation  marchingCubesValidation;
+    inline core::DualContouringComparison dualContouringComparison;
+
+    // Clipmap of the terrain shape streamed around the camera, from the Clipmap window
+    inline core::SdfClipmap sdfClipmap;
+
+    // Fixed-rate simulation thread that moves the camera, from the Simulation window
+    inline core::FixedStepSimulation simulation;
+
+    // CPU meshlet build benchmark, run from the Meshlets window
+    inline core::MeshletBenchmark meshletBenchmark;
+
+    // GPU-driven visibility for the instance grid
+    inline core::InstanceCuller   culler;
+    inline core::OrientationSweep cullSweep;
+
+    // Task/mesh shader path, picked from device support after device creation
+    inline core::RenderPath           renderPath = core::RenderPath::Vertex;
+    inline core::MeshRenderer         meshRenderer;
+    inline core::RenderPathComparison renderPathComparison;
+
+    inline core::GpuTimer gpuTimer;
+
+    // Long-lived VMA resources addressed by stable handles, compacted in the background
+    inline core::ResourceTable resources;
+    inline core::Defragmenter  defragmenter;
+
+    // Resources created by the allocation churn in the Memory window
+    inline std::vector<core::ResourceHandle> churnResources;
 
     
 
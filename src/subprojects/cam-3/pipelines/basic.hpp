@@ -1,62 +1,60 @@
 #pragma once
+#include "../core/bindless.hpp"
+#include "../core/culling.hpp"
+#include "../core/meshpath.hpp"
+#include "../core/surface.hpp"
+#include "../core/material.hpp"
+#include "../core/timer.hpp"
 #include "../data.hpp"
 #include "../setup.hpp"
 #include "../state.hpp"
 
+#include <algorithm>
+#include <span>
+#include <string_view>
 #include <vulkan/vulkan_raii.hpp>
 
 namespace pipelines
 {
   namespace basic
   {
-    inline void recordCommandBufferOffscreen(
-      vk::raii::CommandBuffer &  cmd,
-      core::raii::ShaderBundle & shaderBundle,
-      core::Texture const &      colorTarget,
-      VkBuffer                   vertexBuffer,
-      VkBuffer                   instanceBuffer,
-      uint32_t                   instanceCount,
-      core::Texture const &      depthResources )
+    inline constexpr float CameraNear = 0.1f;
+    inline constexpr float CameraFar  = 10000.0f;
+
+    // View and projection of the user controlled camera in global::state
+    inline data::PushConstants cameraPushConstants( vk::Extent2D extent )
     {
-      cmd.reset();
-      cmd.begin( vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+      glm::vec3 cameraPos = global::state::cameraPosition;
 
-      vk::ImageSubresourceRange subresourceRange{};
-      subresourceRange.setAspectMask( vk::ImageAspectFlagBits::eColor ).setLevelCount( 1 ).setLayerCount( 1 );
+      // Build view direction from rotation (yaw/pitch in radians)
+      float yaw   = global::state::cameraRotation.x;
+      float pitch = global::state::cameraRotation.y;
 
-      vk::ImageMemoryBarrier2 colorBarrier{};
-      colorBarrier.setSrcStageMask( vk::PipelineStageFlagBits2::eTopOfPipe )
-        .setSrcAccessMask( vk::AccessFlagBits2::eNone )
-        .setDstStageMask( vk::PipelineStageFlagBits2::eColorAttachmentOutput )
-        .setDstAccessMask( vk::AccessFlagBits2::eColorAttachmentWrite )
-        .setOldLayout( vk::ImageLayout::eUndefined )
-        .setNewLayout( vk::ImageLayout::eColorAttachmentOptimal )
-        .setSrcQueueFamilyIndex( VK_QUEUE_FAMILY_IGNORED )
-        .setDstQueueFamilyIndex( VK_QUEUE_FAMILY_IGNORED )
-        .setImage( colorTarget.image )
-        .setSubresourceRange( subresourceRange );
+      glm::vec3 direction;
+      direction.x = std::cos( pitch ) * std::sin( yaw );
+      direction.y = std::sin( pitch );
+      direction.z = std::cos( pitch ) * std::cos( yaw );
 
-      // Transition depth (keep in optimal layout)
-      vk::ImageSubresourceRange depthSubresourceRange{};
-      depthSubresourceRange.setAspectMask( vk::ImageAspectFlagBits::eDepth ).setLevelCount( 1 ).setLayerCount( 1 );
+      glm::vec3 cameraTarget = cameraPos + glm::normalize( direction );
+      glm::vec3 cameraUp     = glm::vec3( 0.0f, 1.0f, 0.0f );
 
-      vk::ImageMemoryBarrier2 depthBarrier{};
-      depthBarrier.setSrcStageMask( vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests )
-        .setSrcAccessMask( vk::AccessFlagBits2::eDepthStencilAttachmentWrite )
-        .setDstStageMask( vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests )
-        .setDstAccessMask( vk::AccessFlagBits2::eDepthStencilAttachmentWrite )
-        .setOldLayout( vk::ImageLayout::eDepthAttachmentOptimal )
-        .setNewLayout( vk::ImageLayout::eDepthAttachmentOptimal )
-        .setSrcQueueFamilyIndex( VK_QUEUE_FAMILY_IGNORED )
-        .setDstQueueFamilyIndex( VK_QUEUE_FAMILY_IGNORED )
-        .setImage( depthResources.image )
-        .setSubresourceRange( depthSubresourceRange );
+      glm::mat4 view = glm::lookAt( cameraPos, cameraTarget, cameraUp );
 
-      std::array<vk::ImageMemoryBarrier2, 2> barriers = { depthBarrier, colorBarrier };
-      vk::DependencyInfo                     depInfo{};
-      depInfo.setImageMemoryBarrierCount( barriers.size() ).setPImageMemoryBarriers( barriers.data() );
-      cmd.pipelineBarrier2( depInfo );
+      float     aspect = float( extent.width ) / float( extent.height );
+      glm::mat4 proj   = glm::perspective( glm::radians( 45.0f ), aspect, CameraNear, CameraFar );
+      proj[1][1] *= -1;
+
+      return data::PushConstants{ view, proj, core::InvalidBindlessIndex };
+    }
 
+    // Begins a dynamic rendering pass into colorTarget/depth and sets the dynamic state shared by both render paths.
+    // Both attachments are stored, the occlusion culling builds its depth pyramid from the first pass and
+    // the second pass loads what the first one rendered.
+    inline void beginScenePass( vk::raii::CommandBuffer & cmd,
+                                core::Texture const &     colorTarget,
+                                core::Texture const &     depthResources,
+                                vk::AttachmentLoadOp      loadOp )
+    {
       vk::ClearValue clearValue{};
       clearValue.color = vk::ClearColorValue( std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f } );
 
@@ -66,15 +64,15 @@ namespace pipelines
       vk::RenderingAttachmentInfo colorAttachment{};
       colorAttachment.setImageView( colorTarget.imageView )
         .setImageLayout( vk::ImageLayout::eColorAttachmentOptimal )
-        .setLoadOp( vk::AttachmentLoadOp::eClear )
+        .setLoadOp( loadOp )
         .setStoreOp( vk::AttachmentStoreOp::eStore )
         .setClearValue( clearValue );
 
       vk::RenderingAttachmentInfo depthAttachment{};
       depthAttachment.setImageView( depthResources.imageView )
         .setImageLayout( vk::ImageLayout::eDepthAttachmentOptimal )
-        .setLoadOp( vk::AttachmentLoadOp::eClear )
-        .setStoreOp( vk::AttachmentStoreOp::eDontCare )
+        .setLoadOp( loadOp )
+        .setStoreOp( vk::AttachmentStoreOp::eStore )
         .setClearValue( depthClearValue );
 
       vk::Rect2D renderArea{};
@@ -89,29 +87,11 @@ namespace pipelines
 
       cmd.beginRendering( renderingInfo );
 
-      std::array<vk::ShaderStageFlagBits, 2> stages  = { vk::ShaderStageFlagBits::eVertex, vk::ShaderStageFlagBits::eFragment };
-      std::array<vk::ShaderEXT, 2>           shaders = { *shaderBundle.getCurrentVertexShader(), *shaderBundle.getCurrentFragmentShader() };
-      cmd.bindShadersEXT( stages, shaders );
-
       vk::Viewport viewport{ 0, 0, float( colorTarget.extent.width ), float( colorTarget.extent.height ), 0.0f, 1.0f };
       vk::Rect2D   scissor{ { 0, 0 }, colorTarget.extent };
       cmd.setViewportWithCount( viewport );
       cmd.setScissorWithCount( scissor );
 
-      std::array<vk::VertexInputBindingDescription2EXT, 2> bindingDescs{};
-      bindingDescs[0].setBinding( 0 ).setStride( sizeof( data::Vertex ) ).setInputRate( vk::VertexInputRate::eVertex ).setDivisor( 1 );
-      bindingDescs[1].setBinding( 1 ).setStride( sizeof( data::InstanceData ) ).setInputRate( vk::VertexInputRate::eInstance ).setDivisor( 1 );
-
-      std::array<vk::VertexInputAttributeDescription2EXT, 3> attributeDescs{};
-      attributeDescs[0].setLocation( 0 ).setBinding( 0 ).setFormat( vk::Format::eR32G32Sfloat ).setOffset( offsetof( data::Vertex, position ) );
-      attributeDescs[1].setLocation( 1 ).setBinding( 0 ).setFormat( vk::Format::eR32G32B32Sfloat ).setOffset( offsetof( data::Vertex, color ) );
-      attributeDescs[2].setLocation( 2 ).setBinding( 1 ).setFormat( vk::Format::eR32G32B32Sfloat ).setOffset( offsetof( data::InstanceData, position ) );
-      cmd.setVertexInputEXT( bindingDescs, attributeDescs );
-
-      vk::DeviceSize offset = 0;
-      cmd.bindVertexBuffers( 0, { vertexBuffer }, { offset } );
-      cmd.bindVertexBuffers( 1, { instanceBuffer }, { offset } );
-
       cmd.setRasterizerDiscardEnable( global::state::rasterizerDiscardEnable ? VK_TRUE : VK_FALSE );
       cmd.setCullMode( global::state::cullMode );
       cmd.setFrontFace( global::state::frontFace );
@@ -137,33 +117,203 @@ namespace pipelines
       vk::ColorComponentFlags colorWriteMask =
         vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
       cmd.setColorWriteMaskEXT( 0, colorWriteMask );
-      // Use user-controlled camera position and rotation from global::state
-      glm::vec3 cameraPos = global::state::cameraPosition;
-
-      // Build view direction from rotation (yaw/pitch in radians)
-      float yaw   = global::state::cameraRotation.x;
-      float pitch = global::state::cameraRotation.y;
+    }
 
-      glm::vec3 direction;
-      direction.x = std::cos(pitch) * std::sin(yaw);
-      direction.y = std::sin(pitch);
-      direction.z = std::cos(pitch) * std::cos(yaw);
+    // Scene pass through the vertex stage with the model's buffers bound, `draw` records the draw calls
+    template <typename Draw>
+    inline void recordScenePass( vk::raii::CommandBuffer &   cmd,
+                                 core::raii::ShaderBundle &  shaderBundle,
+                                 core::Texture const &       colorTarget,
+                                 core::Texture const &       depthResources,
+                                 core::Model const &         model,
+                                 core::BindlessHeap const &  bindless,
+                                 data::PushConstants const & pc,
+                                 vk::AttachmentLoadOp        loadOp,
+                                 Draw &&                     draw )
+    {
+      beginScenePass( cmd, colorTarget, depthResources, loadOp );
 
-      glm::vec3 cameraTarget = cameraPos + glm::normalize(direction);
-      glm::vec3 cameraUp     = glm::vec3(0.0f, 1.0f, 0.0f);
+      shaderBundle.bindVertexStages( cmd );
 
-      glm::mat4 view = glm::lookAt(cameraPos, cameraTarget, cameraUp);
+      // Per-instance data is pulled from the bindless heap, only the model itself is a vertex stream
+      model.setVertexInput( cmd );
+      model.bind( cmd );
 
-      float aspect = float(colorTarget.extent.width) / float(colorTarget.extent.height);
-      glm::mat4 proj = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 10000.0f);
-      proj[1][1] *= -1;
+      bindless.bind( cmd, *shaderBundle.pipelineLayout, vk::PipelineBindPoint::eGraphics );
 
-      data::PushConstants pc{ view, proj };
       cmd.pushConstants<data::PushConstants>( *shaderBundle.pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, { pc } );
 
-      cmd.draw( 3, instanceCount, 0, 0 );
+      draw();
 
       cmd.endRendering();
+    }
+
+    inline void recordCommandBufferOffscreen(
+      vk::raii::CommandBuffer &                    cmd,
+      core::raii::ShaderBundle &                   shaderBundle,
+      core::Texture const &                        colorTarget,
+      core::Model const &                          model,
+      core::BindlessHeap &                         bindless,
+      uint32_t                                     instanceBufferIndex,
+      uint32_t                                     instanceCount,
+      core::Texture const &                        depthResources,
+      core::InstanceCuller &                       culler,
+      core::MeshRenderer &                         meshRenderer,
+      core::RenderPath                             renderPath,
+      core::GpuTimer &                             timer,
+      uint32_t                                     frameSlot,
+      std::span<core::SurfaceChunks const * const> surfaces = {} )
+    {
+      cmd.reset();
+      cmd.begin( vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+
+      timer.begin( cmd, frameSlot );
+
+      data::PushConstants pc = cameraPushConstants( colorTarget.extent );
+      pc.instanceBuffer      = instanceBufferIndex;
+      pc.instanceCount       = instanceCount;
+      pc.positionScale       = model.positionScale();
+
+      vk::ImageSubresourceRange subresourceRange{};
+      subresourceRange.setAspectMask( vk::ImageAspectFlagBits::eColor ).setLevelCount( 1 ).setLayerCount( 1 );
+
+      vk::ImageMemoryBarrier2 colorBarrier{};
+      colorBarrier.setSrcStageMask( vk::PipelineStageFlagBits2::eTopOfPipe )
+        .setSrcAccessMask( vk::AccessFlagBits2::eNone )
+        .setDstStageMask( vk::PipelineStageFlagBits2::eColorAttachmentOutput )
+        .setDstAccessMask( vk::AccessFlagBits2::eColorAttachmentWrite )
+        .setOldLayout( vk::ImageLayout::eUndefined )
+        .setNewLayout( vk::ImageLayout::eColorAttachmentOptimal )
+        .setSrcQueueFamilyIndex( VK_QUEUE_FAMILY_IGNORED )
+        .setDstQueueFamilyIndex( VK_QUEUE_FAMILY_IGNORED )
+        .setImage( colorTarget.image )
+        .setSubresourceRange( subresourceRange );
+
+      // Depth is cleared by the first pass, previous contents are discarded
+      vk::ImageSubresourceRange depthSubresourceRange{};
+      depthSubresourceRange.setAspectMask( vk::ImageAspectFlagBits::eDepth ).setLevelCount( 1 ).setLayerCount( 1 );
+
+      vk::ImageMemoryBarrier2 depthBarrier{};
+      depthBarrier.setSrcStageMask( vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests )
+        .setSrcAccessMask( vk::AccessFlagBits2::eDepthStencilAttachmentWrite )
+        .setDstStageMask( vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests )
+        .setDstAccessMask( vk::AccessFlagBits2::eDepthStencilAttachmentWrite )
+        .setOldLayout( vk::ImageLayout::eUndefined )
+        .setNewLayout( vk::ImageLayout::eDepthAttachmentOptimal )
+        .setSrcQueueFamilyIndex( VK_QUEUE_FAMILY_IGNORED )
+        .setDstQueueFamilyIndex( VK_QUEUE_FAMILY_IGNORED )
+        .setImage( depthResources.image )
+        .setSubresourceRange( depthSubresourceRange );
+
+      std::array<vk::ImageMemoryBarrier2, 2> barriers = { depthBarrier, colorBarrier };
+      vk::DependencyInfo                     depInfo{};
+      depInfo.setImageMemoryBarrierCount( barriers.size() ).setPImageMemoryBarriers( barriers.data() );
+      cmd.pipelineBarrier2( depInfo );
+
+      auto scope = [&]( std::string_view name, auto && body )
+      {
+        uint32_t id = timer.beginScope( cmd, name );
+        body();
+        timer.endScope( cmd, id );
+      };
+
+      auto scenePass = [&]( vk::AttachmentLoadOp loadOp, auto && draw )
+      { recordScenePass( cmd, shaderBundle, colorTarget, depthResources, model, bindless, pc, loadOp, draw ); };
+
+      auto cull = [&]( core::CullPhase phase )
+      { culler.cull( cmd, bindless, pc.view, pc.proj, CameraNear, float( colorTarget.extent.height ), instanceBufferIndex, phase ); };
+
+      // Models with more meshlets per instance than a task workgroup may launch take the vertex path
+      if ( renderPath == core::RenderPath::Mesh && meshRenderer.fits( instanceCount, culler.lodEnabled ) )
+      {
+        // Culling and LOD selection happen in the task stage of the draw itself
+        meshRenderer.begin( cmd );
+        scope( "draw mesh",
+               [&]
+               {
+                 beginScenePass( cmd, colorTarget, depthResources, vk::AttachmentLoadOp::eClear );
+                 meshRenderer.draw(
+                   cmd, bindless, pc.view, pc.proj, CameraNear, float( colorTarget.extent.height ), instanceBufferIndex, instanceCount, culler.lodEnabled );
+                 cmd.endRendering();
+               } );
+        meshRenderer.end( cmd, frameSlot );
+      }
+      else
+      {
+        switch ( culler.mode )
+        {
+          case core::CullMode::Off:
+            scope( "draw",
+                   [&]
+                   {
+                     scenePass( vk::AttachmentLoadOp::eClear,
+                                [&] { cmd.drawIndexed( model.lods[0].indexCount, instanceCount, model.lods[0].firstIndex, 0, 0 ); } );
+                   } );
+            break;
+
+          case core::CullMode::Frustum:
+            scope( "cull",
+                   [&]
+                   {
+                     culler.begin( cmd );
+                     cull( core::CullPhase::Frustum );
+                   } );
+            pc.visibleBuffer = culler.listIndex( core::CullPhase::Frustum );
+            scope( "draw", [&] { scenePass( vk::AttachmentLoadOp::eClear, [&] { culler.draw( cmd, core::CullPhase::Frustum ); } ); } );
+            break;
+
+          case core::CullMode::Occlusion:
+            // Early: what was visible last frame, which is most of what is visible now
+            scope( "cull early",
+                   [&]
+                   {
+                     culler.begin( cmd );
+                     cull( core::CullPhase::Early );
+                   } );
+            pc.visibleBuffer = culler.listIndex( core::CullPhase::Early );
+            scope( "draw early", [&] { scenePass( vk::AttachmentLoadOp::eClear, [&] { culler.draw( cmd, core::CullPhase::Early ); } ); } );
+
+            scope( "depth pyramid", [&] { culler.pyramid.build( cmd, bindless, depthResources, global::state::frameCount ); } );
+
+            // Late: everything against the pyramid, draws what became visible on top of the early pass
+            scope( "cull late", [&] { cull( core::CullPhase::Late ); } );
+            {
+              vk::MemoryBarrier2 colorReuse{ vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                                             vk::AccessFlagBits2::eColorAttachmentWrite,
+                                             vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                                             vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite };
+              cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( colorReuse ) );
+            }
+            pc.visibleBuffer = culler.listIndex( core::CullPhase::Late );
+            scope( "draw late", [&] { scenePass( vk::AttachmentLoadOp::eLoad, [&] { culler.draw( cmd, core::CullPhase::Late ); } ); } );
+            break;
+        }
+
+        culler.end( cmd, frameSlot );
+      }
+
+      // Meshed surfaces on top of whatever path drew the instances, depth tested against it
+      if ( std::ranges::any_of( surfaces, []( core::SurfaceChunks const * surface ) { return !surface->empty(); } ) )
+      {
+        vk::MemoryBarrier2 attachmentReuse{
+          vk::PipelineStageFlagBits2::eColorAttachmentOutput | vk::PipelineStageFlagBits2::eLateFragmentTests,
+          vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+          vk::PipelineStageFlagBits2::eColorAttachmentOutput | vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+          vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+            vk::AccessFlagBits2::eDepthStencilAttachmentWrite };
+        cmd.pipelineBarrier2( vk::DependencyInfo{}.setMemoryBarriers( attachmentReuse ) );
+
+        scope( "draw surfaces",
+               [&]
+               {
+                 beginScenePass( cmd, colorTarget, depthResources, vk::AttachmentLoadOp::eLoad );
+                 shaderBundle.bindVertexStages( cmd );
+                 bindless.bind( cmd, *shaderBundle.pipelineLayout, vk::PipelineBindPoint::eGraphics );
+                 for ( core::SurfaceChunks const * surface : surfaces )
+                   surface->draw( cmd, *shaderBundle.pipelineLayout, pc );
+                 cmd.endRendering();
+               } );
+      }
 
       // Transition color target for blit (src)
       colorBarrier.setSrcStageMask( vk::PipelineStageFlagBits2::eColorAttachmentOutput )
@@ -185,7 +335,8 @@ namespace pipelines
       core::SwapchainBundle &    swapchainBundle,
       uint32_t                   imageIndex,
       VkBuffer                   vertexBuffer,
-      VkBuffer                   instanceBuffer,
+      core::BindlessHeap const & bindless,
+      uint32_t                   instanceBufferIndex,
       uint32_t                   instanceCount,
       core::Texture const &      depthResources )
     {
@@ -264,33 +415,29 @@ namespace pipelines
 
       cmd.beginRendering( renderingInfo );
 
-      std::array<vk::ShaderStageFlagBits, 2> stages  = { vk::ShaderStageFlagBits::eVertex, vk::ShaderStageFlagBits::eFragment };
-      std::array<vk::ShaderEXT, 2>           shaders = { *shaderBundle.getCurrentVertexShader(), *shaderBundle.getCurrentFragmentShader() };
-      cmd.bindShadersEXT( stages, shaders );
+      shaderBundle.bindVertexStages( cmd );
 
       vk::Viewport viewport{ 0, 0, float( swapchainBundle.extent.width ), float( swapchainBundle.extent.height ), 0.0f, 1.0f };
       vk::Rect2D   scissor{ { 0, 0 }, swapchainBundle.extent };
       cmd.setViewportWithCount( viewport );
       cmd.setScissorWithCount( scissor );
 
-      // Set up vertex input state - binding 0 for per-vertex data, binding 1 for per-instance data
-      std::array<vk::VertexInputBindingDescription2EXT, 2> bindingDescs{};
+      // Set up vertex input state - binding 0 for per-vertex data, per-instance data comes from the bindless heap
+      std::array<vk::VertexInputBindingDescription2EXT, 1> bindingDescs{};
       bindingDescs[0].setBinding( 0 ).setStride( sizeof( data::Vertex ) ).setInputRate( vk::VertexInputRate::eVertex ).setDivisor( 1 );
-      bindingDescs[1].setBinding( 1 ).setStride( sizeof( data::InstanceData ) ).setInputRate( vk::VertexInputRate::eInstance ).setDivisor( 1 );
 
-      std::array<vk::VertexInputAttributeDescription2EXT, 3> attributeDescs{};
+      std::array<vk::VertexInputAttributeDescription2EXT, 2> attributeDescs{};
       // Per-vertex attributes
-      attributeDescs[0].setLocation( 0 ).setBinding( 0 ).setFormat( vk::Format::eR32G32Sfloat ).setOffset( offsetof( data::Vertex, position ) );
+      attributeDescs[0].setLocation( 0 ).setBinding( 0 ).setFormat( vk::Format::eR32G32B32Sfloat ).setOffset( offsetof( data::Vertex, position ) );
       attributeDescs[1].setLocation( 1 ).setBinding( 0 ).setFormat( vk::Format::eR32G32B32Sfloat ).setOffset( offsetof( data::Vertex, color ) );
-      // Per-instance attribute
-      attributeDescs[2].setLocation( 2 ).setBinding( 1 ).setFormat( vk::Format::eR32G32B32Sfloat ).setOffset( offsetof( data::InstanceData, position ) );
 
       cmd.setVertexInputEXT( bindingDescs, attributeDescs );
 
-      // Bind vertex and instance buffers
+      // Bind vertex buffer and the global descriptor heap
       vk::DeviceSize offset = 0;
       cmd.bindVertexBuffers( 0, { vertexBuffer }, { offset } );
-      cmd.bindVertexBuffers( 1, { instanceBuffer }, { offset } );
+
+      bindless.bind( cmd, *shaderBundle.pipelineLayout, vk::PipelineBindPoint::eGraphics );
 
       cmd.setRasterizerDiscardEnable( global::state::rasterizerDiscardEnable ? VK_TRUE : VK_FALSE );
       cmd.setCullMode( global::state::cullMode );
@@ -332,7 +479,7 @@ namespace pipelines
       glm::mat4 proj   = glm::perspective( glm::radians( 45.0f ), aspect, 0.1f, 10000.0f );
       proj[1][1] *= -1;  // Flip Y for Vulkan
 
-      data::PushConstants pc{ view, proj };
+      data::PushConstants pc{ view, proj, instanceBufferIndex, 0xFFFFFFFFu, instanceCount };
       cmd.pushConstants<data::PushConstants>( *shaderBundle.pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, { pc } );
 
       cmd.draw( 3, instanceCount, 0, 0 );
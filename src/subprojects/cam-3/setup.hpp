@@ -3,6 +3,7 @@
 #include "state.hpp"
 #include "structs.hpp"
 
+#include <array>
 #include <fstream>
 #include <iostream>
 #include <limits>
@@ -384,6 +385,44 @@ namespace core
     texture.extent = vk::Extent2D();
   }
 
+  // Creates a core::Buffer through VMA.
+  // Parameters:
+  //   allocator - VMA allocator for buffer allocation
+  //   size      - size of the buffer in bytes
+  //   usage     - usage flags for buffer creation
+  //   flags     - VMA allocation flags (e.g. mapped / host access for upload buffers)
+  // Returns:
+  //   Populated core::Buffer struct, allocationInfo.pMappedData is set for mapped buffers
+  inline core::Buffer createBuffer( VmaAllocator allocator, vk::DeviceSize size, vk::BufferUsageFlags usage, VmaAllocationCreateFlags flags = 0 )
+  {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size               = size;
+    bufferInfo.usage              = static_cast<VkBufferUsageFlags>( usage );
+    bufferInfo.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage                   = VMA_MEMORY_USAGE_AUTO;
+    allocInfo.flags                   = flags;
+
+    core::Buffer buffer;
+    if ( vmaCreateBuffer( allocator, &bufferInfo, &allocInfo, &buffer.buffer, &buffer.allocation, &buffer.allocationInfo ) != VK_SUCCESS )
+      throw std::runtime_error( "Failed to create buffer with VMA!" );
+    buffer.size  = size;
+    buffer.usage = bufferInfo.usage;
+
+    return buffer;
+  }
+
+  // Destroys the VMA buffer and resets the struct
+  inline void destroyBuffer( VmaAllocator allocator, core::Buffer & buffer )
+  {
+    if ( buffer.buffer && buffer.allocation )
+      vmaDestroyBuffer( allocator, buffer.buffer, buffer.allocation );
+
+    buffer = core::Buffer{};
+  }
+
   namespace raii
   {
 
@@ -462,6 +501,7 @@ namespace core
       {
         VmaAllocatorCreateInfo allocatorInfo = {};
         allocatorInfo.vulkanApiVersion       = VK_API_VERSION_1_4;
+        allocatorInfo.flags                  = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
         allocatorInfo.physicalDevice         = *physicalDevice;
         allocatorInfo.device                 = *device;
         allocatorInfo.instance               = *instance;
@@ -512,11 +552,21 @@ namespace core
       }
     };
 
+    // Task and mesh shader of a ShaderBundle, both empty for bundles that only draw through the vertex stage
+    struct MeshStages
+    {
+      std::string task;
+      std::string mesh;
+    };
+
     struct ShaderBundle
     {
       vk::raii::PipelineLayout         pipelineLayout;
       std::vector<vk::raii::ShaderEXT> vertexShaders;
       std::vector<vk::raii::ShaderEXT> fragmentShaders;
+      vk::raii::ShaderEXT              taskShader = nullptr;
+      vk::raii::ShaderEXT              meshShader = nullptr;
+      vk::ShaderStageFlags             pushConstantStages;
 
       // Current selected shader indices
       int selectedVertexShader   = 0;
@@ -530,22 +580,61 @@ namespace core
         const vk::raii::Device &         device,
         const std::vector<std::string> & vertShaderNames,
         const std::vector<std::string> & fragShaderNames,
-        const vk::PushConstantRange &    pushConstantRange = {} )
-        : pipelineLayout( createPipelineLayout( device, pushConstantRange ) ), vertexShaderNames( vertShaderNames ), fragmentShaderNames( fragShaderNames )
+        const vk::PushConstantRange &              pushConstantRange = {},
+        const std::vector<vk::DescriptorSetLayout> & setLayouts        = {},
+        const MeshStages &                           meshStages        = {} )
+        : pipelineLayout( createPipelineLayout( device, pushConstantRange, setLayouts ) )
+        , pushConstantStages( pushConstantRange.stageFlags )
+        , vertexShaderNames( vertShaderNames )
+        , fragmentShaderNames( fragShaderNames )
       {
         // Create vertex shaders
         for ( const auto & shaderName : vertShaderNames )
         {
-          vertexShaders.emplace_back( createShader( device, shaderName, vk::ShaderStageFlagBits::eVertex, pushConstantRange ) );
+          vertexShaders.emplace_back( createShader( device, shaderName, vk::ShaderStageFlagBits::eVertex, pushConstantRange, setLayouts ) );
         }
 
         // Create fragment shaders
         for ( const auto & shaderName : fragShaderNames )
         {
-          fragmentShaders.emplace_back( createShader( device, shaderName, vk::ShaderStageFlagBits::eFragment, pushConstantRange ) );
+          fragmentShaders.emplace_back( createShader( device, shaderName, vk::ShaderStageFlagBits::eFragment, pushConstantRange, setLayouts ) );
+        }
+
+        // Create task and mesh shaders, requires VK_EXT_mesh_shader
+        if ( !meshStages.mesh.empty() )
+        {
+          taskShader = createShader( device, meshStages.task, vk::ShaderStageFlagBits::eTaskEXT, pushConstantRange, setLayouts );
+          meshShader = createShader( device, meshStages.mesh, vk::ShaderStageFlagBits::eMeshEXT, pushConstantRange, setLayouts );
         }
       }
 
+      // Bind the selected vertex and fragment shader (none when the bundle has no fragment shaders).
+      // While mesh shading is enabled on the device the task and mesh stages are explicitly unbound.
+      void bindVertexStages( vk::raii::CommandBuffer const & cmd )
+      {
+        vk::ShaderEXT fragment = fragmentShaders.empty() ? vk::ShaderEXT{} : *getCurrentFragmentShader();
+
+        std::array<vk::ShaderStageFlagBits, 4> stages  = { vk::ShaderStageFlagBits::eVertex,
+                                                           vk::ShaderStageFlagBits::eFragment,
+                                                           vk::ShaderStageFlagBits::eTaskEXT,
+                                                           vk::ShaderStageFlagBits::eMeshEXT };
+        std::array<vk::ShaderEXT, 4>           shaders = { *getCurrentVertexShader(), fragment, vk::ShaderEXT{}, vk::ShaderEXT{} };
+        uint32_t                               count   = cfg::supported.meshShader ? 4 : 2;
+        cmd.bindShadersEXT( vk::ArrayProxy<const vk::ShaderStageFlagBits>( count, stages.data() ),
+                            vk::ArrayProxy<const vk::ShaderEXT>( count, shaders.data() ) );
+      }
+
+      // Bind the task, mesh and selected fragment shader, the vertex stage is unbound
+      void bindMeshStages( vk::raii::CommandBuffer const & cmd )
+      {
+        std::array<vk::ShaderStageFlagBits, 4> stages  = { vk::ShaderStageFlagBits::eVertex,
+                                                           vk::ShaderStageFlagBits::eTaskEXT,
+                                                           vk::ShaderStageFlagBits::eMeshEXT,
+                                                           vk::ShaderStageFlagBits::eFragment };
+        std::array<vk::ShaderEXT, 4>           shaders = { vk::ShaderEXT{}, *taskShader, *meshShader, *getCurrentFragmentShader() };
+        cmd.bindShadersEXT( stages, shaders );
+      }
+
       // Get currently selected vertex shader
       vk::raii::ShaderEXT & getCurrentVertexShader()
       {
@@ -588,18 +677,24 @@ namespace core
       }
 
     private:
-      vk::raii::PipelineLayout createPipelineLayout( const vk::raii::Device & device, const vk::PushConstantRange & pushConstantRange )
+      vk::raii::PipelineLayout createPipelineLayout(
+        const vk::raii::Device & device, const vk::PushConstantRange & pushConstantRange, const std::vector<vk::DescriptorSetLayout> & setLayouts )
       {
         vk::PipelineLayoutCreateInfo layoutInfo{};
         if ( pushConstantRange.size > 0 )
         {
           layoutInfo.setPushConstantRangeCount( 1 ).setPPushConstantRanges( &pushConstantRange );
         }
+        layoutInfo.setSetLayouts( setLayouts );
         return vk::raii::PipelineLayout( device, layoutInfo );
       }
 
       vk::raii::ShaderEXT createShader(
-        const vk::raii::Device & device, const std::string & shaderName, vk::ShaderStageFlagBits stage, const vk::PushConstantRange & pushConstantRange )
+        const vk::raii::Device &                     device,
+        const std::string &                          shaderName,
+        vk::ShaderStageFlagBits                      stage,
+        const vk::PushConstantRange &                pushConstantRange,
+        const std::vector<vk::DescriptorSetLayout> & setLayouts )
       {
         std::vector<uint32_t> shaderCode = core::help::getShaderCode( shaderName );
 
@@ -614,12 +709,17 @@ namespace core
         {
           shaderInfo.setPushConstantRangeCount( 1 ).setPPushConstantRanges( &pushConstantRange );
         }
+        shaderInfo.setSetLayouts( setLayouts );
 
-        // Set next stage for vertex shaders
-        if ( stage == vk::ShaderStageFlagBits::eVertex )
+        // Set next stage for vertex, task and mesh shaders
+        if ( stage == vk::ShaderStageFlagBits::eVertex || stage == vk::ShaderStageFlagBits::eMeshEXT )
         {
           shaderInfo.setNextStage( vk::ShaderStageFlagBits::eFragment );
         }
+        else if ( stage == vk::ShaderStageFlagBits::eTaskEXT )
+        {
+          shaderInfo.setNextStage( vk::ShaderStageFlagBits::eMeshEXT );
+        }
 
         return vk::raii::ShaderEXT( device, shaderInfo );
       }
@@ -735,7 +835,12 @@ namespace core
     // Recreate depth and offscreen color targets
     core::destroyTexture( device, allocator, depthTexture );
     depthTexture = core::createTexture(
-      device, allocator, screenSize, vk::Format::eD32Sfloat, vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::ImageAspectFlagBits::eDepth );
+      device,
+      allocator,
+      screenSize,
+      vk::Format::eD32Sfloat,
+      vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled,
+      vk::ImageAspectFlagBits::eDepth );
 
     core::destroyTexture( device, allocator, basicTargetTexture );
     basicTargetTexture = core::createTexture(
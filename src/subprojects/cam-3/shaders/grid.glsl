@@ -0,0 +1,41 @@
+// Hashed uniform grid of core::SpatialGrid, built by grid.comp. Requires GL_EXT_nonuniform_qualifier.
+//
+//   cells   uint[tableSize + 1], per bucket the exclusive prefix sum of the sphere counts, the total at the end
+//   sorted  uint[count], sphere indices ordered by bucket
+//
+// Buckets are cells hashed into a power of two table, so unrelated cells can share one. Consumers test the
+// actual distance anyway, and gridVisitOnce() keeps a bucket that several neighbor cells map to from being
+// visited twice.
+
+// All alias the storage buffer array of the bindless heap
+layout(set = 0, binding = 3) buffer GridWordBuffer {
+    uint words[];
+} gridBuffers[];
+
+ivec3 gridCell(vec3 position, float cellSize) {
+    return ivec3(floor(position / cellSize));
+}
+
+// Teschner et al. 2003, the primes spread neighboring cells over the table
+uint gridHash(ivec3 cell, uint tableMask) {
+    return (uint(cell.x) * 73856093u ^ uint(cell.y) * 19349663u ^ uint(cell.z) * 83492791u) & tableMask;
+}
+
+// First entry of `bucket` in the sorted indices, bucket tableSize gives the sphere count
+uint gridBucketStart(uint cellBuffer, uint bucket) {
+    return gridBuffers[cellBuffer].words[bucket];
+}
+
+// Buckets of the 27 cells around a sphere, each reported once
+struct GridVisit {
+    uint buckets[27];
+    uint count;
+};
+
+bool gridVisitOnce(inout GridVisit visit, uint bucket) {
+    for (uint i = 0; i < visit.count; ++i)
+        if (visit.buckets[i] == bucket)
+            return false;
+    visit.buckets[visit.count++] = bucket;
+    return true;
+}
@@ -0,0 +1,164 @@
+// Instance buffer formats, mirrors data::InstanceFormat and core/instanceformat.hpp.
+// Requires GL_EXT_nonuniform_qualifier and GL_EXT_scalar_block_layout. Buffers are declared readonly unless
+// INSTANCE_WRITABLE is defined before the include.
+//
+//   Float      Instance per element, 48 bytes
+//   Packed     uvec4 per element: positionXY, positionZ | chunk, rotation, colorScale
+//   PackedSoA  the same words in three streams: uvec2 positions[count], uint rotations[count], uint colorScales[count]
+
+#define INSTANCE_FORMAT_FLOAT      0
+#define INSTANCE_FORMAT_PACKED     1
+#define INSTANCE_FORMAT_PACKED_SOA 2
+
+#ifndef INSTANCE_FORMAT
+#define INSTANCE_FORMAT INSTANCE_FORMAT_FLOAT
+#endif
+
+#ifdef INSTANCE_WRITABLE
+#define INSTANCE_ACCESS
+#else
+#define INSTANCE_ACCESS readonly
+#endif
+
+const float InstanceChunkSize = 128.0;  // data::instanceChunkSize
+const float InstanceMaxScale  = 4.0;    // data::instanceMaxScale
+
+struct Instance {
+    vec3  position;
+    float scale;
+    vec4  rotation;  // quaternion xyzw
+    vec4  color;
+};
+
+// All alias the storage buffer array of the bindless heap
+layout(set = 0, binding = 3, scalar) INSTANCE_ACCESS buffer InstanceFloatBuffer {
+    Instance instances[];
+} instanceFloatBuffers[];
+
+layout(set = 0, binding = 3) INSTANCE_ACCESS buffer InstancePackedBuffer {
+    uvec4 instances[];
+} instancePackedBuffers[];
+
+layout(set = 0, binding = 3) INSTANCE_ACCESS buffer InstancePositionBuffer {
+    uvec2 positions[];
+} instancePositionBuffers[];
+
+layout(set = 0, binding = 3) INSTANCE_ACCESS buffer InstanceWordBuffer {
+    uint words[];
+} instanceWordBuffers[];
+
+vec2 octahedralEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 p = n.xy;
+    if (n.z < 0.0)
+        p = (1.0 - abs(p.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+    return p;
+}
+
+vec3 octahedralDecode(vec2 p) {
+    vec3  n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+vec3 unpackInstancePosition(uvec2 words) {
+    vec3  local = vec3(unpackUnorm2x16(words.x), unpackUnorm2x16(words.y).x);
+    int   chunk = int(words.y >> 16);
+    ivec3 coord = ivec3(bitfieldExtract(chunk, 0, 5), bitfieldExtract(chunk, 5, 5), bitfieldExtract(chunk, 10, 5));
+    return (vec3(coord) + local) * InstanceChunkSize;
+}
+
+vec4 unpackInstanceRotation(uint word) {
+    int   bits  = int(word);
+    vec2  oct   = vec2(bitfieldExtract(bits, 0, 10), bitfieldExtract(bits, 10, 10)) / 511.0;
+    float angle = float(word >> 20) / 4095.0 * 3.14159265359;  // [0, pi], the axis carries the direction
+    return vec4(octahedralDecode(oct) * sin(angle * 0.5), cos(angle * 0.5));
+}
+
+Instance unpackInstance(uvec4 words) {
+    vec4 colorScale = unpackUnorm4x8(words.w);
+    return Instance(unpackInstancePosition(words.xy), colorScale.w * InstanceMaxScale, unpackInstanceRotation(words.z), vec4(colorScale.rgb, 1.0));
+}
+
+// Every format, for code that compares them. `count` is the instance count of the buffer.
+Instance loadInstanceAs(uint format, uint heapIndex, uint index, uint count) {
+    if (format == INSTANCE_FORMAT_FLOAT)
+        return instanceFloatBuffers[heapIndex].instances[index];
+    if (format == INSTANCE_FORMAT_PACKED)
+        return unpackInstance(instancePackedBuffers[heapIndex].instances[index]);
+
+    uvec2 position = instancePositionBuffers[heapIndex].positions[index];
+    return unpackInstance(uvec4(position, instanceWordBuffers[heapIndex].words[2 * count + index], instanceWordBuffers[heapIndex].words[3 * count + index]));
+}
+
+// Position and scale only, PackedSoA does not touch the rotation stream
+vec4 loadInstanceBoundsAs(uint format, uint heapIndex, uint index, uint count) {
+    if (format == INSTANCE_FORMAT_FLOAT) {
+        Instance instance = instanceFloatBuffers[heapIndex].instances[index];
+        return vec4(instance.position, instance.scale);
+    }
+    if (format == INSTANCE_FORMAT_PACKED) {
+        uvec4 words = instancePackedBuffers[heapIndex].instances[index];
+        return vec4(unpackInstancePosition(words.xy), unpackUnorm4x8(words.w).w * InstanceMaxScale);
+    }
+
+    vec3  position = unpackInstancePosition(instancePositionBuffers[heapIndex].positions[index]);
+    float scale    = unpackUnorm4x8(instanceWordBuffers[heapIndex].words[3 * count + index]).w * InstanceMaxScale;
+    return vec4(position, scale);
+}
+
+// The compile time format of the subproject, the branches fold away
+Instance loadInstance(uint heapIndex, uint index, uint count) {
+    return loadInstanceAs(INSTANCE_FORMAT, heapIndex, index, count);
+}
+
+vec4 loadInstanceBounds(uint heapIndex, uint index, uint count) {
+    return loadInstanceBoundsAs(INSTANCE_FORMAT, heapIndex, index, count);
+}
+
+vec3 rotateByQuaternion(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+#ifdef INSTANCE_WRITABLE
+uvec2 packInstancePosition(vec3 position) {
+    vec3  scaled = position / InstanceChunkSize;
+    ivec3 coord  = clamp(ivec3(floor(scaled)), ivec3(-16), ivec3(15));
+    vec3  local  = clamp(scaled - vec3(coord), 0.0, 1.0);
+    uint  chunk  = uint(coord.x & 31) | (uint(coord.y & 31) << 5) | (uint(coord.z & 31) << 10);
+    return uvec2(packUnorm2x16(local.xy), packUnorm2x16(vec2(local.z, 0.0)) | (chunk << 16));
+}
+
+uint packInstanceRotation(vec4 q) {
+    q           = q.w < 0.0 ? -q : q;  // angle in [0, pi]
+    float s     = length(q.xyz);
+    vec3  axis  = s > 1e-6 ? q.xyz / s : vec3(0.0, 0.0, 1.0);
+    float angle = 2.0 * atan(s, q.w);
+    ivec2 oct   = ivec2(round(clamp(octahedralEncode(axis), -1.0, 1.0) * 511.0));
+    uint  a     = min(uint(round(angle / 3.14159265359 * 4095.0)), 4095u);
+    return uint(oct.x & 1023) | (uint(oct.y & 1023) << 10) | (a << 20);
+}
+
+uvec4 packInstance(Instance instance) {
+    uint colorScale = packUnorm4x8(vec4(instance.color.rgb, instance.scale / InstanceMaxScale));
+    return uvec4(packInstancePosition(instance.position), packInstanceRotation(instance.rotation), colorScale);
+}
+
+void storeInstanceAs(uint format, uint heapIndex, uint index, uint count, Instance instance) {
+    if (format == INSTANCE_FORMAT_FLOAT) {
+        instanceFloatBuffers[heapIndex].instances[index] = instance;
+        return;
+    }
+
+    uvec4 words = packInstance(instance);
+    if (format == INSTANCE_FORMAT_PACKED) {
+        instancePackedBuffers[heapIndex].instances[index] = words;
+        return;
+    }
+
+    instancePositionBuffers[heapIndex].positions[index]    = words.xy;
+    instanceWordBuffers[heapIndex].words[2 * count + index] = words.z;
+    instanceWordBuffers[heapIndex].words[3 * count + index] = words.w;
+}
+#endif
@@ -0,0 +1,32 @@
+#version 460
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "instance.glsl"
+
+// One point per instance with rasterization discarded: the cost is the instance fetch and decode of the
+// vertex shader. The format comes from the push constants so one shader covers all of them, the branch on
+// it is uniform across the draw.
+layout(push_constant) uniform PushConstants {
+    mat4 viewProj;
+    uint instanceBuffer;
+    uint instanceCount;
+    uint format;
+    uint resultBuffer;
+} pc;
+
+layout(set = 0, binding = 3) writeonly buffer ResultBuffer {
+    vec4 value;
+} resultBuffers[];
+
+void main() {
+    Instance instance = loadInstanceAs(pc.format, pc.instanceBuffer, gl_InstanceIndex, pc.instanceCount);
+
+    vec3 worldPos = rotateByQuaternion(instance.rotation, vec3(instance.scale)) + instance.position;
+    gl_Position   = pc.viewProj * vec4(worldPos, 1.0);
+
+    // Never true, keeps the fetch and decode from being removed while nothing is rasterized
+    if (gl_Position.w == -1.0 && instance.color.a == -1.0)
+        resultBuffers[pc.resultBuffer].value = gl_Position * instance.color;
+}
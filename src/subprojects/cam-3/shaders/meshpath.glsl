@@ -0,0 +1,45 @@
+// Shared by instances.task and instances.mesh, mirrors data::MeshPushConstants and core::MeshRenderer
+
+const uint TaskGroupSize       = 64;   // invocations per task workgroup, pc.taskInstances of them take an instance
+const uint MeshletMaxVertices  = 64;   // core::MeshletMaxVertices
+const uint MeshletMaxTriangles = 124;  // core::MeshletMaxTriangles
+const uint MaxLods             = 4;
+const uint QuantizedVertexBit  = 0x80000000u;  // data::QuantizedVertexBit in pc.vertexBuffer
+
+layout(push_constant) uniform PushConstants {
+    mat4  viewProj;
+    vec4  planes[6];
+    vec3  cameraPosition;
+    float radius;
+    vec4  lodScreenSizes;
+    uvec4 lodFirstMeshlet;
+    uvec4 lodMeshlets;
+    uint  instanceBuffer;
+    uint  instanceCount;
+    uint  vertexBuffer;
+    uint  meshletBuffer;
+    float sizeScale;
+    float znear;
+    uint  taskInstances;
+    uint  statsBuffer;
+} pc;
+
+// Visible instances of one task workgroup, slot i launches the meshlets
+// [firstMeshlet[i], firstMeshlet[i] + meshlets of its LOD)
+struct TaskPayload {
+    uint count;
+    uint instances[TaskGroupSize];
+    uint lods[TaskGroupSize];
+    uint firstMeshlet[TaskGroupSize];
+};
+
+// core::MeshRenderer::StatsSize
+layout(set = 0, binding = 3) buffer StatsBuffer {
+    uint lodInstances[MaxLods];
+    uint meshlets;
+    uint coneCulled;
+} statsBuffers[];
+
+uint meshletCount(uint lod) {
+    return pc.lodMeshlets[lod];
+}
@@ -0,0 +1,199 @@
+// LSD radix sort of core::RadixSort, included by radixsort.comp (portable) and radixsort_subgroup.comp, which
+// defines SCAN_SUBGROUPS for the workgroup scan of scan.glsl on subgroup arithmetic. Requires
+// GL_EXT_nonuniform_qualifier.
+//
+//   PassHistogram  per tile: the digit counts of every digit pass at once, added to the global histograms
+//   PassScatter    per tile and digit pass, onesweep (Adinets and Merrill 2022): the tile takes the next partition
+//                  from an atomic counter, ranks its keys by digit and finds the keys of each digit in earlier
+//                  partitions by decoupled lookback (Merrill and Garland 2016), then scatters them
+//
+// The state buffer is cleared with a buffer fill before PassHistogram:
+//
+//   counters    uint[MaxPasses], next partition of every digit pass
+//   histograms  uint[MaxPasses][Digits], keys per digit of every digit pass
+//   status      uint[passCount][partitions][Digits], flag in the top two bits, the count below
+//
+// Lookback spins on partitions that took their index earlier, so they have started and can finish.
+layout(local_size_x = 128) in;
+
+const uint GroupSize      = 128;
+const uint ItemsPerThread = 8;
+const uint TileSize       = GroupSize * ItemsPerThread;
+const uint DigitBits      = 4;
+const uint Digits         = 1u << DigitBits;
+const uint MaxPasses      = 32 / DigitBits;
+const uint PerInvocation  = Digits;  // digit counts per invocation in the scan
+
+const uint PassHistogram = 0;
+const uint PassScatter   = 1;
+
+const uint StatusAggregate = 1u << 30;  // count of this partition only
+const uint StatusPrefix    = 2u << 30;  // count of this and every earlier partition
+const uint StatusValue     = StatusAggregate - 1;
+
+const uint StateCounters   = 0;
+const uint StateHistograms = MaxPasses;
+const uint StateStatus     = MaxPasses + MaxPasses * Digits;
+
+layout(push_constant) uniform PushConstants {
+    uint keyBuffer;
+    uint valueBuffer;  // ~0u sorts keys only
+    uint keyOutBuffer;
+    uint valueOutBuffer;
+    uint stateBuffer;
+    uint count;
+    uint partitions;
+    uint passCount;
+    uint digitPass;
+    uint pass;
+} pc;
+
+// Aliases the storage buffer array of the bindless heap
+layout(set = 0, binding = 3) buffer RadixWordBuffer {
+    uint words[];
+} radixBuffers[];
+
+shared uint histogram[MaxPasses * Digits];
+shared uint digitCounts[Digits * GroupSize];  // [digit][invocation], reused for the values of the reordered tile
+shared uint tileKeys[TileSize];
+shared uint digitBase[Digits];
+shared uint partitionIndex;
+
+#include "scan.glsl"
+
+uint digitOf(uint key) {
+    return (key >> (pc.digitPass * DigitBits)) & (Digits - 1);
+}
+
+void histogramPass() {
+    uint t       = gl_LocalInvocationID.x;
+    histogram[t] = 0;  // GroupSize == MaxPasses * Digits
+    barrier();
+
+    uint base = gl_WorkGroupID.x * TileSize;
+    for (uint i = 0; i < ItemsPerThread; ++i) {
+        uint index = base + i * GroupSize + t;
+        if (index >= pc.count)
+            break;
+        uint key = radixBuffers[pc.keyBuffer].words[index];
+        for (uint p = 0; p < pc.passCount; ++p)
+            atomicAdd(histogram[p * Digits + ((key >> (p * DigitBits)) & (Digits - 1))], 1u);
+    }
+    barrier();
+
+    if (t < pc.passCount * Digits && histogram[t] > 0)
+        atomicAdd(radixBuffers[pc.stateBuffer].words[StateHistograms + t], histogram[t]);
+}
+
+// Keys of `digit` in the partitions before this one. Publishes this partition's count first, so that later
+// partitions can go on while this one looks back, then the inclusive prefix.
+uint lookback(uint partition, uint digit, uint tileCount) {
+    uint status = StateStatus + pc.digitPass * pc.partitions * Digits + digit;
+    uint self   = status + partition * Digits;
+    if (partition == 0) {
+        atomicExchange(radixBuffers[pc.stateBuffer].words[self], StatusPrefix | tileCount);
+        return 0;
+    }
+    atomicExchange(radixBuffers[pc.stateBuffer].words[self], StatusAggregate | tileCount);
+
+    uint exclusive = 0;
+    for (uint j = partition; j-- > 0;) {
+        uint value;
+        do {
+            value = atomicAdd(radixBuffers[pc.stateBuffer].words[status + j * Digits], 0u);
+        } while ((value & ~StatusValue) == 0);
+
+        exclusive += value & StatusValue;
+        if ((value & StatusPrefix) != 0)
+            break;
+    }
+    atomicExchange(radixBuffers[pc.stateBuffer].words[self], StatusPrefix | (exclusive + tileCount));
+    return exclusive;
+}
+
+void scatterPass() {
+    uint t = gl_LocalInvocationID.x;
+    if (t == 0)
+        partitionIndex = atomicAdd(radixBuffers[pc.stateBuffer].words[StateCounters + pc.digitPass], 1u);
+    for (uint d = 0; d < Digits; ++d)
+        digitCounts[d * GroupSize + t] = 0;
+    barrier();
+
+    // Every invocation ranks a run of consecutive keys, which keeps equal keys in input order
+    uint partition = partitionIndex;
+    uint base      = partition * TileSize;
+    bool values    = pc.valueBuffer != 0xFFFFFFFFu;
+    uint keys[ItemsPerThread];
+    uint items[ItemsPerThread];
+    uint ranks[ItemsPerThread];
+    for (uint i = 0; i < ItemsPerThread; ++i) {
+        uint index = base + t * ItemsPerThread + i;
+        ranks[i]   = 0xFFFFFFFFu;
+        if (index >= pc.count)
+            continue;
+        keys[i] = radixBuffers[pc.keyBuffer].words[index];
+        if (values)
+            items[i] = radixBuffers[pc.valueBuffer].words[index];
+        ranks[i] = digitCounts[digitOf(keys[i]) * GroupSize + t]++;
+    }
+    barrier();
+
+    // Digit-major exclusive scan of the counts: keys of smaller digits, then of the same digit in earlier invocations
+    uint counts[PerInvocation];
+    uint sum = 0;
+    for (uint i = 0; i < PerInvocation; ++i) {
+        counts[i] = digitCounts[t * PerInvocation + i];
+        sum += counts[i];
+    }
+    uint total;
+    uint offset = scanWorkgroup(sum, total);
+    for (uint i = 0; i < PerInvocation; ++i) {
+        digitCounts[t * PerInvocation + i] = offset;
+        offset += counts[i];
+    }
+    barrier();
+
+    if (t < Digits) {
+        uint start     = digitCounts[t * GroupSize];
+        uint end       = t + 1 < Digits ? digitCounts[(t + 1) * GroupSize] : total;
+        uint exclusive = lookback(partition, t, end - start);
+
+        uint first = 0;  // of the digit in the output, the keys of all smaller digits
+        for (uint d = 0; d < t; ++d)
+            first += radixBuffers[pc.stateBuffer].words[StateHistograms + pc.digitPass * Digits + d];
+        digitBase[t] = first + exclusive - start;
+    }
+
+    uint positions[ItemsPerThread];
+    for (uint i = 0; i < ItemsPerThread; ++i)
+        if (ranks[i] != 0xFFFFFFFFu)
+            positions[i] = digitCounts[digitOf(keys[i]) * GroupSize + t] + ranks[i];
+    barrier();
+
+    // Reorder the tile by digit in shared memory, consecutive invocations then write consecutive addresses
+    for (uint i = 0; i < ItemsPerThread; ++i)
+        if (ranks[i] != 0xFFFFFFFFu) {
+            tileKeys[positions[i]] = keys[i];
+            if (values)
+                digitCounts[positions[i]] = items[i];
+        }
+    barrier();
+
+    for (uint i = 0; i < ItemsPerThread; ++i) {
+        uint slot = i * GroupSize + t;
+        if (slot >= total)
+            break;
+        uint key    = tileKeys[slot];
+        uint target = digitBase[digitOf(key)] + slot;
+        radixBuffers[pc.keyOutBuffer].words[target] = key;
+        if (values)
+            radixBuffers[pc.valueOutBuffer].words[target] = digitCounts[slot];
+    }
+}
+
+void main() {
+    if (pc.pass == PassHistogram)
+        histogramPass();
+    else
+        scatterPass();
+}
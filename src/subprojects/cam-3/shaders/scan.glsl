@@ -0,0 +1,76 @@
+// Exclusive scan of one value per invocation over the workgroup, shared by core::Scan (scanpasses.glsl) and
+// core::RadixSort (radixsort.glsl). The includer declares GroupSize, its workgroup size, as a constant or a
+// specialization constant. With SCAN_SUBGROUPS defined the scan is built on subgroup arithmetic, which needs
+// GL_KHR_shader_subgroup_basic and GL_KHR_shader_subgroup_arithmetic, otherwise it runs in shared memory only.
+//
+// The operator is addition unless the includer defines SCAN_CUSTOM_OP together with scanIdentity() and
+// scanCombine(a, b), and with SCAN_SUBGROUPS also scanSubgroupExclusive(value) and scanSubgroupTotal(value).
+
+shared uint scanPartial[GroupSize];
+shared uint scanTotal;
+
+#ifndef SCAN_CUSTOM_OP
+uint scanIdentity() {
+    return 0u;
+}
+
+uint scanCombine(uint a, uint b) {
+    return a + b;
+}
+
+#ifdef SCAN_SUBGROUPS
+uint scanSubgroupExclusive(uint value) {
+    return subgroupExclusiveAdd(value);
+}
+
+uint scanSubgroupTotal(uint value) {
+    return subgroupAdd(value);
+}
+#endif
+#endif
+
+#ifdef SCAN_SUBGROUPS
+// Within subgroups, then the first subgroup scans the subgroup totals
+uint scanWorkgroup(uint value, out uint total) {
+    uint prefix = scanSubgroupExclusive(value);
+    uint sum    = scanSubgroupTotal(value);
+    if (subgroupElect())
+        scanPartial[gl_SubgroupID] = sum;
+    barrier();
+    if (gl_SubgroupID == 0) {
+        uint running = scanIdentity();
+        for (uint first = 0; first < gl_NumSubgroups; first += gl_SubgroupSize) {
+            uint s      = first + gl_SubgroupInvocationID;
+            uint add    = s < gl_NumSubgroups ? scanPartial[s] : scanIdentity();
+            uint before = scanCombine(running, scanSubgroupExclusive(add));
+            running     = scanCombine(running, scanSubgroupTotal(add));
+            if (s < gl_NumSubgroups)
+                scanPartial[s] = before;
+        }
+        if (subgroupElect())
+            scanTotal = running;
+    }
+    barrier();
+    total          = scanTotal;
+    uint exclusive = scanCombine(scanPartial[gl_SubgroupID], prefix);
+    barrier();
+    return exclusive;
+}
+#else
+// Hillis and Steele
+uint scanWorkgroup(uint value, out uint total) {
+    uint t         = gl_LocalInvocationID.x;
+    scanPartial[t] = value;
+    barrier();
+    for (uint offset = 1; offset < GroupSize; offset <<= 1) {
+        uint add = t >= offset ? scanPartial[t - offset] : scanIdentity();
+        barrier();
+        scanPartial[t] = scanCombine(add, scanPartial[t]);
+        barrier();
+    }
+    total          = scanPartial[GroupSize - 1];
+    uint exclusive = t > 0 ? scanPartial[t - 1] : scanIdentity();
+    barrier();
+    return exclusive;
+}
+#endif
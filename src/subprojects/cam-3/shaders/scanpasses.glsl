@@ -0,0 +1,220 @@
+// Scan, reduction and stream compaction of core::Scan, included by scan.comp (portable) and scan_subgroup.comp,
+// which defines SCAN_SUBGROUPS for the workgroup scan of scan.glsl on subgroup arithmetic. Requires
+// GL_EXT_nonuniform_qualifier. The workgroup size and the items per invocation are specialization constants.
+//
+//   PassScan     inclusive or exclusive scan of uints with add, min or max, input and output may be the same
+//   PassReduce   the whole input combined into word 0 of the result, which holds the identity beforehand
+//   PassCompact  elements whose flag is set, in input order, the kept count into word 0 of the result
+//
+// Scan and compaction are single pass: every tile takes the next partition from an atomic counter and finds what
+// the partitions before it add by decoupled lookback (Merrill and Garland 2016). The status buffer is cleared with
+// a buffer fill before each of them:
+//
+//   counter     uint, next partition
+//   partitions  uint[partitions][3]: flag, aggregate of the tile, inclusive prefix up to the tile
+//
+// Lookback spins on partitions that took their index earlier, so they have started and can finish.
+layout(local_size_x_id = 0) in;
+layout(constant_id = 0) const uint GroupSize      = 256;
+layout(constant_id = 1) const uint ItemsPerThread = 8;
+
+const uint PassScan    = 0;
+const uint PassReduce  = 1;
+const uint PassCompact = 2;
+
+const uint OpAdd = 0;
+const uint OpMin = 1;
+const uint OpMax = 2;
+
+const uint StatusAggregate = 1;
+const uint StatusPrefix    = 2;
+
+layout(push_constant) uniform PushConstants {
+    uint inputBuffer;   // ~0u for compaction writes the indices of the kept elements
+    uint outputBuffer;
+    uint flagBuffer;    // compaction keeps elements with a nonzero flag, ~0u tests the input values
+    uint statusBuffer;
+    uint resultBuffer;  // reduction and compaction
+    uint count;
+    uint pass;
+    uint op;
+    uint exclusive;
+} pc;
+
+// All alias the storage buffer array of the bindless heap
+layout(set = 0, binding = 3) buffer ScanWordBuffer {
+    uint words[];
+} scanBuffers[];
+
+// Written and read by different workgroups while they run
+layout(set = 0, binding = 3) coherent buffer ScanStatusBuffer {
+    uint words[];
+} scanStatus[];
+
+shared uint tilePrefix;
+shared uint partitionIndex;
+
+// The operator of the pass for scan.glsl
+#define SCAN_CUSTOM_OP
+
+uint scanIdentity() {
+    return pc.op == OpMin ? 0xFFFFFFFFu : 0u;
+}
+
+uint scanCombine(uint a, uint b) {
+    if (pc.op == OpMin)
+        return min(a, b);
+    if (pc.op == OpMax)
+        return max(a, b);
+    return a + b;
+}
+
+#ifdef SCAN_SUBGROUPS
+uint scanSubgroupExclusive(uint value) {
+    if (pc.op == OpMin)
+        return subgroupExclusiveMin(value);
+    if (pc.op == OpMax)
+        return subgroupExclusiveMax(value);
+    return subgroupExclusiveAdd(value);
+}
+
+uint scanSubgroupTotal(uint value) {
+    if (pc.op == OpMin)
+        return subgroupMin(value);
+    if (pc.op == OpMax)
+        return subgroupMax(value);
+    return subgroupAdd(value);
+}
+#endif
+
+#include "scan.glsl"
+
+// Combination of the partitions before this one. Publishes the tile's aggregate first, so that later partitions
+// can go on while this one looks back, then the inclusive prefix.
+uint lookback(uint partition, uint aggregate) {
+    uint self = 1 + partition * 3;
+    if (partition == 0) {
+        scanStatus[pc.statusBuffer].words[self + 2] = aggregate;
+        memoryBarrierBuffer();
+        atomicExchange(scanStatus[pc.statusBuffer].words[self], StatusPrefix);
+        return scanIdentity();
+    }
+    scanStatus[pc.statusBuffer].words[self + 1] = aggregate;
+    memoryBarrierBuffer();
+    atomicExchange(scanStatus[pc.statusBuffer].words[self], StatusAggregate);
+
+    uint exclusive = scanIdentity();
+    for (uint j = partition; j-- > 0;) {
+        uint other = 1 + j * 3;
+        uint flag;
+        do {
+            flag = atomicAdd(scanStatus[pc.statusBuffer].words[other], 0u);
+        } while (flag == 0);
+        memoryBarrierBuffer();
+
+        if (flag == StatusPrefix) {
+            exclusive = scanCombine(scanStatus[pc.statusBuffer].words[other + 2], exclusive);
+            break;
+        }
+        exclusive = scanCombine(scanStatus[pc.statusBuffer].words[other + 1], exclusive);
+    }
+    scanStatus[pc.statusBuffer].words[self + 2] = scanCombine(exclusive, aggregate);
+    memoryBarrierBuffer();
+    atomicExchange(scanStatus[pc.statusBuffer].words[self], StatusPrefix);
+    return exclusive;
+}
+
+// What the tiles before this one combine to, shared with the whole workgroup
+uint tileExclusive(uint partition, uint aggregate) {
+    if (gl_LocalInvocationID.x == 0)
+        tilePrefix = lookback(partition, aggregate);
+    barrier();
+    return tilePrefix;
+}
+
+uint takePartition() {
+    if (gl_LocalInvocationID.x == 0)
+        partitionIndex = atomicAdd(scanStatus[pc.statusBuffer].words[0], 1u);
+    barrier();
+    return partitionIndex;
+}
+
+bool kept(uint index) {
+    if (index >= pc.count)
+        return false;
+    uint flagBuffer = pc.flagBuffer != 0xFFFFFFFFu ? pc.flagBuffer : pc.inputBuffer;
+    return scanBuffers[flagBuffer].words[index] != 0;
+}
+
+void scanPass() {
+    uint partition = takePartition();
+
+    // Every invocation scans a run of consecutive elements
+    uint base = (partition * GroupSize + gl_LocalInvocationID.x) * ItemsPerThread;
+    uint items[ItemsPerThread];
+    uint sum = scanIdentity();
+    for (uint i = 0; i < ItemsPerThread; ++i) {
+        uint index = base + i;
+        items[i]   = index < pc.count ? scanBuffers[pc.inputBuffer].words[index] : scanIdentity();
+        sum        = scanCombine(sum, items[i]);
+    }
+
+    uint total;
+    uint running = scanWorkgroup(sum, total);
+    running      = scanCombine(tileExclusive(partition, total), running);
+
+    for (uint i = 0; i < ItemsPerThread && base + i < pc.count; ++i) {
+        uint inclusive = scanCombine(running, items[i]);
+        scanBuffers[pc.outputBuffer].words[base + i] = pc.exclusive != 0 ? running : inclusive;
+        running = inclusive;
+    }
+}
+
+void reducePass() {
+    uint base = (gl_WorkGroupID.x * GroupSize + gl_LocalInvocationID.x) * ItemsPerThread;
+    uint sum  = scanIdentity();
+    for (uint i = 0; i < ItemsPerThread && base + i < pc.count; ++i)
+        sum = scanCombine(sum, scanBuffers[pc.inputBuffer].words[base + i]);
+
+    uint total;
+    scanWorkgroup(sum, total);
+    if (gl_LocalInvocationID.x != 0)
+        return;
+    if (pc.op == OpMin)
+        atomicMin(scanBuffers[pc.resultBuffer].words[0], total);
+    else if (pc.op == OpMax)
+        atomicMax(scanBuffers[pc.resultBuffer].words[0], total);
+    else
+        atomicAdd(scanBuffers[pc.resultBuffer].words[0], total);
+}
+
+void compactPass() {
+    uint partition = takePartition();
+
+    uint base  = (partition * GroupSize + gl_LocalInvocationID.x) * ItemsPerThread;
+    uint flags = 0;  // bit i keeps element base + i, core::Scan limits ItemsPerThread to 32
+    for (uint i = 0; i < ItemsPerThread; ++i)
+        if (kept(base + i))
+            flags |= 1u << i;
+
+    uint total;
+    uint slot = scanWorkgroup(bitCount(flags), total);
+    slot += tileExclusive(partition, total);
+
+    for (uint i = 0; i < ItemsPerThread; ++i)
+        if ((flags & (1u << i)) != 0)
+            scanBuffers[pc.outputBuffer].words[slot++] = pc.inputBuffer != 0xFFFFFFFFu ? scanBuffers[pc.inputBuffer].words[base + i] : base + i;
+
+    uint partitions = (pc.count + GroupSize * ItemsPerThread - 1) / (GroupSize * ItemsPerThread);
+    if (partition == partitions - 1 && gl_LocalInvocationID.x == GroupSize - 1)
+        scanBuffers[pc.resultBuffer].words[0] = slot;
+}
+
+void main() {
+    if (pc.pass == PassScan)
+        scanPass();
+    else if (pc.pass == PassReduce)
+        reducePass();
+    else
+        compactPass();
+}
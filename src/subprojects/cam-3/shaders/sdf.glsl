@@ -0,0 +1,73 @@
+// Signed distance field of the terrain, mirrored on the CPU by core/sdf.hpp. Requires GL_EXT_nonuniform_qualifier.
+// Negative inside. A sphere with rolling hills and a box on top for sharp edges, followed by the edits: spheres
+// that are added (positive radius) or carved (negative radius) with a smooth blend.
+//
+// The blends fall back to plain min / max outside their blend distance, so an edit only moves the surface within
+// its radius plus the smoothness, which is what core::SdfVolume re-meshes around.
+
+struct SdfScene {
+    vec3  center;
+    float radius;
+    float amplitude;   // of the hills
+    float frequency;   // of the hills, per unit
+    float mesa;        // half size of the box on top, 0 for none
+    float smoothness;  // blend distance of the edits
+    uint  editBuffer;  // vec4 center, radius per edit
+    uint  editCount;
+    uint  pad0;
+    uint  pad1;
+};
+
+// Aliases the storage buffer array of the bindless heap
+layout(set = 0, binding = 3) readonly buffer SdfEditBuffer {
+    vec4 edits[];
+} sdfEditBuffers[];
+
+float sdfBox(vec3 p, vec3 halfSize) {
+    vec3 q = abs(p) - halfSize;
+    return length(max(q, 0.0)) + min(max(q.x, max(q.y, q.z)), 0.0);
+}
+
+// Quilez' polynomial smooth minimum
+float sdfSmoothMin(float a, float b, float k) {
+    if (abs(a - b) >= k)
+        return min(a, b);
+    float h = clamp(0.5 + 0.5 * (b - a) / k, 0.0, 1.0);
+    return mix(b, a, h) - k * h * (1.0 - h);
+}
+
+float sdfScene(vec3 p, SdfScene scene) {
+    vec3  q = p - scene.center;
+    float d = length(q) - scene.radius;
+
+    vec3 w = q * scene.frequency;
+    d -= scene.amplitude * (sin(w.x) * sin(w.y) * sin(w.z) + 0.5 * sin(2.0 * w.x + 1.3) * sin(2.0 * w.z + 0.7));
+
+    if (scene.mesa > 0.0)
+        d = min(d, sdfBox(q - vec3(0.0, scene.radius, 0.0), vec3(scene.mesa)));
+
+    for (uint i = 0; i < scene.editCount; ++i) {
+        vec4  edit   = sdfEditBuffers[scene.editBuffer].edits[i];
+        float sphere = length(p - edit.xyz) - abs(edit.w);
+        d = edit.w >= 0.0 ? sdfSmoothMin(d, sphere, scene.smoothness) : -sdfSmoothMin(-d, sphere, scene.smoothness);
+    }
+    return d;
+}
+
+// Gradient from four samples on a tetrahedron `h` around p
+vec3 sdfNormal(vec3 p, SdfScene scene, float h) {
+    const vec2 k = vec2(1.0, -1.0);
+    vec3 n = k.xyy * sdfScene(p + k.xyy * h, scene) + k.yyx * sdfScene(p + k.yyx * h, scene) +
+             k.yxy * sdfScene(p + k.yxy * h, scene) + k.xxx * sdfScene(p + k.xxx * h, scene);
+    return normalize(n);
+}
+
+// Grass on flat ground, rock on slopes, lit from a fixed direction. The surfaces carry no normals, the
+// shading is baked into the vertex color.
+vec3 sdfColor(vec3 p, vec3 normal, SdfScene scene) {
+    vec3  up     = normalize(p - scene.center);
+    float flat_  = smoothstep(0.6, 0.85, dot(normal, up));
+    vec3  albedo = vec3(0.45, 0.4, 0.35) * (1.0 - flat_) + vec3(0.3, 0.55, 0.25) * flat_;
+    float light  = max(dot(normal, normalize(vec3(0.4, 0.8, -0.45))), 0.0);
+    return albedo * (0.35 + 0.65 * light);
+}
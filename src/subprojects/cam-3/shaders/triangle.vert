@@ -1,4 +1,10 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_GOOGLE_include_directive : require
+
+// Per-instance data is read from storageBuffers[pc.instanceBuffer] in the format selected by INSTANCE_FORMAT
+#include "instance.glsl"
 
 layout(location = 0) out vec3 vColor;
 
@@ -6,20 +12,30 @@ layout(location = 0) out vec3 vColor;
 layout(push_constant) uniform PushConstants {
     mat4 view;
     mat4 proj;
+    uint instanceBuffer;
+    uint visibleBuffer;
+    uint instanceCount;
+    float positionScale;  // 1 for float positions, the model radius for snorm16 ones
 } pc;
 
+// Instance indices that survived culling, aliases the same heap binding.
+// gl_InstanceIndex includes firstInstance, which selects the list region of the LOD being drawn
+layout(set = 0, binding = 3) readonly buffer VisibleBuffer {
+    uint indices[];
+} visibleBuffers[];
+
 // Per-vertex attributes
-layout(location = 0) in vec2 inPosition;
+layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 
-// Per-instance attribute (3D position for this instance)
-layout(location = 2) in vec3 instancePosition;
-
 void main() {
-    // Construct 3D position from 2D vertex position and instance position
-    vec3 worldPos = vec3(inPosition.x, inPosition.y, 0.0) + instancePosition;
+    uint     index    = pc.visibleBuffer != 0xFFFFFFFFu ? visibleBuffers[pc.visibleBuffer].indices[gl_InstanceIndex] : gl_InstanceIndex;
+    Instance instance = loadInstance(pc.instanceBuffer, index, pc.instanceCount);
+
+    // Model space vertex scaled, rotated and offset by the instance
+    vec3 worldPos = rotateByQuaternion(instance.rotation, inPosition * pc.positionScale * instance.scale) + instance.position;
     
     // Apply view and projection transforms
     gl_Position = pc.proj * pc.view * vec4(worldPos, 1.0);
-    vColor = inColor;
+    vColor = inColor * instance.color.rgb;
 }
@@ -72,6 +72,7 @@ namespace global{
         //=========================================================
 
         inline bool imguiMode = false;
+        inline uint64_t frameCount = 0;
         inline glm::vec3 cameraPosition = glm::vec3( 0.0f, 0.0f, 0.0f );
         inline glm::vec2 cameraRotation = glm::vec2( 0.0f, 0.0f );
         inline float cameraZoom = 1.0f;
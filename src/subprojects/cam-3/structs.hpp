@@ -60,10 +60,11 @@ namespace core
 
   struct Buffer
   {
-    VkBuffer          buffer     = VK_NULL_HANDLE;
-    VmaAllocation     allocation = nullptr;
-    VmaAllocationInfo allocationInfo{};  // may contain mapped pointer for host visible buffers
-    VkDeviceSize      size = 0;
+    VkBuffer           buffer     = VK_NULL_HANDLE;
+    VmaAllocation      allocation = nullptr;
+    VmaAllocationInfo  allocationInfo{};  // may contain mapped pointer for host visible buffers
+    VkDeviceSize       size  = 0;
+    VkBufferUsageFlags usage = 0;  // as created, needed to recreate the buffer elsewhere
   };
 
   struct FrameInFlight
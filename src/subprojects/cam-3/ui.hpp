@@ -1,8 +1,18 @@
 #pragma once
 #include "imgui.h"
-#include "state.hpp"
 #include "input.hpp"
+#include "objects.hpp"
+#include "state.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <exception>
+#include <filesystem>
+#include <random>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 namespace ui
@@ -161,4 +171,2051 @@ namespace ui
     ImGui::Text( "Logged: X: %.3f, Y: %.3f", input::virtualxPos, input::virtualyPos );
     ImGui::End();
   }
+
+  inline void renderMemorySnapshot( const char * label, core::MemorySnapshot const & snapshot )
+  {
+    constexpr float MB = 1024.0f * 1024.0f;
+    ImGui::SeparatorText( label );
+    ImGui::Text( "Blocks: %u (%.1f MB)", snapshot.blockCount, snapshot.blockBytes / MB );
+    ImGui::Text( "Allocations: %u (%.1f MB)", snapshot.allocationCount, snapshot.allocationBytes / MB );
+    ImGui::Text( "Free ranges: %u, largest %.2f MB", snapshot.freeRangeCount, snapshot.largestFreeRange / MB );
+    ImGui::Text( "Device local: %.1f MB, spilled: %.1f MB", snapshot.deviceLocalUsage / MB, snapshot.spilledUsage / MB );
+  }
+
+  // Create a batch of randomly sized buffers and textures and release a random half of everything churned so far,
+  // leaves the VMA blocks with the kind of holes that long editing sessions produce
+  inline void churnAllocations( uint32_t count )
+  {
+    static std::mt19937 rng{ 1337 };
+
+    auto &                            table = global::obj::resources;
+    std::vector<core::ResourceHandle> textures;
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+      if ( rng() % 2 == 0 )
+      {
+        vk::DeviceSize size = vk::DeviceSize( 1024 ) << ( rng() % 15 );  // 1 KB .. 16 MB
+        global::obj::churnResources.push_back( table.createBuffer( size, vk::BufferUsageFlagBits::eStorageBuffer ) );
+      }
+      else
+      {
+        uint32_t side = 64u << ( rng() % 6 );  // 64 .. 2048 px
+        textures.push_back(
+          table.createTexture( { side, side }, vk::Format::eR8G8B8A8Unorm, vk::ImageUsageFlagBits::eSampled, vk::ImageAspectFlagBits::eColor ) );
+        global::obj::churnResources.push_back( textures.back() );
+      }
+    }
+
+    // Give the textures contents in a tracked layout, so the defragmenter has something to carry over
+    if ( !textures.empty() )
+    {
+      vk::raii::CommandPool pool( global::obj::device,
+                                  vk::CommandPoolCreateInfo{ vk::CommandPoolCreateFlagBits::eTransient, global::obj::queueFamilyIndices.graphicsFamily.value() } );
+      vk::raii::CommandBuffer cmd = std::move( vk::raii::CommandBuffers( global::obj::device, vk::CommandBufferAllocateInfo{ pool, vk::CommandBufferLevel::ePrimary, 1 } ).front() );
+      cmd.begin( vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit } );
+
+      vk::ImageSubresourceRange range{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+      for ( core::ResourceHandle handle : textures )
+      {
+        vk::Image image = table.texture( handle ).image;
+
+        vk::ImageMemoryBarrier2 toClear{};
+        toClear.setSrcStageMask( vk::PipelineStageFlagBits2::eTopOfPipe )
+          .setDstStageMask( vk::PipelineStageFlagBits2::eTransfer )
+          .setDstAccessMask( vk::AccessFlagBits2::eTransferWrite )
+          .setOldLayout( vk::ImageLayout::eUndefined )
+          .setNewLayout( vk::ImageLayout::eTransferDstOptimal )
+          .setImage( image )
+          .setSubresourceRange( range );
+        cmd.pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( toClear ) );
+
+        std::uniform_real_distribution<float> channel( 0.0f, 1.0f );
+        vk::ClearColorValue                   color( std::array<float, 4>{ channel( rng ), channel( rng ), channel( rng ), 1.0f } );
+        cmd.clearColorImage( image, vk::ImageLayout::eTransferDstOptimal, color, range );
+
+        vk::ImageMemoryBarrier2 toRead{};
+        toRead.setSrcStageMask( vk::PipelineStageFlagBits2::eTransfer )
+          .setSrcAccessMask( vk::AccessFlagBits2::eTransferWrite )
+          .setDstStageMask( vk::PipelineStageFlagBits2::eAllCommands )
+          .setDstAccessMask( vk::AccessFlagBits2::eShaderSampledRead )
+          .setOldLayout( vk::ImageLayout::eTransferDstOptimal )
+          .setNewLayout( vk::ImageLayout::eShaderReadOnlyOptimal )
+          .setImage( image )
+          .setSubresourceRange( range );
+        cmd.pipelineBarrier2( vk::DependencyInfo{}.setImageMemoryBarriers( toRead ) );
+      }
+      cmd.end();
+
+      vk::raii::Fence             fence( global::obj::device, vk::FenceCreateInfo{} );
+      vk::CommandBufferSubmitInfo cmdInfo{};
+      cmdInfo.setCommandBuffer( *cmd );
+      global::obj::graphicsQueue.submit2( vk::SubmitInfo2{}.setCommandBufferInfos( cmdInfo ), *fence );
+      (void)global::obj::device.waitForFences( { *fence }, VK_TRUE, UINT64_MAX );
+
+      for ( core::ResourceHandle handle : textures )
+        table.setLayout( handle, vk::ImageLayout::eShaderReadOnlyOptimal );
+    }
+
+    std::shuffle( global::obj::churnResources.begin(), global::obj::churnResources.end(), rng );
+    size_t keep = global::obj::churnResources.size() / 2;
+    for ( size_t i = keep; i < global::obj::churnResources.size(); ++i )
+      table.release( global::obj::churnResources[i], global::state::frameCount );
+    global::obj::churnResources.resize( keep );
+  }
+
+  inline void renderDefragWindow()
+  {
+    auto & defrag = global::obj::defragmenter;
+
+    ImGui::Begin( "Memory" );
+
+    ImGui::Text( "Table resources: %zu alive", global::obj::resources.aliveCount() );
+    renderMemorySnapshot( "Current", core::takeMemorySnapshot( global::obj::allocator ) );
+
+    ImGui::SeparatorText( "Defragmentation" );
+
+    int   mbPerPass     = static_cast<int>( defrag.maxBytesPerPass / ( 1024 * 1024 ) );
+    int   allocsPerPass = static_cast<int>( defrag.maxAllocationsPerPass );
+    if ( ImGui::SliderInt( "MB per pass", &mbPerPass, 1, 256 ) )
+      defrag.maxBytesPerPass = static_cast<VkDeviceSize>( mbPerPass ) * 1024 * 1024;
+    if ( ImGui::SliderInt( "Allocations per pass", &allocsPerPass, 1, 512 ) )
+      defrag.maxAllocationsPerPass = static_cast<uint32_t>( allocsPerPass );
+    ImGui::SliderFloat( "Time budget (ms)", &defrag.timeBudgetMs, 0.05f, 4.0f );
+    ImGui::Checkbox( "Automatic", &defrag.autoDefragment );
+    ImGui::SameLine();
+    ImGui::SliderFloat( "Free ratio", &defrag.autoFreeRatio, 0.05f, 0.9f );
+
+    ImGui::BeginDisabled( defrag.running() );
+    if ( ImGui::Button( "Defragment" ) )
+      defrag.start();
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    if ( ImGui::Button( "Churn 256" ) )
+      churnAllocations( 256 );
+    ImGui::SameLine();
+    if ( ImGui::Button( "Release all" ) )
+    {
+      for ( core::ResourceHandle handle : global::obj::churnResources )
+        global::obj::resources.release( handle, global::state::frameCount );
+      global::obj::churnResources.clear();
+    }
+
+    ImGui::Text( "%s", defrag.running() ? "Running" : "Idle" );
+    ImGui::Text( "Moved: %u allocations, %.2f MB in %u passes",
+                 defrag.stats.allocationsMoved,
+                 defrag.stats.bytesMoved / ( 1024.0f * 1024.0f ),
+                 defrag.stats.passes );
+    ImGui::Text( "Freed: %u blocks, %.2f MB", defrag.stats.blocksFreed, defrag.stats.bytesFreed / ( 1024.0f * 1024.0f ) );
+    ImGui::Text( "Last step: %.3f ms", defrag.stats.lastStepMs );
+
+    ImGui::SeparatorText( "Bindless heap" );
+    auto & heap = global::obj::bindless;
+    ImGui::Text( "Sampled images: %u / %u", heap.usedCount( core::BindlessHeap::SampledImages ), heap.capacity[core::BindlessHeap::SampledImages] );
+    ImGui::Text( "Storage images: %u / %u", heap.usedCount( core::BindlessHeap::StorageImages ), heap.capacity[core::BindlessHeap::StorageImages] );
+    ImGui::Text( "Samplers: %u / %u", heap.usedCount( core::BindlessHeap::Samplers ), heap.capacity[core::BindlessHeap::Samplers] );
+    ImGui::Text( "Storage buffers: %u / %u", heap.usedCount( core::BindlessHeap::StorageBuffers ), heap.capacity[core::BindlessHeap::StorageBuffers] );
+
+    if ( defrag.before.blockCount > 0 )
+    {
+      renderMemorySnapshot( "Before last run", defrag.before );
+      renderMemorySnapshot( "After last run", defrag.after );
+    }
+
+    ImGui::End();
+  }
+
+  inline void renderBindingWindow()
+  {
+    auto & bench = global::obj::bindingBenchmark;
+
+    ImGui::Begin( "Binding Backends" );
+
+    ImGui::Text( "VK_EXT_descriptor_buffer: %s", cfg::supported.descriptorBuffer ? "supported" : "not supported" );
+    ImGui::Text( "Preferred backend: %s", core::toString( core::preferredBindingBackend() ) );
+
+    ImGui::SeparatorText( "Rebinding benchmark" );
+
+    int draws  = static_cast<int>( bench.draws );
+    int frames = static_cast<int>( bench.frames );
+    if ( ImGui::SliderInt( "Draws per frame", &draws, 1, core::BindingBenchmark::MaxDraws ) )
+      bench.draws = static_cast<uint32_t>( draws );
+    if ( ImGui::SliderInt( "Frames", &frames, 1, 512 ) )
+      bench.frames = static_cast<uint32_t>( frames );
+
+    auto run = [&]( core::BindingBackend b )
+    {
+      bench.run( global::obj::device,
+                 global::obj::physicalDevice,
+                 global::obj::allocator,
+                 global::obj::queueFamilyIndices.graphicsFamily.value(),
+                 global::obj::graphicsQueue,
+                 b );
+    };
+
+    if ( ImGui::Button( "Run both" ) )
+    {
+      run( core::BindingBackend::DescriptorSets );
+      if ( cfg::supported.descriptorBuffer )
+        run( core::BindingBackend::DescriptorBuffer );
+    }
+    ImGui::SameLine();
+    if ( ImGui::Button( "Clear" ) )
+      bench.results.clear();
+
+    if ( ImGui::BeginTable( "results", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Backend" );
+      ImGui::TableSetupColumn( "Draws" );
+      ImGui::TableSetupColumn( "CPU ms/frame" );
+      ImGui::TableSetupColumn( "us/draw" );
+      ImGui::TableSetupColumn( "Wall ms/frame" );
+      ImGui::TableSetupColumn( "Mismatches" );
+      ImGui::TableHeadersRow();
+
+      for ( auto const & r : bench.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( core::toString( r.backend ) );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", r.draws );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.3f", r.cpuMsPerFrame );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.3f", r.usPerDraw );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.3f", r.wallMsPerFrame );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", r.mismatches );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::End();
+  }
+
+  inline void renderCullingWindow()
+  {
+    auto & culler = global::obj::culler;
+    auto & sweep  = global::obj::cullSweep;
+    auto & timer  = global::obj::gpuTimer;
+
+    ImGui::Begin( "Culling" );
+
+    if ( ImGui::BeginCombo( "Mode", core::toString( culler.mode ) ) )
+    {
+      for ( auto mode : { core::CullMode::Off, core::CullMode::Frustum, core::CullMode::Occlusion } )
+        if ( ImGui::Selectable( core::toString( mode ), culler.mode == mode ) )
+          culler.mode = mode;
+      ImGui::EndCombo();
+    }
+
+    auto const & stats   = culler.stats;
+    auto         percent = [&]( uint32_t count ) { return culler.instanceCount ? 100.0f * count / culler.instanceCount : 0.0f; };
+
+    ImGui::Text( "Drawn: %u / %u (%.1f%%)", stats.drawn, culler.instanceCount, percent( stats.drawn ) );
+    ImGui::Text( "Culled: %.1f%%", 100.0f - percent( stats.drawn ) );
+    if ( stats.mode != core::CullMode::Off )
+      ImGui::Text( "  frustum: %.1f%%", 100.0f - percent( stats.frustumVisible ) );
+    if ( stats.mode == core::CullMode::Occlusion )
+    {
+      ImGui::Text( "  occlusion: %.1f%%", percent( stats.occluded ) );
+      ImGui::Text( "Early pass (visible last frame): %u", stats.early );
+      ImGui::Text( "Late pass (newly visible): %u", stats.late );
+      ImGui::Text( "Depth pyramid: %ux%u, %u levels", culler.pyramid.extent.width, culler.pyramid.extent.height, culler.pyramid.levelCount );
+    }
+
+    ImGui::SeparatorText( "Level of detail" );
+    ImGui::BeginDisabled( culler.mode == core::CullMode::Off );
+    ImGui::Checkbox( "LOD selection", &culler.lodEnabled );
+    ImGui::SliderFloat( "Hysteresis", &culler.lodHysteresis, 0.0f, 0.5f );
+    ImGui::EndDisabled();
+
+    auto & model = global::obj::model;
+    for ( uint32_t lod = 0; lod < model.lods.size(); ++lod )
+    {
+      ImGui::PushID( static_cast<int>( lod ) );
+      if ( lod + 1 < model.lods.size() )
+        ImGui::DragFloat( "##size", &model.lods[lod].minScreenSize, 0.5f, 0.0f, 1024.0f, ">= %.0f px" );
+      else
+        ImGui::TextUnformatted( "coarsest" );
+      ImGui::SameLine();
+      ImGui::Text( "LOD %u: %u triangles, %u instances", lod, model.lods[lod].triangleCount(), stats.lodInstances[lod] );
+      ImGui::PopID();
+    }
+
+    ImGui::Text( "Triangles submitted: %.2f M", stats.triangles * 1e-6 );
+    ImGui::Text( "Same instances at LOD 0: %.2f M (%.1fx)",
+                 stats.trianglesLod0 * 1e-6,
+                 stats.triangles ? double( stats.trianglesLod0 ) / double( stats.triangles ) : 1.0 );
+
+    ImGui::SeparatorText( "GPU time" );
+    for ( auto const & scope : timer.scopes )
+      ImGui::Text( "%.*s: %.3f ms", static_cast<int>( scope.name.size() ), scope.name.data(), scope.ms );
+
+    ImGui::SeparatorText( "Orientation sweep" );
+    ImGui::BeginDisabled( sweep.active );
+    if ( ImGui::Button( "Sweep camera orientations" ) )
+      sweep.start( global::state::cameraRotation );
+    ImGui::EndDisabled();
+
+    if ( sweep.active )
+      ImGui::Text( "Running... %zu / %u", sweep.samples.size(), core::OrientationSweep::StepCount );
+    else if ( !sweep.samples.empty() )
+    {
+      uint32_t minVisible = UINT32_MAX, maxVisible = 0;
+      double   visibleSum = 0.0, triangleSum = 0.0, cullSum = 0.0, sceneSum = 0.0;
+      for ( auto const & sample : sweep.samples )
+      {
+        minVisible = std::min( minVisible, sample.visible );
+        maxVisible = std::max( maxVisible, sample.visible );
+        visibleSum += sample.visible;
+        triangleSum += double( sample.triangles );
+        cullSum += sample.cullMs;
+        sceneSum += sample.sceneMs;
+      }
+      double n = static_cast<double>( sweep.samples.size() );
+      ImGui::Text( "%zu orientations", sweep.samples.size() );
+      ImGui::Text( "Drawn: avg %.0f, min %u, max %u of %u", visibleSum / n, minVisible, maxVisible, culler.instanceCount );
+      ImGui::Text( "Triangles: avg %.2f M", triangleSum / n * 1e-6 );
+      ImGui::Text( "Culling: avg %.3f ms", cullSum / n );
+      ImGui::Text( "Drawing: avg %.3f ms", sceneSum / n );
+
+      if ( ImGui::TreeNode( "Samples" ) )
+      {
+        for ( auto const & sample : sweep.samples )
+          ImGui::Text( "yaw %6.1f pitch %5.1f  drawn %6u  triangles %9llu  cull %.3f ms  draw %.3f ms",
+                       glm::degrees( sample.rotation.x ),
+                       glm::degrees( sample.rotation.y ),
+                       sample.visible,
+                       static_cast<unsigned long long>( sample.triangles ),
+                       sample.cullMs,
+                       sample.sceneMs );
+        ImGui::TreePop();
+      }
+    }
+
+    ImGui::End();
+  }
+
+  inline void renderRenderPathWindow()
+  {
+    auto & mesh       = global::obj::meshRenderer;
+    auto & comparison = global::obj::renderPathComparison;
+
+    ImGui::Begin( "Render Path" );
+
+    ImGui::Text( "VK_EXT_mesh_shader: %s", cfg::supported.meshShader ? "supported" : "not supported" );
+
+    ImGui::BeginDisabled( comparison.active );
+    int path = static_cast<int>( global::obj::renderPath );
+    ImGui::RadioButton( core::toString( core::RenderPath::Vertex ), &path, 0 );
+    ImGui::BeginDisabled( !mesh.available() );
+    ImGui::SameLine();
+    ImGui::RadioButton( core::toString( core::RenderPath::Mesh ), &path, 1 );
+    ImGui::EndDisabled();
+    global::obj::renderPath = static_cast<core::RenderPath>( path );
+    ImGui::EndDisabled();
+
+    if ( global::obj::renderPath == core::RenderPath::Mesh )
+    {
+      ImGui::TextUnformatted( "Frustum culling and LOD in the task stage, the cull mode is ignored" );
+      if ( uint32_t perGroup = mesh.taskInstances( global::obj::culler.lodEnabled ) )
+        ImGui::Text( "%u instances per task workgroup", perGroup );
+      else
+        ImGui::TextUnformatted( "The model has too many meshlets for one task workgroup, drawing with vertex shaders" );
+      ImGui::Text( "Drawn: %u, meshlets: %u (%u cone culled), triangles: %.2f M",
+                   mesh.stats.drawn,
+                   mesh.stats.meshlets,
+                   mesh.stats.coneCulled,
+                   mesh.stats.triangles * 1e-6 );
+      for ( uint32_t lod = 0; lod < global::obj::model.lods.size(); ++lod )
+        ImGui::Text( "  LOD %u: %u instances", lod, mesh.stats.lodInstances[lod] );
+    }
+
+    ImGui::SeparatorText( "Comparison" );
+    ImGui::BeginDisabled( comparison.active || !mesh.available() || mesh.taskInstances( global::obj::culler.lodEnabled ) == 0 );
+    if ( ImGui::Button( "Compare render paths" ) )
+      comparison.start( global::obj::renderPath, global::obj::culler.mode );
+    ImGui::EndDisabled();
+
+    if ( comparison.active )
+      ImGui::TextUnformatted( "Running..." );
+    else if ( !comparison.results.empty() && ImGui::BeginTable( "paths", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Path" );
+      ImGui::TableSetupColumn( "GPU ms" );
+      ImGui::TableSetupColumn( "Drawn" );
+      ImGui::TableSetupColumn( "M triangles" );
+      ImGui::TableSetupColumn( "G triangles/s" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : comparison.results )
+      {
+        double n         = std::max( 1u, result.frames );
+        double ms        = result.ms / n;
+        double triangles = result.triangles / n;
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( core::toString( result.path ) );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.3f", ms );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.0f", result.drawn / n );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.2f", triangles * 1e-6 );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.2f", ms > 0.0 ? triangles / ms * 1e-6 : 0.0 );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::End();
+  }
+
+  // Switches what the scene draws and resizes the culling lists to its count. A source with nothing to draw leaves
+  // the scene on the instances.
+  inline void setSceneSource( core::SceneSource source )
+  {
+    global::obj::device.waitIdle();
+    uint32_t count = 0;
+    switch ( source )
+    {
+      case core::SceneSource::Instances: count = global::obj::instances.count; break;
+      case core::SceneSource::GpuSpheres: count = global::obj::verlet.count; break;
+      case core::SceneSource::CpuSpheres: count = global::obj::cpuVerlet.drawable() ? global::obj::cpuVerlet.count : 0; break;
+      case core::SceneSource::Entities: count = global::obj::scene.drawable() ? global::obj::scene.capacity : 0; break;
+    }
+    if ( count == 0 )
+    {
+      source = core::SceneSource::Instances;
+      count  = global::obj::instances.count;
+    }
+    global::obj::sceneSource = source;
+    global::obj::culler.resize( global::obj::bindless, count, global::state::frameCount );
+  }
+
+  // Refill the instance buffer from global::obj::instanceParams, the scene draws the instances again
+  inline void regenerateInstances()
+  {
+    global::obj::device.waitIdle();
+    global::obj::instances.generate( global::obj::bindless, global::obj::instanceParams, global::state::frameCount );
+    setSceneSource( core::SceneSource::Instances );
+  }
+
+  // Reseeds the spheres from global::obj::verletParams and draws them
+  inline void resetSpheres()
+  {
+    global::obj::device.waitIdle();
+    global::obj::verlet.reset( global::obj::bindless, global::obj::verletParams, global::state::frameCount );
+    setSceneSource( core::SceneSource::GpuSpheres );
+  }
+
+  // Reseeds the CPU spheres from global::obj::verletParams and draws them
+  inline void resetCpuSpheres()
+  {
+    global::obj::device.waitIdle();
+    global::obj::cpuVerlet.reset( global::obj::verletParams );
+    global::obj::cpuVerlet.attach( global::obj::bindless, global::state::frameCount );
+    setSceneSource( core::SceneSource::CpuSpheres );
+  }
+
+  // Swaps a loaded model in for global::obj::model, the previous one is released to the resource table
+  inline void replaceModel( core::Model loaded )
+  {
+    global::obj::device.waitIdle();
+    global::obj::model.release( global::obj::resources, global::obj::bindless, global::state::frameCount );
+    global::obj::model = std::move( loaded );
+    global::obj::model.adopt( global::obj::resources, global::obj::bindless );
+  }
+
+  inline void renderInstancesWindow()
+  {
+    auto & generator = global::obj::instances;
+    auto & params    = global::obj::instanceParams;
+
+    ImGui::Begin( "Instances" );
+
+    int layout = static_cast<int>( params.layout );
+    ImGui::RadioButton( core::toString( core::InstanceLayout::Grid ), &layout, 0 );
+    ImGui::SameLine();
+    ImGui::RadioButton( core::toString( core::InstanceLayout::Ball ), &layout, 1 );
+    params.layout = static_cast<core::InstanceLayout>( layout );
+
+    int source = static_cast<int>( params.source );
+    ImGui::RadioButton( core::toString( core::InstanceSource::Gpu ), &source, 0 );
+    ImGui::SameLine();
+    ImGui::RadioButton( core::toString( core::InstanceSource::Cpu ), &source, 1 );
+    params.source = static_cast<core::InstanceSource>( source );
+
+    if ( params.layout == core::InstanceLayout::Grid )
+    {
+      int count[3] = { static_cast<int>( params.gridCount.x ), static_cast<int>( params.gridCount.y ), static_cast<int>( params.gridCount.z ) };
+      if ( ImGui::SliderInt3( "Cells", count, 1, 256 ) )
+        params.gridCount = glm::uvec3( count[0], count[1], count[2] );
+      ImGui::SliderFloat( "Spacing", &params.spacing, 2.0f * data::modelRadius, 16.0f );
+      ImGui::SliderFloat( "Jitter", &params.jitter, 0.0f, 0.5f );
+    }
+    else
+    {
+      int count = static_cast<int>( params.ballCount );
+      if ( ImGui::SliderInt( "Count", &count, 1, static_cast<int>( core::InstanceGenerator::MaxInstances ), "%d", ImGuiSliderFlags_Logarithmic ) )
+        params.ballCount = static_cast<uint32_t>( count );
+      ImGui::SliderFloat( "Radius", &params.ballRadius, 10.0f, 2000.0f, "%.0f", ImGuiSliderFlags_Logarithmic );
+    }
+
+    ImGui::SliderFloat( "Scale jitter", &params.scaleJitter, 0.0f, 0.9f );
+    ImGui::Checkbox( "Random rotation", &params.randomRotation );
+    ImGui::SameLine();
+    ImGui::Checkbox( "Random color", &params.randomColor );
+
+    int seed = static_cast<int>( params.seed );
+    if ( ImGui::InputInt( "Seed", &seed ) )
+      params.seed = static_cast<uint32_t>( seed );
+
+    ImGui::BeginDisabled( params.source != core::InstanceSource::Cpu );
+    int threads = static_cast<int>( params.threads );
+    if ( ImGui::SliderInt( "Threads", &threads, 0, static_cast<int>( std::max( 1u, std::thread::hardware_concurrency() ) ), threads ? "%d" : "all" ) )
+      params.threads = static_cast<uint32_t>( threads );
+    ImGui::EndDisabled();
+
+    bool valid = params.count() > 0 && params.count() <= core::InstanceGenerator::MaxInstances;
+    ImGui::Text( "%llu instances, %.1f MB as %s",
+                 static_cast<unsigned long long>( params.count() ),
+                 double( params.count() * core::instanceStride( data::instanceFormat ) ) / ( 1024.0 * 1024.0 ),
+                 core::toString( data::instanceFormat ) );
+    if ( !valid )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "Limit is %u instances", core::InstanceGenerator::MaxInstances );
+
+    ImGui::BeginDisabled( !valid );
+    if ( ImGui::Button( "Generate" ) )
+      regenerateInstances();
+    ImGui::EndDisabled();
+
+    ImGui::SeparatorText( "Generations" );
+    for ( auto const & result : generator.results )
+    {
+      char const * layoutName = core::toString( result.params.layout );
+      char const * sourceName = core::toString( result.params.source );
+      if ( result.threads )
+        ImGui::Text( "%s, %s (%u): %u instances in %.2f ms", layoutName, sourceName, result.threads, result.count, result.ms );
+      else
+        ImGui::Text( "%s, %s: %u instances in %.2f ms", layoutName, sourceName, result.count, result.ms );
+    }
+
+    ImGui::SeparatorText( "Format benchmark" );
+
+    auto & bench   = global::obj::instanceBenchmark;
+    int    count   = static_cast<int>( bench.instanceCount );
+    int    repeats = static_cast<int>( bench.repeats );
+    if ( ImGui::SliderInt( "Instances", &count, 1024, static_cast<int>( core::InstanceGenerator::MaxInstances ), "%d", ImGuiSliderFlags_Logarithmic ) )
+      bench.instanceCount = static_cast<uint32_t>( count );
+    if ( ImGui::SliderInt( "Draws", &repeats, 1, 64 ) )
+      bench.repeats = static_cast<uint32_t>( repeats );
+
+    if ( ImGui::Button( "Run formats" ) )
+    {
+      global::obj::device.waitIdle();
+      bench.run( global::obj::device,
+                 global::obj::physicalDevice,
+                 global::obj::allocator,
+                 global::obj::bindless,
+                 generator,
+                 global::obj::queueFamilyIndices.graphicsFamily.value(),
+                 global::obj::graphicsQueue,
+                 global::state::frameCount );
+    }
+
+    if ( !bench.results.empty() && ImGui::BeginTable( "formats", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Format" );
+      ImGui::TableSetupColumn( "Bytes" );
+      ImGui::TableSetupColumn( "ms/draw" );
+      ImGui::TableSetupColumn( "M instances/s" );
+      ImGui::TableSetupColumn( "GB/s" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : bench.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( core::toString( result.format ) );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", static_cast<uint32_t>( core::instanceStride( result.format ) ) );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.3f", result.msPerDraw );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.instancesPerSecond );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.gigabytesPerSecond );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::End();
+  }
+
+  inline void renderSceneWindow()
+  {
+    auto & scene = global::obj::scene;
+
+    ImGui::Begin( "Scene" );
+
+    if ( ImGui::Button( "Populate" ) )
+    {
+      try
+      {
+        global::obj::device.waitIdle();
+        scene.populate( global::obj::bindless, global::obj::instanceParams, global::state::frameCount );
+        scene.error.clear();
+        setSceneSource( core::SceneSource::Entities );
+      }
+      catch ( std::exception const & e )
+      {
+        scene.error = e.what();
+        setSceneSource( global::obj::sceneSource );  // a failure halfway may have destroyed what the scene draws
+      }
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "One entity per instance of the Instances window, with a transform, a material and a renderable" );
+    ImGui::SameLine();
+    bool drawn = global::obj::sceneSource == core::SceneSource::Entities;
+    ImGui::BeginDisabled( !scene.drawable() );
+    if ( ImGui::Checkbox( "Draw entities", &drawn ) )
+      setSceneSource( drawn ? core::SceneSource::Entities : core::SceneSource::Instances );
+    ImGui::EndDisabled();
+
+    if ( !scene.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", scene.error.c_str() );
+    if ( !scene.drawable() )
+    {
+      ImGui::End();
+      return;
+    }
+    ImGui::Text( "%u entities in %u slots, populated in %.1f ms", scene.liveCount(), scene.capacity, scene.populateMs );
+
+    ImGui::SeparatorText( "Changes" );
+
+    ImGui::Checkbox( "Animate", &scene.animated );
+    ImGui::SameLine();
+    ImGui::Checkbox( "Clustered", &scene.clustered );
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "Touch consecutive slots instead of random ones" );
+    float percent = scene.touchFraction * 100.0f;
+    if ( ImGui::SliderFloat( "Touched per frame", &percent, 0.001f, 100.0f, "%.3f %%", ImGuiSliderFlags_Logarithmic ) )
+      scene.touchFraction = percent / 100.0f;
+    ImGui::SliderFloat( "Move", &scene.touchDistance, 0.0f, 4.0f );
+
+    uint32_t batch = std::max( scene.capacity / 100, 1u );
+    ImGui::BeginDisabled( scene.freeCount() == 0 );
+    if ( ImGui::Button( "Spawn 1%" ) )
+      scene.spawn( batch, global::state::frameCount );
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    ImGui::BeginDisabled( scene.liveCount() == 0 );
+    if ( ImGui::Button( "Despawn 1%" ) )
+      scene.despawn( batch, global::state::frameCount );
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    ImGui::Text( "%u free slots", scene.freeCount() );
+
+    ImGui::SeparatorText( "Upload" );
+
+    int gap  = static_cast<int>( scene.mergeGap );
+    int runs = static_cast<int>( scene.maxRuns );
+    if ( ImGui::SliderInt( "Merge gap", &gap, 0, 256, "%d slots" ) )
+      scene.mergeGap = static_cast<uint32_t>( gap );
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "Runs this close are joined, re-uploading the clean slots between them to save a copy region" );
+    if ( ImGui::SliderInt( "Max runs", &runs, 1, 65536, "%d", ImGuiSliderFlags_Logarithmic ) )
+      scene.maxRuns = static_cast<uint32_t>( runs );
+
+    auto const &   stats = scene.stats;
+    vk::DeviceSize whole = core::instanceStride( data::instanceFormat ) * vk::DeviceSize( scene.capacity );
+    ImGui::Text( "%u touched, %u slots changed, %u runs, %u copy regions", stats.touched, stats.dirty, stats.runs, stats.regions );
+    ImGui::Text( "%.1f KB uploaded, %.2f %% of the %.1f MB buffer",
+                 double( stats.bytes ) / 1024.0,
+                 whole ? 100.0 * double( stats.bytes ) / double( whole ) : 0.0,
+                 double( whole ) / ( 1024.0 * 1024.0 ) );
+    ImGui::Text( "%.3f ms touching, %.3f ms collecting and encoding, %.3f ms GPU copy", stats.touchMs, stats.flushMs, stats.gpuMs );
+
+    if ( ImGui::Button( "Verify" ) )
+    {
+      global::obj::device.waitIdle();
+      scene.verify();
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "Reads the instance buffer back and compares every slot with the registry" );
+    if ( scene.verified )
+    {
+      ImGui::SameLine();
+      if ( scene.mismatches == 0 )
+        ImGui::Text( "all %u slots match", scene.capacity );
+      else
+        ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%u of %u slots differ", scene.mismatches, scene.capacity );
+    }
+
+    ImGui::End();
+  }
+
+  inline void renderSpheresWindow()
+  {
+    auto & sim    = global::obj::verlet;
+    auto & params = global::obj::verletParams;
+
+    ImGui::Begin( "Spheres" );
+
+    int count = static_cast<int>( params.count );
+    if ( ImGui::SliderInt( "Count", &count, 1, static_cast<int>( core::VerletSim::MaxSpheres ), "%d", ImGuiSliderFlags_Logarithmic ) )
+      params.count = static_cast<uint32_t>( count );
+    ImGui::SliderFloat( "Radius", &params.radius, 0.1f, data::instanceMaxScale * data::modelRadius );
+    ImGui::SliderFloat3( "Container min", &params.boundsMin.x, -1000.0f, 0.0f );
+    ImGui::SliderFloat3( "Container max", &params.boundsMax.x, 0.0f, 1000.0f );
+    ImGui::SliderFloat( "Launch speed", &params.launchSpeed, 0.0f, 50.0f );
+    int seed = static_cast<int>( params.seed );
+    if ( ImGui::InputInt( "Seed", &seed ) )
+      params.seed = static_cast<uint32_t>( seed );
+    int softBodies = static_cast<int>( params.softBodies );
+    if ( ImGui::SliderInt( "Soft bodies", &softBodies, 0, 10000, "%d", ImGuiSliderFlags_Logarithmic ) )
+      params.softBodies = static_cast<uint32_t>( softBodies );
+    int softBodySize = static_cast<int>( params.softBodySize );
+    if ( ImGui::SliderInt( "Soft body edge", &softBodySize, 2, 8 ) )
+      params.softBodySize = static_cast<uint32_t>( softBodySize );
+
+    if ( ImGui::Button( "Reset" ) )
+    {
+      try
+      {
+        resetSpheres();
+        sim.error.clear();
+      }
+      catch ( std::exception const & e )
+      {
+        sim.error = e.what();
+        setSceneSource( global::obj::sceneSource );  // a failure halfway may have destroyed what the scene draws
+      }
+    }
+    ImGui::SameLine();
+    ImGui::Text( "%.1f MB state, %.1f MB instances",
+                 double( params.count ) * 2.0 * sizeof( glm::vec4 ) / ( 1024.0 * 1024.0 ),
+                 double( params.count * core::instanceStride( data::instanceFormat ) ) / ( 1024.0 * 1024.0 ) );
+
+    // Take effect on the running simulation
+    int substeps = static_cast<int>( params.substeps );
+    if ( ImGui::SliderInt( "Substeps", &substeps, 1, 32 ) )
+      params.substeps = static_cast<uint32_t>( substeps );
+    ImGui::SliderFloat3( "Gravity", &params.gravity.x, -20.0f, 20.0f );
+    ImGui::SliderFloat( "Damping", &params.damping, 0.0f, 0.01f, "%.4f" );
+    ImGui::Checkbox( "Collisions", &params.collisions );
+    ImGui::SameLine();
+    ImGui::SliderFloat( "Relaxation", &params.relaxation, 0.1f, 1.0f );
+    ImGui::SliderFloat( "Compliance", &params.springs.compliance, 1e-9f, 1e-2f, "%.1e", ImGuiSliderFlags_Logarithmic );
+    ImGui::SliderFloat( "Break stretch", &params.springs.breakStretch, 0.0f, 2.0f, params.springs.breakStretch > 0.0f ? "%.2f" : "never" );
+    int iterations = static_cast<int>( params.springs.iterations );
+    if ( ImGui::SliderInt( "Spring iterations", &iterations, 1, 16 ) )
+      params.springs.iterations = static_cast<uint32_t>( iterations );
+    sim.params.substeps   = params.substeps;
+    sim.params.gravity    = params.gravity;
+    sim.params.damping    = params.damping;
+    sim.params.collisions = params.collisions;
+    sim.params.relaxation = params.relaxation;
+    sim.params.springs    = params.springs;
+
+    bool drawn = global::obj::sceneSource == core::SceneSource::GpuSpheres;
+    ImGui::BeginDisabled( sim.count == 0 );
+    if ( ImGui::Checkbox( "Draw spheres", &drawn ) )
+      setSceneSource( drawn ? core::SceneSource::GpuSpheres : core::SceneSource::Instances );
+    ImGui::SameLine();
+    ImGui::Checkbox( "Paused", &sim.paused );
+    ImGui::EndDisabled();
+
+    if ( !sim.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", sim.error.c_str() );
+    if ( sim.count > 0 )
+      ImGui::Text( "%u spheres, %llu substeps, %.3f ms GPU per frame",
+                   sim.count,
+                   static_cast<unsigned long long>( sim.substeps ),
+                   drawn && !sim.paused ? sim.gpuMs : 0.0f );
+    if ( sim.xpbd.springCount > 0 )
+      ImGui::Text( "%u springs in %u colors, %u broken", sim.xpbd.springCount, sim.xpbd.colorCount(), sim.xpbd.brokenCount() );
+
+    ImGui::SeparatorText( "Sensors" );
+
+    auto & sensors = global::obj::sphereSensors;
+    int    tracked = static_cast<int>( sensors.tracked );
+    ImGui::BeginDisabled( sensors.enabled );
+    if ( ImGui::SliderInt( "Tracked spheres", &tracked, 1, 1 << 20, "%d", ImGuiSliderFlags_Logarithmic ) )
+      sensors.tracked = static_cast<uint32_t>( tracked );
+    ImGui::EndDisabled();
+    bool sensing = sensors.enabled;
+    if ( ImGui::Checkbox( "Read back", &sensing ) )
+    {
+      global::obj::device.waitIdle();
+      if ( sensing )
+        sensors.start();
+      else
+        sensors.stop();
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "Copies the first spheres to the host every frame, delivered once the GPU passed them" );
+    if ( sensors.enabled && sensors.last.count > 0 )
+    {
+      auto const & reading = sensors.last;
+      ImGui::Text( "Frame %llu (%llu frames late): %u spheres, centroid %.2f %.2f %.2f, height %.2f to %.2f",
+                   static_cast<unsigned long long>( reading.frame ),
+                   static_cast<unsigned long long>( reading.latency ),
+                   reading.count,
+                   reading.centroid.x,
+                   reading.centroid.y,
+                   reading.centroid.z,
+                   reading.lowest,
+                   reading.highest );
+      ImGui::Text( "%llu delivered, %llu dropped",
+                   static_cast<unsigned long long>( sensors.ring.delivered ),
+                   static_cast<unsigned long long>( sensors.ring.dropped ) );
+    }
+
+    ImGui::SeparatorText( "Broadphase validation" );
+
+    auto & validation = global::obj::gridValidation;
+    int    checked    = static_cast<int>( validation.count );
+    if ( ImGui::SliderInt( "Spheres", &checked, 1, static_cast<int>( core::VerletSim::MaxSpheres ), "%d", ImGuiSliderFlags_Logarithmic ) )
+      validation.count = static_cast<uint32_t>( checked );
+    int hardwareThreads   = static_cast<int>( std::max( 1u, std::thread::hardware_concurrency() ) );
+    int validationThreads = static_cast<int>( validation.threads );
+    if ( ImGui::SliderInt( "CPU threads", &validationThreads, 0, hardwareThreads, validationThreads ? "%d" : "all" ) )
+      validation.threads = static_cast<uint32_t>( validationThreads );
+
+    if ( ImGui::Button( "Validate grid" ) )
+    {
+      global::obj::device.waitIdle();
+      validation.run( global::obj::device,
+                      global::obj::physicalDevice,
+                      global::obj::allocator,
+                      global::obj::bindless,
+                      global::obj::queueFamilyIndices.graphicsFamily.value(),
+                      global::obj::graphicsQueue,
+                      global::state::frameCount );
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "One GPU broadphase and collision pass against the CPU reference, small counts also against every pair" );
+
+    if ( !validation.results.empty() && ImGui::BeginTable( "grid", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Spheres" );
+      ImGui::TableSetupColumn( "Contacts" );
+      ImGui::TableSetupColumn( "Max error" );
+      ImGui::TableSetupColumn( "CPU ms" );
+      ImGui::TableSetupColumn( "Result" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : validation.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.count );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%llu", static_cast<unsigned long long>( result.contactsGpu ) );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.2e", result.maxError );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.2f (%u threads)", result.cpuBuildMs + result.cpuCollideMs, result.threads );
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( result.error.empty() ? "valid" : result.error.c_str() );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::SeparatorText( "Scaling benchmark" );
+
+    auto & bench  = global::obj::verletBenchmark;
+    int    frames = static_cast<int>( bench.frames );
+    if ( ImGui::SliderInt( "Frames", &frames, 1, 256 ) )
+      bench.frames = static_cast<uint32_t>( frames );
+
+    if ( ImGui::Button( "Run counts" ) )
+    {
+      global::obj::device.waitIdle();
+      try
+      {
+        bench.run( global::obj::device,
+                   global::obj::physicalDevice,
+                   global::obj::allocator,
+                   global::obj::bindless,
+                   params,
+                   global::obj::queueFamilyIndices.graphicsFamily.value(),
+                   global::obj::graphicsQueue,
+                   global::state::frameCount );
+        sim.error.clear();
+      }
+      catch ( std::exception const & e )
+      {
+        sim.error = e.what();
+      }
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "10k to 4M spheres with the substeps above, GPU time only" );
+
+    if ( !bench.results.empty() && ImGui::BeginTable( "verlet", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Spheres" );
+      ImGui::TableSetupColumn( "ms/frame" );
+      ImGui::TableSetupColumn( "ms/substep" );
+      ImGui::TableSetupColumn( "M substeps/s" );
+      ImGui::TableSetupColumn( "GB/s" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : bench.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.count );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.3f", result.msPerFrame );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.3f", result.msPerSubstep );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.spheresPerSecond );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.gigabytesPerSecond );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::SeparatorText( "CPU backend" );
+
+    auto & cpu        = global::obj::cpuVerlet;
+    int    cpuThreads = static_cast<int>( cpu.threads );
+    if ( ImGui::SliderInt( "Threads", &cpuThreads, 0, hardwareThreads, cpuThreads ? "%d" : "all" ) )
+      cpu.threads = static_cast<uint32_t>( cpuThreads );
+    ImGui::Checkbox( "Scalar kernels", &cpu.scalar );
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "The portable kernels in place of %s, bitwise equal results",
+                         core::CpuVerletSim::nativeKernel() );
+
+    if ( ImGui::Button( "Reset on CPU" ) )
+    {
+      try
+      {
+        resetCpuSpheres();
+        cpu.error.clear();
+      }
+      catch ( std::exception const & e )
+      {
+        cpu.error = e.what();
+        setSceneSource( global::obj::sceneSource );  // a failure halfway may have destroyed what the scene draws
+      }
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "Seeds the spheres above on the CPU threads, the thread count applies here" );
+    ImGui::SameLine();
+    bool cpuDrawn = global::obj::sceneSource == core::SceneSource::CpuSpheres;
+    ImGui::BeginDisabled( !cpu.drawable() );
+    if ( ImGui::Checkbox( "Draw CPU spheres", &cpuDrawn ) )
+      setSceneSource( cpuDrawn ? core::SceneSource::CpuSpheres : core::SceneSource::Instances );
+    ImGui::SameLine();
+    ImGui::Checkbox( "Paused##cpu", &cpu.paused );
+    ImGui::EndDisabled();
+    cpu.params.substeps   = params.substeps;
+    cpu.params.gravity    = params.gravity;
+    cpu.params.damping    = params.damping;
+    cpu.params.collisions = params.collisions;
+    cpu.params.relaxation = params.relaxation;
+
+    if ( !cpu.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", cpu.error.c_str() );
+    if ( cpu.count > 0 )
+    {
+      ImGui::Text( "%u spheres, %llu substeps, %llu contacts, %u threads (%s), %llu steals",
+                   cpu.count,
+                   static_cast<unsigned long long>( cpu.substeps ),
+                   static_cast<unsigned long long>( cpu.contacts ),
+                   cpu.threadCount(),
+                   cpu.kernel(),
+                   static_cast<unsigned long long>( cpu.steals() ) );
+      ImGui::Text( "%.2f ms per frame: integrate %.2f, sort %.2f, collide %.2f, encode %.2f",
+                   cpu.frameMs,
+                   cpu.timings.integrateMs,
+                   cpu.timings.sortMs,
+                   cpu.timings.collideMs,
+                   cpu.timings.encodeMs );
+    }
+
+    auto & cpuBench = global::obj::cpuVerletBenchmark;
+    if ( ImGui::Button( "Run CPU counts" ) )
+    {
+      cpuBench.threads = cpu.threads;
+      cpuBench.scalar  = cpu.scalar;
+      cpuBench.frames  = bench.frames;
+      cpuBench.run( params );
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "10k to 1M spheres with the substeps above, up to 100k also checked against one thread" );
+    if ( !cpuBench.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", cpuBench.error.c_str() );
+
+    if ( !cpuBench.results.empty() && ImGui::BeginTable( "cpu verlet", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Spheres" );
+      ImGui::TableSetupColumn( "Threads" );
+      ImGui::TableSetupColumn( "ms/frame" );
+      ImGui::TableSetupColumn( "Substeps/s" );
+      ImGui::TableSetupColumn( "M substeps/s" );
+      ImGui::TableSetupColumn( "Deterministic" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : cpuBench.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.count );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.threads );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.2f", result.msPerFrame );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.0f", result.stepsPerSecond );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.spheresPerSecond );
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( result.checked ? ( result.deterministic ? "matches 1 thread" : "DIFFERS" ) : "-" );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::End();
+  }
+
+  inline void renderConstraintsWindow()
+  {
+    auto & validation = global::obj::xpbdValidation;
+    auto & bench      = global::obj::xpbdBenchmark;
+
+    ImGui::Begin( "Constraints" );
+
+    int bodies = static_cast<int>( validation.bodies );
+    if ( ImGui::SliderInt( "Soft bodies", &bodies, 1, 10000, "%d", ImGuiSliderFlags_Logarithmic ) )
+      validation.bodies = static_cast<uint32_t>( bodies );
+    int size = static_cast<int>( validation.size );
+    if ( ImGui::SliderInt( "Edge", &size, 2, 8 ) )
+      validation.size = bench.size = static_cast<uint32_t>( size );
+    int iterations = static_cast<int>( validation.params.iterations );
+    if ( ImGui::SliderInt( "Iterations", &iterations, 1, 16 ) )
+      validation.params.iterations = static_cast<uint32_t>( iterations );
+    ImGui::SliderFloat( "Compliance", &validation.params.compliance, 1e-9f, 1e-2f, "%.1e", ImGuiSliderFlags_Logarithmic );
+    ImGui::SliderFloat( "Break stretch", &validation.breakStretch, 0.01f, 1.0f );
+    bench.params.compliance = validation.params.compliance;
+
+    if ( ImGui::Button( "Validate XPBD" ) )
+    {
+      global::obj::device.waitIdle();
+      try
+      {
+        validation.run( global::obj::device,
+                        global::obj::physicalDevice,
+                        global::obj::allocator,
+                        global::obj::bindless,
+                        global::obj::queueFamilyIndices.graphicsFamily.value(),
+                        global::obj::graphicsQueue,
+                        global::state::frameCount );
+        validation.error.clear();
+      }
+      catch ( std::exception const & e )
+      {
+        validation.error = e.what();
+      }
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "Jittered soft bodies solved on the GPU and by the CPU reference, without and with breaking" );
+    if ( !validation.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", validation.error.c_str() );
+
+    if ( !validation.results.empty() && ImGui::BeginTable( "xpbd", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Pass" );
+      ImGui::TableSetupColumn( "Springs" );
+      ImGui::TableSetupColumn( "Broken" );
+      ImGui::TableSetupColumn( "Max error" );
+      ImGui::TableSetupColumn( "GPU / CPU ms" );
+      ImGui::TableSetupColumn( "Result" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : validation.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( result.pass.c_str() );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u (%u colors)", result.springs, result.colors );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u / %u", result.brokenGpu, result.brokenCpu );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.2e", result.maxError );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.3f / %.2f", result.gpuMs, result.cpuMs );
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( result.error.empty() ? "valid" : result.error.c_str() );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::SeparatorText( "Benchmark" );
+
+    int timed = static_cast<int>( bench.iterations );
+    if ( ImGui::SliderInt( "Timed iterations", &timed, 1, 256 ) )
+      bench.iterations = static_cast<uint32_t>( timed );
+
+    if ( ImGui::Button( "Run spring counts" ) )
+    {
+      global::obj::device.waitIdle();
+      try
+      {
+        bench.run( global::obj::device,
+                   global::obj::physicalDevice,
+                   global::obj::allocator,
+                   global::obj::bindless,
+                   global::obj::queueFamilyIndices.graphicsFamily.value(),
+                   global::obj::graphicsQueue,
+                   global::state::frameCount );
+        validation.error.clear();
+      }
+      catch ( std::exception const & e )
+      {
+        validation.error = e.what();
+      }
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "10k to 4M springs, every color once per iteration; the CPU reference runs on one thread up to 1M springs" );
+
+    if ( !bench.results.empty() && ImGui::BeginTable( "xpbdBench", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Springs" );
+      ImGui::TableSetupColumn( "Colors" );
+      ImGui::TableSetupColumn( "GPU ms/iteration" );
+      ImGui::TableSetupColumn( "GPU iterations/s" );
+      ImGui::TableSetupColumn( "GB/s" );
+      ImGui::TableSetupColumn( "CPU iterations/s" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : bench.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.springs );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.colors );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.3f", result.gpuMsPerIteration );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.0f", result.gpuIterationsPerSecond );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.gpuGigabytesPerSecond );
+        ImGui::TableNextColumn();
+        if ( result.cpuIterationsPerSecond > 0.0f )
+          ImGui::Text( "%.0f", result.cpuIterationsPerSecond );
+        else
+          ImGui::TextUnformatted( "-" );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::End();
+  }
+
+  inline void renderReadbackWindow()
+  {
+    auto & stress = global::obj::readbackStress;
+
+    ImGui::Begin( "Readback" );
+
+    int megabytes = static_cast<int>( stress.megabytes );
+    ImGui::BeginDisabled( stress.enabled );
+    if ( ImGui::SliderInt( "MB per frame", &megabytes, 1, 256, "%d", ImGuiSliderFlags_Logarithmic ) )
+      stress.megabytes = static_cast<uint32_t>( megabytes );
+    ImGui::EndDisabled();
+
+    bool running = stress.enabled;
+    if ( ImGui::Checkbox( "Stress ring", &running ) )
+    {
+      global::obj::device.waitIdle();
+      try
+      {
+        if ( running )
+          stress.start();
+        else
+          stress.stop();
+      }
+      catch ( std::exception const & e )
+      {
+        stress.stop();
+        stress.error = e.what();
+      }
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "Fills a buffer every frame and reads it back through the ring, every word of every frame is checked" );
+
+    if ( stress.frames > 0 )
+    {
+      float seconds = ImGui::GetIO().Framerate > 0.0f ? 1.0f / ImGui::GetIO().Framerate : 0.0f;
+      ImGui::Text( "%llu frames delivered, %llu dropped, %llu corrupted",
+                   static_cast<unsigned long long>( stress.frames ),
+                   static_cast<unsigned long long>( stress.ring.dropped ),
+                   static_cast<unsigned long long>( stress.corrupted ) );
+      ImGui::Text( "%.2f frames latency on average, %.2f ms host time per poll, %.0f MB/s",
+                   stress.averageLatency,
+                   stress.pollMs,
+                   seconds > 0.0f ? double( stress.megabytes ) / seconds : 0.0 );
+    }
+    if ( !stress.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", stress.error.c_str() );
+
+    ImGui::End();
+  }
+
+  inline void renderSortWindow()
+  {
+    auto & validation = global::obj::radixSortValidation;
+    auto & bench      = global::obj::radixSortBenchmark;
+
+    ImGui::Begin( "Sorting" );
+    ImGui::Text( "Radix sort, %s path available", core::subgroupArithmeticSupported( global::obj::physicalDevice ) ? "subgroup and portable" : "portable" );
+
+    int keyBits = static_cast<int>( validation.keyBits );
+    if ( ImGui::SliderInt( "Key bits", &keyBits, 1, 32 ) )
+    {
+      validation.keyBits = static_cast<uint32_t>( keyBits );
+      bench.keyBits      = validation.keyBits;
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "Random keys below 2^bits, one digit pass per 4 bits" );
+
+    ImGui::SeparatorText( "Validation" );
+
+    int count = static_cast<int>( validation.count );
+    if ( ImGui::SliderInt( "Keys", &count, 1, 1 << 24, "%d", ImGuiSliderFlags_Logarithmic ) )
+      validation.count = static_cast<uint32_t>( count );
+    int seed = static_cast<int>( validation.seed );
+    if ( ImGui::InputInt( "Seed", &seed ) )
+      validation.seed = static_cast<uint32_t>( seed );
+
+    if ( ImGui::Button( "Validate sort" ) )
+    {
+      global::obj::device.waitIdle();
+      validation.run( global::obj::device,
+                      global::obj::physicalDevice,
+                      global::obj::allocator,
+                      global::obj::bindless,
+                      global::obj::queueFamilyIndices.graphicsFamily.value(),
+                      global::obj::graphicsQueue,
+                      global::state::frameCount );
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "Keys only and with their index as value on every path, against std::stable_sort" );
+
+    if ( !validation.results.empty() && ImGui::BeginTable( "sortcheck", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Keys" );
+      ImGui::TableSetupColumn( "Path" );
+      ImGui::TableSetupColumn( "GPU ms" );
+      ImGui::TableSetupColumn( "CPU ms" );
+      ImGui::TableSetupColumn( "Result" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : validation.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u%s", result.count, result.values ? " + values" : "" );
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( result.subgroups ? "subgroups" : "portable" );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.3f", result.gpuMs );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.2f", result.cpuMs );
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( result.error.empty() ? "valid" : result.error.c_str() );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::SeparatorText( "Benchmark" );
+
+    int iterations = static_cast<int>( bench.iterations );
+    if ( ImGui::SliderInt( "Iterations", &iterations, 1, 64 ) )
+      bench.iterations = static_cast<uint32_t>( iterations );
+
+    if ( ImGui::Button( "Run counts" ) )
+    {
+      global::obj::device.waitIdle();
+      bench.run( global::obj::device,
+                 global::obj::physicalDevice,
+                 global::obj::allocator,
+                 global::obj::bindless,
+                 global::obj::queueFamilyIndices.graphicsFamily.value(),
+                 global::obj::graphicsQueue,
+                 global::state::frameCount );
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "64k to 16M keys, GPU time of the sort only" );
+
+    if ( !bench.results.empty() && ImGui::BeginTable( "sortbench", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Keys" );
+      ImGui::TableSetupColumn( "Path" );
+      ImGui::TableSetupColumn( "ms" );
+      ImGui::TableSetupColumn( "M keys/s" );
+      ImGui::TableSetupColumn( "GB/s" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : bench.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u%s", result.count, result.values ? " + values" : "" );
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( result.subgroups ? "subgroups" : "portable" );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.3f", result.ms );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.0f", result.keysPerSecond );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.gigabytesPerSecond );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::End();
+  }
+
+  inline void renderScanWindow()
+  {
+    auto & config     = global::obj::scanConfig;
+    auto & validation = global::obj::scanValidation;
+    auto & bench      = global::obj::scanBenchmark;
+
+    ImGui::Begin( "Scan" );
+    ImGui::Text( "Scan, reduce and compact, %s path available",
+                 core::subgroupArithmeticSupported( global::obj::physicalDevice ) ? "subgroup and portable" : "portable" );
+
+    // Specialization constants, both runs below create their shaders with them
+    int groupSizeLog = std::countr_zero( config.groupSize );
+    if ( ImGui::SliderInt( "Workgroup size", &groupSizeLog, 5, 10, std::to_string( 1u << groupSizeLog ).c_str() ) )
+      config.groupSize = 1u << groupSizeLog;
+    int items = static_cast<int>( config.itemsPerThread );
+    if ( ImGui::SliderInt( "Items per invocation", &items, 1, static_cast<int>( core::Scan::MaxItemsPerThread ) ) )
+      config.itemsPerThread = static_cast<uint32_t>( items );
+    ImGui::Text( "%u elements per workgroup", config.tileSize() );
+
+    ImGui::SeparatorText( "Validation" );
+
+    int count = static_cast<int>( validation.count );
+    if ( ImGui::SliderInt( "Elements", &count, 1, 1 << 24, "%d", ImGuiSliderFlags_Logarithmic ) )
+      validation.count = static_cast<uint32_t>( count );
+
+    if ( ImGui::Button( "Validate scan" ) )
+    {
+      global::obj::device.waitIdle();
+      try
+      {
+        validation.error.clear();
+        validation.run( global::obj::device,
+                        global::obj::physicalDevice,
+                        global::obj::allocator,
+                        global::obj::bindless,
+                        config,
+                        global::obj::queueFamilyIndices.graphicsFamily.value(),
+                        global::obj::graphicsQueue,
+                        global::state::frameCount );
+      }
+      catch ( std::exception const & e )
+      {
+        validation.error = e.what();
+      }
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "Every operation on every path against std::inclusive_scan, std::exclusive_scan, std::reduce and std::copy_if" );
+
+    if ( !validation.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", validation.error.c_str() );
+    if ( !validation.results.empty() && ImGui::BeginTable( "scancheck", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Elements" );
+      ImGui::TableSetupColumn( "Path" );
+      ImGui::TableSetupColumn( "Checks" );
+      ImGui::TableSetupColumn( "Result" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : validation.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.count );
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( result.subgroups ? "subgroups" : "portable" );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.checks );
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( result.error.empty() ? "valid" : result.error.c_str() );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::SeparatorText( "Benchmark" );
+
+    int iterations = static_cast<int>( bench.iterations );
+    if ( ImGui::SliderInt( "Iterations", &iterations, 1, 64 ) )
+      bench.iterations = static_cast<uint32_t>( iterations );
+
+    if ( ImGui::Button( "Run counts" ) )
+    {
+      global::obj::device.waitIdle();
+      try
+      {
+        bench.error.clear();
+        bench.run( global::obj::device,
+                   global::obj::physicalDevice,
+                   global::obj::allocator,
+                   global::obj::bindless,
+                   config,
+                   global::obj::queueFamilyIndices.graphicsFamily.value(),
+                   global::obj::graphicsQueue,
+                   global::state::frameCount );
+      }
+      catch ( std::exception const & e )
+      {
+        bench.error = e.what();
+      }
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "64k to 16M elements, GPU time of each operation only" );
+
+    if ( !bench.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", bench.error.c_str() );
+    if ( !bench.results.empty() && ImGui::BeginTable( "scanbench", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Operation" );
+      ImGui::TableSetupColumn( "Elements" );
+      ImGui::TableSetupColumn( "Path" );
+      ImGui::TableSetupColumn( "ms" );
+      ImGui::TableSetupColumn( "GB/s" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : bench.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( core::ScanBenchmark::passName( result.pass ) );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.count );
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( result.subgroups ? "subgroups" : "portable" );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.3f", result.ms );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.gigabytesPerSecond );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::End();
+  }
+
+  inline void renderMeshletsWindow()
+  {
+    auto const & model = global::obj::model;
+    auto &       bench = global::obj::meshletBenchmark;
+
+    ImGui::Begin( "Meshlets" );
+
+    ImGui::Text( "Limits: %u vertices, %u triangles", core::MeshletMaxVertices, core::MeshletMaxTriangles );
+    for ( uint32_t lod = 0; lod < model.lods.size(); ++lod )
+      ImGui::Text( "LOD %u: %u triangles in %u meshlets", lod, model.lods[lod].triangleCount(), model.lods[lod].meshletCount );
+
+    ImGui::SeparatorText( "Build benchmark" );
+
+    int subdivisions = static_cast<int>( bench.subdivisions );
+    int meshCount    = static_cast<int>( bench.meshCount );
+    int threads      = static_cast<int>( bench.threads );
+    if ( ImGui::SliderInt( "Subdivisions", &subdivisions, 3, 9 ) )
+      bench.subdivisions = static_cast<uint32_t>( subdivisions );
+    if ( ImGui::SliderInt( "Meshes", &meshCount, 1, 64 ) )
+      bench.meshCount = static_cast<uint32_t>( meshCount );
+    if ( ImGui::SliderInt( "Threads", &threads, 0, static_cast<int>( std::max( 1u, std::thread::hardware_concurrency() ) ), threads ? "%d" : "all" ) )
+      bench.threads = static_cast<uint32_t>( threads );
+    ImGui::Text( "%.2f M triangles per run", double( bench.meshCount ) * 20.0 * std::pow( 4.0, bench.subdivisions ) * 1e-6 );
+
+    if ( ImGui::Button( "Run build" ) )
+      bench.run();
+
+    if ( !bench.results.empty() && ImGui::BeginTable( "meshlets", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Threads" );
+      ImGui::TableSetupColumn( "Build ms" );
+      ImGui::TableSetupColumn( "M triangles/s" );
+      ImGui::TableSetupColumn( "Meshlets" );
+      ImGui::TableSetupColumn( "Avg v / t" );
+      ImGui::TableSetupColumn( "Cache MB / ms" );
+      ImGui::TableSetupColumn( "Check" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : bench.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.threads );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.buildMs );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.buildMs > 0.0f ? double( result.triangles ) / result.buildMs * 1e-3 : 0.0 );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.meshlets );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f / %.1f", result.avgVertices, result.avgTriangles );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f / %.2f", double( result.cacheBytes ) / ( 1024.0 * 1024.0 ), result.loadMs );
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( result.error.empty() ? "valid" : result.error.c_str() );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::End();
+  }
+
+  // Reallocates the terrain for its current layout, every chunk is meshed again over the next frames
+  inline void rebuildTerrain()
+  {
+    auto & volume = global::obj::sdfVolume;
+    global::obj::device.waitIdle();
+    try
+    {
+      volume.error.clear();
+      volume.rebuild( global::obj::bindless, global::state::frameCount );
+    }
+    catch ( std::exception const & e )
+    {
+      volume.error = e.what();
+      volume.destroy( global::obj::bindless, global::state::frameCount );
+    }
+  }
+
+  inline void renderTerrainWindow()
+  {
+    auto & volume     = global::obj::sdfVolume;
+    auto & validation = global::obj::marchingCubesValidation;
+
+    static float editRadius = 8.0f;
+
+    ImGui::Begin( "Terrain" );
+
+    // Layout, applied by Rebuild
+    auto & layout    = volume.layout;
+    int    chunks[3] = { static_cast<int>( layout.chunks.x ), static_cast<int>( layout.chunks.y ), static_cast<int>( layout.chunks.z ) };
+    if ( ImGui::SliderInt3( "Chunks", chunks, 1, 8 ) )
+      layout.chunks = glm::uvec3( chunks[0], chunks[1], chunks[2] );
+    int cells = static_cast<int>( layout.cells );
+    if ( ImGui::SliderInt( "Cells per chunk", &cells, 8, 64 ) )
+      layout.cells = static_cast<uint32_t>( cells );
+    ImGui::SliderFloat( "Voxel size", &layout.voxelSize, 0.25f, 4.0f );
+    int vertices = static_cast<int>( layout.verticesPerSlot );
+    if ( ImGui::SliderInt( "Vertices per chunk", &vertices, 1024, 1 << 18, "%d", ImGuiSliderFlags_Logarithmic ) )
+      layout.verticesPerSlot = static_cast<uint32_t>( vertices );
+    int indices = static_cast<int>( layout.indicesPerSlot );
+    if ( ImGui::SliderInt( "Indices per chunk", &indices, 3072, 1 << 20, "%d", ImGuiSliderFlags_Logarithmic ) )
+      layout.indicesPerSlot = static_cast<uint32_t>( indices );
+
+    if ( ImGui::Button( "Rebuild" ) )
+      rebuildTerrain();
+    ImGui::SameLine();
+    bool enabled = volume.enabled;
+    if ( ImGui::Checkbox( "Draw terrain", &enabled ) )
+    {
+      if ( enabled && volume.surface.empty() )
+        rebuildTerrain();
+      volume.enabled = enabled && !volume.surface.empty();
+    }
+    if ( !volume.surface.empty() )
+      ImGui::Text( "%u chunks of %.0f units, %.1f MB of slots",
+                   volume.chunkCount(),
+                   volume.chunkSize(),
+                   double( volume.surface.bytes() ) / ( 1024.0 * 1024.0 ) );
+
+    // Shape, every chunk is re-meshed when it changes
+    bool changed = ImGui::SliderFloat3( "Center", &volume.scene.center.x, -500.0f, 500.0f );
+    changed |= ImGui::SliderFloat( "Radius", &volume.scene.radius, 1.0f, 150.0f );
+    changed |= ImGui::SliderFloat( "Hills", &volume.scene.amplitude, 0.0f, 20.0f );
+    changed |= ImGui::SliderFloat( "Hill frequency", &volume.scene.frequency, 0.01f, 0.5f );
+    changed |= ImGui::SliderFloat( "Mesa", &volume.scene.mesa, 0.0f, 40.0f );
+    changed |= ImGui::SliderFloat( "Edit smoothness", &volume.scene.smoothness, 0.0f, 10.0f );
+    if ( changed && !volume.surface.empty() )
+      volume.markAllDirty();
+
+    int budget = static_cast<int>( volume.budget );
+    if ( ImGui::SliderInt( "Chunks per frame", &budget, 1, static_cast<int>( core::MarchingCubes::MaxJobs ) ) )
+      volume.budget = static_cast<uint32_t>( budget );
+
+    ImGui::SeparatorText( "Edits" );
+
+    ImGui::SliderFloat( "Edit radius", &editRadius, 1.0f, 40.0f );
+    ImGui::BeginDisabled( volume.surface.empty() );
+    for ( float sign : { -1.0f, 1.0f } )
+    {
+      if ( sign > 0.0f )
+        ImGui::SameLine();
+      if ( ImGui::Button( sign < 0.0f ? "Carve" : "Add" ) )
+      {
+        float     yaw   = global::state::cameraRotation.x;
+        float     pitch = global::state::cameraRotation.y;
+        glm::vec3 view  = glm::vec3( std::cos( pitch ) * std::sin( yaw ), std::sin( pitch ), std::cos( pitch ) * std::cos( yaw ) );
+        if ( auto hit = volume.raycast( global::state::cameraPosition, view, 2000.0f ) )
+        {
+          if ( !volume.addEdit( glm::vec4( *hit, sign * editRadius ) ) )
+            volume.error = "The edit list is full";
+        }
+        else
+          volume.error = "The camera does not look at the terrain";
+      }
+      if ( ImGui::IsItemHovered() )
+        ImGui::SetTooltip( "Where the camera looks at the terrain, only the chunks the sphere reaches are re-meshed" );
+    }
+    ImGui::SameLine();
+    if ( ImGui::Button( "Clear edits" ) )
+      volume.clearEdits();
+    ImGui::EndDisabled();
+
+    if ( !volume.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", volume.error.c_str() );
+    if ( !volume.surface.empty() )
+      ImGui::Text( "%zu edits, %u chunks dirty, %llu meshed, %.3f ms GPU per frame",
+                   volume.edits.size(),
+                   volume.dirtyCount(),
+                   static_cast<unsigned long long>( volume.meshed ),
+                   volume.enabled ? volume.gpuMs : 0.0f );
+
+    ImGui::SeparatorText( "Validation" );
+
+    if ( ImGui::Button( "Validate meshing" ) )
+    {
+      global::obj::device.waitIdle();
+      try
+      {
+        validation.error.clear();
+        validation.scene  = volume.scene;
+        validation.layout = volume.layout;
+        validation.run( global::obj::device,
+                        global::obj::physicalDevice,
+                        global::obj::allocator,
+                        global::obj::bindless,
+                        global::obj::queueFamilyIndices.graphicsFamily.value(),
+                        global::obj::graphicsQueue,
+                        global::state::frameCount );
+      }
+      catch ( std::exception const & e )
+      {
+        validation.error = e.what();
+      }
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "Meshes the current shape with the layout above, then re-meshes after two edits, against the CPU mesher" );
+
+    if ( !validation.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", validation.error.c_str() );
+    if ( !validation.results.empty() && ImGui::BeginTable( "mccheck", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Pass" );
+      ImGui::TableSetupColumn( "Chunks" );
+      ImGui::TableSetupColumn( "Vertices" );
+      ImGui::TableSetupColumn( "Triangles" );
+      ImGui::TableSetupColumn( "Field error" );
+      ImGui::TableSetupColumn( "GPU ms" );
+      ImGui::TableSetupColumn( "CPU ms" );
+      ImGui::TableSetupColumn( "Result" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : validation.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( result.pass.c_str() );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.chunks );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.vertices );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.triangles );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1e", result.maxFieldError );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.3f", result.gpuMs );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.cpuMs );
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( result.error.empty() ? "valid" : result.error.c_str() );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::SeparatorText( "Dual contouring" );
+
+    auto & contouring = global::obj::dualContouringComparison;
+    ImGui::SliderFloat( "Error threshold", &contouring.threshold, 0.0f, 1.0f, "%.3f", ImGuiSliderFlags_Logarithmic );
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "Largest QEF error of a collapsed octree node, in squared voxels" );
+    int contouringThreads = static_cast<int>( contouring.threads );
+    int hardwareThreads   = static_cast<int>( std::max( 1u, std::thread::hardware_concurrency() ) );
+    if ( ImGui::SliderInt( "Contouring threads", &contouringThreads, 0, hardwareThreads, contouringThreads ? "%d" : "all" ) )
+      contouring.threads = static_cast<uint32_t>( contouringThreads );
+
+    if ( ImGui::Button( "Compare meshers" ) )
+    {
+      global::obj::device.waitIdle();
+      try
+      {
+        contouring.error.clear();
+        contouring.run( global::obj::device,
+                        global::obj::physicalDevice,
+                        global::obj::allocator,
+                        global::obj::bindless,
+                        global::obj::queueFamilyIndices.graphicsFamily.value(),
+                        global::obj::graphicsQueue,
+                        global::state::frameCount,
+                        volume.layout,
+                        volume.scene,
+                        volume.edits );
+      }
+      catch ( std::exception const & e )
+      {
+        contouring.error = e.what();
+      }
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "Meshes the current shape and edits with marching cubes and with dual contouring, with and without simplification" );
+    ImGui::SameLine();
+    ImGui::BeginDisabled( contouring.surface.empty() );
+    ImGui::Checkbox( "Show dual contouring", &contouring.show );
+    ImGui::EndDisabled();
+
+    if ( !contouring.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", contouring.error.c_str() );
+    if ( !contouring.results.empty() && ImGui::BeginTable( "dccompare", 9, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Mesher" );
+      ImGui::TableSetupColumn( "Chunks" );
+      ImGui::TableSetupColumn( "Vertices" );
+      ImGui::TableSetupColumn( "Triangles" );
+      ImGui::TableSetupColumn( "Collapsed" );
+      ImGui::TableSetupColumn( "Overflows" );
+      ImGui::TableSetupColumn( "GPU ms" );
+      ImGui::TableSetupColumn( "CPU ms" );
+      ImGui::TableSetupColumn( "Total ms" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : contouring.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( result.mesher.c_str() );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.chunks );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.vertices );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.triangles );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.collapsed );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.overflows );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.3f", result.gpuMs );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.cpuMs );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.totalMs );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::End();
+  }
+
+  inline void rebuildClipmap()
+  {
+    auto & clipmap = global::obj::sdfClipmap;
+    global::obj::device.waitIdle();
+    try
+    {
+      clipmap.error.clear();
+      clipmap.scene = global::obj::sdfVolume.scene;
+      clipmap.rebuild( global::obj::bindless, global::state::frameCount );
+    }
+    catch ( std::exception const & e )
+    {
+      clipmap.error = e.what();
+      clipmap.destroy( global::obj::bindless, global::state::frameCount );
+    }
+  }
+
+  inline void renderClipmapWindow()
+  {
+    auto & clipmap = global::obj::sdfClipmap;
+    auto & layout  = clipmap.layout;
+
+    ImGui::Begin( "Clipmap" );
+
+    // Layout, applied by Rebuild together with the shape of the Terrain window
+    int levels = static_cast<int>( layout.levels );
+    if ( ImGui::SliderInt( "Levels", &levels, 1, static_cast<int>( core::SdfClipmapLayout::MaxLevels ) ) )
+      layout.levels = static_cast<uint32_t>( levels );
+    int ring = static_cast<int>( layout.ring );
+    if ( ImGui::SliderInt( "Ring chunks", &ring, 4, 16 ) )
+      layout.ring = static_cast<uint32_t>( ring + ring % 2 );
+    int cells = static_cast<int>( layout.cells );
+    if ( ImGui::SliderInt( "Cells per chunk", &cells, 8, 32 ) )
+      layout.cells = static_cast<uint32_t>( cells );
+    ImGui::SliderFloat( "Finest voxel", &layout.voxelSize, 0.125f, 4.0f, "%.3f", ImGuiSliderFlags_Logarithmic );
+    int budgetMB = static_cast<int>( layout.budgetMB );
+    if ( ImGui::SliderInt( "Memory budget", &budgetMB, 8, 2048, "%d MB", ImGuiSliderFlags_Logarithmic ) )
+      layout.budgetMB = static_cast<uint32_t>( budgetMB );
+    ImGui::Text( "%u slots of %.0f KB, level 0 chunks of %.1f units", layout.slotCount(), double( layout.bytesPerSlot() ) / 1024.0, layout.chunkSize( 0 ) );
+
+    if ( ImGui::Button( "Rebuild" ) )
+      rebuildClipmap();
+    ImGui::SameLine();
+    bool enabled = clipmap.enabled;
+    if ( ImGui::Checkbox( "Stream around the camera", &enabled ) )
+    {
+      if ( enabled && clipmap.surface.empty() )
+        rebuildClipmap();
+      clipmap.enabled = enabled && !clipmap.surface.empty();
+    }
+    int budget = static_cast<int>( clipmap.budget );
+    if ( ImGui::SliderInt( "Chunks per frame", &budget, 1, static_cast<int>( core::MarchingCubes::MaxJobs ) ) )
+      clipmap.budget = static_cast<uint32_t>( budget );
+
+    if ( !clipmap.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", clipmap.error.c_str() );
+    if ( !clipmap.surface.empty() )
+    {
+      auto const & stats = clipmap.stats;
+      ImGui::Text( "%.0f chunks/s generated, %llu in total, %.3f ms GPU per frame",
+                   stats.perSecond,
+                   static_cast<unsigned long long>( stats.generated ),
+                   clipmap.enabled ? stats.gpuMs : 0.0f );
+      ImGui::Text( "Cache hit rate %.1f %% (%llu hits, %llu misses), %llu evictions",
+                   100.0f * clipmap.hitRate(),
+                   static_cast<unsigned long long>( stats.hits ),
+                   static_cast<unsigned long long>( stats.misses ),
+                   static_cast<unsigned long long>( stats.evictions ) );
+      ImGui::Text( "%u of %u slots resident, %.1f of %u MB, %u chunks cached",
+                   stats.resident,
+                   clipmap.surface.slots,
+                   double( clipmap.residentBytes() ) / ( 1024.0 * 1024.0 ),
+                   layout.budgetMB,
+                   stats.cached );
+      ImGui::Text( "%u missing, %u in flight, %llu overflows, %llu frames without a free slot",
+                   stats.missing,
+                   stats.pending,
+                   static_cast<unsigned long long>( stats.overflows ),
+                   static_cast<unsigned long long>( stats.starved ) );
+
+      std::string perLevel;
+      for ( uint32_t level = 0; level < layout.levels && level < core::SdfClipmapLayout::MaxLevels; ++level )
+        perLevel += ( level ? ", " : "" ) + std::to_string( stats.drawnPerLevel[level] );
+      ImGui::Text( "%u chunks drawn, per level %s", stats.drawn, perLevel.c_str() );
+    }
+
+    ImGui::End();
+  }
+
+  inline void renderSimulationWindow()
+  {
+    auto & simulation = global::obj::simulation;
+    auto & stats      = simulation.stats;
+
+    ImGui::Begin( "Simulation" );
+
+    float rate = simulation.rate.load();
+    if ( ImGui::SliderFloat( "Tick rate", &rate, 10.0f, 1000.0f, "%.0f Hz", ImGuiSliderFlags_Logarithmic ) )
+      simulation.rate.store( rate );
+    float moveSpeed = simulation.moveSpeed.load();
+    if ( ImGui::SliderFloat( "Camera speed", &moveSpeed, 0.5f, 60.0f, "%.1f units/s", ImGuiSliderFlags_Logarithmic ) )
+      simulation.moveSpeed.store( moveSpeed );
+
+    // Measured on the simulation thread, so none of it depends on vsync or the frame time
+    float stepMs = stats.stepMs.load();
+    ImGui::Text( "%.1f ticks/s on the simulation thread, %.1f frames/s rendered", stats.ticksPerSecond.load(), ImGui::GetIO().Framerate );
+    ImGui::Text( "%.4f ms per tick, %.0f ticks/s possible", stepMs, stepMs > 0.0f ? 1000.0f / stepMs : 0.0f );
+    ImGui::Text( "Woke %.3f ms late on average, %llu ticks skipped after falling behind",
+                 stats.wakeLateMs.load(),
+                 static_cast<unsigned long long>( stats.skipped.load() ) );
+    ImGui::Text( "Tick %llu, frame drawn %.2f of the way from the previous tick",
+                 static_cast<unsigned long long>( simulation.latestTick() ),
+                 simulation.interpolation() );
+
+    ImGui::End();
+  }
+
+  inline void renderModelWindow()
+  {
+    static std::array<char, 512> path     = { "./cache/icosphere8.obj" };
+    static int                   threads  = 0;
+    static bool                  optimize = true;
+    auto &                       loader   = global::obj::meshLoader;
+    auto &                       bench    = global::obj::meshLoadBenchmark;
+    auto &                       cooked   = global::obj::cookedLoadBenchmark;
+    auto const &                 model    = global::obj::model;
+
+    ImGui::Begin( "Model" );
+
+    ImGui::Text( "%u LODs, %u triangles at LOD 0", static_cast<uint32_t>( model.lods.size() ), model.lods.empty() ? 0u : model.lods[0].triangleCount() );
+
+    ImGui::InputText( "File", path.data(), path.size() );
+    ImGui::SliderInt( "Threads", &threads, 0, static_cast<int>( std::max( 1u, std::thread::hardware_concurrency() ) ), threads ? "%d" : "all" );
+    ImGui::Checkbox( "Optimize indices (vertex cache, overdraw, vertex fetch)", &optimize );
+
+    ImGui::BeginDisabled( loader.busy() );
+    if ( ImGui::Button( "Load" ) )
+      loader.start( path.data(), static_cast<uint32_t>( threads ), optimize );
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    if ( ImGui::Button( "Write test OBJ" ) )
+      core::MeshLoadBenchmark::writeTestObj( path.data(), 8 );
+    ImGui::SameLine();
+    if ( ImGui::Button( "Cook" ) )
+    {
+      try
+      {
+        core::cookMeshFile( path.data(), core::cookedPathFor( path.data() ), static_cast<uint32_t>( threads ), optimize );
+      }
+      catch ( std::exception const & e )
+      {
+        loader.error = e.what();
+      }
+    }
+    if ( ImGui::IsItemHovered() )
+      ImGui::SetTooltip( "Writes %s, load it to draw the cooked model", core::cookedPathFor( path.data() ).string().c_str() );
+
+    if ( loader.busy() )
+      ImGui::TextUnformatted( "Loading..." );
+    if ( !loader.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", loader.error.c_str() );
+    if ( !loader.history.empty() )
+    {
+      auto const & s = loader.history.back();
+      ImGui::Text( "%s: %u vertices, %u triangles, %u meshlets", s.path.c_str(), s.vertices, s.triangles, s.meshlets );
+      ImGui::Text( "CPU %.1f ms (parse %.1f, convert %.1f, optimize %.1f, meshlets %.1f, staging %.1f)",
+                   s.cpuMs,
+                   s.parseMs,
+                   s.convertMs,
+                   s.optimizeMs,
+                   s.meshletMs,
+                   s.stagingMs );
+      ImGui::Text( "Upload %.1f ms", s.uploadMs );
+    }
+
+    // Every load, so the same file with and without optimization can be compared in the scene pass
+    ImGui::SeparatorText( "Index order" );
+    ImGui::TextWrapped( "ACMR: vertices transformed per triangle, ATVR: per vertex, both for a 16 entry FIFO cache. "
+                        "Draw is the average scene pass GPU time over %u frames after the model was swapped in.",
+                        core::MeshLoader::DrawFrames );
+    if ( !loader.history.empty() && ImGui::BeginTable( "orders", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "File" );
+      ImGui::TableSetupColumn( "Optimized" );
+      ImGui::TableSetupColumn( "ACMR" );
+      ImGui::TableSetupColumn( "ATVR" );
+      ImGui::TableSetupColumn( "Optimize ms" );
+      ImGui::TableSetupColumn( "Draw GPU ms" );
+      ImGui::TableHeadersRow();
+      for ( auto const & s : loader.history )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( std::filesystem::path( s.path ).filename().string().c_str() );
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( s.optimized ? "yes" : "no" );
+        // Cooked loads were analyzed when they were cooked
+        bool analyzed = s.cacheBefore.acmr > 0.0f;
+        ImGui::TableNextColumn();
+        if ( analyzed )
+          ImGui::Text( "%.3f -> %.3f", s.cacheBefore.acmr, s.cacheAfter.acmr );
+        else
+          ImGui::TextUnformatted( "-" );
+        ImGui::TableNextColumn();
+        if ( analyzed )
+          ImGui::Text( "%.3f -> %.3f", s.cacheBefore.atvr, s.cacheAfter.atvr );
+        else
+          ImGui::TextUnformatted( "-" );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", s.optimizeMs );
+        ImGui::TableNextColumn();
+        if ( s.drawFrames > 0 )
+          ImGui::Text( "%.3f (%u)", s.drawMs, s.drawFrames );
+        else
+          ImGui::TextUnformatted( "-" );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::SeparatorText( "Cooked format" );
+    ImGui::BeginDisabled( loader.busy() );
+    if ( ImGui::Button( "Compare source and cooked load" ) )
+      cooked.run( path.data(), global::obj::allocator );
+    ImGui::EndDisabled();
+
+    if ( !cooked.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", cooked.error.c_str() );
+    if ( cooked.valid() && ImGui::BeginTable( "cooked", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Format" );
+      ImGui::TableSetupColumn( "File MB" );
+      ImGui::TableSetupColumn( "Total ms" );
+      ImGui::TableSetupColumn( "Parse / validate" );
+      ImGui::TableSetupColumn( "Staging" );
+      ImGui::TableHeadersRow();
+      for ( auto const & [name, s] : { std::pair{ "source", &cooked.source }, std::pair{ "cooked", &cooked.cooked } } )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted( name );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", double( s->fileBytes ) / ( 1024.0 * 1024.0 ) );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.2f", s->cpuMs );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.2f", s->parseMs );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.2f", s->stagingMs );
+      }
+      ImGui::EndTable();
+      ImGui::Text( "Cooked load %.0fx faster, cooking took %.1f ms", cooked.source.cpuMs / std::max( cooked.cooked.cpuMs, 1e-3 ), cooked.cook.cpuMs );
+    }
+
+    ImGui::SeparatorText( "Load benchmark" );
+    ImGui::BeginDisabled( loader.busy() );
+    if ( ImGui::Button( "Run 1, 2, 4, 8 threads" ) )
+      bench.run( path.data(), global::obj::allocator );
+    ImGui::EndDisabled();
+
+    if ( !bench.error.empty() )
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", bench.error.c_str() );
+    if ( !bench.results.empty() && ImGui::BeginTable( "loads", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) )
+    {
+      ImGui::TableSetupColumn( "Threads" );
+      ImGui::TableSetupColumn( "Total ms" );
+      ImGui::TableSetupColumn( "Parse" );
+      ImGui::TableSetupColumn( "Convert" );
+      ImGui::TableSetupColumn( "Meshlets" );
+      ImGui::TableSetupColumn( "Staging" );
+      ImGui::TableSetupColumn( "MB/s" );
+      ImGui::TableHeadersRow();
+      for ( auto const & result : bench.results )
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text( "%u", result.threads );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.cpuMs );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.parseMs );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.convertMs );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.meshletMs );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.1f", result.stagingMs );
+        ImGui::TableNextColumn();
+        ImGui::Text( "%.0f", result.cpuMs > 0.0 ? double( result.fileBytes ) / ( 1024.0 * 1024.0 ) / ( result.cpuMs * 1e-3 ) : 0.0 );
+      }
+      ImGui::EndTable();
+    }
+
+    ImGui::End();
+  }
 }  // namespace ui